@@ -0,0 +1,85 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: main.cc
+// -----------------------------------------------------------------------------
+//
+// See the basics of how a standalone HTTP server using WebForge works. This is
+// the same application as examples/hellocgi, served by wf::ServeHTTP instead.
+//
+// This server serves exactly one endpoint:
+// / - Serves a plain-text hello-world message.
+// All other requests are handled as a 404.
+//
+// The first command line argument, if given, is the address to listen on
+// (default 0.0.0.0:8080). The second one is the number of worker threads, where
+// 0 means one per CPU (default 1).
+//
+
+#include <iostream>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "webforge/http/http.h"
+#include "webforge/serve/http.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+absl::Status HelloWorld(wf::RequestPtr req, wf::ResponsePtr res) {
+  res->Header("Content-Type", "text/plain");
+  res->End("Hello, world!\n").IgnoreError();
+
+  return absl::OkStatus();
+}
+
+absl::Status NotFoundError(wf::RequestPtr req, wf::ResponsePtr res) {
+  res->Status(404);
+  res->Header("Content-Type", "text/plain");
+  res->Write("404 Not Found\n").IgnoreError();
+
+  if (res->Error().ok()) {
+    res->End();
+  } else {
+    res->Write(res->Error().ToString()).IgnoreError();
+    res->End("\n").IgnoreError();
+  }
+
+  return absl::OkStatus();
+}
+
+int main(int argc, char** argv) {
+  wf::Application app;
+
+  // Routes
+  app.Get("/", std::make_unique<wf::FProcessor>(HelloWorld));
+
+  // Error pages
+  app.Error(absl::StatusCode::kNotFound,
+            std::make_unique<wf::FProcessor>(NotFoundError));
+
+  wf::HTTPServerOptions options;
+  if (argc > 1) {
+    options.address = argv[1];
+  }
+
+  if (argc > 2 && !absl::SimpleAtoi(argv[2], &options.workers.count)) {
+    std::cerr << "invalid worker count: " << argv[2] << std::endl;
+    return 1;
+  }
+
+  return wf::ServeHTTP(&app, options);
+}
@@ -0,0 +1,210 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: commands.cc
+// -----------------------------------------------------------------------------
+//
+// This file implements the CLI's subcommands on top of the core library.
+//
+
+#include "webforge/commands.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+
+#include "webforge/core/asset_map.h"
+#include "webforge/core/minifier.h"
+#include "webforge/core/renderer.h"
+#include "webforge/flags.h"
+#include "webforge/site/fingerprint.h"
+#include "webforge/site/static_manifest.h"
+
+namespace wf {
+
+namespace {
+
+// Minifiable source types, by file extension.
+constexpr struct {
+  absl::string_view extension;
+  SourceType type;
+} kSourceTypes[] = {
+  {".html", SourceType::kHtml},
+  {".htm", SourceType::kHtml},
+  {".css", SourceType::kCss},
+  {".js", SourceType::kJavaScript},
+  {".xml", SourceType::kXml},
+};
+
+// Writes `data` to `out`, which is either a path or "pipe:<fd>".
+absl::Status WriteTo(absl::string_view out, absl::string_view data) {
+  absl::string_view pipe = out;
+  if (absl::ConsumePrefix(&pipe, "pipe:")) {
+    int fd;
+    if (!absl::SimpleAtoi(pipe, &fd)) {
+      return absl::InvalidArgumentError(absl::StrCat("bad output: ", out));
+    }
+
+    while (!data.empty()) {
+      ssize_t n = write(fd, data.data(), data.size());
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return absl::ErrnoToStatus(errno, "write() failed");
+      }
+
+      data.remove_prefix(n);
+    }
+
+    return absl::OkStatus();
+  }
+
+  std::ofstream file(std::string(out), std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+  if (!file) {
+    return absl::UnavailableError(absl::StrCat("cannot write to ", out));
+  }
+
+  return absl::OkStatus();
+}
+
+// Writes `data` to --out.
+absl::Status WriteOutput(absl::string_view data) {
+  return WriteTo(absl::GetFlag(FLAGS_out), data);
+}
+
+}
+
+absl::Status RunFingerprintCommand(const std::vector<char*>& args) {
+  if (args.size() != 1) {
+    return absl::InvalidArgumentError("usage: webforge fingerprint <dir>");
+  }
+
+  absl::StatusOr<AssetMap> assets = FingerprintStaticDirectory(args[0]);
+  if (!assets.ok()) {
+    return assets.status();
+  }
+
+  return WriteOutput(assets->Serialize());
+}
+
+absl::Status RunManifestCommand(const std::vector<char*>& args) {
+  if (args.size() != 1) {
+    return absl::InvalidArgumentError("usage: webforge manifest <dir>");
+  }
+
+  std::filesystem::path dir(args[0]);
+  absl::StatusOr<std::vector<ManifestEntry>> entries =
+    ScanStaticDirectory(dir);
+  if (!entries.ok()) {
+    return entries.status();
+  }
+
+  absl::StatusOr<std::string> manifest =
+    SerializeStaticManifest(entries.value());
+  if (!manifest.ok()) {
+    return manifest.status();
+  }
+
+  VLOG(1) << "Indexed " << entries->size() << " static files in " << dir;
+  return WriteOutput(manifest.value());
+}
+
+absl::Status RunRenderCommand(const std::vector<char*>& args) {
+  if (args.size() != 1) {
+    return absl::InvalidArgumentError("usage: webforge render <component>");
+  }
+
+  std::string component(args[0]);
+  Renderer renderer(absl::GetFlag(FLAGS_cd));
+
+  std::ostringstream rendered;
+  if (absl::GetFlag(FLAGS_render)) {
+    absl::Status s = renderer.Render(component, nullptr, {}, &rendered);
+    if (!s.ok()) {
+      return s;
+    }
+  } else {
+    std::ifstream is(renderer.SearchPath() / component, std::ios::binary);
+    if (!is.is_open()) {
+      return absl::NotFoundError(absl::StrCat("no such component ",
+                                              component));
+    }
+
+    rendered << is.rdbuf();
+  }
+
+  std::string output = rendered.str();
+  if (absl::GetFlag(FLAGS_minify)) {
+    for (const auto& source_type : kSourceTypes) {
+      if (!absl::EndsWith(component, source_type.extension)) {
+        continue;
+      }
+
+      Minifier minifier;
+      std::istringstream is(output);
+      std::ostringstream minified;
+      absl::Status s = minifier.Minify(source_type.type, &is, &minified);
+      if (!s.ok()) {
+        return s;
+      }
+
+      output = minified.str();
+      break;
+    }
+  }
+
+  absl::Status s = WriteOutput(output);
+  if (!s.ok()) {
+    return s;
+  }
+
+  std::string depout = absl::GetFlag(FLAGS_depout);
+  if (depout.empty()) {
+    return absl::OkStatus();
+  }
+
+  // The component comes first, then everything it includes or extends, one
+  // path per line.
+  std::string dependencies =
+    absl::StrCat((renderer.SearchPath() / component).string(), "\n");
+  for (const std::string& dependency : renderer.Dependencies(component)) {
+    absl::StrAppend(&dependencies,
+                    (renderer.SearchPath() / dependency).string(), "\n");
+  }
+
+  return WriteTo(depout, dependencies);
+}
+
+}
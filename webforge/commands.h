@@ -0,0 +1,50 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: commands.h
+// -----------------------------------------------------------------------------
+//
+// This header declares the CLI's subcommands. Each is invoked by main.cc with
+// the positional arguments that follow its name, after flags were parsed, and
+// writes its result to --out.
+//
+// - `webforge fingerprint <dir>` renames the static assets in <dir> to
+//   content-hashed names and writes the resulting wf::AssetMap (see
+//   webforge/site/fingerprint.h).
+// - `webforge manifest <dir>` writes a static manifest of <dir> (see
+//   webforge/site/static_manifest.h).
+// - `webforge render <component>` renders <component> from --cd, unless
+//   --render=false, and minifies it if --minify is set and its extension says
+//   what it is. With --depout, it also writes the paths of the component and
+//   every template it includes or extends, one per line.
+//
+
+#ifndef WEBFORGE_COMMANDS_H_
+#define WEBFORGE_COMMANDS_H_
+
+#include <vector>
+
+#include "absl/status/status.h"
+
+namespace wf {
+
+absl::Status RunFingerprintCommand(const std::vector<char*>& args);
+absl::Status RunManifestCommand(const std::vector<char*>& args);
+absl::Status RunRenderCommand(const std::vector<char*>& args);
+
+}
+
+#endif  // WEBFORGE_COMMANDS_H_
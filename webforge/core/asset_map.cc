@@ -0,0 +1,107 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: asset_map.cc
+// -----------------------------------------------------------------------------
+//
+// This file implements wf::AssetMap on top of nlohmann::json.
+//
+
+#include "webforge/core/asset_map.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include <nlohmann/json.hpp>
+
+namespace wf {
+
+AssetMap::AssetMap(absl::string_view base) :
+  base_(absl::StripSuffix(base, "/")) {
+  // Nothing to do.
+}
+
+absl::StatusOr<AssetMap> AssetMap::Load(const std::filesystem::path& path,
+                                        absl::string_view base) {
+  std::ifstream is(path);
+  if (!is.is_open()) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot open asset map %s", path.string()));
+  }
+
+  nlohmann::json json;
+  try {
+    json = nlohmann::json::parse(is);
+  } catch (nlohmann::json::exception& e) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("json parsing failed: %s", e.what()));
+  }
+
+  if (!json.is_object()) {
+    return absl::InvalidArgumentError("asset map must be a JSON object");
+  }
+
+  AssetMap map(base);
+  for (const auto& [name, fingerprinted] : json.items()) {
+    if (!fingerprinted.is_string()) {
+      return absl::InvalidArgumentError(
+        absl::StrFormat("asset map entry '%s' is not a string", name));
+    }
+
+    map.Add(name, fingerprinted.get<std::string>());
+  }
+
+  return map;
+}
+
+void AssetMap::Add(absl::string_view name, absl::string_view fingerprinted) {
+  names_[name] = std::string(fingerprinted);
+  fingerprinted_.insert(std::string(fingerprinted));
+}
+
+std::string AssetMap::URL(absl::string_view name) const {
+  name = absl::StripPrefix(name, "/");
+
+  auto it = names_.find(name);
+  if (it != names_.end()) {
+    name = it->second;
+  }
+
+  return absl::StrCat(base_, "/", name);
+}
+
+bool AssetMap::IsFingerprinted(absl::string_view path) const {
+  return fingerprinted_.contains(path);
+}
+
+std::string AssetMap::Serialize() const {
+  // nlohmann::json keeps object keys sorted, so equal maps serialize equally.
+  nlohmann::json json = nlohmann::json::object();
+  for (const auto& [name, fingerprinted] : names_) {
+    json[name] = fingerprinted;
+  }
+
+  return json.dump(2) + "\n";
+}
+
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: asset_map.h
+// -----------------------------------------------------------------------------
+//
+// wf::AssetMap maps the names of static assets (e.g. "css/app.css") to their
+// fingerprinted names (e.g. "css/app.3f9a1c2b.css"), which have a hash of
+// their content in them and so change whenever the content does. It is what
+// `webforge fingerprint` emits, and what the `asset()` template function (see
+// renderer.h) and wf::StaticMiddleware consult.
+//
+// On disk, a map is a JSON object from names to fingerprinted names.
+//
+
+#ifndef WEBFORGE_CORE_ASSET_MAP_H_
+#define WEBFORGE_CORE_ASSET_MAP_H_
+
+#include <filesystem>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace wf {
+
+class AssetMap {
+public:
+  // Creates an empty map, whose URLs start with `base`.
+  explicit AssetMap(absl::string_view base = "/");
+
+  // Loads a map written by Serialize(). `base` is the URL path the assets are
+  // served at, as given to wf::StaticMiddleware.
+  static absl::StatusOr<AssetMap> Load(const std::filesystem::path& path,
+                                       absl::string_view base = "/");
+
+  void Add(absl::string_view name, absl::string_view fingerprinted);
+
+  // Returns the URL of the asset `name`. Assets that aren't in the map keep
+  // their name, so that templates work the same before assets are
+  // fingerprinted.
+  std::string URL(absl::string_view name) const;
+
+  // Whether `path`, relative to the asset directory, is a fingerprinted name.
+  bool IsFingerprinted(absl::string_view path) const;
+
+  // Returns the map as JSON, with its keys sorted.
+  std::string Serialize() const;
+
+private:
+  std::string base_;
+  absl::flat_hash_map<std::string, std::string> names_;
+  absl::flat_hash_set<std::string> fingerprinted_;
+};
+
+}
+
+#endif  // WEBFORGE_CORE_ASSET_MAP_H_
@@ -18,60 +18,47 @@
 // -----------------------------------------------------------------------------
 //
 // This file implements the wf::Renderer class as a caching wrapper around
-// inja::Environment.
+// inja::Parser and inja::Renderer.
 //
 
 #include "webforge/core/renderer.h"
 
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include <inja/inja.hpp>
 #include <nlohmann/json.hpp>
 
+#include "webforge/core/asset_map.h"
 #include "webforge/core/data.pb.h"
+#include "webforge/core/template_cache.h"
 
 namespace wf {
 
 Renderer::Renderer(const std::filesystem::path& search_path) :
-  search_path_(search_path) {
-  // By default, we don't want to escape HTML strings. The RenderHTML function
-  // interacts with this part of inja, and the rest of the code makes the
-  // assumption that strings will not be HTML-escaped.
-  env_.set_html_autoescape(false);
-
-  // Tell inja::Environment we want to be in charge of included/extended
-  // template lookups.
-  env_.set_search_included_templates_in_files(false);
-
-  env_.set_include_callback([this, search_path]
-                            (const std::filesystem::path& current_path,
-                             absl::string_view name) {
-    // search_path + name or else throw (I hate throw but it is what it is)
-    std::filesystem::path new_path(search_path / name);
-
-    std::ifstream is(new_path.string());
-    if (!is.is_open()) {
-      throw inja::InjaError("file_error",
-        absl::StrFormat("no such template '%s'", name));
+  search_path_(search_path), cache_(std::make_shared<const Cache>()) {
+  functions_.add_callback("asset", 1, [this](inja::Arguments& args) {
+    std::string name = args.at(0)->get<std::string>();
+    if (assets_ == nullptr) {
+      return nlohmann::json(name);
     }
 
-    absl::StatusOr<const inja::Template> s_tmpl = CacheHitOrParse(name, &is);
-    if (!s_tmpl.ok()) {
-      throw inja::InjaError("parser_error",
-        std::string(s_tmpl.status().message()));
-    }
-
-    return s_tmpl.value();
+    return nlohmann::json(assets_->URL(name));
   });
 }
 
@@ -79,12 +66,20 @@ absl::Status Renderer::Render(absl::string_view key,
                               std::istream* component,
                               const std::vector<wf::proto::Data>& data,
                               std::ostream* output) {
-  absl::StatusOr<const inja::Template> s_tmpl = CacheHitOrParse(key,
-                                                                component);
+  return Render(key, component, data, RenderOptions(), output);
+}
+
+absl::Status Renderer::Render(absl::string_view key,
+                              std::istream* component,
+                              const std::vector<wf::proto::Data>& data,
+                              const RenderOptions& options,
+                              std::ostream* output) {
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> s_tmpl =
+    CacheHitOrParse(key, component);
   if (!s_tmpl.ok()) {
     return s_tmpl.status();
   }
-  const inja::Template& tmpl = s_tmpl.value();
+  const CompiledTemplate& compiled = *s_tmpl.value();
 
   nlohmann::json render_payload({});
   absl::Status s = PopulateRenderPayload(&render_payload, data);
@@ -92,8 +87,12 @@ absl::Status Renderer::Render(absl::string_view key,
     return s;
   }
 
+  inja::RenderConfig config;
+  config.html_autoescape = options.html_autoescape;
+
   try {
-    env_.render_to(*output, tmpl, render_payload);
+    inja::Renderer(config, compiled.includes, functions_)
+      .render_to(*output, compiled.tmpl, render_payload);
   } catch (const inja::InjaError& e) {
     return absl::AbortedError(std::string("failed to render template: ") +
                               e.what());
@@ -106,15 +105,92 @@ absl::Status Renderer::RenderHTML(absl::string_view key,
                                   std::istream* component,
                                   const std::vector<wf::proto::Data>& data,
                                   std::ostream* output) {
-  env_.set_html_autoescape(true);
-  absl::Status s = Render(key, component, data, output);
-  env_.set_html_autoescape(false);
-  return s;
+  RenderOptions options;
+  options.html_autoescape = true;
+  return Render(key, component, data, options, output);
 }
 
 void Renderer::FlushCache() {
-  // Nice and easy :)
-  template_cache_.clear();
+  // Renders in progress keep the snapshot they started with.
+  absl::MutexLock lock(&parse_mutex_);
+  Publish(std::make_shared<const Cache>());
+}
+
+void Renderer::Invalidate(absl::string_view key) {
+  absl::MutexLock lock(&parse_mutex_);
+  std::shared_ptr<const Cache> current = Snapshot();
+
+  // Walk the reverse dependencies to find everything that has `key` built in.
+  std::vector<std::string> stale = {std::string(key)};
+  absl::flat_hash_set<std::string> seen = {std::string(key)};
+  bool cached = false;
+  for (std::size_t i = 0; i < stale.size(); ++i) {
+    cached = cached || current->templates.contains(stale[i]);
+
+    auto it = current->dependents.find(stale[i]);
+    if (it == current->dependents.end()) {
+      continue;
+    }
+
+    for (const std::string& dependent : it->second) {
+      if (seen.insert(dependent).second) {
+        stale.push_back(dependent);
+      }
+    }
+  }
+
+  // Only cached templates have edges, so there is nothing to do, and no reason
+  // to copy the cache, unless one of them is stale.
+  if (!cached) {
+    return;
+  }
+
+  std::shared_ptr<Cache> next = std::make_shared<Cache>(*current);
+
+  // Every dependent of a stale template is stale itself, so removing the stale
+  // templates' own edges leaves no edge behind that points at one of them.
+  for (const std::string& name : stale) {
+    auto it = next->templates.find(name);
+    if (it == next->templates.end()) {
+      continue;
+    }
+
+    for (const std::string& dependency : it->second->dependencies) {
+      auto dependents = next->dependents.find(dependency);
+      dependents->second.erase(name);
+      if (dependents->second.empty()) {
+        next->dependents.erase(dependents);
+      }
+    }
+
+    next->templates.erase(it);
+  }
+
+  Publish(std::move(next));
+}
+
+std::vector<std::string> Renderer::Dependencies(absl::string_view key) const {
+  std::shared_ptr<const Cache> cache = Snapshot();
+  auto it = cache->templates.find(key);
+  if (it == cache->templates.end()) {
+    return {};
+  }
+
+  // Includes are resolved transitively, and TemplateStorage is sorted.
+  std::vector<std::string> dependencies;
+  for (const auto& [name, tmpl] : it->second->includes) {
+    dependencies.push_back(name);
+  }
+
+  return dependencies;
+}
+
+void Renderer::UseAssetMap(std::shared_ptr<const AssetMap> assets) {
+  assets_ = std::move(assets);
+}
+
+void Renderer::UseTemplateCache(std::shared_ptr<const TemplateCache> cache) {
+  template_cache_ = std::move(cache);
 }
 
 const std::filesystem::path& Renderer::SearchPath() const {
@@ -183,15 +259,62 @@ absl::Status Renderer::PopulateRenderPayload(
   return absl::OkStatus();
 }
 
-absl::StatusOr<const inja::Template> Renderer::CacheHitOrParse(
-    absl::string_view key,
-    std::istream* is) {
-  std::ifstream ifs;
-  if (template_cache_.contains(key)) {
-    return template_cache_[key];
+absl::StatusOr<std::shared_ptr<const Renderer::CompiledTemplate>>
+Renderer::CacheHitOrParse(absl::string_view key, std::istream* is) {
+  std::shared_ptr<const Cache> cache = Snapshot();
+  auto it = cache->templates.find(key);
+  if (it != cache->templates.end()) {
+    return it->second;
+  }
+
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> s_tmpl;
+  std::vector<std::shared_ptr<const CompiledTemplate>> parsed;
+  {
+    // Cache miss! Another thread may have parsed the template while we waited
+    // for the lock, so look again before parsing.
+    absl::MutexLock lock(&parse_mutex_);
+    cache = Snapshot();
+    it = cache->templates.find(key);
+    if (it != cache->templates.end()) {
+      return it->second;
+    }
+
+    // Parsing a template may add its includes as well, so it goes into a copy
+    // of the snapshot, which replaces the current one only once it is
+    // complete.
+    std::shared_ptr<Cache> next = std::make_shared<Cache>(*cache);
+    s_tmpl = ParseLocked(next.get(), key, is);
+    parsed.swap(unstored_);
+    if (!s_tmpl.ok()) {
+      return s_tmpl.status();
+    }
+
+    Publish(std::move(next));
   }
 
-  // Cache miss!
+  // Writing to the template cache means creating directories and files, which
+  // other threads' cache misses shouldn't have to wait for. The cache is only
+  // an optimization, so failing to write to it is fine.
+  if (!parsed.empty()) {
+    std::vector<const inja::Template*> templates;
+    for (const std::shared_ptr<const CompiledTemplate>& compiled : parsed) {
+      templates.push_back(&compiled->tmpl);
+    }
+
+    template_cache_->Store(templates, lexer_config_).IgnoreError();
+  }
+
+  return s_tmpl;
+}
+
+absl::StatusOr<std::shared_ptr<const Renderer::CompiledTemplate>>
+Renderer::ParseLocked(Cache* cache, absl::string_view key, std::istream* is) {
+  auto it = cache->templates.find(key);
+  if (it != cache->templates.end()) {
+    return it->second;
+  }
+
+  std::ifstream ifs;
   if (is == nullptr) {
     ifs = std::ifstream(search_path_ / key);
     if (!ifs.is_open()) {
@@ -202,18 +325,110 @@ absl::StatusOr<const inja::Template> Renderer::CacheHitOrParse(
   }
 
   std::string src(std::istreambuf_iterator<char>(*is), {});
+  auto compiled = std::make_shared<CompiledTemplate>();
+
+  // A template that was parsed before, by this process or another, only needs
+  // its includes to be resolved again. If it can't be loaded for any reason,
+  // it is simply parsed.
+  std::vector<std::string> names;
+  absl::StatusOr<inja::Template> s_stored = absl::NotFoundError("no cache");
+  if (template_cache_ != nullptr) {
+    s_stored = template_cache_->Load(src, lexer_config_, functions_, &names);
+  }
 
-  try {
-    inja::Template t = env_.parse(src);
+  if (s_stored.ok()) {
+    compiled->tmpl = std::move(s_stored.value());
 
-    template_cache_[key] = t;
-  } catch (const inja::InjaError& e) {
-    return absl::AbortedError(std::string("failed to parse template: ") +
-                              e.what());
+    // The same as what inja::Parser does with each include it comes across.
+    for (const std::string& name : names) {
+      if (compiled->includes.find(name) != compiled->includes.end()) {
+        continue;
+      }
+
+      absl::StatusOr<std::shared_ptr<const CompiledTemplate>> s_included =
+        IncludeLocked(cache, compiled.get(), name);
+      if (!s_included.ok()) {
+        return absl::AbortedError(absl::StrCat("failed to parse template: ",
+                                               s_included.status().message()));
+      }
+
+      compiled->includes.emplace(name, s_included.value()->tmpl);
+    }
+  } else {
+    // We want to be in charge of included/extended template lookups, so that
+    // they come from the search path and are cached like any other template.
+    // Each include is resolved here, once: the included template and
+    // everything it includes in turn are copied into this template's own
+    // storage, which is all that inja looks at when rendering it.
+    inja::ParserConfig config;
+    config.search_included_templates_in_files = false;
+    config.include_callback = [this, cache, compiled](
+                                const std::filesystem::path&,
+                                const std::string& name) {
+      // parse_mutex_ is still held by whoever called ParseLocked() on `cache`.
+      parse_mutex_.AssertHeld();
+      absl::StatusOr<std::shared_ptr<const CompiledTemplate>> s_included =
+        IncludeLocked(cache, compiled.get(), name);
+      if (absl::IsNotFound(s_included.status())) {
+        throw inja::InjaError("file_error",
+          absl::StrFormat("no such template '%s'", name));
+      } else if (!s_included.ok()) {
+        // I hate throw but it is what it is
+        throw inja::InjaError("parser_error",
+          std::string(s_included.status().message()));
+      }
+
+      return s_included.value()->tmpl;
+    };
+
+    try {
+      inja::Parser parser(config, lexer_config_, compiled->includes,
+                          functions_);
+      compiled->tmpl = parser.parse(src, "");
+    } catch (const inja::InjaError& e) {
+      return absl::AbortedError(std::string("failed to parse template: ") +
+                                e.what());
+    }
+
+    // Stored by CacheHitOrParse() once the lock is released.
+    if (template_cache_ != nullptr) {
+      unstored_.push_back(compiled);
+    }
   }
 
-  return template_cache_[key];
+  for (const std::string& dependency : compiled->dependencies) {
+    cache->dependents[dependency].insert(std::string(key));
+  }
+
+  cache->templates[key] = compiled;
+  return compiled;
+}
+
+absl::StatusOr<std::shared_ptr<const Renderer::CompiledTemplate>>
+Renderer::IncludeLocked(Cache* cache, CompiledTemplate* compiled,
+                        const std::string& name) {
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> s_tmpl =
+    ParseLocked(cache, name, nullptr);
+  if (!s_tmpl.ok()) {
+    return s_tmpl.status();
+  }
+
+  const CompiledTemplate& included = *s_tmpl.value();
+  compiled->dependencies.push_back(name);
+  compiled->includes.insert(included.includes.begin(),
+                            included.includes.end());
+  return s_tmpl;
 }
 
+std::shared_ptr<const Renderer::Cache> Renderer::Snapshot() const {
+  absl::ReaderMutexLock lock(&cache_mutex_);
+  return cache_;
 }
 
+void Renderer::Publish(std::shared_ptr<const Cache> cache) {
+  // The old snapshot is freed by whichever render lets go of it last.
+  absl::MutexLock lock(&cache_mutex_);
+  cache_ = std::move(cache);
+}
+
+}
@@ -23,32 +23,59 @@
 // which it refers, was to render HTML components into complete documents. Inja,
 // however, is sufficiently genericized that we can use it on any file type.
 //
-// The wf::Renderer class acts as a mature wrapper around inja::Environment,
-// which manages templates, optional HTML autoescaping, and piping
+// The wf::Renderer class acts as a mature wrapper around Inja's parser and
+// renderer, which manages templates, optional HTML autoescaping, and piping
 // automatically. This class is designed to exist for the lifetime of whatever
 // program that uses it, as inja::Template objects are cached for future reuse
 // (unless explicitly Flush'd).
 //
+// A Renderer is thread-safe, and one instance is meant to be shared by every
+// thread that renders. Parsed templates are immutable and live in a snapshot
+// of the cache that is replaced, never modified, whenever a template is added
+// (read-copy-update). Renders only share ownership of the template they use,
+// so they never wait for each other, and a render that overlaps FlushCache()
+// finishes with the templates it started with. Options such as autoescaping
+// are passed to each render instead of being stored in the Renderer.
+//
+// Besides Inja's own functions, templates can call `asset("app.css")`, which
+// resolves to the URL of a static asset through a wf::AssetMap (see
+// UseAssetMap()), so that pages link to fingerprinted names.
+//
+// Parsed templates can also be kept on disk with a wf::TemplateCache (see
+// UseTemplateCache()), so that a new process loads them instead of parsing
+// them again.
+//
 
 #ifndef WEBFORGE_CORE_RENDERER_H_
 #define WEBFORGE_CORE_RENDERER_H_
 
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include <inja/inja.hpp>
 #include <nlohmann/json.hpp>
 
+#include "webforge/core/asset_map.h"
 #include "webforge/core/data.pb.h"
+#include "webforge/core/template_cache.h"
 
 namespace wf {
 
+struct RenderOptions {
+  // Whether strings from the data are HTML-escaped.
+  bool html_autoescape = false;
+};
+
 class Renderer {
 public:
   Renderer(const std::filesystem::path& search_path = ".");
@@ -65,6 +92,13 @@ public:
                       const std::vector<wf::proto::Data>& data,
                       std::ostream* output);
 
+  // Same as above, but renders with `options`.
+  absl::Status Render(absl::string_view key,
+                      std::istream* component,
+                      const std::vector<wf::proto::Data>& data,
+                      const RenderOptions& options,
+                      std::ostream* output);
+
   // Same as Render() but HTML-escapes strings
   absl::Status RenderHTML(absl::string_view key,
                           std::istream* component,
@@ -72,10 +106,51 @@ public:
                           std::ostream* output);
 
   void FlushCache();
+
+  // Drops `key` from the cache, along with every cached template that includes
+  // or extends it, directly or not, so that only those are parsed again when
+  // they are next rendered. Templates that don't depend on `key` stay cached.
+  void Invalidate(absl::string_view key);
+
+  // Returns the names of the templates that `key` includes or extends,
+  // directly or not, in sorted order. Only cached templates are known, so this
+  // is empty unless `key` was rendered (and not invalidated) before.
+  std::vector<std::string> Dependencies(absl::string_view key) const;
+
+  // Makes `asset()` resolve names through `assets`. Without a map, it returns
+  // the names it is given. Not thread-safe; call it before rendering.
+  void UseAssetMap(std::shared_ptr<const AssetMap> assets);
+
+  // Loads templates from `cache` when they were parsed before, and stores the
+  // ones that weren't. Not thread-safe; call it before rendering.
+  void UseTemplateCache(std::shared_ptr<const TemplateCache> cache);
   
   const std::filesystem::path& SearchPath() const;
 
 private:
+  // A parsed template, along with every template that it includes or extends,
+  // directly or not. Includes are resolved once, when the template is parsed,
+  // so rendering never has to look past `includes`.
+  struct CompiledTemplate {
+    inja::Template tmpl;
+    inja::TemplateStorage includes;
+
+    // The templates that this one includes or extends itself.
+    std::vector<std::string> dependencies;
+  };
+
+  // One immutable generation of the template cache. Copying it copies pointers
+  // to the templates, and the names in the dependency graph.
+  struct Cache {
+    absl::flat_hash_map<std::string,
+                        std::shared_ptr<const CompiledTemplate>> templates;
+
+    // The reverse of CompiledTemplate::dependencies: for each template, the
+    // cached templates that include or extend it themselves.
+    absl::flat_hash_map<std::string,
+                        absl::flat_hash_set<std::string>> dependents;
+  };
+
   absl::Status ExpandRenderValue(nlohmann::json* json_value,
                                  const wf::proto::RenderValue& value);
 
@@ -83,19 +158,54 @@ private:
   absl::Status PopulateRenderPayload(nlohmann::json* payload,
                                      const std::vector<wf::proto::Data>& data);
 
-  // Checks cache to see if template was already parsed, or parses it.
+  // Checks cache to see if template was already parsed, or parses it. A cache
+  // hit only shares ownership of the template, and the template stays valid
+  // even if the cache is flushed.
   //
   // This function may fail if the input template source is malformed in any way
   // that causes it to fail parsing. No cache activity will result in errors.
-  absl::StatusOr<const inja::Template> CacheHitOrParse(
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> CacheHitOrParse(
     absl::string_view key,
     std::istream* is
   );
 
-  inja::Environment env_;
+  // Parses a template into `cache`, a copy of the current snapshot that hasn't
+  // been published yet. Includes are parsed into it as well.
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> ParseLocked(
+    Cache* cache,
+    absl::string_view key,
+    std::istream* is
+  ) ABSL_EXCLUSIVE_LOCKS_REQUIRED(parse_mutex_);
+
+  // Parses `name` into `cache` as an include of `compiled`, and adds it and
+  // its own includes to those of `compiled`.
+  absl::StatusOr<std::shared_ptr<const CompiledTemplate>> IncludeLocked(
+    Cache* cache,
+    CompiledTemplate* compiled,
+    const std::string& name
+  ) ABSL_EXCLUSIVE_LOCKS_REQUIRED(parse_mutex_);
+
+  std::shared_ptr<const Cache> Snapshot() const;
+  void Publish(std::shared_ptr<const Cache> cache);
+
+  inja::LexerConfig lexer_config_;
+  inja::FunctionStorage functions_;
 
   std::filesystem::path search_path_;
-  absl::flat_hash_map<std::string, inja::Template> template_cache_;
+  std::shared_ptr<const AssetMap> assets_;
+  std::shared_ptr<const TemplateCache> template_cache_;
+
+  // Serializes writers of the cache, which copy and replace the snapshot.
+  absl::Mutex parse_mutex_;
+
+  // Templates parsed by ParseLocked() that are yet to be written to
+  // template_cache_.
+  std::vector<std::shared_ptr<const CompiledTemplate>> unstored_
+    ABSL_GUARDED_BY(parse_mutex_);
+
+  // Only guards swapping the pointer; snapshots themselves are never modified.
+  mutable absl::Mutex cache_mutex_;
+  std::shared_ptr<const Cache> cache_ ABSL_GUARDED_BY(cache_mutex_);
 };
 
 }
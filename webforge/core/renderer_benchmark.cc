@@ -0,0 +1,223 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: renderer_benchmark.cc
+// -----------------------------------------------------------------------------
+//
+// Measures how rendering scales when many threads share one wf::Renderer, as
+// the threads of a serve target do. The page includes two other templates, so
+// every render also reads includes from the shared cache, and half of the
+// threads render with HTML autoescaping.
+//
+// Also measures include-heavy pages, made of many components that each include
+// another one, both from a warm cache and parsed from scratch. Cold renders are
+// measured once with every template parsed, and once with every template
+// loaded from a warm wf::TemplateCache, as after a restart.
+//
+// Run with:
+//   bazel run -c opt //webforge/core:renderer_benchmark
+//
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include <benchmark/benchmark.h>
+
+#include "webforge/core/data.pb.h"
+#include "webforge/core/renderer.h"
+#include "webforge/core/template_cache.h"
+
+namespace {
+
+constexpr int kMaxComponents = 256;
+
+// Writes the templates once, and returns the directory they are in.
+const std::filesystem::path& TemplateDir() {
+  static const std::filesystem::path* dir = [] {
+    auto dir = new std::filesystem::path(
+      std::filesystem::temp_directory_path() /
+      absl::StrCat("renderer_benchmark.", getpid()));
+    std::filesystem::create_directories(*dir);
+
+    std::ofstream(*dir / "header.html") << "<header>{{ title }}</header>\n";
+    std::ofstream(*dir / "footer.html") << "<footer>{{ footer }}</footer>\n";
+    std::ofstream(*dir / "page.html") <<
+      "<html>{% include \"header.html\" %}<ul>\n"
+      "{% for item in items %}<li>{{ loop.index }}: {{ item }}</li>\n"
+      "{% endfor %}</ul>{% include \"footer.html\" %}</html>\n";
+
+    // components<n>.html includes n components, which all include icon.html.
+    std::ofstream(*dir / "icon.html") << "<i class=\"icon\"></i>";
+    std::string page;
+    for (int i = 0; i < kMaxComponents; ++i) {
+      std::ofstream(*dir / absl::StrCat("component", i, ".html")) <<
+        "<div class=\"component\">{% include \"icon.html\" %}"
+        "<h2>{{ title }}</h2><p>{{ footer }}</p></div>\n";
+
+      absl::StrAppend(&page, "{% include \"component", i, ".html\" %}");
+      if (((i + 1) & i) == 0) {
+        std::ofstream(*dir / absl::StrCat("components", i + 1, ".html")) <<
+          "<html>" << page << "</html>\n";
+      }
+    }
+
+    return dir;
+  }();
+
+  return *dir;
+}
+
+// Returns the Renderer that every thread shares.
+wf::Renderer* SharedRenderer() {
+  static wf::Renderer* renderer = new wf::Renderer(TemplateDir());
+  return renderer;
+}
+
+std::vector<wf::proto::Data> PageData() {
+  wf::proto::Data title;
+  title.set_key("title");
+  title.mutable_value()->set_text("Benchmark <page>");
+
+  wf::proto::Data footer;
+  footer.set_key("footer");
+  footer.mutable_value()->set_text("Rendered & shared");
+
+  wf::proto::Data items;
+  items.set_key("items");
+  for (int i = 0; i < 20; ++i) {
+    items.mutable_value()->mutable_vector()->add_vector()
+      ->set_text(absl::StrCat("item <", i, ">"));
+  }
+
+  return {title, footer, items};
+}
+
+void BM_SharedRender(benchmark::State& state) {
+  wf::Renderer* renderer = SharedRenderer();
+  std::vector<wf::proto::Data> data = PageData();
+
+  wf::RenderOptions options;
+  options.html_autoescape = state.thread_index() % 2 == 0;
+
+  for (auto _ : state) {
+    std::ostringstream output;
+    absl::Status s = renderer->Render("page.html", nullptr, data, options,
+                                      &output);
+    if (!s.ok()) {
+      state.SkipWithError(std::string(s.message()).c_str());
+      return;
+    }
+
+    benchmark::DoNotOptimize(output);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Renders a page that includes state.range(0) components from a warm cache.
+void BM_IncludeHeavyRender(benchmark::State& state) {
+  wf::Renderer renderer(TemplateDir());
+  std::vector<wf::proto::Data> data = PageData();
+  std::string page = absl::StrCat("components", state.range(0), ".html");
+
+  for (auto _ : state) {
+    std::ostringstream output;
+    absl::Status s = renderer.Render(page, nullptr, data, &output);
+    if (!s.ok()) {
+      state.SkipWithError(std::string(s.message()).c_str());
+      return;
+    }
+
+    benchmark::DoNotOptimize(output);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same as above, but every iteration parses the page and its components again.
+void BM_IncludeHeavyParse(benchmark::State& state) {
+  wf::Renderer renderer(TemplateDir());
+  std::vector<wf::proto::Data> data = PageData();
+  std::string page = absl::StrCat("components", state.range(0), ".html");
+
+  for (auto _ : state) {
+    renderer.FlushCache();
+
+    std::ostringstream output;
+    absl::Status s = renderer.Render(page, nullptr, data, &output);
+    if (!s.ok()) {
+      state.SkipWithError(std::string(s.message()).c_str());
+      return;
+    }
+
+    benchmark::DoNotOptimize(output);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same as above, but templates are loaded from a wf::TemplateCache that already
+// holds all of them, instead of being parsed.
+void BM_IncludeHeavyLoad(benchmark::State& state) {
+  wf::Renderer renderer(TemplateDir());
+  std::vector<wf::proto::Data> data = PageData();
+  std::string page = absl::StrCat("components", state.range(0), ".html");
+
+  std::filesystem::path cache_dir =
+    std::filesystem::temp_directory_path() /
+    absl::StrCat("renderer_benchmark_cache.", getpid());
+  renderer.UseTemplateCache(std::make_shared<wf::TemplateCache>(cache_dir));
+
+  // Fills the template cache.
+  std::ostringstream warmup;
+  absl::Status s = renderer.Render(page, nullptr, data, &warmup);
+  if (!s.ok()) {
+    state.SkipWithError(std::string(s.message()).c_str());
+    return;
+  }
+
+  for (auto _ : state) {
+    renderer.FlushCache();
+
+    std::ostringstream output;
+    s = renderer.Render(page, nullptr, data, &output);
+    if (!s.ok()) {
+      state.SkipWithError(std::string(s.message()).c_str());
+      return;
+    }
+
+    benchmark::DoNotOptimize(output);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+BENCHMARK(BM_SharedRender)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_IncludeHeavyRender)->RangeMultiplier(4)->Range(1, kMaxComponents);
+BENCHMARK(BM_IncludeHeavyParse)->RangeMultiplier(4)->Range(1, kMaxComponents);
+BENCHMARK(BM_IncludeHeavyLoad)->RangeMultiplier(4)->Range(1, kMaxComponents);
+
+BENCHMARK_MAIN();
@@ -23,15 +23,33 @@
 
 #include "webforge/core/renderer.h"
 
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/status_matchers.h"
 #include <gtest/gtest.h>
 
+#include "webforge/core/asset_map.h"
 #include "webforge/core/data.pb.h"
 
+// Returns an empty directory of the current test's own, so that tests don't
+// see each other's templates.
+std::filesystem::path TestDir() {
+  const testing::TestInfo* info =
+    testing::UnitTest::GetInstance()->current_test_info();
+  std::filesystem::path dir = std::filesystem::path(testing::TempDir()) /
+                              info->test_suite_name() / info->name();
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
 class RendererTest : public testing::Test {
 protected:
   wf::Renderer renderer_;
@@ -126,6 +144,138 @@ TEST_F(RendererTest, CanRenderNestedObjects) {
   EXPECT_EQ(output.str(), "Text 123 3.14 1 2 3 ");
 }
 
+TEST_F(RendererTest, CanResolveAssets) {
+  std::istringstream src("{{ asset(\"app.css\") }} {{ asset(\"app.js\") }}");
+  std::ostringstream output;
+
+  absl::Status render_status = renderer_.Render("foo", &src, {}, &output);
+  ASSERT_THAT(render_status, absl_testing::IsOk());
+
+  EXPECT_EQ(output.str(), "app.css app.js");
+
+  auto assets = std::make_shared<wf::AssetMap>("/static");
+  assets->Add("app.css", "app.3f9a1c2b.css");
+  renderer_.UseAssetMap(assets);
+
+  output.str("");
+  render_status = renderer_.Render("foo", nullptr, {}, &output);
+  ASSERT_THAT(render_status, absl_testing::IsOk());
+
+  EXPECT_EQ(output.str(), "/static/app.3f9a1c2b.css /static/app.js");
+}
+
+TEST(RendererIncludeTest, CanIncludeNestedTemplates) {
+  std::filesystem::path dir = TestDir();
+  std::ofstream(dir / "layout.html") << "[{% block body %}{% endblock %}]";
+  std::ofstream(dir / "outer.html") << "<{% include \"inner.html\" %}>";
+  std::ofstream(dir / "inner.html") << "{{ name }}";
+
+  wf::Renderer renderer(dir);
+  wf::proto::Data name;
+  name.set_key("name");
+  name.mutable_value()->set_text("world");
+
+  // The page only names outer.html, which brings inner.html along.
+  std::istringstream src("{% extends \"layout.html\" %}"
+                         "{% block body %}{% include \"outer.html\" %}"
+                         "{% endblock %}");
+  std::ostringstream output;
+  absl::Status render_status = renderer.Render("page", &src, {name}, &output);
+  ASSERT_THAT(render_status, absl_testing::IsOk());
+
+  EXPECT_EQ(output.str(), "[<world>]");
+
+  // Includes were resolved when they were parsed, so cached templates don't
+  // see edits until the cache is flushed.
+  std::ofstream(dir / "inner.html") << "{{ name }}!";
+  output.str("");
+  render_status = renderer.Render("outer.html", nullptr, {name}, &output);
+  ASSERT_THAT(render_status, absl_testing::IsOk());
+
+  EXPECT_EQ(output.str(), "<world>");
+
+  renderer.FlushCache();
+  output.str("");
+  render_status = renderer.Render("outer.html", nullptr, {name}, &output);
+  ASSERT_THAT(render_status, absl_testing::IsOk());
+
+  EXPECT_EQ(output.str(), "<world!>");
+}
+
+TEST(RendererIncludeTest, CanInvalidateDependents) {
+  std::filesystem::path dir = TestDir();
+  std::ofstream(dir / "base.html") << "base";
+  std::ofstream(dir / "middle.html") << "{% include \"base.html\" %}+middle";
+  std::ofstream(dir / "top.html") << "{% include \"middle.html\" %}+top";
+  std::ofstream(dir / "other.html") << "other";
+
+  wf::Renderer renderer(dir);
+  for (const char* name : {"top.html", "other.html"}) {
+    std::ostringstream output;
+    ASSERT_THAT(renderer.Render(name, nullptr, {}, &output),
+                absl_testing::IsOk());
+  }
+
+  EXPECT_EQ(renderer.Dependencies("top.html"),
+            std::vector<std::string>({"base.html", "middle.html"}));
+  EXPECT_EQ(renderer.Dependencies("other.html"), std::vector<std::string>());
+
+  std::ofstream(dir / "base.html") << "BASE";
+  std::ofstream(dir / "other.html") << "OTHER";
+  renderer.Invalidate("base.html");
+
+  // Everything built on base.html is parsed again, but other.html isn't.
+  std::ostringstream output;
+  ASSERT_THAT(renderer.Render("top.html", nullptr, {}, &output),
+              absl_testing::IsOk());
+  EXPECT_EQ(output.str(), "BASE+middle+top");
+
+  output.str("");
+  ASSERT_THAT(renderer.Render("other.html", nullptr, {}, &output),
+              absl_testing::IsOk());
+  EXPECT_EQ(output.str(), "other");
+}
+
+TEST(RendererThreadTest, CanRenderConcurrently) {
+  std::filesystem::path dir = TestDir();
+  std::ofstream(dir / "page.html") << "<p>{% include \"inner.html\" %}</p>";
+  std::ofstream(dir / "inner.html") << "{{ content }}";
+
+  wf::Renderer renderer(dir);
+  wf::proto::Data content;
+  content.set_key("content");
+  content.mutable_value()->set_text("<b>");
+
+  // Half of the threads escape HTML and half don't, and none of them may see
+  // the other half's option. Every fourth iteration flushes the cache under
+  // the feet of the others.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&renderer, &content, t] {
+      wf::RenderOptions options;
+      options.html_autoescape = t % 2 == 0;
+
+      for (int i = 0; i < 100; ++i) {
+        if (t == 0 && i % 4 == 0) {
+          renderer.FlushCache();
+        }
+
+        std::ostringstream output;
+        absl::Status render_status = renderer.Render("page.html", nullptr,
+                                                     {content}, options,
+                                                     &output);
+        ASSERT_THAT(render_status, absl_testing::IsOk());
+        EXPECT_EQ(output.str(), options.html_autoescape ? "<p>&lt;b&gt;</p>"
+                                                        : "<p><b></p>");
+      }
+    });
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
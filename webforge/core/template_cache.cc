@@ -0,0 +1,1060 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_cache.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::TemplateCache, and the conversion between inja's syntax tree
+// and the flat form it is stored in.
+//
+// A stored template is its content, followed by its root block. A block is a
+// count followed by that many nodes, and a node is its kind, its position and
+// whatever else the kind calls for, in the order inja::Parser builds it.
+// Integers are 32 bits wide and strings are prefixed with their length. The
+// pack starts with a PackHeader, followed by an index of PackEntry sorted by
+// key, and then the templates. Everything is in host byte order, since a cache
+// is never shared between machines.
+//
+
+#include "webforge/core/template_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include <inja/inja.hpp>
+#include <nlohmann/json.hpp>
+
+namespace wf {
+
+namespace {
+
+// Bump whenever the stored form changes, and whenever inja is upgraded, since
+// the numbering of inja::FunctionStorage::Operation may change with it.
+constexpr uint32_t kFormatVersion = 2;
+
+constexpr char kPackMagic[4] = {'W', 'F', 'T', 'C'};
+
+// Deeper syntax trees than this are taken for corruption, rather than
+// recursing into them until the stack runs out.
+constexpr int kMaxDepth = 256;
+
+struct PackHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;  // Of PackEntry
+};
+
+struct PackEntry {
+  uint64_t key;  // See KeyFor()
+  uint64_t offset;  // From the start of the pack
+  uint64_t size;
+};
+
+enum class NodeKind : uint8_t {
+  kText = 1,
+  kLiteral,
+  kData,
+  kFunction,
+  kExpression,
+  kForArray,
+  kForObject,
+  kIf,
+  kInclude,
+  kExtends,
+  kBlock,
+  kSet,
+};
+
+// A 64-bit hash that, unlike absl::Hash, is the same in every process. Every
+// load hashes the whole template, so it takes eight bytes at a time.
+class KeyHasher {
+public:
+  void Update(absl::string_view data) {
+    // The length keeps "ab" + "c" apart from "a" + "bc".
+    std::size_t length = data.size();
+    while (data.size() >= sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, data.data(), sizeof(word));
+      Mix(word);
+      data.remove_prefix(sizeof(word));
+    }
+
+    uint64_t rest = 0;
+    memcpy(&rest, data.data(), data.size());
+    Mix(rest);
+    Mix(length);
+  }
+
+  uint64_t Finish() const {
+    return hash_;
+  }
+
+private:
+  void Mix(uint64_t word) {
+    hash_ = (hash_ ^ word) * 0x9e3779b97f4a7c15;
+    hash_ ^= hash_ >> 29;
+  }
+
+  uint64_t hash_ = 0xcbf29ce484222325;
+};
+
+// Identifies `content` as parsed with `lexer_config` in the pack.
+uint64_t KeyFor(absl::string_view content,
+                const inja::LexerConfig& lexer_config) {
+  KeyHasher hasher;
+  for (const std::string* delimiter : {
+         &lexer_config.statement_open,
+         &lexer_config.statement_open_no_lstrip,
+         &lexer_config.statement_open_force_lstrip,
+         &lexer_config.statement_close,
+         &lexer_config.statement_close_force_rstrip,
+         &lexer_config.line_statement,
+         &lexer_config.expression_open,
+         &lexer_config.expression_open_force_lstrip,
+         &lexer_config.expression_close,
+         &lexer_config.expression_close_force_rstrip,
+         &lexer_config.comment_open,
+         &lexer_config.comment_open_force_lstrip,
+         &lexer_config.comment_close,
+         &lexer_config.comment_close_force_rstrip,
+       }) {
+    hasher.Update(*delimiter);
+  }
+
+  char flags[2] = {lexer_config.trim_blocks, lexer_config.lstrip_blocks};
+  hasher.Update(absl::string_view(flags, sizeof(flags)));
+  hasher.Update(content);
+  return hasher.Finish();
+}
+
+// A read-only mapping of a whole cache file. Cache files are only ever
+// replaced, never written in place, so the mapping stays valid.
+class Mapping {
+public:
+  static absl::StatusOr<std::unique_ptr<Mapping>> Open(
+    const std::filesystem::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return absl::ErrnoToStatus(errno, absl::StrCat("cannot open ",
+                                                     path.string()));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      absl::Status s = absl::ErrnoToStatus(errno, "fstat() failed");
+      close(fd);
+      return s;
+    }
+
+    if (st.st_size == 0) {
+      // mmap(2) refuses empty mappings.
+      close(fd);
+      return std::unique_ptr<Mapping>(new Mapping(nullptr, 0));
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap() failed");
+    }
+
+    return std::unique_ptr<Mapping>(new Mapping(data, st.st_size));
+  }
+
+  ~Mapping() {
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  absl::string_view Contents() const {
+    return absl::string_view(static_cast<const char*>(data_), size_);
+  }
+
+private:
+  Mapping(void* data, std::size_t size) : data_(data), size_(size) {
+    // Nothing to do.
+  }
+
+  void* data_;
+  std::size_t size_;
+};
+
+// Reads the integers and strings of a stored template. Every read fails once
+// the data runs out.
+class Reader {
+public:
+  explicit Reader(absl::string_view data) : data_(data) {
+    // Nothing to do.
+  }
+
+  bool U8(uint8_t* value) {
+    if (data_.empty()) {
+      return false;
+    }
+
+    *value = static_cast<uint8_t>(data_.front());
+    data_.remove_prefix(1);
+    return true;
+  }
+
+  bool U32(uint32_t* value) {
+    if (data_.size() < sizeof(*value)) {
+      return false;
+    }
+
+    memcpy(value, data_.data(), sizeof(*value));
+    data_.remove_prefix(sizeof(*value));
+    return true;
+  }
+
+  bool String(absl::string_view* value) {
+    uint32_t size;
+    if (!U32(&size) || data_.size() < size) {
+      return false;
+    }
+
+    *value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool Done() const {
+    return data_.empty();
+  }
+
+private:
+  absl::string_view data_;
+};
+
+class Serializer : public inja::NodeVisitor {
+public:
+  explicit Serializer(std::string* out) : out_(out) {
+    // Nothing to do.
+  }
+
+  absl::Status Serialize(const inja::Template& tmpl) {
+    String(tmpl.content);
+    Block(tmpl.root);
+    return status_;
+  }
+
+private:
+  void U8(uint8_t value) {
+    out_->push_back(static_cast<char>(value));
+  }
+
+  void U32(uint64_t value) {
+    if (value > UINT32_MAX) {
+      Unsupported("templates of 4 GiB or more");
+    }
+
+    uint32_t narrow = static_cast<uint32_t>(value);
+    out_->append(reinterpret_cast<const char*>(&narrow), sizeof(narrow));
+  }
+
+  void String(absl::string_view value) {
+    U32(value.size());
+    out_->append(value.data(), value.size());
+  }
+
+  void Begin(NodeKind kind, const inja::AstNode& node) {
+    U8(static_cast<uint8_t>(kind));
+    U32(node.pos);
+  }
+
+  void Block(const inja::BlockNode& block) {
+    U32(block.nodes.size());
+    for (const auto& node : block.nodes) {
+      node->accept(*this);
+    }
+  }
+
+  void ExpressionRoot(const inja::ExpressionListNode& list) {
+    U8(list.root != nullptr);
+    if (list.root != nullptr) {
+      list.root->accept(*this);
+    }
+  }
+
+  void ExpressionList(const inja::ExpressionListNode& list) {
+    U32(list.pos);
+    ExpressionRoot(list);
+  }
+
+  void Unsupported(absl::string_view what) {
+    status_ = absl::UnimplementedError(absl::StrCat("cannot serialize ", what));
+  }
+
+  void visit(const inja::BlockNode& node) override {
+    Unsupported("nested block");
+  }
+
+  void visit(const inja::TextNode& node) override {
+    Begin(NodeKind::kText, node);
+    U32(node.length);
+  }
+
+  void visit(const inja::ExpressionNode& node) override {
+    Unsupported("bare expression");
+  }
+
+  void visit(const inja::LiteralNode& node) override {
+    Begin(NodeKind::kLiteral, node);
+    String(node.value.dump());
+  }
+
+  void visit(const inja::DataNode& node) override {
+    Begin(NodeKind::kData, node);
+    String(node.name);
+  }
+
+  void visit(const inja::FunctionNode& node) override {
+    Begin(NodeKind::kFunction, node);
+    String(node.name);
+    U32(static_cast<uint32_t>(node.operation));
+    U32(static_cast<uint32_t>(node.number_args));
+    U32(node.precedence);
+    U8(node.associativity == inja::FunctionNode::Associativity::Right);
+    U32(node.arguments.size());
+    for (const auto& argument : node.arguments) {
+      argument->accept(*this);
+    }
+  }
+
+  void visit(const inja::ExpressionListNode& node) override {
+    Begin(NodeKind::kExpression, node);
+    ExpressionRoot(node);
+  }
+
+  void visit(const inja::StatementNode& node) override {
+    Unsupported("bare statement");
+  }
+
+  void visit(const inja::ForStatementNode& node) override {
+    Unsupported("bare for statement");
+  }
+
+  void visit(const inja::ForArrayStatementNode& node) override {
+    Begin(NodeKind::kForArray, node);
+    String(node.value);
+    ExpressionList(node.condition);
+    Block(node.body);
+  }
+
+  void visit(const inja::ForObjectStatementNode& node) override {
+    Begin(NodeKind::kForObject, node);
+    String(node.key);
+    String(node.value);
+    ExpressionList(node.condition);
+    Block(node.body);
+  }
+
+  void visit(const inja::IfStatementNode& node) override {
+    Begin(NodeKind::kIf, node);
+    U8(node.is_nested);
+    U8(node.has_false_statement);
+    ExpressionList(node.condition);
+    Block(node.true_statement);
+    Block(node.false_statement);
+  }
+
+  void visit(const inja::IncludeStatementNode& node) override {
+    Begin(NodeKind::kInclude, node);
+    String(node.file);
+  }
+
+  void visit(const inja::ExtendsStatementNode& node) override {
+    Begin(NodeKind::kExtends, node);
+    String(node.file);
+  }
+
+  void visit(const inja::BlockStatementNode& node) override {
+    Begin(NodeKind::kBlock, node);
+    String(node.name);
+    Block(node.block);
+  }
+
+  void visit(const inja::SetStatementNode& node) override {
+    Begin(NodeKind::kSet, node);
+    String(node.key);
+    ExpressionList(node.expression);
+  }
+
+  std::string* out_;
+  absl::Status status_;
+};
+
+// Rebuilds the nodes of one template, the way inja::Parser would have.
+class Deserializer {
+public:
+  Deserializer(absl::string_view bytes, const inja::FunctionStorage& functions,
+               std::vector<std::string>* includes) :
+    reader_(bytes), functions_(functions), includes_(includes),
+    tmpl_(nullptr) {
+    // Nothing to do.
+  }
+
+  absl::StatusOr<inja::Template> Deserialize() {
+    absl::string_view content;
+    if (!reader_.String(&content)) {
+      return Corrupt();
+    }
+
+    inja::Template tmpl{std::string(content)};
+    tmpl_ = &tmpl;
+    absl::Status s = Block(&tmpl.root, 0);
+    if (s.ok() && !reader_.Done()) {
+      s = Corrupt();
+    }
+
+    if (!s.ok()) {
+      return s;
+    }
+
+    return tmpl;
+  }
+
+private:
+  static absl::Status Corrupt() {
+    return absl::DataLossError("corrupt compiled template");
+  }
+
+  // inja reads `length` bytes of the content at `pos` when rendering text, and
+  // the content up to `pos` when reporting errors, so both have to be within
+  // the content.
+  absl::Status CheckRange(uint64_t pos, uint64_t length = 0) const {
+    if (pos > tmpl_->content.size() ||
+        length > tmpl_->content.size() - pos) {
+      return absl::DataLossError("position out of range in compiled template");
+    }
+
+    return absl::OkStatus();
+  }
+
+  // Reads the kind and position that every node starts with.
+  absl::Status Begin(int depth, NodeKind* kind, std::size_t* pos) {
+    uint8_t kind_byte;
+    uint32_t pos_value;
+    if (depth > kMaxDepth || !reader_.U8(&kind_byte) ||
+        !reader_.U32(&pos_value)) {
+      return Corrupt();
+    }
+
+    *kind = static_cast<NodeKind>(kind_byte);
+    *pos = pos_value;
+    return CheckRange(pos_value);
+  }
+
+  absl::Status Block(inja::BlockNode* out, int depth) {
+    uint32_t count;
+    if (!reader_.U32(&count)) {
+      return Corrupt();
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      absl::StatusOr<std::shared_ptr<inja::AstNode>> s_node =
+        Node(out, depth + 1);
+      if (!s_node.ok()) {
+        return s_node.status();
+      }
+
+      out->nodes.push_back(std::move(s_node.value()));
+    }
+
+    return absl::OkStatus();
+  }
+
+  // Builds a node of the block `parent`.
+  absl::StatusOr<std::shared_ptr<inja::AstNode>> Node(inja::BlockNode* parent,
+                                                      int depth) {
+    NodeKind kind;
+    std::size_t pos;
+    absl::Status s = Begin(depth, &kind, &pos);
+    if (!s.ok()) {
+      return s;
+    }
+
+    absl::string_view name;
+    absl::string_view value;
+    switch (kind) {
+    case NodeKind::kText: {
+      uint32_t length;
+      if (!reader_.U32(&length)) {
+        return Corrupt();
+      }
+
+      s = CheckRange(pos, length);
+      if (!s.ok()) {
+        return s;
+      }
+
+      return std::make_shared<inja::TextNode>(pos, length);
+    }
+    case NodeKind::kExpression: {
+      auto node = std::make_shared<inja::ExpressionListNode>(pos);
+      s = ExpressionRoot(node.get(), depth);
+      if (!s.ok()) {
+        return s;
+      }
+
+      return node;
+    }
+    case NodeKind::kForArray:
+    case NodeKind::kForObject: {
+      std::shared_ptr<inja::ForStatementNode> node;
+      if (kind == NodeKind::kForObject) {
+        if (!reader_.String(&name) || !reader_.String(&value)) {
+          return Corrupt();
+        }
+
+        node = std::make_shared<inja::ForObjectStatementNode>(
+          std::string(name), std::string(value), parent, pos);
+      } else {
+        if (!reader_.String(&value)) {
+          return Corrupt();
+        }
+
+        node = std::make_shared<inja::ForArrayStatementNode>(
+          std::string(value), parent, pos);
+      }
+
+      s = ExpressionList(&node->condition, depth);
+      if (s.ok()) {
+        s = Block(&node->body, depth);
+      }
+
+      if (!s.ok()) {
+        return s;
+      }
+
+      return node;
+    }
+    case NodeKind::kIf: {
+      uint8_t is_nested;
+      uint8_t has_else;
+      if (!reader_.U8(&is_nested) || !reader_.U8(&has_else)) {
+        return Corrupt();
+      }
+
+      auto node = std::make_shared<inja::IfStatementNode>(is_nested != 0,
+                                                          parent, pos);
+      node->has_false_statement = has_else != 0;
+
+      s = ExpressionList(&node->condition, depth);
+      if (s.ok()) {
+        s = Block(&node->true_statement, depth);
+      }
+
+      if (s.ok()) {
+        s = Block(&node->false_statement, depth);
+      }
+
+      if (!s.ok()) {
+        return s;
+      }
+
+      return node;
+    }
+    case NodeKind::kInclude:
+    case NodeKind::kExtends:
+      if (!reader_.String(&name)) {
+        return Corrupt();
+      }
+
+      includes_->emplace_back(name);
+      if (kind == NodeKind::kInclude) {
+        return std::make_shared<inja::IncludeStatementNode>(std::string(name),
+                                                            pos);
+      }
+
+      return std::make_shared<inja::ExtendsStatementNode>(std::string(name),
+                                                          pos);
+    case NodeKind::kBlock: {
+      if (!reader_.String(&name)) {
+        return Corrupt();
+      }
+
+      auto node = std::make_shared<inja::BlockStatementNode>(
+        parent, std::string(name), pos);
+      tmpl_->block_storage.emplace(node->name, node);
+
+      s = Block(&node->block, depth);
+      if (!s.ok()) {
+        return s;
+      }
+
+      return node;
+    }
+    case NodeKind::kSet: {
+      if (!reader_.String(&name)) {
+        return Corrupt();
+      }
+
+      auto node = std::make_shared<inja::SetStatementNode>(std::string(name),
+                                                           pos);
+      s = ExpressionList(&node->expression, depth);
+      if (!s.ok()) {
+        return s;
+      }
+
+      return node;
+    }
+    default:
+      return absl::DataLossError("unexpected node in compiled template");
+    }
+  }
+
+  absl::Status ExpressionList(inja::ExpressionListNode* out, int depth) {
+    uint32_t pos;
+    if (!reader_.U32(&pos)) {
+      return Corrupt();
+    }
+
+    absl::Status s = CheckRange(pos);
+    if (!s.ok()) {
+      return s;
+    }
+
+    out->pos = pos;
+    return ExpressionRoot(out, depth);
+  }
+
+  absl::Status ExpressionRoot(inja::ExpressionListNode* out, int depth) {
+    uint8_t has_root;
+    if (!reader_.U8(&has_root)) {
+      return Corrupt();
+    }
+
+    if (has_root == 0) {
+      return absl::OkStatus();
+    }
+
+    absl::StatusOr<std::shared_ptr<inja::ExpressionNode>> root =
+      Expression(depth + 1);
+    if (!root.ok()) {
+      return root.status();
+    }
+
+    out->root = std::move(root.value());
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<std::shared_ptr<inja::ExpressionNode>> Expression(int depth) {
+    NodeKind kind;
+    std::size_t pos;
+    absl::Status s = Begin(depth, &kind, &pos);
+    if (!s.ok()) {
+      return s;
+    }
+
+    absl::string_view value;
+    switch (kind) {
+    case NodeKind::kLiteral:
+      if (!reader_.String(&value)) {
+        return Corrupt();
+      }
+
+      try {
+        return std::make_shared<inja::LiteralNode>(
+          std::string_view(value.data(), value.size()), pos);
+      } catch (const nlohmann::json::exception& e) {
+        return absl::DataLossError(absl::StrCat("bad literal: ", e.what()));
+      }
+    case NodeKind::kData:
+      if (!reader_.String(&value)) {
+        return Corrupt();
+      }
+
+      return std::make_shared<inja::DataNode>(
+        std::string_view(value.data(), value.size()), pos);
+    case NodeKind::kFunction:
+      return Function(pos, depth);
+    default:
+      return absl::DataLossError("unexpected expression in compiled template");
+    }
+  }
+
+  absl::StatusOr<std::shared_ptr<inja::ExpressionNode>> Function(
+    std::size_t pos, int depth) {
+    using Op = inja::FunctionStorage::Operation;
+
+    absl::string_view name;
+    uint32_t operation;
+    uint32_t number_args;
+    uint32_t precedence;
+    uint8_t right_associative;
+    uint32_t count;
+    if (!reader_.String(&name) || !reader_.U32(&operation) ||
+        !reader_.U32(&number_args) || !reader_.U32(&precedence) ||
+        !reader_.U8(&right_associative) || !reader_.U32(&count)) {
+      return Corrupt();
+    }
+
+    if (operation > static_cast<uint32_t>(Op::None)) {
+      return absl::DataLossError("unknown operation in compiled template");
+    }
+
+    auto node = std::make_shared<inja::FunctionNode>(
+      std::string_view(name.data(), name.size()), pos);
+    node->operation = static_cast<Op>(operation);
+    node->number_args = static_cast<int32_t>(number_args);
+    node->precedence = precedence;
+    node->associativity = right_associative != 0 ?
+                          inja::FunctionNode::Associativity::Right :
+                          inja::FunctionNode::Associativity::Left;
+
+    for (uint32_t i = 0; i < count; ++i) {
+      absl::StatusOr<std::shared_ptr<inja::ExpressionNode>> s_argument =
+        Expression(depth + 1);
+      if (!s_argument.ok()) {
+        return s_argument.status();
+      }
+
+      node->arguments.push_back(std::move(s_argument.value()));
+    }
+
+    // Callbacks aren't data, so they are looked up again, as the parser does.
+    if (node->operation == Op::Callback) {
+      inja::FunctionStorage::FunctionData function =
+        functions_.find_function(node->name, node->number_args);
+      if (function.operation != Op::Callback) {
+        return absl::NotFoundError(absl::StrFormat("unknown function %s",
+                                                   node->name));
+      }
+
+      node->callback = function.callback;
+    }
+
+    return node;
+  }
+
+  Reader reader_;
+  const inja::FunctionStorage& functions_;
+  std::vector<std::string>* includes_;
+  inja::Template* tmpl_;
+};
+
+// Writes `data` to a file of our own next to `path`, and then moves it into
+// place in one go.
+absl::Status ReplaceFile(const std::filesystem::path& path,
+                         absl::string_view data) {
+  std::string temp_path = absl::StrCat(path.string(), ".XXXXXX");
+  int fd = mkstemp(temp_path.data());
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "mkstemp() failed");
+  }
+
+  while (!data.empty()) {
+    ssize_t n = write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      absl::Status s = absl::ErrnoToStatus(errno, "write() failed");
+      close(fd);
+      unlink(temp_path.c_str());
+      return s;
+    }
+
+    data.remove_prefix(n);
+  }
+
+  // mkstemp() makes files only we can read.
+  fchmod(fd, 0644);
+  close(fd);
+  if (rename(temp_path.c_str(), path.c_str()) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "rename() failed");
+    unlink(temp_path.c_str());
+    return s;
+  }
+
+  return absl::OkStatus();
+}
+
+}
+
+// A mapped pack, whose header and index have been checked.
+class TemplateCache::Pack {
+public:
+  static absl::StatusOr<std::unique_ptr<const Pack>> Open(
+    const std::filesystem::path& path) {
+    absl::StatusOr<std::unique_ptr<Mapping>> mapping = Mapping::Open(path);
+    if (!mapping.ok()) {
+      return mapping.status();
+    }
+
+    absl::string_view bytes = mapping.value()->Contents();
+    PackHeader header;
+    if (bytes.size() < sizeof(header)) {
+      return absl::DataLossError("truncated template pack");
+    }
+
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.magic, kPackMagic, sizeof(kPackMagic)) != 0 ||
+        header.version != kFormatVersion ||
+        header.count > (bytes.size() - sizeof(header)) / sizeof(PackEntry)) {
+      return absl::DataLossError("not a template pack of this version");
+    }
+
+    return std::unique_ptr<const Pack>(
+      new Pack(std::move(mapping).value(), header.count));
+  }
+
+  // Returns the stored template with `key`, or an empty string if there is
+  // none.
+  absl::string_view Find(uint64_t key) const {
+    std::size_t low = 0;
+    std::size_t high = count_;
+    while (low < high) {
+      std::size_t middle = low + (high - low) / 2;
+      PackEntry entry = Entry(middle);
+      if (entry.key < key) {
+        low = middle + 1;
+      } else if (entry.key > key) {
+        high = middle;
+      } else {
+        return Bytes(entry);
+      }
+    }
+
+    return absl::string_view();
+  }
+
+  // Appends every stored template to `entries`, paired with its key.
+  void List(std::vector<std::pair<uint64_t, absl::string_view>>* entries)
+    const {
+    for (std::size_t i = 0; i < count_; ++i) {
+      PackEntry entry = Entry(i);
+      absl::string_view bytes = Bytes(entry);
+      if (!bytes.empty()) {
+        entries->emplace_back(entry.key, bytes);
+      }
+    }
+  }
+
+  std::size_t Size() const {
+    return mapping_->Contents().size();
+  }
+
+private:
+  Pack(std::unique_ptr<Mapping> mapping, std::size_t count) :
+    mapping_(std::move(mapping)), count_(count) {
+    // Nothing to do.
+  }
+
+  PackEntry Entry(std::size_t i) const {
+    PackEntry entry;
+    memcpy(&entry, mapping_->Contents().data() + sizeof(PackHeader) +
+                   i * sizeof(entry), sizeof(entry));
+    return entry;
+  }
+
+  // The bytes `entry` points at, or nothing if they are out of bounds.
+  absl::string_view Bytes(const PackEntry& entry) const {
+    absl::string_view contents = mapping_->Contents();
+    if (entry.offset > contents.size() ||
+        entry.size > contents.size() - entry.offset) {
+      return absl::string_view();
+    }
+
+    return contents.substr(entry.offset, entry.size);
+  }
+
+  std::unique_ptr<Mapping> mapping_;
+  std::size_t count_;
+};
+
+TemplateCache::TemplateCache(const std::filesystem::path& dir) : dir_(dir),
+  mapped_(false) {
+  // Nothing to do.
+}
+
+TemplateCache::~TemplateCache() {
+  // Nothing to do.
+}
+
+absl::StatusOr<inja::Template> TemplateCache::Load(
+  absl::string_view content,
+  const inja::LexerConfig& lexer_config,
+  const inja::FunctionStorage& functions,
+  std::vector<std::string>* includes) const {
+  std::shared_ptr<const Pack> pack = CurrentPack();
+  if (pack == nullptr) {
+    return absl::NotFoundError("no template pack");
+  }
+
+  absl::string_view bytes = pack->Find(KeyFor(content, lexer_config));
+
+  // The key is only a hash.
+  absl::string_view stored;
+  if (!Reader(bytes).String(&stored) || stored != content) {
+    return absl::NotFoundError("no compiled template");
+  }
+
+  return DeserializeTemplate(bytes, functions, includes);
+}
+
+absl::Status TemplateCache::Store(
+  absl::Span<const inja::Template* const> templates,
+  const inja::LexerConfig& lexer_config) const {
+  absl::Status status;
+
+  // Reserved up front, since `entries` points into the strings.
+  std::vector<std::string> serialized;
+  serialized.reserve(templates.size());
+  std::vector<std::pair<uint64_t, absl::string_view>> entries;
+  std::size_t size = sizeof(PackHeader);
+  for (const inja::Template* tmpl : templates) {
+    absl::StatusOr<std::string> bytes = SerializeTemplate(*tmpl);
+    if (!bytes.ok()) {
+      status.Update(bytes.status());
+      continue;
+    }
+
+    serialized.push_back(std::move(bytes).value());
+    entries.emplace_back(KeyFor(tmpl->content, lexer_config),
+                         serialized.back());
+    size += sizeof(PackEntry) + serialized.back().size();
+  }
+
+  if (entries.empty()) {
+    return status;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  if (ec) {
+    return absl::ErrnoToStatus(ec.value(), absl::StrCat("cannot create ",
+                                                        dir_.string()));
+  }
+
+  // Keep what was stored before, including by other processes since this one
+  // mapped the pack, unless the pack would grow too large.
+  std::filesystem::path path = PackPath();
+  absl::StatusOr<std::unique_ptr<const Pack>> old = Pack::Open(path);
+  if (old.ok() && size + old.value()->Size() <= kMaxPackSize) {
+    old.value()->List(&entries);
+  }
+
+  // New templates come first, so that they win over old ones with their key.
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.first < b.first;
+                   });
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const auto& a, const auto& b) {
+                              return a.first == b.first;
+                            }),
+                entries.end());
+
+  PackHeader header;
+  memcpy(header.magic, kPackMagic, sizeof(kPackMagic));
+  header.version = kFormatVersion;
+  header.count = entries.size();
+
+  std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+  uint64_t offset = sizeof(header) + entries.size() * sizeof(PackEntry);
+  for (const auto& [key, bytes] : entries) {
+    PackEntry entry = {key, offset, bytes.size()};
+    data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    offset += bytes.size();
+  }
+
+  for (const auto& [key, bytes] : entries) {
+    data.append(bytes.data(), bytes.size());
+  }
+
+  absl::Status s = ReplaceFile(path, data);
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Later loads by this process see what it just stored.
+  absl::StatusOr<std::unique_ptr<const Pack>> pack = Pack::Open(path);
+  absl::MutexLock lock(&mutex_);
+  mapped_ = true;
+  if (pack.ok()) {
+    pack_ = std::move(pack).value();
+  }
+
+  return status;
+}
+
+std::shared_ptr<const TemplateCache::Pack> TemplateCache::CurrentPack() const {
+  absl::MutexLock lock(&mutex_);
+  if (!mapped_) {
+    // Once is enough: a process that finds no pack parses its templates, and
+    // stores them, which maps the new pack.
+    mapped_ = true;
+    absl::StatusOr<std::unique_ptr<const Pack>> pack = Pack::Open(PackPath());
+    if (pack.ok()) {
+      pack_ = std::move(pack).value();
+    }
+  }
+
+  return pack_;
+}
+
+std::filesystem::path TemplateCache::PackPath() const {
+  return dir_ / "templates.pack";
+}
+
+absl::StatusOr<std::string> SerializeTemplate(const inja::Template& tmpl) {
+  std::string bytes;
+  absl::Status s = Serializer(&bytes).Serialize(tmpl);
+  if (!s.ok()) {
+    return s;
+  }
+
+  return bytes;
+}
+
+absl::StatusOr<inja::Template> DeserializeTemplate(
+  absl::string_view bytes,
+  const inja::FunctionStorage& functions,
+  std::vector<std::string>* includes) {
+  return Deserializer(bytes, functions, includes).Deserialize();
+}
+
+}
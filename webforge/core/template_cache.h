@@ -0,0 +1,124 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_cache.h
+// -----------------------------------------------------------------------------
+//
+// wf::TemplateCache keeps parsed templates in a directory, so that they outlive
+// the process that parsed them. A CGI program, which handles a single request
+// and exits, would otherwise lex and parse every template it renders on every
+// request; with a cache, only the first process pays for it. Servers restart
+// faster for the same reason.
+//
+// All templates live in a single pack file, which a process maps once and then
+// loads every template from without further filesystem calls. Each template is
+// found in the pack's index by a hash of its content and of the lexer
+// configuration, so an edited template simply misses, and is stored in a flat
+// form that its syntax tree is rebuilt from directly, without going through an
+// intermediate message. Anything in the pack that doesn't add up (a bad format
+// version, or positions outside the template's content) makes the template
+// miss, so that it is parsed again.
+//
+// Storing templates writes a new pack, with the templates of the current one,
+// and replaces the current one with rename(2) so that processes never see one
+// half-written. Two processes storing at once may lose each other's templates,
+// which are then parsed and stored again later. Once the pack grows past
+// kMaxPackSize, the templates it held are dropped. The directory can be emptied
+// at any time.
+//
+// Example use:
+//   auto renderer = std::make_shared<wf::Renderer>("components");
+//   renderer->UseTemplateCache(
+//     std::make_shared<wf::TemplateCache>("/var/cache/webforge"));
+//
+
+#ifndef WEBFORGE_CORE_TEMPLATE_CACHE_H_
+#define WEBFORGE_CORE_TEMPLATE_CACHE_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include <inja/inja.hpp>
+
+namespace wf {
+
+class TemplateCache {
+public:
+  // Upper bound on the size of the pack, past which stored templates are
+  // dropped.
+  static constexpr std::size_t kMaxPackSize = 16 * 1024 * 1024;
+
+  explicit TemplateCache(const std::filesystem::path& dir);
+  ~TemplateCache();
+
+  TemplateCache(const TemplateCache&) = delete;
+  TemplateCache& operator=(const TemplateCache&) = delete;
+
+  // Returns the template that was stored for `content` and `lexer_config`, with
+  // the callbacks it calls looked up in `functions`. The names of the templates
+  // it includes or extends are appended to `includes`, in the order they
+  // appear.
+  //
+  // Returns an absl::NotFoundError if no such template was stored, or if it
+  // calls a function that `functions` doesn't have (anymore), and an
+  // absl::DataLossError if what was stored is corrupt.
+  absl::StatusOr<inja::Template> Load(absl::string_view content,
+                                      const inja::LexerConfig& lexer_config,
+                                      const inja::FunctionStorage& functions,
+                                      std::vector<std::string>* includes) const;
+
+  // Stores `templates`, which were parsed with `lexer_config`, in one go.
+  // Templates that can't be stored are skipped, and the first reason is
+  // returned once the others are stored.
+  absl::Status Store(absl::Span<const inja::Template* const> templates,
+                     const inja::LexerConfig& lexer_config) const;
+
+private:
+  class Pack;
+
+  // Returns the pack this process loads from, mapping it on first use. Null if
+  // there is none (yet).
+  std::shared_ptr<const Pack> CurrentPack() const;
+
+  std::filesystem::path PackPath() const;
+
+  std::filesystem::path dir_;
+
+  mutable absl::Mutex mutex_;
+  mutable bool mapped_ ABSL_GUARDED_BY(mutex_);
+  mutable std::shared_ptr<const Pack> pack_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Converts between inja's syntax tree and the flat form it is stored in, which
+// includes the template's content. Exposed for tests.
+absl::StatusOr<std::string> SerializeTemplate(const inja::Template& tmpl);
+absl::StatusOr<inja::Template> DeserializeTemplate(
+  absl::string_view bytes,
+  const inja::FunctionStorage& functions,
+  std::vector<std::string>* includes);
+
+}
+
+#endif  // WEBFORGE_CORE_TEMPLATE_CACHE_H_
@@ -0,0 +1,311 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_cache_test.cc
+// -----------------------------------------------------------------------------
+//
+// Tests that templates survive wf::TemplateCache unchanged, both on their own
+// and through a wf::Renderer, with caches in a temporary directory.
+//
+
+#include "webforge/core/template_cache.h"
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
+#include <gtest/gtest.h>
+#include <inja/inja.hpp>
+#include <nlohmann/json.hpp>
+
+#include "webforge/core/renderer.h"
+
+namespace {
+
+// Overwrites the 32-bit integer at `offset` of a stored template.
+void SetU32(std::string* bytes, std::size_t offset, uint32_t value) {
+  ASSERT_LE(offset + sizeof(value), bytes->size());
+  memcpy(bytes->data() + offset, &value, sizeof(value));
+}
+
+// Where the length of a template's first node, if it is text, is stored
+// relative to the start of its content: after the content, the root block's
+// node count, and the node's kind and position.
+std::size_t FirstTextLengthOffset(const std::string& content) {
+  return content.size() + sizeof(uint32_t) + 1 + sizeof(uint32_t);
+}
+
+// Parses `src` with inja, sends it through its serialized form and back, and
+// renders both versions with `data`. `storage` holds the templates it may
+// include.
+void ExpectRoundTrip(const std::string& src, const nlohmann::json& data,
+                     inja::TemplateStorage storage = {}) {
+  inja::FunctionStorage functions;
+  functions.add_callback("double", 1, [](inja::Arguments& args) {
+    return args.at(0)->get<int>() * 2;
+  });
+
+  inja::Template tmpl = inja::Parser(inja::ParserConfig(), inja::LexerConfig(),
+                                     storage, functions).parse(src, "");
+
+  absl::StatusOr<std::string> stored = wf::SerializeTemplate(tmpl);
+  ASSERT_THAT(stored, absl_testing::IsOk());
+
+  std::vector<std::string> includes;
+  absl::StatusOr<inja::Template> loaded =
+    wf::DeserializeTemplate(*stored, functions, &includes);
+  ASSERT_THAT(loaded, absl_testing::IsOk());
+
+  std::ostringstream expected;
+  std::ostringstream actual;
+  inja::Renderer(inja::RenderConfig(), storage, functions)
+    .render_to(expected, tmpl, data);
+  inja::Renderer(inja::RenderConfig(), storage, functions)
+    .render_to(actual, loaded.value(), data);
+  EXPECT_EQ(actual.str(), expected.str());
+  EXPECT_FALSE(actual.str().empty());
+}
+
+TEST(TemplateCacheTest, RoundTripsExpressionsAndStatements) {
+  nlohmann::json data = {
+    {"user", {{"name", "Ada"}}},
+    {"items", {"a", "b", "c"}},
+    {"scores", {{"x", 1}, {"y", 2}}},
+    {"hidden", false},
+  };
+
+  ExpectRoundTrip(
+    "{% set greeting = \"Hi\" %}{{ greeting }} {{ user.name }}!"
+    "{% if length(items) > 2 and not hidden %} many"
+    "{% else if hidden %} hidden{% else %} few{% endif %}"
+    "{% for item in items %} {{ loop.index }}:{{ upper(item) }}{% endfor %}"
+    "{% for k, v in scores %} {{ k }}={{ v * 2 + 1 }}{% endfor %}"
+    " {{ double(3) }} {{ length([1, 2, 3]) }} {{ default(missing, \"none\") }}"
+    "{# comment #} {{ {\"a\": [1, 2.5, null]} }}", data);
+}
+
+TEST(TemplateCacheTest, RoundTripsIncludesAndBlocks) {
+  inja::TemplateStorage storage;
+  inja::FunctionStorage functions;
+  for (const auto& [name, src] : {
+         std::pair("base.html", "<{% block head %}base head{% endblock %}|"
+                                "{% block body %}base body{% endblock %}>"),
+         std::pair("part.html", "[{{ name }}]"),
+       }) {
+    storage.emplace(name, inja::Parser(inja::ParserConfig(),
+                                       inja::LexerConfig(), storage, functions)
+                            .parse(src, ""));
+  }
+
+  ExpectRoundTrip("{% extends \"base.html\" %}"
+                  "{% block body %}child {% include \"part.html\" %}"
+                  "{% endblock %}", {{"name", "part"}}, storage);
+}
+
+TEST(TemplateCacheTest, ListsIncludesInOrder) {
+  inja::TemplateStorage storage;
+  inja::FunctionStorage functions;
+  inja::ParserConfig config;
+  config.include_callback = [](const std::filesystem::path&,
+                               const std::string&) {
+    return inja::Template("");
+  };
+
+  inja::Template tmpl = inja::Parser(config, inja::LexerConfig(), storage,
+                                     functions)
+    .parse("{% extends \"b\" %}{% if true %}{% include \"a\" %}{% endif %}",
+           "");
+  absl::StatusOr<std::string> stored = wf::SerializeTemplate(tmpl);
+  ASSERT_THAT(stored, absl_testing::IsOk());
+
+  std::vector<std::string> includes;
+  ASSERT_THAT(wf::DeserializeTemplate(*stored, functions, &includes),
+              absl_testing::IsOk());
+  EXPECT_EQ(includes, std::vector<std::string>({"b", "a"}));
+}
+
+TEST(TemplateCacheTest, RejectsUnknownCallbacks) {
+  inja::TemplateStorage storage;
+  inja::FunctionStorage functions;
+  functions.add_callback("shout", 1, [](inja::Arguments& args) {
+    return args.at(0)->get<std::string>() + "!";
+  });
+
+  inja::Template tmpl = inja::Parser(inja::ParserConfig(), inja::LexerConfig(),
+                                     storage, functions)
+    .parse("{{ shout(\"hey\") }}", "");
+  absl::StatusOr<std::string> stored = wf::SerializeTemplate(tmpl);
+  ASSERT_THAT(stored, absl_testing::IsOk());
+
+  std::vector<std::string> includes;
+  EXPECT_THAT(wf::DeserializeTemplate(*stored, inja::FunctionStorage(),
+                                      &includes),
+              absl_testing::StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(TemplateCacheTest, RejectsPositionsOutsideContent) {
+  inja::TemplateStorage storage;
+  inja::FunctionStorage functions;
+  inja::Template tmpl = inja::Parser(inja::ParserConfig(), inja::LexerConfig(),
+                                     storage, functions)
+    .parse("text {{ value }}", "");
+  absl::StatusOr<std::string> stored = wf::SerializeTemplate(tmpl);
+  ASSERT_THAT(stored, absl_testing::IsOk());
+
+  // The content is preceded by its size.
+  std::size_t text_length = sizeof(uint32_t) +
+                            FirstTextLengthOffset(tmpl.content);
+  std::vector<std::string> includes;
+  std::string long_text = *stored;
+  SetU32(&long_text, text_length, 1000);
+  EXPECT_THAT(wf::DeserializeTemplate(long_text, functions, &includes),
+              absl_testing::StatusIs(absl::StatusCode::kDataLoss));
+
+  // The expression follows the text: its kind, then its position.
+  std::string far_expression = *stored;
+  SetU32(&far_expression, text_length + sizeof(uint32_t) + 1, 1000);
+  EXPECT_THAT(wf::DeserializeTemplate(far_expression, functions, &includes),
+              absl_testing::StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST(TemplateCacheTest, RejectsTruncatedTemplates) {
+  inja::TemplateStorage storage;
+  inja::FunctionStorage functions;
+  inja::Template tmpl = inja::Parser(inja::ParserConfig(), inja::LexerConfig(),
+                                     storage, functions)
+    .parse("{% for i in items %}{% if i > 1 %}{{ i }}{% endif %}{% endfor %}",
+           "");
+  absl::StatusOr<std::string> stored = wf::SerializeTemplate(tmpl);
+  ASSERT_THAT(stored, absl_testing::IsOk());
+
+  for (std::size_t size = 0; size < stored->size(); ++size) {
+    std::vector<std::string> includes;
+    EXPECT_THAT(wf::DeserializeTemplate(stored->substr(0, size), functions,
+                                        &includes),
+                absl_testing::StatusIs(absl::StatusCode::kDataLoss))
+      << size;
+  }
+}
+
+class RendererTemplateCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(testing::TempDir()) /
+           testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_ / "components");
+  }
+
+  void Write(const std::string& name, const std::string& contents) {
+    std::ofstream(dir_ / "components" / name) << contents;
+  }
+
+  // Renders `name` with a new Renderer and TemplateCache, like a new process
+  // would.
+  std::string Render(const std::string& name) {
+    wf::Renderer renderer(dir_ / "components");
+    renderer.UseTemplateCache(
+      std::make_shared<wf::TemplateCache>(dir_ / "cache"));
+
+    std::ostringstream output;
+    absl::Status s = renderer.Render(name, nullptr, {}, &output);
+    return s.ok() ? output.str() : s.ToString();
+  }
+
+  std::filesystem::path PackPath() {
+    return dir_ / "cache" / "templates.pack";
+  }
+
+  // The inode of the pack, which changes whenever it is replaced.
+  ino_t PackInode() {
+    struct stat st;
+    EXPECT_EQ(stat(PackPath().c_str(), &st), 0);
+    return st.st_ino;
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(RendererTemplateCacheTest, LoadsTemplatesParsedBefore) {
+  Write("base.html", "<{% block body %}{% endblock %}>");
+  Write("page.html", "{% extends \"base.html\" %}{% block body %}"
+                     "{% include \"part.html\" %} {{ asset(\"app.css\") }}"
+                     "{% endblock %}");
+  Write("part.html", "{% set n = 2 %}{{ n * 21 }}");
+
+  EXPECT_EQ(Render("page.html"), "<42 app.css>");
+  ino_t stored = PackInode();
+
+  // Nothing is parsed, and so nothing is stored, again.
+  EXPECT_EQ(Render("page.html"), "<42 app.css>");
+  EXPECT_EQ(PackInode(), stored);
+
+  // An edited template no longer matches what was stored for it, and is
+  // stored alongside the others.
+  Write("part.html", "{{ 7 * 6 }}!");
+  EXPECT_EQ(Render("page.html"), "<42! app.css>");
+  stored = PackInode();
+  EXPECT_EQ(Render("page.html"), "<42! app.css>");
+  EXPECT_EQ(PackInode(), stored);
+}
+
+TEST_F(RendererTemplateCacheTest, ParsesCorruptTemplatesAgain) {
+  Write("page.html", "{% for i in [1, 2, 3] %}{{ i }}{% endfor %}");
+  EXPECT_EQ(Render("page.html"), "123");
+
+  for (const auto& entry :
+       std::filesystem::directory_iterator(dir_ / "cache")) {
+    std::ofstream(entry.path()) << "not a template";
+  }
+
+  EXPECT_EQ(Render("page.html"), "123");
+  EXPECT_EQ(Render("page.html"), "123");
+}
+
+TEST_F(RendererTemplateCacheTest, ParsesTemplatesWithBadTextLengthsAgain) {
+  Write("page.html", "Hello, {{ \"world\" }}!");
+  EXPECT_EQ(Render("page.html"), "Hello, world!");
+
+  // Still a well-formed pack, but with text that runs past the end of the
+  // template's content.
+  std::string content = "Hello, {{ \"world\" }}!";
+  std::ifstream in(PackPath(), std::ios::binary);
+  std::string pack(std::istreambuf_iterator<char>(in), {});
+  std::size_t start = pack.find(content);
+  ASSERT_NE(start, std::string::npos);
+  SetU32(&pack, start + FirstTextLengthOffset(content), 1 << 20);
+  std::ofstream(PackPath(), std::ios::binary) << pack;
+
+  EXPECT_EQ(Render("page.html"), "Hello, world!");
+}
+
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
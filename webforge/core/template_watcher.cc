@@ -0,0 +1,236 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_watcher.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::TemplateWatcher on top of inotify(7) and eventfd(2).
+//
+
+#include "webforge/core/template_watcher.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+
+#include "webforge/core/renderer.h"
+
+namespace wf {
+
+namespace {
+
+// Files that are done being written, or moved or deleted, and directories that
+// appear.
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                IN_DELETE | IN_CREATE | IN_ONLYDIR;
+
+}
+
+absl::StatusOr<std::unique_ptr<TemplateWatcher>> TemplateWatcher::Create(
+  std::shared_ptr<Renderer> renderer) {
+  int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) {
+    return absl::ErrnoToStatus(errno, "inotify_init1() failed");
+  }
+
+  int wake_fd = eventfd(0, EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "eventfd() failed");
+    close(inotify_fd);
+    return s;
+  }
+
+  std::unique_ptr<TemplateWatcher> watcher(
+    new TemplateWatcher(std::move(renderer), inotify_fd, wake_fd));
+  absl::Status s = watcher->Watch("");
+  if (!s.ok()) {
+    return s;
+  }
+
+  watcher->thread_ = std::thread(&TemplateWatcher::Run, watcher.get());
+  return watcher;
+}
+
+TemplateWatcher::TemplateWatcher(std::shared_ptr<Renderer> renderer,
+                                 int inotify_fd, int wake_fd) :
+  renderer_(std::move(renderer)), inotify_fd_(inotify_fd), wake_fd_(wake_fd) {
+  // Nothing to do.
+}
+
+TemplateWatcher::~TemplateWatcher() {
+  if (thread_.joinable()) {
+    uint64_t one = 1;
+    while (write(wake_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+      // Try again.
+    }
+
+    thread_.join();
+  }
+
+  close(wake_fd_);
+  close(inotify_fd_);
+}
+
+absl::Status TemplateWatcher::Watch(const std::filesystem::path& dir) {
+  std::filesystem::path path = renderer_->SearchPath() / dir;
+  int wd = inotify_add_watch(inotify_fd_, path.c_str(), kWatchMask);
+  if (wd < 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("cannot watch ",
+                                                   path.string()));
+  }
+
+  directories_[wd] = dir;
+
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+    if (!entry.is_directory(ec) || entry.is_symlink(ec)) {
+      continue;
+    }
+
+    absl::Status s = Watch(dir / entry.path().filename());
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  if (ec) {
+    return absl::ErrnoToStatus(ec.value(), absl::StrCat("cannot list ",
+                                                        path.string()));
+  }
+
+  return absl::OkStatus();
+}
+
+void TemplateWatcher::Run() {
+  // Big enough for at least one event with the longest possible name.
+  alignas(inotify_event) char buffer[sizeof(inotify_event) + NAME_MAX + 1];
+
+  while (true) {
+    pollfd fds[2] = {
+      {inotify_fd_, POLLIN, 0},
+      {wake_fd_, POLLIN, 0},
+    };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return;
+    }
+
+    if (fds[1].revents != 0) {
+      return;
+    }
+
+    ssize_t n = read(inotify_fd_, buffer, sizeof(buffer));
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+
+      return;
+    }
+
+    for (ssize_t offset = 0; offset < n;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer +
+                                                                 offset);
+      HandleEvent(*event);
+      offset += sizeof(inotify_event) + event->len;
+    }
+  }
+}
+
+void TemplateWatcher::HandleEvent(const inotify_event& event) {
+  if (event.mask & IN_Q_OVERFLOW) {
+    // Events were lost, so anything may have changed.
+    renderer_->FlushCache();
+    return;
+  }
+
+  auto it = directories_.find(event.wd);
+  if (it == directories_.end()) {
+    return;
+  }
+
+  if (event.mask & IN_IGNORED) {
+    // The directory is gone.
+    directories_.erase(it);
+    return;
+  }
+
+  if (event.len == 0) {
+    return;
+  }
+
+  std::filesystem::path name = it->second / event.name;
+  if (event.mask & IN_ISDIR) {
+    if (event.mask & IN_MOVED_FROM) {
+      // Watches follow a directory that is moved, so ours would go on
+      // reporting its files under their old names.
+      std::vector<int> moved;
+      for (const auto& [wd, dir] : directories_) {
+        auto mismatch = std::mismatch(name.begin(), name.end(),
+                                      dir.begin(), dir.end());
+        if (mismatch.first == name.end()) {
+          moved.push_back(wd);
+        }
+      }
+
+      for (int wd : moved) {
+        inotify_rm_watch(inotify_fd_, wd);
+        directories_.erase(wd);
+      }
+    } else if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+      Watch(name).IgnoreError();
+    }
+
+    // Whatever was cached from a directory that came or went is stale, but
+    // the cache can't tell which templates that was.
+    if (event.mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE)) {
+      renderer_->FlushCache();
+    }
+
+    return;
+  }
+
+  // A new file can't be cached yet. Its contents are picked up once it has
+  // been written.
+  if (event.mask & IN_CREATE) {
+    return;
+  }
+
+  renderer_->Invalidate(name.generic_string());
+}
+
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_watcher.h
+// -----------------------------------------------------------------------------
+//
+// wf::TemplateWatcher keeps a long-running wf::Renderer in step with its search
+// path. It watches the search path, and every directory below it, with
+// inotify(7) on a thread of its own. Whenever a file is written, moved or
+// deleted, the template of the same name (along with everything that includes
+// it) is dropped from the cache (see Renderer::Invalidate()), and parsed again
+// the next time it is rendered. Renders in progress finish with the version
+// they started with.
+//
+// Unlike checking modification times, this costs nothing per request.
+//
+
+#ifndef WEBFORGE_CORE_TEMPLATE_WATCHER_H_
+#define WEBFORGE_CORE_TEMPLATE_WATCHER_H_
+
+#include <sys/inotify.h>
+
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+#include "webforge/core/renderer.h"
+
+namespace wf {
+
+class TemplateWatcher {
+public:
+  // Starts watching the search path of `renderer`. Fails if inotify(7) is
+  // unavailable, or the search path can't be watched.
+  static absl::StatusOr<std::unique_ptr<TemplateWatcher>> Create(
+    std::shared_ptr<Renderer> renderer);
+
+  // Stops watching.
+  ~TemplateWatcher();
+
+  TemplateWatcher(const TemplateWatcher&) = delete;
+  TemplateWatcher& operator=(const TemplateWatcher&) = delete;
+
+private:
+  TemplateWatcher(std::shared_ptr<Renderer> renderer, int inotify_fd,
+                  int wake_fd);
+
+  // Watches `dir` (relative to the search path) and the directories below it.
+  absl::Status Watch(const std::filesystem::path& dir);
+
+  // Runs on thread_ until the destructor signals wake_fd_.
+  void Run();
+
+  void HandleEvent(const inotify_event& event);
+
+  std::shared_ptr<Renderer> renderer_;
+  int inotify_fd_;
+  int wake_fd_;
+
+  // Watched directories by watch descriptor, relative to the search path.
+  // Only touched by thread_ once it runs.
+  absl::flat_hash_map<int, std::filesystem::path> directories_;
+
+  std::thread thread_;
+};
+
+}
+
+#endif  // WEBFORGE_CORE_TEMPLATE_WATCHER_H_
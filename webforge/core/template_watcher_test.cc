@@ -0,0 +1,128 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: template_watcher_test.cc
+// -----------------------------------------------------------------------------
+//
+// Tests wf::TemplateWatcher against real files in a temporary directory.
+//
+
+#include "webforge/core/template_watcher.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include <gtest/gtest.h>
+
+#include "webforge/core/renderer.h"
+
+namespace {
+
+class TemplateWatcherTest : public testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(testing::TempDir()) /
+           testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_ / "partials");
+    renderer_ = std::make_shared<wf::Renderer>(dir_);
+  }
+
+  void Write(const std::string& name, const std::string& contents) {
+    std::ofstream(dir_ / name) << contents;
+  }
+
+  std::string Render(const std::string& name) {
+    std::ostringstream output;
+    absl::Status s = renderer_->Render(name, nullptr, {}, &output);
+    return s.ok() ? output.str() : s.ToString();
+  }
+
+  // Renders `name` until it comes out as `expected`, for up to five seconds,
+  // since the watcher gets to events on a thread of its own.
+  std::string RenderUntil(const std::string& name,
+                          const std::string& expected) {
+    absl::Time deadline = absl::Now() + absl::Seconds(5);
+    std::string output = Render(name);
+    while (output != expected && absl::Now() < deadline) {
+      absl::SleepFor(absl::Milliseconds(10));
+      output = Render(name);
+    }
+
+    return output;
+  }
+
+  std::filesystem::path dir_;
+  std::shared_ptr<wf::Renderer> renderer_;
+};
+
+TEST_F(TemplateWatcherTest, ReloadsChangedIncludes) {
+  Write("page.html", "<{% include \"partials/head.html\" %}>");
+  Write("partials/head.html", "old");
+  Write("other.html", "other");
+
+  absl::StatusOr<std::unique_ptr<wf::TemplateWatcher>> watcher =
+    wf::TemplateWatcher::Create(renderer_);
+  ASSERT_THAT(watcher, absl_testing::IsOk());
+
+  EXPECT_EQ(Render("page.html"), "<old>");
+  EXPECT_EQ(Render("other.html"), "other");
+
+  Write("partials/head.html", "new");
+  EXPECT_EQ(RenderUntil("page.html", "<new>"), "<new>");
+
+  // Editors that save by renaming a new file over the old one work too.
+  Write("partials/head.html.tmp", "newer");
+  std::filesystem::rename(dir_ / "partials/head.html.tmp",
+                          dir_ / "partials/head.html");
+  EXPECT_EQ(RenderUntil("page.html", "<newer>"), "<newer>");
+}
+
+TEST_F(TemplateWatcherTest, WatchesNewDirectories) {
+  absl::StatusOr<std::unique_ptr<wf::TemplateWatcher>> watcher =
+    wf::TemplateWatcher::Create(renderer_);
+  ASSERT_THAT(watcher, absl_testing::IsOk());
+
+  // Give the watcher time to see the directory before files appear in it.
+  std::filesystem::create_directories(dir_ / "blog");
+  absl::SleepFor(absl::Milliseconds(100));
+
+  Write("blog/post.html", "first");
+  EXPECT_EQ(Render("blog/post.html"), "first");
+
+  Write("blog/post.html", "second");
+  EXPECT_EQ(RenderUntil("blog/post.html", "second"), "second");
+}
+
+TEST_F(TemplateWatcherTest, FailsWithoutSearchPath) {
+  auto renderer = std::make_shared<wf::Renderer>(dir_ / "missing");
+  EXPECT_FALSE(wf::TemplateWatcher::Create(renderer).ok());
+}
+
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,223 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: etag.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::ETagHasher with XXH64 (seed 0), and the If-None-Match and
+// If-Modified-Since evaluation built on it.
+//
+
+#include "webforge/http/etag.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/date.h"
+#include "webforge/http/http.h"
+#include "webforge/http/strings.h"
+
+namespace wf {
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t RotateLeft(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+// XXH64 is defined over little-endian words.
+uint64_t Load64(const char* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+uint32_t Load32(const char* p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap32(x);
+#endif
+  return x;
+}
+
+uint64_t Round(uint64_t lane, uint64_t input) {
+  lane += input * kPrime2;
+  lane = RotateLeft(lane, 31);
+  return lane * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t hash, uint64_t lane) {
+  hash ^= Round(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+
+// Strips the W/ prefix that marks a weak ETag.
+absl::string_view Opaque(absl::string_view etag) {
+  etag = absl::StripAsciiWhitespace(etag);
+  absl::ConsumePrefix(&etag, "W/");
+  return etag;
+}
+
+}
+
+ETagHasher::ETagHasher() : lanes_{kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1},
+  stripe_size_(0), total_size_(0) {
+  // Nothing to do.
+}
+
+void ETagHasher::Update(absl::string_view data) {
+  total_size_ += data.size();
+
+  if (stripe_size_ > 0) {
+    std::size_t n = std::min(data.size(), sizeof(stripe_) - stripe_size_);
+    memcpy(stripe_ + stripe_size_, data.data(), n);
+    stripe_size_ += n;
+    data.remove_prefix(n);
+
+    if (stripe_size_ < sizeof(stripe_)) {
+      return;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+      lanes_[i] = Round(lanes_[i], Load64(stripe_ + i * 8));
+    }
+    stripe_size_ = 0;
+  }
+
+  // The four lanes are independent, so that the CPU can work on all of them at
+  // once.
+  const char* p = data.data();
+  const char* end = p + data.size();
+  while (end - p >= 32) {
+    lanes_[0] = Round(lanes_[0], Load64(p));
+    lanes_[1] = Round(lanes_[1], Load64(p + 8));
+    lanes_[2] = Round(lanes_[2], Load64(p + 16));
+    lanes_[3] = Round(lanes_[3], Load64(p + 24));
+    p += 32;
+  }
+
+  memcpy(stripe_, p, end - p);
+  stripe_size_ = end - p;
+}
+
+std::string ETagHasher::Finish() const {
+  uint64_t hash;
+  if (total_size_ >= 32) {
+    hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+           RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    for (uint64_t lane : lanes_) {
+      hash = MergeRound(hash, lane);
+    }
+  } else {
+    hash = kPrime5;
+  }
+
+  hash += total_size_;
+
+  const char* p = stripe_;
+  const char* end = stripe_ + stripe_size_;
+  for (; end - p >= 8; p += 8) {
+    hash ^= Round(0, Load64(p));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+
+  if (end - p >= 4) {
+    hash ^= static_cast<uint64_t>(Load32(p)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+
+  for (; p < end; ++p) {
+    hash ^= static_cast<uint8_t>(*p) * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+
+  return absl::StrFormat("\"%016x\"", hash);
+}
+
+std::string StrongETag(absl::string_view content) {
+  ETagHasher hasher;
+  hasher.Update(content);
+  return hasher.Finish();
+}
+
+bool ETagMatches(absl::string_view if_none_match, absl::string_view etag) {
+  if (absl::StripAsciiWhitespace(if_none_match) == "*") {
+    return true;
+  }
+
+  etag = Opaque(etag);
+  for (absl::string_view candidate : absl::StrSplit(if_none_match, ',')) {
+    if (Opaque(candidate) == etag) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool NotModified(const Request& req, absl::string_view etag,
+                 const HTTPDate* modified_time) {
+  if (req.Method() != CaseInsensitive("GET") &&
+      req.Method() != CaseInsensitive("HEAD")) {
+    return false;
+  }
+
+  absl::StatusOr<const std::string> if_none_match = req.Header("If-None-Match");
+  if (if_none_match.ok()) {
+    // If-Modified-Since is ignored whenever If-None-Match is present, since it
+    // is the more precise of the two.
+    return !etag.empty() && ETagMatches(if_none_match.value(), etag);
+  }
+
+  absl::StatusOr<const std::string> ims = req.Header("If-Modified-Since");
+  if (modified_time == nullptr || !ims.ok()) {
+    return false;
+  }
+
+  // If the time data is malformed, we don't care. Don't error out here.
+  absl::StatusOr<HTTPDate> ims_date = HTTPDate::FromString(ims.value());
+  return ims_date.ok() && *modified_time <= ims_date.value();
+}
+
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: etag.h
+// -----------------------------------------------------------------------------
+//
+// Entity tags and the conditional requests that use them.
+//
+// wf::ETagHasher and wf::StrongETag derive a strong ETag from the bytes of a
+// representation, so that two responses get the same tag exactly when their
+// bodies are the same, no matter when or by which process they were produced.
+// The hash is XXH64, which is fast enough to run over rendered pages on every
+// request, and the same across machines.
+//
+// wf::NotModified evaluates If-None-Match and If-Modified-Since the way RFC 9110
+// orders them, so that every handler answers conditional requests alike.
+//
+
+#ifndef WEBFORGE_HTTP_ETAG_H_
+#define WEBFORGE_HTTP_ETAG_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/date.h"
+#include "webforge/http/http.h"
+
+namespace wf {
+
+// Computes a strong ETag over bytes that arrive a piece at a time.
+class ETagHasher {
+public:
+  ETagHasher();
+
+  void Update(absl::string_view data);
+
+  // Returns the ETag for everything passed to Update(), quotes included.
+  std::string Finish() const;
+
+private:
+  uint64_t lanes_[4];
+  char stripe_[32];  // Input that doesn't fill a whole stripe yet
+  std::size_t stripe_size_;
+  uint64_t total_size_;
+};
+
+// Returns the strong ETag for `content`, quotes included.
+std::string StrongETag(absl::string_view content);
+
+// Checks whether `etag` is one of the tags in `if_none_match`, the value of an
+// If-None-Match header. The comparison is weak, as If-None-Match requires: a
+// W/ prefix on either side is ignored. "*" matches any tag.
+bool ETagMatches(absl::string_view if_none_match, absl::string_view etag);
+
+// Checks whether the client that sent `req` already has the representation
+// identified by `etag` and `modified_time`, so that a 304 can be sent instead.
+//
+// If-None-Match is used if present, and If-Modified-Since otherwise; the latter
+// only if `modified_time` isn't null. Only GET and HEAD requests are ever
+// answered with a 304.
+bool NotModified(const Request& req, absl::string_view etag,
+                 const HTTPDate* modified_time);
+
+}
+
+#endif  // WEBFORGE_HTTP_ETAG_H_
@@ -0,0 +1,77 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: etag_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file defines tests for ETag generation and conditional requests.
+//
+
+#include "webforge/http/etag.h"
+
+#include <cstddef>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "webforge/http/date.h"
+#include "webforge/http/http.h"
+
+TEST(ETagTest, HashesContentsInAnyPieces) {
+  // XXH64 of the empty string.
+  EXPECT_EQ(wf::StrongETag(""), "\"ef46db3751d8e999\"");
+
+  std::string content;
+  for (int i = 0; i < 1000; ++i) {
+    content += std::to_string(i);
+  }
+
+  wf::ETagHasher hasher;
+  for (std::size_t i = 0; i < content.size(); i += 7) {
+    hasher.Update(content.substr(i, 7));
+  }
+  EXPECT_EQ(hasher.Finish(), wf::StrongETag(content));
+  EXPECT_NE(wf::StrongETag(content), wf::StrongETag(content + "!"));
+}
+
+TEST(ETagTest, MatchesIfNoneMatchWeakly) {
+  EXPECT_TRUE(wf::ETagMatches("\"a\", \"b\"", "\"b\""));
+  EXPECT_TRUE(wf::ETagMatches("W/\"b\"", "\"b\""));
+  EXPECT_TRUE(wf::ETagMatches("*", "\"c\""));
+  EXPECT_FALSE(wf::ETagMatches("\"a\", \"b\"", "\"c\""));
+}
+
+TEST(ETagTest, PrefersIfNoneMatchOverIfModifiedSince) {
+  wf::Request req;
+  req.Method("GET");
+  wf::HTTPDate modified = wf::HTTPDate::FromString(
+    "Wed, 21 Oct 2015 07:28:00 GMT").value();
+
+  req.Header("If-Modified-Since", "Wed, 21 Oct 2015 07:28:00 GMT");
+  EXPECT_TRUE(wf::NotModified(req, "\"a\"", &modified));
+
+  req.Header("If-None-Match", "\"b\"");
+  EXPECT_FALSE(wf::NotModified(req, "\"a\"", &modified));
+  EXPECT_TRUE(wf::NotModified(req, "\"b\"", &modified));
+
+  req.Method("POST");
+  EXPECT_FALSE(wf::NotModified(req, "\"b\"", &modified));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: file.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::File on top of open(2), fstat(2) and pread(2), and
+// wf::MappedFile on top of mmap(2).
+//
+
+#include "webforge/http/file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+absl::StatusOr<std::shared_ptr<const File>> File::Open(
+  const std::filesystem::path& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT || errno == ENOTDIR) {
+      return absl::NotFoundError("no such file");
+    }
+
+    return absl::ErrnoToStatus(errno, "open() failed");
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "fstat() failed");
+    close(fd);
+    return s;
+  }
+
+  if (!S_ISREG(st.st_mode)) {
+    close(fd);
+    return absl::FailedPreconditionError("not a regular file");
+  }
+
+  return std::shared_ptr<const File>(new File(fd, st));
+}
+
+File::File(int fd, const struct stat& st) : fd_(fd), size_(st.st_size),
+  modified_time_(absl::TimeFromTimespec(st.st_mtim)), device_(st.st_dev),
+  inode_(st.st_ino) {
+  // Nothing to do.
+}
+
+File::~File() {
+  close(fd_);
+}
+
+int File::Descriptor() const {
+  return fd_;
+}
+
+std::size_t File::Size() const {
+  return size_;
+}
+
+absl::Time File::ModifiedTime() const {
+  return modified_time_;
+}
+
+dev_t File::Device() const {
+  return device_;
+}
+
+ino_t File::Inode() const {
+  return inode_;
+}
+
+absl::StatusOr<std::size_t> File::Read(off_t offset, std::size_t length,
+                                       char* buffer) const {
+  std::size_t total = 0;
+  while (total < length) {
+    ssize_t n = pread(fd_, buffer + total, length - total, offset + total);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return absl::ErrnoToStatus(errno, "pread() failed");
+    }
+
+    if (n == 0) {
+      break;
+    }
+
+    total += n;
+  }
+
+  return total;
+}
+
+absl::StatusOr<std::shared_ptr<const MappedFile>> MappedFile::Map(
+  const File& file) {
+  if (file.Size() == 0) {
+    // mmap(2) refuses empty mappings.
+    return std::shared_ptr<const MappedFile>(new MappedFile(nullptr, 0));
+  }
+
+  void* data = mmap(nullptr, file.Size(), PROT_READ, MAP_SHARED,
+                    file.Descriptor(), 0);
+  if (data == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap() failed");
+  }
+
+  return std::shared_ptr<const MappedFile>(new MappedFile(data, file.Size()));
+}
+
+MappedFile::MappedFile(void* data, std::size_t size) : data_(data),
+  size_(size) {
+  // Nothing to do.
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+absl::string_view MappedFile::Contents() const {
+  return absl::string_view(static_cast<const char*>(data_), size_);
+}
+
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: file.h
+// -----------------------------------------------------------------------------
+//
+// wf::File is an open, read-only file that can be handed to a wf::Response to
+// be sent as (part of) its body, see wf::Response::WriteFile.
+//
+// Sending a file can outlive the handler that started it, since the server may
+// only get around to it after the response has ended. A wf::File is therefore
+// always owned through a std::shared_ptr, and its descriptor is closed once the
+// last reference goes away.
+//
+// wf::MappedFile maps a wf::File into memory instead, for handing its contents
+// to code that wants bytes rather than a descriptor without reading them into a
+// buffer first. It is owned the same way, and unmapped with its last reference.
+//
+
+#ifndef WEBFORGE_HTTP_FILE_H_
+#define WEBFORGE_HTTP_FILE_H_
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+class File {
+public:
+  // Opens the regular file at `path` for reading.
+  //
+  // Returns an absl::NotFoundError if there is no such file, and an
+  // absl::FailedPreconditionError if `path` is not a regular file.
+  static absl::StatusOr<std::shared_ptr<const File>> Open(
+    const std::filesystem::path& path);
+
+  ~File();
+
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+
+  int Descriptor() const;
+
+  // Size and modification time, as of when the file was opened.
+  std::size_t Size() const;
+  absl::Time ModifiedTime() const;
+
+  // Together, these identify the file itself rather than the path it was
+  // opened by.
+  dev_t Device() const;
+  ino_t Inode() const;
+
+  // Reads up to `length` bytes at `offset` into `buffer`, and returns how many
+  // were read. Fewer than `length` means the end of the file was reached.
+  absl::StatusOr<std::size_t> Read(off_t offset, std::size_t length,
+                                   char* buffer) const;
+
+private:
+  File(int fd, const struct stat& st);
+
+  int fd_;
+  std::size_t size_;
+  absl::Time modified_time_;
+  dev_t device_;
+  ino_t inode_;
+};
+
+class MappedFile {
+public:
+  // Maps all of `file` read-only.
+  //
+  // The mapping sees changes made to the file in place, and touching a part of
+  // it that has since been truncated away raises SIGBUS. Files that are mapped
+  // should therefore only ever be replaced, e.g. with rename(2).
+  static absl::StatusOr<std::shared_ptr<const MappedFile>> Map(
+    const File& file);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  absl::string_view Contents() const;
+
+private:
+  MappedFile(void* data, std::size_t size);
+
+  void* data_;
+  std::size_t size_;
+};
+
+}
+
+#endif  // WEBFORGE_HTTP_FILE_H_
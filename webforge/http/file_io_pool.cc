@@ -0,0 +1,131 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: file_io_pool.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::FileIOPool with a queue of tasks shared by its threads.
+//
+
+#include "webforge/http/file_io_pool.h"
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace wf {
+
+std::shared_ptr<FileIOPool::ScopedExecutor::State>&
+FileIOPool::ScopedExecutor::Current() {
+  thread_local std::shared_ptr<State> state;
+  return state;
+}
+
+FileIOPool::ScopedExecutor::ScopedExecutor(Executor executor) :
+  state_(std::make_shared<State>()),
+  previous_(Current()) {
+  absl::MutexLock lock(&state_->mutex);
+  state_->executor = std::move(executor);
+  Current() = state_;
+}
+
+FileIOPool::ScopedExecutor::~ScopedExecutor() {
+  Current() = std::move(previous_);
+
+  absl::MutexLock lock(&state_->mutex);
+  state_->executor = nullptr;
+}
+
+FileIOPool::FileIOPool(int threads) : thread_count_(threads),
+  stopping_(false) {
+  // Nothing to do.
+}
+
+FileIOPool::~FileIOPool() {
+  std::vector<std::thread> threads;
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+    threads.swap(threads_);
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+std::shared_ptr<FileIOPool> FileIOPool::Shared() {
+  static std::shared_ptr<FileIOPool> pool = std::make_shared<FileIOPool>();
+  return pool;
+}
+
+void FileIOPool::Run(Task work, Task done) {
+  std::shared_ptr<ScopedExecutor::State> state = ScopedExecutor::Current();
+  if (state == nullptr) {
+    work();
+    done();
+    return;
+  }
+
+  Task task = [work = std::move(work), done = std::move(done),
+               state = std::move(state)]() mutable {
+    work();
+
+    absl::MutexLock lock(&state->mutex);
+    if (state->executor) {
+      state->executor(std::move(done));
+    }
+  };
+
+  absl::MutexLock lock(&mutex_);
+  if (threads_.empty()) {
+    for (int i = 0; i < thread_count_; ++i) {
+      threads_.emplace_back(&FileIOPool::Work, this);
+    }
+  }
+
+  queue_.push_back(std::move(task));
+}
+
+bool FileIOPool::HasWork() const {
+  return stopping_ || !queue_.empty();
+}
+
+void FileIOPool::Work() {
+  while (true) {
+    Task task;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &FileIOPool::HasWork));
+
+      if (queue_.empty()) {
+        // Stopping, and nothing left to do.
+        return;
+      }
+
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    task();
+  }
+}
+
+}
@@ -0,0 +1,113 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: file_io_pool.h
+// -----------------------------------------------------------------------------
+//
+// wf::FileIOPool keeps blocking filesystem calls off the threads that run
+// event loops. Sockets can be waited on, but opening or reading a file that
+// isn't in the page cache (or even stat'ing it, on a slow or network
+// filesystem) blocks the whole thread, and with it every other connection of
+// its event loop.
+//
+// Static handlers hand such work to the pool, which runs it on one of a few
+// threads of its own, and then has the event loop that asked for it run the
+// rest of the request. For this, each thread that runs an event loop installs
+// an executor (see FileIOPool::ScopedExecutor), which wf::Server does for both
+// of its I/O backends.
+//
+// Threads without an executor, such as that of a CGI program, which handles a
+// single request, keep doing the work right away. The pool only starts its
+// threads the first time they are needed.
+//
+
+#ifndef WEBFORGE_HTTP_FILE_IO_POOL_H_
+#define WEBFORGE_HTTP_FILE_IO_POOL_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace wf {
+
+class FileIOPool {
+public:
+  using Task = std::function<void()>;
+
+  // Runs a task on the thread it belongs to. Must be thread-safe.
+  using Executor = std::function<void(Task)>;
+
+  // Makes `executor` the executor of the calling thread for as long as it
+  // exists. Work that finishes after it is gone is dropped instead of being
+  // handed to it, so that it can't outlive whatever it posts to.
+  class ScopedExecutor {
+  public:
+    explicit ScopedExecutor(Executor executor);
+    ~ScopedExecutor();
+
+    ScopedExecutor(const ScopedExecutor&) = delete;
+    ScopedExecutor& operator=(const ScopedExecutor&) = delete;
+
+  private:
+    friend class FileIOPool;
+
+    struct State {
+      absl::Mutex mutex;
+      Executor executor ABSL_GUARDED_BY(mutex);
+    };
+
+    // The state of the calling thread's innermost ScopedExecutor, if any.
+    static std::shared_ptr<State>& Current();
+
+    std::shared_ptr<State> state_;
+    std::shared_ptr<State> previous_;
+  };
+
+  explicit FileIOPool(int threads = 4);
+  ~FileIOPool();
+
+  FileIOPool(const FileIOPool&) = delete;
+  FileIOPool& operator=(const FileIOPool&) = delete;
+
+  // The pool shared by static handlers that aren't given one of their own.
+  static std::shared_ptr<FileIOPool> Shared();
+
+  // Runs `work` on one of the pool's threads, and then `done` on the calling
+  // thread, through its executor. On a thread without an executor, both run
+  // before this method returns.
+  void Run(Task work, Task done);
+
+private:
+  // Runs queued tasks until the pool is destroyed.
+  void Work();
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  int thread_count_;
+
+  mutable absl::Mutex mutex_;
+  std::deque<Task> queue_ ABSL_GUARDED_BY(mutex_);
+  bool stopping_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::thread> threads_ ABSL_GUARDED_BY(mutex_);
+};
+
+}
+
+#endif  // WEBFORGE_HTTP_FILE_IO_POOL_H_
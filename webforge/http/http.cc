@@ -22,18 +22,27 @@
 
 #include "webforge/http/http.h"
 
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <initializer_list>
 #include <iostream>
 #include <memory>
 #include <streambuf>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
@@ -42,6 +51,7 @@
 #include "webforge/core/data.pb.h"
 #include "webforge/core/renderer.h"
 #include "webforge/http/cookie.h"
+#include "webforge/http/file.h"
 #include "webforge/http/strings.h"
 
 extern char** environ;
@@ -50,39 +60,39 @@ namespace wf {
 
 namespace {
 
-class ResponseStreambuf : public std::streambuf {
-public:
-  ResponseStreambuf(Response* res) : res_(res) {}
-
-protected:
-  std::streamsize xsputn(const char_type* s, std::streamsize n) override {
-    res_->Write(std::string(s, n)).IgnoreError();
-    return n;
-  }
-
-  int_type overflow(int_type c) override {
-    if (c != EOF) {
-      res_->Write(std::string(1, static_cast<char>(c))).IgnoreError();
-    }
-    
-    return 0;
-  }
-
-  int sync() override {
-    return 0;
+// Looks `name` up in a map keyed by CaseInsensitive() names. Only allocates if
+// `name` isn't lowercase already.
+template <typename Map>
+typename Map::const_iterator FindCaseInsensitive(const Map& map,
+                                                 absl::string_view name) {
+  if (std::none_of(name.begin(), name.end(), absl::ascii_isupper)) {
+    return map.find(name);
   }
 
-private:
-  Response* res_;
-};
+  return map.find(CaseInsensitive(name));
+}
 
 }
 
-Request::Request() : method_(CaseInsensitive("GET")), path_("/"),
+Request::Request() : using_tls_(false), method_(CaseInsensitive("GET")),
+  path_("/"),
   version_(CaseInsensitive("HTTP/0.9")) {
   // Nothing to do.
 }
 
+void Request::Reset() {
+  using_tls_ = false;
+  method_.assign("get");
+  path_.assign("/");
+  version_.assign("http/0.9");
+
+  // clear() keeps the table allocated, unless it has grown unusually large.
+  query_.clear();
+  headers_.clear();
+  cookies_.clear();
+  stream_ = nullptr;
+}
+
 bool Request::UsingTLS() const {
   return using_tls_;
 }
@@ -141,18 +151,16 @@ void Request::Version(absl::string_view version) {
 }
 
 absl::StatusOr<const std::string> Request::Header(absl::string_view name) const {
-  std::string name_string = CaseInsensitive(name);
-  if (headers_.contains(name_string)) {
-    return headers_.at(name_string);
+  auto it = FindCaseInsensitive(headers_, name);
+  if (it != headers_.end()) {
+    return it->second;
   }
 
   return absl::NotFoundError("no header with that name");
 }
 
 void Request::Header(absl::string_view name, absl::string_view value) {
-  std::string name_string = CaseInsensitive(name);
-
-  if (name_string == CaseInsensitive("Cookie")) {
+  if (absl::EqualsIgnoreCase(name, "Cookie")) {
     // We must treat cookies specially. This is not just a regular header.
     std::vector<absl::string_view> parts = absl::StrSplit(value, ';');
     for (auto& it : parts) {
@@ -182,7 +190,7 @@ void Request::Header(absl::string_view name, absl::string_view value) {
     return;
   }
 
-  headers_[name_string] = std::string(value);
+  headers_[CaseInsensitive(name)] = std::string(value);
 }
 
 const absl::flat_hash_map<std::string, std::string>& Request::Headers() const {
@@ -318,6 +326,38 @@ ResponseWriter::ResponseWriter() {
   // Nothing to do.
 }
 
+absl::Status ResponseWriter::Flush() {
+  return absl::OkStatus();
+}
+
+absl::Status ResponseWriter::WriteFile(std::shared_ptr<const File> file,
+                                       off_t offset, std::size_t length) {
+  constexpr std::size_t kPieceSize = 64 * 1024;
+  std::string buffer(std::min(length, kPieceSize), '\0');
+
+  while (length > 0) {
+    absl::StatusOr<std::size_t> n = file->Read(
+      offset, std::min(length, buffer.size()), buffer.data());
+    if (!n.ok()) {
+      return n.status();
+    }
+
+    if (n.value() == 0) {
+      return absl::OutOfRangeError("file ended early");
+    }
+
+    absl::Status s = WriteChunk(absl::string_view(buffer.data(), n.value()));
+    if (!s.ok()) {
+      return s;
+    }
+
+    offset += n.value();
+    length -= n.value();
+  }
+
+  return absl::OkStatus();
+}
+
 absl::Status ResponseWriter::WriteEnd(absl::string_view chunk) {
   absl::Status s = WriteChunk(chunk);
   End();
@@ -325,6 +365,58 @@ absl::Status ResponseWriter::WriteEnd(absl::string_view chunk) {
   return s;
 }
 
+void ResponseWriter::AppendHead(const Response& res,
+                                absl::string_view status_line,
+                                std::initializer_list<absl::string_view> skip,
+                                std::size_t extra, std::string* out) {
+  constexpr absl::string_view kCRLF = "\r\n";
+  constexpr absl::string_view kSeparator = ": ";
+  constexpr absl::string_view kSetCookie = "set-cookie: ";
+
+  auto skipped = [&skip](absl::string_view name) {
+    return std::find(skip.begin(), skip.end(), name) != skip.end();
+  };
+
+  // Cookies are rare, and only know their length once rendered.
+  std::vector<std::string> cookies;
+  cookies.reserve(res.Cookies().size());
+  for (const auto& it : res.Cookies()) {
+    cookies.push_back(it.second.ToString());
+  }
+
+  std::size_t size = status_line.size() + kCRLF.size();
+  for (const auto& it : res.Headers()) {
+    if (!skipped(it.first)) {
+      size += it.first.size() + kSeparator.size() + it.second.size() +
+              kCRLF.size();
+    }
+  }
+
+  for (const auto& cookie : cookies) {
+    size += kSetCookie.size() + cookie.size() + kCRLF.size();
+  }
+
+  out->reserve(out->size() + size + extra);
+  out->append(status_line.data(), status_line.size());
+  out->append(kCRLF.data(), kCRLF.size());
+  for (const auto& it : res.Headers()) {
+    if (skipped(it.first)) {
+      continue;
+    }
+
+    out->append(it.first);
+    out->append(kSeparator.data(), kSeparator.size());
+    out->append(it.second);
+    out->append(kCRLF.data(), kCRLF.size());
+  }
+
+  for (const auto& cookie : cookies) {
+    out->append(kSetCookie.data(), kSetCookie.size());
+    out->append(cookie);
+    out->append(kCRLF.data(), kCRLF.size());
+  }
+}
+
 Response::Response() : head_written_(false), finished_(false),
   version_(CaseInsensitive("HTTP/0.9")), status_(200),
   charset_(CaseInsensitive("UTF-8")), is_head_(false) {
@@ -333,13 +425,25 @@ Response::Response() : head_written_(false), finished_(false),
 
 std::shared_ptr<Response> Response::FromRequest(const Request& req) {
   std::shared_ptr<Response> res = std::make_shared<Response>();
-
-  res->version_ = req.Version();
-  res->is_head_ = req.Method() == CaseInsensitive("HEAD");
+  res->Reset(req);
 
   return res;  
 }
 
+void Response::Reset(const Request& req) {
+  head_written_ = false;
+  finished_ = false;
+  version_.assign(req.Version());
+  status_ = 200;
+  headers_.clear();
+  charset_.assign("utf-8");
+  cookies_.clear();
+  writer_ = nullptr;
+  renderer_ = nullptr;
+  error_ = absl::OkStatus();
+  is_head_ = req.Method() == "head";
+}
+
 void Response::UseWriter(std::shared_ptr<ResponseWriter> writer) {
   writer_ = writer;
 }
@@ -348,6 +452,10 @@ void Response::UseRenderer(std::shared_ptr<Renderer> renderer) {
   renderer_ = renderer;
 }
 
+std::shared_ptr<ResponseWriter> Response::Writer() const {
+  return writer_;
+}
+
 bool Response::HeadWritten() const {
   return head_written_;
 }
@@ -373,9 +481,9 @@ void Response::Status(int status) {
 }
 
 absl::StatusOr<const std::string> Response::Header(absl::string_view name) const {
-  std::string name_string = CaseInsensitive(name);
-  if (headers_.contains(name_string)) {
-    return headers_.at(name_string);
+  auto it = FindCaseInsensitive(headers_, name);
+  if (it != headers_.end()) {
+    return it->second;
   }
 
   return absl::NotFoundError("no header with that name");
@@ -498,6 +606,28 @@ absl::Status Response::Write(absl::string_view data) {
   return writer_->WriteChunk(data);
 }
 
+absl::Status Response::WriteFile(std::shared_ptr<const File> file,
+                                 off_t offset, std::size_t length) {
+  if (finished_) {
+    return absl::FailedPreconditionError(
+      "cannot write data, response already finished"
+    );
+  }
+
+  if (!head_written_) {
+    absl::Status s = WriteHead();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  if (is_head_ || length == 0) {
+    return absl::OkStatus();
+  }
+
+  return writer_->WriteFile(std::move(file), offset, length);
+}
+
 absl::Status Response::End(absl::string_view data) {
   if (!head_written_) {
     // We can actually write the content-length too.
@@ -518,9 +648,25 @@ void Response::End() {
     WriteHead().IgnoreError();
   }
 
+  finished_ = true;
   writer_->End();
 }
 
+absl::Status Response::Flush() {
+  if (finished_) {
+    return absl::OkStatus();
+  }
+
+  if (!head_written_) {
+    absl::Status s = WriteHead();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  return writer_->Flush();
+}
+
 absl::Status Response::Render(absl::string_view component,
                               const std::vector<wf::proto::Data>& data) {
   const std::string& mime_type = GetMimeType(component);
@@ -541,8 +687,70 @@ absl::Status Response::Render(absl::string_view component,
     s = renderer_->Render(component, nullptr, data, &os);
   }
 
+  absl::Status drained = sb.Drain();
+  if (s.ok()) {
+    s = drained;
+  }
+
   return s;
 }
 
+ResponseStreambuf::ResponseStreambuf(Response* res) : res_(res) {
+  setp(buffer_, buffer_ + sizeof(buffer_));
+}
+
+absl::Status ResponseStreambuf::Drain() {
+  absl::string_view pending(pbase(), pptr() - pbase());
+  setp(buffer_, buffer_ + sizeof(buffer_));
+
+  if (pending.empty()) {
+    return absl::OkStatus();
+  }
+
+  return res_->Write(pending);
+}
+
+std::streamsize ResponseStreambuf::xsputn(const char_type* s,
+                                          std::streamsize n) {
+  if (n <= epptr() - pptr()) {
+    memcpy(pptr(), s, n);
+    pbump(n);
+    return n;
+  }
+
+  if (!Drain().ok()) {
+    return 0;
+  }
+
+  if (n >= static_cast<std::streamsize>(sizeof(buffer_))) {
+    // Wouldn't fit anyway, so skip the copy.
+    return res_->Write(absl::string_view(s, n)).ok() ? n : 0;
+  }
+
+  memcpy(pptr(), s, n);
+  pbump(n);
+  return n;
+}
+
+ResponseStreambuf::int_type ResponseStreambuf::overflow(int_type c) {
+  if (!Drain().ok()) {
+    return traits_type::eof();
+  }
+
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
 }
 
+int ResponseStreambuf::sync() {
+  if (!Drain().ok()) {
+    return -1;
+  }
+
+  return res_->Flush().ok() ? 0 : -1;
+}
+
+}
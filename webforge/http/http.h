@@ -27,9 +27,14 @@
 #ifndef WEBFORGE_SITE_HTTP_H_
 #define WEBFORGE_SITE_HTTP_H_
 
+#include <sys/types.h>
+
+#include <cstddef>
 #include <filesystem>
+#include <initializer_list>
 #include <iostream>
 #include <memory>
+#include <streambuf>
 #include <string>
 #include <vector>
 
@@ -42,6 +47,7 @@
 #include "webforge/core/data.pb.h"
 #include "webforge/core/renderer.h"
 #include "webforge/http/cookie.h"
+#include "webforge/http/file.h"
 
 namespace wf {
 
@@ -49,6 +55,11 @@ class Request {
 public:
   Request();
 
+  // Returns the request to the state of a newly constructed one, but keeps the
+  // memory its strings and maps have allocated, so a connection can reuse the
+  // same Request for each of its requests.
+  void Reset();
+
   bool UsingTLS() const;
   void UsingTLS(bool using_tls);
 
@@ -129,8 +140,31 @@ public:
   virtual absl::Status WriteChunk(absl::string_view chunk) = 0;
   virtual void End() = 0;
 
+  // Sends everything written so far to the client, for writers that hold
+  // output back to send it in larger pieces. Does nothing by default.
+  virtual absl::Status Flush();
+
+  // Writes `length` bytes of `file`, starting at `offset`, as the next part of
+  // the body. Writers that send to a descriptor override this to have the
+  // kernel copy the file over (see sendfile(2)), so that it never passes
+  // through user space. By default, the file is read and passed to
+  // WriteChunk() a piece at a time.
+  virtual absl::Status WriteFile(std::shared_ptr<const File> file,
+                                 off_t offset, std::size_t length);
+
   // Guaranteed to call End() even when returning an error.
   absl::Status WriteEnd(absl::string_view chunk);
+
+  // Appends the head of `res` to `out`: `status_line`, then every header whose
+  // name isn't in `skip`, then a Set-Cookie line per cookie, each followed by
+  // CRLF. The blank line that ends the head is left to the caller, so that it
+  // can add headers of its own first.
+  //
+  // `out` is grown once, to fit the head plus `extra` more bytes, so that the
+  // head is serialized without reallocating and can go out in a single write.
+  static void AppendHead(const Response& res, absl::string_view status_line,
+                         std::initializer_list<absl::string_view> skip,
+                         std::size_t extra, std::string* out);
 };
 
 class Response {
@@ -142,9 +176,18 @@ public:
   // DOES NOT SET A RESPONSE WRITER.
   static std::shared_ptr<Response> FromRequest(const Request& req);
 
+  // Returns the response to the state FromRequest(req) creates it in, but keeps
+  // the memory its strings and maps have allocated. Also drops the writer and
+  // renderer.
+  void Reset(const Request& req);
+
   void UseWriter(std::shared_ptr<ResponseWriter> writer);
   void UseRenderer(std::shared_ptr<Renderer> renderer);
 
+  // Returns the writer set with UseWriter(), so that a middleware can wrap it
+  // in one of its own.
+  std::shared_ptr<ResponseWriter> Writer() const;
+
   bool HeadWritten() const;
   bool Finished() const;
 
@@ -178,9 +221,21 @@ public:
 
   absl::Status WriteHead();
   absl::Status Write(absl::string_view data);
+
+  // Writes `length` bytes of `file`, starting at `offset`, as body data. See
+  // ResponseWriter::WriteFile.
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length);
   absl::Status End(absl::string_view data);
   void End();
 
+  // Sends everything written so far to the client right away, instead of when
+  // the response writer sees fit. Writes the head first if necessary.
+  //
+  // Useful to get the top of a page to the client before producing the rest of
+  // it takes a while. std::flush on a Render() stream has the same effect.
+  absl::Status Flush();
+
   // Calls WriteHead if not already done, and calls End once it is done writing
   // data out.
   absl::Status Render(absl::string_view component,
@@ -200,6 +255,36 @@ private:
   bool is_head_;  // Was the request a HEAD request?
 };
 
+// The std::streambuf that Response::Render() hands to the renderer, which can
+// also be used to write a response with operator<<.
+//
+// Renderers tend to produce lots of tiny writes, so they are collected into
+// pieces of up to kBufferSize bytes before they reach Response::Write(). Writes
+// that wouldn't fit skip the buffer. Flushing the stream (e.g. std::flush)
+// flushes the response too.
+class ResponseStreambuf : public std::streambuf {
+public:
+  static constexpr std::size_t kBufferSize = 8 * 1024;
+
+  explicit ResponseStreambuf(Response* res);
+
+  ResponseStreambuf(const ResponseStreambuf&) = delete;
+  ResponseStreambuf& operator=(const ResponseStreambuf&) = delete;
+
+  // Writes whatever is still buffered to the response. Must be called once
+  // done writing, before the response ends.
+  absl::Status Drain();
+
+protected:
+  std::streamsize xsputn(const char_type* s, std::streamsize n) override;
+  int_type overflow(int_type c) override;
+  int sync() override;
+
+private:
+  Response* res_;
+  char buffer_[kBufferSize];
+};
+
 using RequestPtr = std::shared_ptr<Request>;
 using ResponsePtr = std::shared_ptr<Response>;
 
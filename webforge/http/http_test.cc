@@ -22,9 +22,12 @@
 
 #include "webforge/http/http.h"
 
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
@@ -33,6 +36,9 @@
 #include <gtest/gtest.h>
 #include <nlohmann/json.hpp>
 
+#include "webforge/core/data.pb.h"
+#include "webforge/core/renderer.h"
+
 class RequestTest : public testing::Test {
 protected:
   void SetUp() override {
@@ -214,7 +220,7 @@ namespace {
 
 class WriteHeadWriter : public wf::ResponseWriter {
 public:
-  WriteHeadWriter() : head_written_(false) {}
+  WriteHeadWriter() : head_written_(false), flushes_(0) {}
 
   absl::Status WriteHead(const wf::Response& res) override {
     head_written_ = true;
@@ -222,6 +228,12 @@ public:
   }
 
   absl::Status WriteChunk(absl::string_view chunk) override {
+    chunks_.emplace_back(chunk);
+    return absl::OkStatus();
+  }
+
+  absl::Status Flush() override {
+    flushes_++;
     return absl::OkStatus();
   }
 
@@ -231,8 +243,18 @@ public:
     return head_written_;
   }
 
+  const std::vector<std::string>& Chunks() const {
+    return chunks_;
+  }
+
+  int Flushes() const {
+    return flushes_;
+  }
+
 private:
   bool head_written_;
+  std::vector<std::string> chunks_;
+  int flushes_;
 };
 
 class WriteEndGuaranteeWriter : public wf::ResponseWriter {
@@ -281,6 +303,92 @@ TEST_F(ResponseTest, EndDoesWriteHead) {
   EXPECT_TRUE(writer->HeadWritten());
 }
 
+TEST_F(ResponseTest, StreambufMergesTinyWrites) {
+  auto writer = std::make_shared<WriteHeadWriter>();
+  res_.UseWriter(writer);
+
+  wf::ResponseStreambuf sb(&res_);
+  std::ostream os(&sb);
+  for (int i = 0; i < 10000; i++) {
+    os << "ab";
+  }
+  ASSERT_THAT(sb.Drain(), absl_testing::IsOk());
+
+  std::string body;
+  for (const std::string& chunk : writer->Chunks()) {
+    EXPECT_LE(chunk.size(), wf::ResponseStreambuf::kBufferSize);
+    body += chunk;
+  }
+
+  // 20000 bytes in 8 KiB pieces, rather than 10000 writes.
+  EXPECT_EQ(writer->Chunks().size(), 3);
+  EXPECT_EQ(body.size(), 20000);
+}
+
+TEST_F(ResponseTest, StreambufLargeWritesSkipBuffer) {
+  auto writer = std::make_shared<WriteHeadWriter>();
+  res_.UseWriter(writer);
+
+  std::string large(wf::ResponseStreambuf::kBufferSize, 'x');
+  wf::ResponseStreambuf sb(&res_);
+  std::ostream os(&sb);
+  os << "head";
+  os << large;
+
+  // What was buffered goes first, then the large write as it is.
+  ASSERT_EQ(writer->Chunks().size(), 2);
+  EXPECT_EQ(writer->Chunks()[0], "head");
+  EXPECT_EQ(writer->Chunks()[1], large);
+
+  ASSERT_THAT(sb.Drain(), absl_testing::IsOk());
+  EXPECT_EQ(writer->Chunks().size(), 2);
+}
+
+TEST_F(ResponseTest, StreambufFlushFlushesWriter) {
+  auto writer = std::make_shared<WriteHeadWriter>();
+  res_.UseWriter(writer);
+
+  wf::ResponseStreambuf sb(&res_);
+  std::ostream os(&sb);
+  os << "top of the page";
+  EXPECT_TRUE(writer->Chunks().empty());
+
+  os << std::flush;
+  EXPECT_TRUE(os.good());
+  EXPECT_EQ(writer->Flushes(), 1);
+  ASSERT_EQ(writer->Chunks().size(), 1);
+  EXPECT_EQ(writer->Chunks()[0], "top of the page");
+}
+
+TEST_F(ResponseTest, RenderDrainsBufferedOutput) {
+  std::filesystem::path dir =
+    std::filesystem::path(testing::TempDir()) / "response_render";
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir / "page.txt") << "{% for i in range(5000) %}ab{% endfor %}";
+
+  auto writer = std::make_shared<WriteHeadWriter>();
+  res_.UseWriter(writer);
+  res_.UseRenderer(std::make_shared<wf::Renderer>(dir));
+
+  ASSERT_THAT(res_.Render("page.txt", {}), absl_testing::IsOk());
+
+  std::string expected;
+  for (int i = 0; i < 5000; i++) {
+    expected += "ab";
+  }
+
+  std::string body;
+  for (const std::string& chunk : writer->Chunks()) {
+    body += chunk;
+  }
+
+  // The last, partially filled buffer must not be left behind.
+  ASSERT_EQ(writer->Chunks().size(), 2);
+  EXPECT_EQ(writer->Chunks()[1].size(),
+            expected.size() - wf::ResponseStreambuf::kBufferSize);
+  EXPECT_EQ(body, expected);
+}
+
 TEST_F(ResponseTest, EndGuaranteedToDoWriterEnd) {
   auto writer = std::make_shared<WriteEndGuaranteeWriter>();
   res_.UseWriter(writer);
@@ -291,6 +399,22 @@ TEST_F(ResponseTest, EndGuaranteedToDoWriterEnd) {
   EXPECT_TRUE(writer->HasEnded());
 }
 
+TEST_F(ResponseTest, AppendHeadSerializesHeadersAndCookies) {
+  res_.Header("Content-Type", "text/plain");
+  res_.Header("Connection", "close");
+  res_.Cookie("session", "abc");
+
+  std::string head = "prefix\n";
+  wf::ResponseWriter::AppendHead(res_, "HTTP/1.1 200 OK", {"connection"}, 16,
+                                 &head);
+
+  EXPECT_EQ(head, "prefix\n"
+                  "HTTP/1.1 200 OK\r\n"
+                  "content-type: text/plain\r\n"
+                  "set-cookie: session=abc\r\n");
+  EXPECT_GE(head.capacity(), head.size() + 16);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
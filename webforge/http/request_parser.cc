@@ -0,0 +1,230 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: request_parser.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::RequestParser. Line ends and the colons of header fields are
+// found with SSE2 (or AVX2, if enabled at compile time) byte comparisons, which
+// look at 16 (or 32) bytes at a time.
+//
+
+#include "webforge/http/request_parser.h"
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+
+namespace wf {
+
+namespace {
+
+// Returns the index of the first `c` in the `n` bytes at `data`, or `n` if
+// there is none.
+std::size_t FindByte(const char* data, std::size_t n, char c) {
+  std::size_t i = 0;
+
+#if defined(__AVX2__)
+  const __m256i wide_needle = _mm256_set1_epi8(c);
+  for (; i + 32 <= n; i += 32) {
+    __m256i block = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(data + i));
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block,
+                                                           wide_needle));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; i + 16 <= n; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    if (data[i] == c) {
+      return i;
+    }
+  }
+
+  return n;
+}
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+}
+
+const absl::string_view* RequestHead::Find(absl::string_view name) const {
+  for (const HeaderField& field : fields) {
+    if (absl::EqualsIgnoreCase(field.name, name)) {
+      return &field.value;
+    }
+  }
+
+  return nullptr;
+}
+
+RequestParser::RequestParser(std::size_t max_head_size) :
+  max_head_size_(max_head_size) {
+  Reset();
+}
+
+absl::StatusOr<std::size_t> RequestParser::Parse(absl::string_view buffer,
+                                                 RequestHead* head) {
+  while (true) {
+    std::size_t end = scanned_ + FindByte(buffer.data() + scanned_,
+                                          buffer.size() - scanned_, '\n');
+    if (end == buffer.size()) {
+      scanned_ = end;
+      if (buffer.size() > max_head_size_) {
+        return absl::ResourceExhaustedError("request head too large");
+      }
+
+      return 0;
+    }
+
+    if (end + 1 > max_head_size_) {
+      return absl::ResourceExhaustedError("request head too large");
+    }
+
+    if (end == line_start_ || buffer[end - 1] != '\r') {
+      return absl::InvalidArgumentError("line not terminated by CRLF");
+    }
+
+    absl::string_view line = buffer.substr(line_start_, end - 1 - line_start_);
+    std::size_t offset = line_start_;
+    line_start_ = end + 1;
+    scanned_ = line_start_;
+
+    if (!has_request_line_) {
+      if (line.empty()) {
+        // RFC 9112, section 2.2: servers SHOULD ignore empty lines before the
+        // request line, which some clients send after a request body.
+        continue;
+      }
+
+      absl::Status s = ParseRequestLine(line, offset);
+      if (!s.ok()) {
+        return s;
+      }
+
+      has_request_line_ = true;
+    } else if (line.empty()) {
+      break;
+    } else {
+      absl::Status s = ParseField(line, offset);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+
+  auto view = [buffer](Span span) {
+    return buffer.substr(span.offset, span.size);
+  };
+
+  head->method = view(method_);
+  head->target = view(target_);
+  head->version = view(version_);
+  head->fields.clear();
+  for (const auto& it : fields_) {
+    head->fields.push_back(HeaderField{view(it.first), view(it.second)});
+  }
+
+  std::size_t size = line_start_;
+  Reset();
+  return size;
+}
+
+void RequestParser::Reset() {
+  line_start_ = 0;
+  scanned_ = 0;
+  has_request_line_ = false;
+  fields_.clear();
+}
+
+absl::Status RequestParser::ParseRequestLine(absl::string_view line,
+                                             std::size_t offset) {
+  // e.g. GET /index.html?foo=bar HTTP/1.1
+  std::size_t first = FindByte(line.data(), line.size(), ' ');
+  if (first == 0 || first == line.size()) {
+    return absl::InvalidArgumentError("malformed request line");
+  }
+
+  std::size_t second = first + 1 + FindByte(line.data() + first + 1,
+                                            line.size() - first - 1, ' ');
+  if (second == first + 1 || second + 1 >= line.size() ||
+      line.find(' ', second + 1) != absl::string_view::npos) {
+    return absl::InvalidArgumentError("malformed request line");
+  }
+
+  method_ = Span{static_cast<uint32_t>(offset),
+                 static_cast<uint32_t>(first)};
+  target_ = Span{static_cast<uint32_t>(offset + first + 1),
+                 static_cast<uint32_t>(second - first - 1)};
+  version_ = Span{static_cast<uint32_t>(offset + second + 1),
+                  static_cast<uint32_t>(line.size() - second - 1)};
+  return absl::OkStatus();
+}
+
+absl::Status RequestParser::ParseField(absl::string_view line,
+                                       std::size_t offset) {
+  // Leading whitespace would make this an obsolete line folding, and
+  // whitespace before the colon isn't allowed either (RFC 9112 section 5).
+  std::size_t colon = FindByte(line.data(), line.size(), ':');
+  if (colon == 0 || colon == line.size() || IsWhitespace(line[0]) ||
+      IsWhitespace(line[colon - 1])) {
+    return absl::InvalidArgumentError("malformed header field");
+  }
+
+  std::size_t begin = colon + 1;
+  std::size_t end = line.size();
+  while (begin < end && IsWhitespace(line[begin])) {
+    ++begin;
+  }
+
+  while (end > begin && IsWhitespace(line[end - 1])) {
+    --end;
+  }
+
+  fields_.emplace_back(
+    Span{static_cast<uint32_t>(offset), static_cast<uint32_t>(colon)},
+    Span{static_cast<uint32_t>(offset + begin),
+         static_cast<uint32_t>(end - begin)});
+  return absl::OkStatus();
+}
+
+}
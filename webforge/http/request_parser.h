@@ -0,0 +1,117 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: request_parser.h
+// -----------------------------------------------------------------------------
+//
+// wf::RequestParser parses the head (request line and header fields) of an
+// HTTP/1.x request in place. Instead of building a wf::Request, it fills in a
+// wf::RequestHead whose fields are views into the buffer the request was read
+// into, so parsing a request doesn't allocate anything once the RequestHead's
+// field vector has grown to fit.
+//
+// The parser is incremental: it can be handed the same, growing buffer after
+// every read, and only scans the bytes it hasn't seen yet. Once a head is
+// complete, the parser starts over, so pipelined requests are parsed by handing
+// it whatever follows the previous request. Empty lines in front of a request
+// line are skipped, and count towards the size of the head.
+//
+// Only the parsing is zero-allocation. wf::Request owns its strings, so
+// whoever turns a RequestHead into a wf::Request (like wf::HTTPConnection)
+// still copies the fields it keeps, though into a reused Request whose
+// containers have already grown to fit.
+//
+
+#ifndef WEBFORGE_HTTP_REQUEST_PARSER_H_
+#define WEBFORGE_HTTP_REQUEST_PARSER_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace wf {
+
+struct HeaderField {
+  absl::string_view name;  // As sent by the client, in whatever case
+  absl::string_view value;  // Without leading or trailing whitespace
+};
+
+// A parsed request head. Every view points into the buffer that was passed to
+// RequestParser::Parse, and is only valid for as long as that buffer is.
+struct RequestHead {
+  absl::string_view method;  // e.g. GET
+  absl::string_view target;  // e.g. /index.html?foo=bar
+  absl::string_view version;  // e.g. HTTP/1.1
+  std::vector<HeaderField> fields;  // In the order they were sent
+
+  // Returns the value of the first field called `name`, compared
+  // case-insensitively, or nullptr if there is no such field.
+  const absl::string_view* Find(absl::string_view name) const;
+};
+
+class RequestParser {
+public:
+  // Heads longer than `max_head_size` bytes, including the blank line that
+  // ends them, are rejected.
+  explicit RequestParser(std::size_t max_head_size);
+
+  // Parses the request head at the start of `buffer` into `head`.
+  //
+  // Returns the size of the head, including any empty lines before it and the
+  // blank line that ends it, once it is complete. Returns 0 if more data is
+  // needed, in which case Parse should be called again with the same bytes
+  // plus whatever arrived since. `buffer` may move in between calls, as long as
+  // its contents don't change.
+  //
+  // Errors are:
+  // - absl::InvalidArgumentError for a malformed request line or field
+  // - absl::ResourceExhaustedError for a head that is too long
+  absl::StatusOr<std::size_t> Parse(absl::string_view buffer,
+                                    RequestHead* head);
+
+  // Forgets about a partially parsed head.
+  void Reset();
+
+private:
+  // Offsets into the buffer, which stay valid when the buffer moves.
+  struct Span {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  absl::Status ParseRequestLine(absl::string_view line, std::size_t offset);
+  absl::Status ParseField(absl::string_view line, std::size_t offset);
+
+  std::size_t max_head_size_;
+
+  std::size_t line_start_;  // Start of the first line that isn't parsed yet
+  std::size_t scanned_;  // How far line_start_'s line was searched for its end
+  bool has_request_line_;
+
+  Span method_;
+  Span target_;
+  Span version_;
+  std::vector<std::pair<Span, Span>> fields_;
+};
+
+}
+
+#endif  // WEBFORGE_HTTP_REQUEST_PARSER_H_
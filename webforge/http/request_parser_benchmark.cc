@@ -0,0 +1,131 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: request_parser_benchmark.cc
+// -----------------------------------------------------------------------------
+//
+// Compares parsing a typical browser request with wf::RequestParser against
+// the way request heads used to be parsed: splitting the head into lines and
+// storing every field with Request::Header, which lowercases a copy of each
+// name and copies each value. Both then look up the fields a server needs for
+// every request.
+//
+// Run with:
+//   bazel run -c opt //webforge/http:request_parser_benchmark
+//
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include <benchmark/benchmark.h>
+
+#include "webforge/http/http.h"
+#include "webforge/http/request_parser.h"
+
+namespace {
+
+constexpr absl::string_view kRequest =
+  "GET /articles/2025/05/index.html?page=2 HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:138.0) Gecko/20100101 "
+  "Firefox/138.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+  "Referer: https://www.example.com/articles/2025/05/\r\n"
+  "Connection: keep-alive\r\n"
+  "Upgrade-Insecure-Requests: 1\r\n"
+  "Sec-Fetch-Dest: document\r\n"
+  "Sec-Fetch-Mode: navigate\r\n"
+  "Sec-Fetch-Site: same-origin\r\n"
+  "Priority: u=0, i\r\n"
+  "\r\n";
+
+void BM_RequestParser(benchmark::State& state) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  for (auto _ : state) {
+    absl::StatusOr<std::size_t> size = parser.Parse(kRequest, &head);
+    benchmark::DoNotOptimize(size);
+    benchmark::DoNotOptimize(head.Find("Content-Length"));
+    benchmark::DoNotOptimize(head.Find("Transfer-Encoding"));
+    benchmark::DoNotOptimize(head.Find("Connection"));
+    benchmark::DoNotOptimize(head.Find("Expect"));
+  }
+
+  state.SetBytesProcessed(state.iterations() * kRequest.size());
+}
+
+// Same as above, but with the request arriving a few bytes at a time.
+void BM_RequestParserPartial(benchmark::State& state) {
+  const std::size_t read_size = state.range(0);
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  for (auto _ : state) {
+    for (std::size_t n = read_size; ; n += read_size) {
+      absl::StatusOr<std::size_t> size =
+        parser.Parse(kRequest.substr(0, n), &head);
+      if (!size.ok() || size.value() != 0) {
+        break;
+      }
+    }
+
+    benchmark::DoNotOptimize(head.Find("Connection"));
+  }
+
+  state.SetBytesProcessed(state.iterations() * kRequest.size());
+}
+
+void BM_RequestHeader(benchmark::State& state) {
+  for (auto _ : state) {
+    std::vector<absl::string_view> lines = absl::StrSplit(
+      kRequest.substr(0, kRequest.find("\r\n\r\n")), "\r\n");
+    std::vector<absl::string_view> parts = absl::StrSplit(lines[0], ' ');
+
+    wf::Request req;
+    req.Method(parts[0]);
+    req.Path(parts[1]);
+    req.Version(parts[2]);
+    for (std::size_t i = 1; i < lines.size(); ++i) {
+      absl::string_view line = lines[i];
+      auto colon = line.find(':');
+      absl::string_view value = line.substr(colon + 1);
+      value.remove_prefix(value.find_first_not_of(' '));
+      req.Header(line.substr(0, colon), value);
+    }
+
+    benchmark::DoNotOptimize(req.Header("Content-Length"));
+    benchmark::DoNotOptimize(req.Header("Transfer-Encoding"));
+    benchmark::DoNotOptimize(req.Header("Connection"));
+    benchmark::DoNotOptimize(req.Header("Expect"));
+  }
+
+  state.SetBytesProcessed(state.iterations() * kRequest.size());
+}
+
+}
+
+BENCHMARK(BM_RequestParser);
+BENCHMARK(BM_RequestParserPartial)->Arg(16)->Arg(128);
+BENCHMARK(BM_RequestHeader);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,161 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: request_parser_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file defines tests for wf::RequestParser.
+//
+
+#include "webforge/http/request_parser.h"
+
+#include <cstddef>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr absl::string_view kRequest =
+  "GET /index.html?foo=bar HTTP/1.1\r\n"
+  "Host: example.com\r\n"
+  "Accept:text/html \r\n"
+  "X-Empty:\r\n"
+  "\r\n";
+
+}
+
+TEST(RequestParser, CanParseRequest) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  absl::StatusOr<std::size_t> size = parser.Parse(kRequest, &head);
+  ASSERT_TRUE(size.ok());
+  EXPECT_EQ(size.value(), kRequest.size());
+
+  EXPECT_EQ(head.method, "GET");
+  EXPECT_EQ(head.target, "/index.html?foo=bar");
+  EXPECT_EQ(head.version, "HTTP/1.1");
+  ASSERT_EQ(head.fields.size(), 3);
+  EXPECT_EQ(head.fields[0].name, "Host");
+  EXPECT_EQ(head.fields[0].value, "example.com");
+  EXPECT_EQ(head.fields[1].value, "text/html");
+  EXPECT_EQ(head.fields[2].value, "");
+
+  // The views point into the buffer that was parsed.
+  EXPECT_EQ(head.method.data(), kRequest.data());
+}
+
+TEST(RequestParser, CanFindFieldsCaseInsensitively) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+  ASSERT_TRUE(parser.Parse(kRequest, &head).ok());
+
+  ASSERT_NE(head.Find("host"), nullptr);
+  EXPECT_EQ(*head.Find("HOST"), "example.com");
+  EXPECT_EQ(head.Find("Content-Length"), nullptr);
+}
+
+TEST(RequestParser, CanResumeAfterPartialReads) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  // Each byte is handed over separately, in a buffer that moves every time.
+  std::string buffer;
+  for (std::size_t i = 0; i < kRequest.size(); ++i) {
+    buffer.push_back(kRequest[i]);
+    buffer.shrink_to_fit();
+
+    absl::StatusOr<std::size_t> size = parser.Parse(buffer, &head);
+    ASSERT_TRUE(size.ok());
+    EXPECT_EQ(size.value(), i + 1 == kRequest.size() ? kRequest.size() : 0);
+  }
+
+  EXPECT_EQ(head.target, "/index.html?foo=bar");
+  EXPECT_EQ(*head.Find("Accept"), "text/html");
+}
+
+TEST(RequestParser, CanParsePipelinedRequests) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  std::string buffer = absl::StrCat(kRequest, "HEAD / HTTP/1.0\r\n\r\n");
+  absl::string_view rest = buffer;
+
+  absl::StatusOr<std::size_t> size = parser.Parse(rest, &head);
+  ASSERT_TRUE(size.ok());
+  EXPECT_EQ(head.method, "GET");
+  rest.remove_prefix(size.value());
+
+  size = parser.Parse(rest, &head);
+  ASSERT_TRUE(size.ok());
+  EXPECT_EQ(size.value(), rest.size());
+  EXPECT_EQ(head.method, "HEAD");
+  EXPECT_EQ(head.version, "HTTP/1.0");
+  EXPECT_TRUE(head.fields.empty());
+}
+
+TEST(RequestParser, SkipsEmptyLinesBeforeRequestLine) {
+  wf::RequestParser parser(16 * 1024);
+  wf::RequestHead head;
+
+  std::string buffer = absl::StrCat("\r\n\r\n", kRequest);
+  absl::StatusOr<std::size_t> size = parser.Parse(buffer, &head);
+  ASSERT_TRUE(size.ok());
+  EXPECT_EQ(size.value(), buffer.size());
+  EXPECT_EQ(head.method, "GET");
+  EXPECT_EQ(head.fields.size(), 3);
+}
+
+TEST(RequestParser, RejectsMalformedHeads) {
+  for (absl::string_view request : {
+    "GET /\r\n\r\n",
+    "GET  / HTTP/1.1\r\n\r\n",
+    "GET / HTTP/1.1 extra\r\n\r\n",
+    "GET / HTTP/1.1\n\n",
+    "GET / HTTP/1.1\r\nNo-Colon\r\n\r\n",
+    "GET / HTTP/1.1\r\nSpace : before colon\r\n\r\n",
+    "GET / HTTP/1.1\r\n Folded: field\r\n\r\n",
+  }) {
+    wf::RequestParser parser(16 * 1024);
+    wf::RequestHead head;
+
+    EXPECT_EQ(parser.Parse(request, &head).status().code(),
+              absl::StatusCode::kInvalidArgument) << request;
+  }
+}
+
+TEST(RequestParser, RejectsHeadsThatAreTooLarge) {
+  wf::RequestParser parser(32);
+  wf::RequestHead head;
+
+  std::string request = absl::StrCat("GET /", std::string(64, 'a'));
+  EXPECT_EQ(parser.Parse(request, &head).status().code(),
+            absl::StatusCode::kResourceExhausted);
+
+  parser.Reset();
+  EXPECT_EQ(parser.Parse(kRequest, &head).status().code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -67,6 +67,12 @@ std::string URLDecode(absl::string_view s, bool plus_space = true);
 // Gets the mime type of a file based on the extension
 const std::string& GetMimeType(absl::string_view name);
 
+// Gets the reason phrase of an HTTP status code (e.g. 404 -> "Not Found")
+//
+// Unrecognized status codes get the reason phrase "Unknown". The
+// implementation of this function is in status.cc.
+const std::string& GetStatusReason(int status);
+
 // Transforms the given string into a consistent casing.
 std::string CaseInsensitive(absl::string_view s);
 std::string* CaseInsensitive(std::string* s);
@@ -111,6 +111,14 @@ TEST(HTTPStrings, CanHandleCaseInsensitiveComparisons) {
   EXPECT_EQ(wf::CaseInsensitive("FoO bAr"), wf::CaseInsensitive("fOo BaR"));
 }
 
+TEST(HTTPStrings, CanGetStatusReasons) {
+  EXPECT_EQ(wf::GetStatusReason(200), "OK");
+  EXPECT_EQ(wf::GetStatusReason(404), "Not Found");
+
+  // Unrecognized status codes still get *something*
+  EXPECT_EQ(wf::GetStatusReason(299), "Unknown");
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
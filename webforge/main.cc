@@ -30,6 +30,7 @@
 
 #include <unistd.h>
 
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -41,7 +42,9 @@
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
 
+#include "webforge/commands.h"
 #include "webforge/file_log_sink.h"
 #include "webforge/flags.h"
 
@@ -63,6 +66,18 @@ ABSL_FLAG(bool, minify, true,
 
 namespace {
 
+struct Subcommand {
+  absl::string_view name;
+  absl::Status (*run)(const std::vector<char*>& args);
+};
+
+// Every subcommand, see commands.h.
+constexpr Subcommand kSubcommands[] = {
+  {"fingerprint", wf::RunFingerprintCommand},
+  {"manifest", wf::RunManifestCommand},
+  {"render", wf::RunRenderCommand},
+};
+
 // Returns a user-ready string with the WebForge version.
 //
 // If built without -DNDEBUG, or Bazel --compilation_mode=opt, this function
@@ -79,6 +94,20 @@ std::string GetWebForgeVersion() {
   return version_str;
 }
 
+// Prints how to invoke the CLI to stderr, for when no known subcommand was
+// given.
+void PrintUsage(absl::string_view program) {
+  std::cerr << "Usage: " << program << " <subcommand> [flags] [args...]\n"
+            << "\n"
+            << "Subcommands:\n";
+  for (const Subcommand& subcommand : kSubcommands) {
+    std::cerr << "  " << subcommand.name << '\n';
+  }
+
+  std::cerr << "\n"
+            << "Try --help for the list of flags.\n";
+}
+
 // Provides additional after-the-fact sanitization for CLI flags.
 absl::Status SanitizeCommandLineFlags() {
   if (absl::GetFlag(FLAGS_out).size() == 0) {
@@ -116,6 +145,28 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  return 0;
+  if (positionals.size() < 2) {
+    PrintUsage(positionals[0]);
+    return 1;
+  }
+
+  for (const Subcommand& subcommand : kSubcommands) {
+    if (subcommand.name != positionals[1]) {
+      continue;
+    }
+
+    s = subcommand.run(std::vector<char*>(positionals.begin() + 2,
+                                          positionals.end()));
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      return 1;
+    }
+
+    return 0;
+  }
+
+  std::cerr << "Unknown subcommand: " << positionals[1] << "\n\n";
+  PrintUsage(positionals[0]);
+  return 1;
 }
 
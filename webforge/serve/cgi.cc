@@ -22,14 +22,25 @@
 
 #include "webforge/serve/cgi.h"
 
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 
+#include "webforge/http/file.h"
 #include "webforge/http/http.h"
 #include "webforge/http/strings.h"
 #include "webforge/site/application.h"
@@ -45,41 +56,16 @@ RequestPtr RequestFromCGIEnvironment() {
 
   // Iterate through every environment variable and pick out the useful info.
   for (char** env = environ; *env; ++env) {
-    std::string e(*env);
-    absl::string_view key(e);
-    absl::string_view value(e);
+    absl::string_view key(*env);
+    absl::string_view value(*env);
     auto pos = key.find('=');
+    if (pos == absl::string_view::npos) {
+      continue;
+    }
     key.remove_suffix(key.size() - pos);
     value.remove_prefix(pos + 1);
 
-    if (key == "HTTPS") {
-      req->UsingTLS(true);
-    } else if (key == "REQUEST_METHOD") {
-      req->Method(value);
-    } else if (key == "PATH_INFO") {
-      req->Path(value);
-    } else if (key == "QUERY_STRING") {
-      ParseQueryString(value, req->MutableQuery());
-    } else if (key == "SERVER_PROTOCOL") {
-      req->Version(value);
-    } else if (key == "CONTENT_TYPE") {
-      req->Header("Content-Type", value);
-    } else if (key == "CONTENT_LENGTH") {
-      req->Header("Content-Length", value);
-    } else if (key.find("HTTP_") == 0) {
-      key.remove_prefix(5);
-      std::string key_name(key);
-      std::transform(key_name.begin(), key_name.end(), key_name.begin(),
-                     [](unsigned char c) {
-        if (c == '_') {
-          return '-';
-        }
-
-        return (char)c;
-      });
-
-      req->Header(key_name, value);
-    }
+    ApplyCGIVariable(key, value, req.get());
   }
 
   // CGI uses stdin to read request body data
@@ -89,6 +75,10 @@ RequestPtr RequestFromCGIEnvironment() {
 }
 
 // Supports writing output in a format that CGI webservers will understand.
+//
+// The head is held back until the first chunk of the body, so that both reach
+// the webserver in one writev(2). Everything after that goes through std::cout,
+// which is only flushed when the response asks for it or ends.
 class CGIWriter : public ResponseWriter {
 public:
   CGIWriter() {
@@ -96,35 +86,159 @@ public:
   }
 
   absl::Status WriteHead(const Response& res) override {
-    std::cout << "status: " << res.Status() << std::endl;
-    for (auto& it : res.Headers()) {
-      std::cout << it.first << ": " << it.second << std::endl;
+    head_.clear();
+    AppendCGIHead(res, &head_);
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    if (!head_.empty()) {
+      return WriteHeadWith(chunk);
     }
-    
-    for (auto& it : res.Cookies()) {
-      std::cout << "set-cookie: " << it.second << std::endl;
+
+    std::cout.write(chunk.data(), chunk.size());
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length) override {
+    absl::Status s = Flush();
+    if (!s.ok()) {
+      return s;
     }
 
-    // Head is finished
-    std::cout << std::endl;
+    while (length > 0) {
+      ssize_t n = sendfile(STDOUT_FILENO, file->Descriptor(), &offset, length);
+      if (n > 0) {
+        length -= n;
+        continue;
+      }
+
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        // stdout is something sendfile(2) can't write to.
+        return ResponseWriter::WriteFile(std::move(file), offset, length);
+      }
+
+      if (n == 0) {
+        return absl::OutOfRangeError("file ended early");
+      }
+
+      return absl::ErrnoToStatus(errno, "sendfile() failed");
+    }
 
     return absl::OkStatus();
   }
 
-  absl::Status WriteChunk(absl::string_view chunk) override {
-    std::cout << chunk;
+  absl::Status Flush() override {
+    if (!head_.empty()) {
+      return WriteHeadWith("");
+    }
+
+    std::cout << std::flush;
     return absl::OkStatus();
   }
 
   void End() override {
+    if (!head_.empty()) {
+      WriteHeadWith("").IgnoreError();
+    }
+
     // In theory, we could close std::cout, but something about doing that just
     // feels *wrong*. We do, however, need to flush std::cout.
     std::cout << std::flush;
   }
+
+private:
+  // Writes the held back head followed by `chunk`, straight to stdout.
+  absl::Status WriteHeadWith(absl::string_view chunk) {
+    // Nothing should be buffered ahead of the head, but just in case.
+    std::cout << std::flush;
+
+    iovec iov[2];
+    iov[0].iov_base = head_.data();
+    iov[0].iov_len = head_.size();
+    iov[1].iov_base = const_cast<char*>(chunk.data());
+    iov[1].iov_len = chunk.size();
+
+    iovec* next = iov;
+    int count = chunk.empty() ? 1 : 2;
+    while (count > 0) {
+      ssize_t n = writev(STDOUT_FILENO, next, count);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        head_.clear();
+        return absl::ErrnoToStatus(errno, "writev() failed");
+      }
+
+      while (count > 0 && static_cast<std::size_t>(n) >= next->iov_len) {
+        n -= next->iov_len;
+        ++next;
+        --count;
+      }
+
+      if (count > 0) {
+        next->iov_base = static_cast<char*>(next->iov_base) + n;
+        next->iov_len -= n;
+      }
+    }
+
+    head_.clear();
+    return absl::OkStatus();
+  }
+
+  std::string head_;  // Serialized, but not yet written
 };
 
 }
 
+void ApplyCGIVariable(absl::string_view key, absl::string_view value,
+                      Request* req) {
+  if (key == "HTTPS") {
+    req->UsingTLS(true);
+  } else if (key == "REQUEST_METHOD") {
+    req->Method(value);
+  } else if (key == "PATH_INFO") {
+    req->Path(value);
+  } else if (key == "QUERY_STRING") {
+    ParseQueryString(value, req->MutableQuery());
+  } else if (key == "SERVER_PROTOCOL") {
+    req->Version(value);
+  } else if (key == "CONTENT_TYPE") {
+    req->Header("Content-Type", value);
+  } else if (key == "CONTENT_LENGTH") {
+    req->Header("Content-Length", value);
+  } else if (key.find("HTTP_") == 0) {
+    key.remove_prefix(5);
+    std::string key_name(key);
+    std::transform(key_name.begin(), key_name.end(), key_name.begin(),
+                   [](unsigned char c) {
+      if (c == '_') {
+        return '-';
+      }
+
+      return (char)c;
+    });
+
+    req->Header(key_name, value);
+  }
+}
+
+void AppendCGIHead(const Response& res, std::string* out) {
+  // Two bytes extra for the blank line.
+  ResponseWriter::AppendHead(
+    res, absl::StrFormat("status: %d %s", res.Status(),
+                         GetStatusReason(res.Status())),
+    {}, 2, out);
+  out->append("\r\n");
+}
+
 int ServeCGI(wf::Application* application) {
   RequestPtr req = RequestFromCGIEnvironment();
   ResponsePtr res = Response::FromRequest(*req);
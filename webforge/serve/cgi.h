@@ -36,10 +36,27 @@
 #ifndef WEBFORGE_SERVE_CGI_H_
 #define WEBFORGE_SERVE_CGI_H_
 
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/http.h"
 #include "webforge/site/application.h"
 
 namespace wf {
 
+// Applies one CGI meta-variable (e.g. REQUEST_METHOD or HTTP_HOST) to `req`.
+//
+// This is the mapping wf::ServeCGI uses to build a wf::Request out of its
+// environment. Protocols that carry the same variables over the wire, like
+// FastCGI and SCGI, use it too. Unrecognized variables are ignored.
+void ApplyCGIVariable(absl::string_view key, absl::string_view value,
+                      Request* req);
+
+// Appends the head of `res` to `out` the way a CGI program writes it to
+// stdout: a Status header, the response headers and cookies, and a blank line.
+void AppendCGIHead(const Response& res, std::string* out);
+
 // Starts processing a CGI request based on the current environment.
 //
 // Intended to be called from main() as `return wf::ServeCGI(...);` - the return
@@ -0,0 +1,188 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: event_loop.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::EventLoop on top of epoll(7) and eventfd(2).
+//
+
+#include "webforge/serve/event_loop.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+
+namespace wf {
+
+namespace {
+
+// Number of events pulled out of the kernel per epoll_wait() call.
+const int kMaxEvents = 256;
+
+}
+
+absl::StatusOr<std::unique_ptr<EventLoop>> EventLoop::Create() {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    return absl::ErrnoToStatus(errno, "epoll_create1() failed");
+  }
+
+  int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "eventfd() failed");
+    close(epoll_fd);
+    return s;
+  }
+
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = wake_fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "epoll_ctl() failed");
+    close(wake_fd);
+    close(epoll_fd);
+    return s;
+  }
+
+  return std::unique_ptr<EventLoop>(new EventLoop(epoll_fd, wake_fd));
+}
+
+EventLoop::EventLoop(int epoll_fd, int wake_fd) : epoll_fd_(epoll_fd),
+  wake_fd_(wake_fd), stopped_(false) {
+  // Nothing to do.
+}
+
+EventLoop::~EventLoop() {
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+absl::Status EventLoop::Add(int fd, uint32_t events, Handler handler) {
+  epoll_event ev;
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    return absl::ErrnoToStatus(errno, "epoll_ctl(EPOLL_CTL_ADD) failed");
+  }
+
+  handlers_[fd] = std::make_shared<Handler>(std::move(handler));
+  return absl::OkStatus();
+}
+
+absl::Status EventLoop::Modify(int fd, uint32_t events) {
+  epoll_event ev;
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+    return absl::ErrnoToStatus(errno, "epoll_ctl(EPOLL_CTL_MOD) failed");
+  }
+
+  return absl::OkStatus();
+}
+
+void EventLoop::Remove(int fd) {
+  // Fails if the descriptor was already closed, which removes it anyway.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  handlers_.erase(fd);
+}
+
+void EventLoop::Post(Task task) {
+  {
+    absl::MutexLock lock(&posted_mutex_);
+    posted_.push_back(std::move(task));
+  }
+
+  Wake();
+}
+
+void EventLoop::Stop() {
+  stopped_ = true;
+  Wake();
+}
+
+absl::Status EventLoop::Run() {
+  epoll_event events[kMaxEvents];
+
+  while (!stopped_) {
+    int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return absl::ErrnoToStatus(errno, "epoll_wait() failed");
+    }
+
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == wake_fd_) {
+        uint64_t value;
+        while (read(wake_fd_, &value, sizeof(value)) > 0) {
+          // Drain the counter so the eventfd stops being readable.
+        }
+
+        continue;
+      }
+
+      auto it = handlers_.find(fd);
+      if (it == handlers_.end()) {
+        // Removed by a handler earlier in this batch.
+        continue;
+      }
+
+      std::shared_ptr<Handler> handler = it->second;
+      (*handler)(events[i].events);
+    }
+
+    RunPostedTasks();
+  }
+
+  return absl::OkStatus();
+}
+
+void EventLoop::Wake() {
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // Only fails if the counter would overflow, in which case the loop is
+    // already awake.
+  }
+}
+
+void EventLoop::RunPostedTasks() {
+  std::vector<Task> tasks;
+  {
+    absl::MutexLock lock(&posted_mutex_);
+    tasks.swap(posted_);
+  }
+
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+}
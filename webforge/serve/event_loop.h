@@ -0,0 +1,101 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: event_loop.h
+// -----------------------------------------------------------------------------
+//
+// wf::EventLoop is a thin wrapper around Linux's epoll(7). Persistent serve
+// targets register their listening socket and each client connection with an
+// EventLoop, which then calls back into them whenever the file descriptor is
+// ready.
+//
+// An EventLoop is single-threaded: every handler runs on the thread that called
+// Run(). The only methods that may be called from other threads are Post() and
+// Stop(), which wake the loop up through an eventfd(2).
+//
+
+#ifndef WEBFORGE_SERVE_EVENT_LOOP_H_
+#define WEBFORGE_SERVE_EVENT_LOOP_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+
+namespace wf {
+
+class EventLoop {
+public:
+  // Called with the epoll event mask (EPOLLIN, EPOLLOUT, ...) that fired.
+  using Handler = std::function<void(uint32_t events)>;
+  using Task = std::function<void()>;
+
+  // Creates an EventLoop, or returns why the kernel refused to give us one.
+  static absl::StatusOr<std::unique_ptr<EventLoop>> Create();
+
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  // Starts watching `fd` for `events`.
+  //
+  // Handlers may safely Add(), Modify() or Remove() any descriptor, including
+  // their own, while they are running.
+  absl::Status Add(int fd, uint32_t events, Handler handler);
+  absl::Status Modify(int fd, uint32_t events);
+
+  // Stops watching `fd`. Does NOT close it.
+  void Remove(int fd);
+
+  // Queues `task` to be run on the loop thread. Thread-safe.
+  void Post(Task task);
+
+  // Makes Run() return after the current iteration. Thread-safe.
+  void Stop();
+
+  // Dispatches events until Stop() is called.
+  absl::Status Run();
+
+private:
+  EventLoop(int epoll_fd, int wake_fd);
+
+  void Wake();
+  void RunPostedTasks();
+
+  int epoll_fd_;
+  int wake_fd_;
+  std::atomic<bool> stopped_;
+
+  // Handlers are shared so that a handler removing itself doesn't destroy the
+  // std::function that is currently executing.
+  absl::flat_hash_map<int, std::shared_ptr<Handler>> handlers_;
+
+  absl::Mutex posted_mutex_;
+  std::vector<Task> posted_ ABSL_GUARDED_BY(posted_mutex_);
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_EVENT_LOOP_H_
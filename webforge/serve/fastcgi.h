@@ -0,0 +1,73 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fastcgi.h
+// -----------------------------------------------------------------------------
+//
+// wf::ServeFastCGI turns the program into a long-running FastCGI application
+// server. A web server like nginx accepts the HTTP connections and forwards
+// each request over FastCGI, so, unlike with wf::ServeCGI, no process has to be
+// started per request and the wf::Application (along with its wf::Renderer
+// template cache) is shared by every request.
+//
+// Requests are described by the same variables as with CGI, so the web server
+// has to pass PATH_INFO, which nginx doesn't do by default:
+//   location / {
+//     include fastcgi_params;
+//     fastcgi_param PATH_INFO $uri;
+//     fastcgi_keep_conn on;
+//     fastcgi_pass unix:/run/webforge/fastcgi.sock;
+//   }
+//
+// Example use:
+//   int main(int argc, char** argv) {
+//     wf::Application app;
+//
+//     // Set up routes on app
+//
+//     return wf::ServeFastCGI(&app);
+//   }
+//
+
+#ifndef WEBFORGE_SERVE_FASTCGI_H_
+#define WEBFORGE_SERVE_FASTCGI_H_
+
+#include "webforge/serve/fastcgi_connection.h"
+#include "webforge/serve/server.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+// A wf::Server that speaks FastCGI to web servers.
+//
+// Most programs want wf::ServeFastCGI instead. This class exists for programs
+// that need to stop the server again, like tests and benchmarks.
+class FastCGIServer : public Server {
+public:
+  FastCGIServer(Application* application,
+                const FastCGIServerOptions& options = FastCGIServerOptions());
+};
+
+// Serves FastCGI requests forever (or until a fatal error occurs).
+//
+// Intended to be called from main() as `return wf::ServeFastCGI(...);` - the
+// return value is an exit code.
+int ServeFastCGI(Application* application,
+                 const FastCGIServerOptions& options = FastCGIServerOptions());
+
+}
+
+#endif  // WEBFORGE_SERVE_FASTCGI_H_
@@ -0,0 +1,619 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fastcgi_connection.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::FastCGIConnection along with wf::FastCGIWriter, the
+// ResponseWriter that frames wf::Response output as FCGI_STDOUT records.
+//
+// The record layout and constants come from the FastCGI specification:
+// https://fastcgi-archives.github.io/FastCGI_Specification.html
+//
+
+#include "webforge/serve/fastcgi_connection.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/file.h"
+#include "webforge/http/http.h"
+#include "webforge/http/strings.h"
+#include "webforge/serve/cgi.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+namespace {
+
+constexpr uint8_t kVersion = 1;
+constexpr std::size_t kHeaderSize = 8;
+constexpr std::size_t kMaxContentSize = 65535;
+
+// Record types
+constexpr uint8_t kBeginRequest = 1;
+constexpr uint8_t kAbortRequest = 2;
+constexpr uint8_t kEndRequest = 3;
+constexpr uint8_t kParams = 4;
+constexpr uint8_t kStdin = 5;
+constexpr uint8_t kStdout = 6;
+constexpr uint8_t kGetValues = 9;
+constexpr uint8_t kGetValuesResult = 10;
+constexpr uint8_t kUnknownType = 11;
+
+// Roles and flags of FCGI_BEGIN_REQUEST
+constexpr uint16_t kResponder = 1;
+constexpr uint8_t kKeepConn = 1;
+
+// Protocol statuses of FCGI_END_REQUEST
+constexpr uint8_t kRequestComplete = 0;
+constexpr uint8_t kOverloaded = 2;
+constexpr uint8_t kUnknownRole = 3;
+
+// Reads one length of a name-value pair, which is either one byte long or four
+// bytes long with the high bit set.
+bool ReadLength(absl::string_view* data, uint32_t* length) {
+  if (data->empty()) {
+    return false;
+  }
+
+  auto b0 = static_cast<uint8_t>((*data)[0]);
+  if ((b0 & 0x80) == 0) {
+    *length = b0;
+    data->remove_prefix(1);
+    return true;
+  }
+
+  if (data->size() < 4) {
+    return false;
+  }
+
+  *length = (static_cast<uint32_t>(b0 & 0x7f) << 24) |
+            (static_cast<uint32_t>(static_cast<uint8_t>((*data)[1])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>((*data)[2])) << 8) |
+            static_cast<uint32_t>(static_cast<uint8_t>((*data)[3]));
+  data->remove_prefix(4);
+  return true;
+}
+
+// Calls `fn` for each name-value pair in `data`.
+absl::Status ForEachNameValuePair(
+  absl::string_view data,
+  const std::function<void(absl::string_view, absl::string_view)>& fn) {
+  while (!data.empty()) {
+    uint32_t name_length;
+    uint32_t value_length;
+    if (!ReadLength(&data, &name_length) ||
+        !ReadLength(&data, &value_length) ||
+        data.size() < static_cast<uint64_t>(name_length) + value_length) {
+      return absl::InvalidArgumentError("malformed name-value pair");
+    }
+
+    fn(data.substr(0, name_length), data.substr(name_length, value_length));
+    data.remove_prefix(name_length + value_length);
+  }
+
+  return absl::OkStatus();
+}
+
+void AppendLength(std::string* out, std::size_t length) {
+  if (length < 0x80) {
+    out->push_back(static_cast<char>(length));
+    return;
+  }
+
+  out->push_back(static_cast<char>(((length >> 24) & 0x7f) | 0x80));
+  out->push_back(static_cast<char>((length >> 16) & 0xff));
+  out->push_back(static_cast<char>((length >> 8) & 0xff));
+  out->push_back(static_cast<char>(length & 0xff));
+}
+
+void AppendNameValuePair(std::string* out, absl::string_view name,
+                         absl::string_view value) {
+  AppendLength(out, name.size());
+  AppendLength(out, value.size());
+  out->append(name.data(), name.size());
+  out->append(value.data(), value.size());
+}
+
+}
+
+// Frames the output of a single wf::Response as the FCGI_STDOUT stream of one
+// request, in the same format a CGI program would write to stdout.
+class FastCGIWriter : public ResponseWriter {
+public:
+  FastCGIWriter(FastCGIConnection* connection, uint16_t id, bool keep_conn) :
+    connection_(connection), id_(id), keep_conn_(keep_conn), ended_(false) {
+    // Nothing to do.
+  }
+
+  absl::Status WriteHead(const Response& res) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    std::string head;
+    AppendCGIHead(res, &head);
+    return WriteChunk(head);
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    // An empty record would end the stream.
+    while (!chunk.empty()) {
+      std::size_t n = std::min(chunk.size(), kMaxContentSize);
+      connection_->WriteRecord(kStdout, id_, chunk.substr(0, n));
+      chunk.remove_prefix(n);
+    }
+
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    connection_->WriteFileRecords(kStdout, id_, std::move(file), offset,
+                                  length);
+    return absl::OkStatus();
+  }
+
+  absl::Status Flush() override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    // Output isn't held back, so only the server needs to know.
+    if (connection_->on_output_) {
+      connection_->on_output_();
+    }
+
+    return absl::OkStatus();
+  }
+
+  void End() override {
+    if (ended_ || connection_ == nullptr) {
+      return;
+    }
+    ended_ = true;
+
+    connection_->WriteRecord(kStdout, id_, "");
+    connection_->WriteEndRequest(id_, kRequestComplete);
+
+    FastCGIConnection* connection = connection_;
+    connection_ = nullptr;
+    connection->FinishRequest(id_, keep_conn_);
+  }
+
+  // Called when the request goes away before the response has ended.
+  void Detach() {
+    connection_ = nullptr;
+  }
+
+private:
+  FastCGIConnection* connection_;
+  uint16_t id_;
+  bool keep_conn_;
+  bool ended_;
+};
+
+FastCGIConnection::FastCGIConnection(Application* application,
+                                     const FastCGIServerOptions& options) :
+  application_(application), options_(options), dispatching_(false),
+  closing_(false), eof_(false) {
+  // Nothing to do.
+}
+
+FastCGIConnection::~FastCGIConnection() {
+  for (auto& it : requests_) {
+    if (it.second.writer) {
+      it.second.writer->Detach();
+    }
+  }
+}
+
+void FastCGIConnection::Receive(absl::string_view data) {
+  if (closing_) {
+    return;
+  }
+
+  in_.append(data.data(), data.size());
+  ProcessRecords();
+}
+
+void FastCGIConnection::ReceiveEOF() {
+  eof_ = true;
+
+  // Requests that were never dispatched can't be completed anymore. The ones
+  // that were still get to write their responses.
+  for (auto it = requests_.begin(); it != requests_.end();) {
+    if (it->second.writer) {
+      ++it;
+    } else {
+      requests_.erase(it++);
+    }
+  }
+}
+
+absl::string_view FastCGIConnection::Output() const {
+  return out_.Bytes();
+}
+
+void FastCGIConnection::Sent(std::size_t n) {
+  out_.SentBytes(n);
+}
+
+void FastCGIConnection::HoldOutput() {
+  out_.Hold();
+}
+
+const FileRange* FastCGIConnection::OutputFile() const {
+  return out_.FrontFile();
+}
+
+void FastCGIConnection::SentFile(std::size_t n) {
+  out_.SentFile(n);
+}
+
+bool FastCGIConnection::Done() const {
+  return (closing_ || eof_) && requests_.empty() && out_.Empty();
+}
+
+bool FastCGIConnection::DoneAfterOutput() const {
+  return (closing_ || eof_) && requests_.empty() && out_.OnlyBytes();
+}
+
+bool FastCGIConnection::WantsInput() const {
+  if (out_.BufferedBytes() >= options_.max_buffered_output) {
+    return false;
+  }
+
+  // Without a response in flight, reading has to go on for the requests that
+  // are still incomplete to ever be dispatched, and what they hold is bounded
+  // by max_requests, max_params_size and max_body_size.
+  return !Busy() || BufferedInput() < options_.max_buffered_input;
+}
+
+bool FastCGIConnection::Busy() const {
+  for (const auto& it : requests_) {
+    if (it.second.writer) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void FastCGIConnection::OnOutput(std::function<void()> on_output) {
+  on_output_ = std::move(on_output);
+}
+
+void FastCGIConnection::ProcessRecords() {
+  std::size_t pos = 0;
+  while (!closing_ && in_.size() - pos >= kHeaderSize &&
+         out_.BufferedBytes() < options_.max_buffered_output) {
+    const auto* header = reinterpret_cast<const uint8_t*>(in_.data() + pos);
+    if (header[0] != kVersion) {
+      Shutdown();
+      break;
+    }
+
+    uint8_t type = header[1];
+    uint16_t id = (header[2] << 8) | header[3];
+    std::size_t length = (header[4] << 8) | header[5];
+    std::size_t padding = header[6];
+    if (in_.size() - pos < kHeaderSize + length + padding) {
+      // Wait for the rest of the record.
+      break;
+    }
+
+    absl::string_view content(in_.data() + pos + kHeaderSize, length);
+    pos += kHeaderSize + length + padding;
+
+    if (!HandleRecord(type, id, content).ok()) {
+      Shutdown();
+      break;
+    }
+  }
+
+  if (closing_) {
+    in_.clear();
+  } else {
+    in_.erase(0, pos);
+  }
+}
+
+std::size_t FastCGIConnection::BufferedInput() const {
+  std::size_t size = in_.size();
+  for (const auto& it : requests_) {
+    size += it.second.params.size() + it.second.body.size();
+  }
+
+  return size;
+}
+
+absl::Status FastCGIConnection::HandleRecord(uint8_t type, uint16_t id,
+                                             absl::string_view content) {
+  if (id == 0) {
+    HandleManagementRecord(type, content);
+    return absl::OkStatus();
+  }
+
+  if (type == kBeginRequest) {
+    return HandleBeginRequest(id, content);
+  }
+
+  if (!requests_.contains(id)) {
+    // Records for request IDs that aren't active are ignored, e.g. the rest of
+    // the body of a rejected request.
+    return absl::OkStatus();
+  }
+
+  switch (type) {
+    case kAbortRequest:
+      if (requests_[id].writer) {
+        requests_[id].writer->Detach();
+      }
+      requests_.erase(id);
+      WriteEndRequest(id, kRequestComplete);
+      return absl::OkStatus();
+    case kParams:
+      return HandleParams(id, content);
+    case kStdin:
+      return HandleStdin(id, content);
+    default:
+      // Other streams, like FCGI_DATA, only matter to other roles.
+      return absl::OkStatus();
+  }
+}
+
+absl::Status FastCGIConnection::HandleBeginRequest(uint16_t id,
+                                                   absl::string_view content) {
+  if (content.size() < 8 || requests_.contains(id)) {
+    return absl::InvalidArgumentError("malformed FCGI_BEGIN_REQUEST");
+  }
+
+  const auto* body = reinterpret_cast<const uint8_t*>(content.data());
+  uint16_t role = (body[0] << 8) | body[1];
+  bool keep_conn = (body[2] & kKeepConn) != 0;
+
+  if (role != kResponder) {
+    WriteEndRequest(id, kUnknownRole);
+    return absl::OkStatus();
+  }
+
+  if (requests_.size() >= static_cast<std::size_t>(options_.max_requests)) {
+    WriteEndRequest(id, kOverloaded);
+    return absl::OkStatus();
+  }
+
+  PendingRequest& pending = requests_[id];
+  pending.keep_conn = keep_conn;
+  pending.params_done = false;
+  return absl::OkStatus();
+}
+
+absl::Status FastCGIConnection::HandleParams(uint16_t id,
+                                             absl::string_view content) {
+  PendingRequest& pending = requests_[id];
+  if (pending.params_done) {
+    return absl::InvalidArgumentError("FCGI_PARAMS after end of stream");
+  }
+
+  if (!content.empty()) {
+    if (pending.params.size() + content.size() > options_.max_params_size) {
+      Reject(id, 431);
+      return absl::OkStatus();
+    }
+
+    pending.params.append(content.data(), content.size());
+    return absl::OkStatus();
+  }
+
+  // An empty record ends the stream.
+  pending.params_done = true;
+  pending.req = std::make_shared<Request>();
+
+  Request* req = pending.req.get();
+  absl::Status s = ForEachNameValuePair(pending.params,
+    [req](absl::string_view name, absl::string_view value) {
+    ApplyCGIVariable(name, value, req);
+  });
+  pending.params.clear();
+
+  if (!s.ok()) {
+    Reject(id, 400);
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status FastCGIConnection::HandleStdin(uint16_t id,
+                                            absl::string_view content) {
+  PendingRequest& pending = requests_[id];
+  if (!pending.params_done || pending.writer) {
+    return absl::InvalidArgumentError("unexpected FCGI_STDIN");
+  }
+
+  if (!content.empty()) {
+    if (pending.body.size() + content.size() > options_.max_body_size) {
+      Reject(id, 413);
+      return absl::OkStatus();
+    }
+
+    pending.body.append(content.data(), content.size());
+    return absl::OkStatus();
+  }
+
+  // An empty record ends the stream. Handlers read the body synchronously, so
+  // the request can only be dispatched once all of it is here.
+  Dispatch(id);
+  return absl::OkStatus();
+}
+
+void FastCGIConnection::HandleManagementRecord(uint8_t type,
+                                               absl::string_view content) {
+  if (type != kGetValues) {
+    std::string body(8, '\0');
+    body[0] = static_cast<char>(type);
+    WriteRecord(kUnknownType, 0, body);
+    return;
+  }
+
+  std::string result;
+  ForEachNameValuePair(content,
+    [this, &result](absl::string_view name, absl::string_view value) {
+    if (name == "FCGI_MAX_REQS") {
+      AppendNameValuePair(&result, name, absl::StrCat(options_.max_requests));
+    } else if (name == "FCGI_MPXS_CONNS") {
+      AppendNameValuePair(&result, name, "1");
+    }
+  }).IgnoreError();
+
+  WriteRecord(kGetValuesResult, 0, result);
+}
+
+void FastCGIConnection::Dispatch(uint16_t id) {
+  PendingRequest& pending = requests_[id];
+
+  RequestPtr req = std::move(pending.req);
+  req->Stream(std::make_shared<std::istringstream>(std::move(pending.body)));
+  pending.body.clear();
+
+  ResponsePtr res = Response::FromRequest(*req);
+  pending.writer = std::make_shared<FastCGIWriter>(this, id, pending.keep_conn);
+  res->UseWriter(pending.writer);
+
+  // The handler may end the response before returning, which erases `pending`.
+  dispatching_ = true;
+  application_->Handle(req, res).IgnoreError();
+  dispatching_ = false;
+}
+
+void FastCGIConnection::Reject(uint16_t id, int code) {
+  bool keep_conn = requests_[id].keep_conn;
+
+  std::string body = absl::StrFormat("%d %s\n", code, GetStatusReason(code));
+  WriteRecord(kStdout, id,
+              absl::StrFormat("status: %d %s\r\n"
+                              "content-type: text/plain; charset=utf-8\r\n"
+                              "content-length: %d\r\n"
+                              "\r\n"
+                              "%s",
+                              code, GetStatusReason(code), body.size(), body));
+  WriteRecord(kStdout, id, "");
+  WriteEndRequest(id, kRequestComplete);
+
+  requests_.erase(id);
+  if (!keep_conn) {
+    closing_ = true;
+  }
+}
+
+void FastCGIConnection::FinishRequest(uint16_t id, bool keep_conn) {
+  requests_.erase(id);
+  if (!keep_conn) {
+    // The web server closes its end once it has the response, but there is no
+    // need to wait for that.
+    closing_ = true;
+  }
+
+  if (!dispatching_ && on_output_) {
+    on_output_();
+  }
+}
+
+void FastCGIConnection::Shutdown() {
+  for (auto& it : requests_) {
+    if (it.second.writer) {
+      it.second.writer->Detach();
+    }
+  }
+
+  requests_.clear();
+  closing_ = true;
+}
+
+std::size_t FastCGIConnection::WriteRecordHeader(uint8_t type, uint16_t id,
+                                                 std::size_t length) {
+  // Padding keeps every record 8-byte aligned, as the specification
+  // recommends.
+  std::size_t padding = (8 - length % 8) % 8;
+
+  char header[kHeaderSize] = {
+    static_cast<char>(kVersion),
+    static_cast<char>(type),
+    static_cast<char>(id >> 8),
+    static_cast<char>(id & 0xff),
+    static_cast<char>(length >> 8),
+    static_cast<char>(length & 0xff),
+    static_cast<char>(padding),
+    0,
+  };
+
+  out_.Tail()->append(header, kHeaderSize);
+  return padding;
+}
+
+void FastCGIConnection::WriteRecord(uint8_t type, uint16_t id,
+                                    absl::string_view content) {
+  std::size_t padding = WriteRecordHeader(type, id, content.size());
+
+  std::string* out = out_.Tail();
+  out->append(content.data(), content.size());
+  out->append(padding, '\0');
+}
+
+void FastCGIConnection::WriteFileRecords(uint8_t type, uint16_t id,
+                                         std::shared_ptr<const File> file,
+                                         off_t offset, std::size_t length) {
+  while (length > 0) {
+    std::size_t n = std::min(length, kMaxContentSize);
+    std::size_t padding = WriteRecordHeader(type, id, n);
+    out_.AppendFile(file, offset, n);
+    out_.Tail()->append(padding, '\0');
+
+    offset += n;
+    length -= n;
+  }
+}
+
+void FastCGIConnection::WriteEndRequest(uint16_t id, uint8_t protocol_status) {
+  // appStatus (always 0), protocolStatus, and three reserved bytes.
+  std::string body(8, '\0');
+  body[4] = static_cast<char>(protocol_status);
+  WriteRecord(kEndRequest, id, body);
+}
+
+}
@@ -0,0 +1,199 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fastcgi_connection.h
+// -----------------------------------------------------------------------------
+//
+// wf::FastCGIConnection implements the responder role of the FastCGI protocol
+// (version 1) for a single connection from a web server, without doing any I/O
+// itself (see wf::Connection in server.h).
+//
+// FastCGI multiplexes requests over one connection: every record carries a
+// request ID, so a web server may interleave the records of several requests.
+// The connection collects FCGI_PARAMS and FCGI_STDIN for each request ID
+// independently, turns the parameters into a wf::Request with the same mapping
+// wf::ServeCGI applies to its environment, and dispatches it to the
+// wf::Application once FCGI_STDIN has been closed. The response is sent back as
+// FCGI_STDOUT records, followed by FCGI_END_REQUEST. Reading stops while too
+// much is buffered (see FastCGIServerOptions::max_buffered_input).
+//
+
+#ifndef WEBFORGE_SERVE_FASTCGI_CONNECTION_H_
+#define WEBFORGE_SERVE_FASTCGI_CONNECTION_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/file.h"
+#include "webforge/http/http.h"
+#include "webforge/serve/output_queue.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+// Parameters for wf::ServeFastCGI and each of its connections.
+struct FastCGIServerOptions {
+  // Address to listen on. See wf::Listen for the accepted formats.
+  std::string address = "unix:/run/webforge/fastcgi.sock";
+
+  // Maximum length of the queue of pending connections (see listen(2)).
+  int backlog = 1024;
+
+  // How many event loops serve requests. See wf::RunWorkers.
+  WorkerOptions workers;
+
+  // How each worker performs socket I/O. See wf::IOBackend.
+  IOBackend backend = IOBackend::kEpoll;
+
+  // Web servers are disconnected after this long without any I/O while no
+  // response is being produced. Web servers usually manage the lifetime of
+  // their FastCGI connections themselves, so there is no timeout by default.
+  absl::Duration idle_timeout = absl::InfiniteDuration();
+
+  // Maximum number of requests in flight on one connection. Advertised to the
+  // web server as FCGI_MAX_REQS.
+  int max_requests = 256;
+
+  // Requests with more FCGI_PARAMS data are rejected.
+  std::size_t max_params_size = 64 * 1024;
+
+  // Requests with a longer body are rejected.
+  std::size_t max_body_size = 8 * 1024 * 1024;
+
+  // While a response is being produced, the connection stops reading from the
+  // web server once this many bytes of records and of other requests'
+  // parameters and bodies are buffered, so that a web server can't pile up
+  // requests faster than the application handles them.
+  std::size_t max_buffered_input = 64 * 1024;
+
+  // Likewise, while this many bytes of responses are waiting to be sent, the
+  // connection stops reading and doesn't handle further records, so that a web
+  // server that keeps sending requests without reading the responses can't
+  // make it buffer without bound either.
+  std::size_t max_buffered_output = 1024 * 1024;
+};
+
+class FastCGIWriter;
+
+class FastCGIConnection : public Connection {
+public:
+  FastCGIConnection(Application* application,
+                    const FastCGIServerOptions& options);
+  ~FastCGIConnection() override;
+
+  FastCGIConnection(const FastCGIConnection&) = delete;
+  FastCGIConnection& operator=(const FastCGIConnection&) = delete;
+
+  // See wf::Connection.
+  void Receive(absl::string_view data) override;
+  void ReceiveEOF() override;
+  absl::string_view Output() const override;
+  void Sent(std::size_t n) override;
+  void HoldOutput() override;
+  const FileRange* OutputFile() const override;
+  void SentFile(std::size_t n) override;
+  bool Done() const override;
+  bool DoneAfterOutput() const override;
+  bool WantsInput() const override;
+  bool Busy() const override;
+  void OnOutput(std::function<void()> on_output) override;
+
+private:
+  friend class FastCGIWriter;
+
+  // Everything known about one request ID.
+  struct PendingRequest {
+    bool keep_conn;  // FCGI_KEEP_CONN was set
+    bool params_done;  // The empty FCGI_PARAMS record has been received
+    std::string params;
+    std::string body;
+    RequestPtr req;
+
+    // Set once the request has been handed to the application.
+    std::shared_ptr<FastCGIWriter> writer;
+  };
+
+  // Handles every complete record in in_, unless too much output is buffered.
+  void ProcessRecords();
+
+  // Returns how many bytes of input are held, whether as unhandled records or
+  // as the parameters and bodies of requests that haven't been dispatched.
+  std::size_t BufferedInput() const;
+
+  // Handles a single record. Returns an error if the web server violated the
+  // protocol, in which case the connection has to be closed.
+  absl::Status HandleRecord(uint8_t type, uint16_t id,
+                            absl::string_view content);
+  absl::Status HandleBeginRequest(uint16_t id, absl::string_view content);
+  absl::Status HandleParams(uint16_t id, absl::string_view content);
+  absl::Status HandleStdin(uint16_t id, absl::string_view content);
+  void HandleManagementRecord(uint8_t type, absl::string_view content);
+
+  void Dispatch(uint16_t id);
+
+  // Ends request `id` with a short error response without dispatching it.
+  void Reject(uint16_t id, int code);
+
+  // Called by a FastCGIWriter once its response has been fully written.
+  void FinishRequest(uint16_t id, bool keep_conn);
+
+  // Stops handling requests, e.g. after a protocol error.
+  void Shutdown();
+
+  // Appends one record to the output.
+  void WriteRecord(uint8_t type, uint16_t id, absl::string_view content);
+
+  // Appends the records for a stream of type `type` whose content is `length`
+  // bytes of `file`. The content is left in the file, to be sent from there.
+  void WriteFileRecords(uint8_t type, uint16_t id,
+                        std::shared_ptr<const File> file, off_t offset,
+                        std::size_t length);
+
+  // Appends a record header for `length` bytes of content, and returns how
+  // many bytes of padding have to follow the content.
+  std::size_t WriteRecordHeader(uint8_t type, uint16_t id, std::size_t length);
+
+  void WriteEndRequest(uint16_t id, uint8_t protocol_status);
+
+  Application* application_;
+  FastCGIServerOptions options_;
+  std::function<void()> on_output_;
+
+  std::string in_;
+  OutputQueue out_;
+
+  absl::flat_hash_map<uint16_t, PendingRequest> requests_;
+
+  bool dispatching_;
+  bool closing_;  // No more requests will be handled
+  bool eof_;  // The web server won't send anything else
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_FASTCGI_CONNECTION_H_
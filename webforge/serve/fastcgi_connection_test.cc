@@ -0,0 +1,309 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fastcgi_connection_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::FastCGIConnection by feeding it raw FastCGI records and
+// inspecting the records it produces.
+//
+
+#include "webforge/serve/fastcgi_connection.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "webforge/http/http.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+namespace {
+
+struct Record {
+  uint8_t type;
+  uint16_t id;
+  std::string content;
+};
+
+std::string MakeRecord(uint8_t type, uint16_t id, absl::string_view content) {
+  std::string record = {
+    1,
+    static_cast<char>(type),
+    static_cast<char>(id >> 8),
+    static_cast<char>(id & 0xff),
+    static_cast<char>(content.size() >> 8),
+    static_cast<char>(content.size() & 0xff),
+    0,
+    0,
+  };
+  record.append(content.data(), content.size());
+  return record;
+}
+
+std::string MakeBeginRequest(uint16_t id, bool keep_conn) {
+  std::string body = {0, 1, static_cast<char>(keep_conn ? 1 : 0), 0, 0, 0, 0,
+                      0};
+  return MakeRecord(1, id, body);
+}
+
+std::string MakeParams(
+  uint16_t id,
+  const std::vector<std::pair<std::string, std::string>>& params) {
+  std::string body;
+  for (const auto& it : params) {
+    body.push_back(static_cast<char>(it.first.size()));
+    body.push_back(static_cast<char>(it.second.size()));
+    body.append(it.first);
+    body.append(it.second);
+  }
+
+  return MakeRecord(4, id, body) + MakeRecord(4, id, "");
+}
+
+// Everything a web server sends for a simple request.
+std::string MakeRequest(uint16_t id, absl::string_view method,
+                        absl::string_view path, absl::string_view body,
+                        bool keep_conn = true) {
+  std::string request = MakeBeginRequest(id, keep_conn);
+  request.append(MakeParams(id, {
+    {"REQUEST_METHOD", std::string(method)},
+    {"PATH_INFO", std::string(path)},
+    {"SERVER_PROTOCOL", "HTTP/1.1"},
+  }));
+
+  if (!body.empty()) {
+    request.append(MakeRecord(5, id, body));
+  }
+  request.append(MakeRecord(5, id, ""));
+  return request;
+}
+
+std::vector<Record> ParseRecords(absl::string_view data) {
+  std::vector<Record> records;
+  while (data.size() >= 8) {
+    const auto* header = reinterpret_cast<const uint8_t*>(data.data());
+    std::size_t length = (header[4] << 8) | header[5];
+    std::size_t padding = header[6];
+
+    records.push_back({header[1], static_cast<uint16_t>((header[2] << 8) |
+                                                        header[3]),
+                       std::string(data.substr(8, length))});
+    data.remove_prefix(8 + length + padding);
+  }
+
+  return records;
+}
+
+// Concatenates the FCGI_STDOUT stream of request `id`.
+std::string Stdout(const std::vector<Record>& records, uint16_t id) {
+  std::string out;
+  for (const auto& record : records) {
+    if (record.type == 6 && record.id == id) {
+      out.append(record.content);
+    }
+  }
+
+  return out;
+}
+
+}
+
+class FastCGIConnectionTest : public testing::Test {
+protected:
+  void SetUp() override {
+    app_.Get("/", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->End("Hello, world!").IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    app_.Post("/echo", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      std::string body(std::istreambuf_iterator<char>(*req->Stream()), {});
+      res->Header("Content-Type", "text/plain");
+      res->End(body).IgnoreError();
+      return absl::OkStatus();
+    }));
+  }
+
+  // Takes everything the connection wants to send.
+  std::vector<Record> TakeRecords(wf::FastCGIConnection* connection) {
+    std::string output(connection->Output());
+    connection->Sent(output.size());
+    return ParseRecords(output);
+  }
+
+  wf::Application app_;
+  wf::FastCGIServerOptions options_;
+};
+
+TEST_F(FastCGIConnectionTest, CanServeRequest) {
+  wf::FastCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest(1, "GET", "/", ""));
+
+  std::vector<Record> records = TakeRecords(&connection);
+  std::string out = Stdout(records, 1);
+  EXPECT_THAT(out, testing::StartsWith("status: 200 OK\r\n"));
+  EXPECT_THAT(out, testing::EndsWith("\r\n\r\nHello, world!"));
+
+  // The stream ends with an empty record, followed by FCGI_END_REQUEST.
+  ASSERT_GE(records.size(), 2);
+  EXPECT_EQ(records[records.size() - 2].type, 6);
+  EXPECT_TRUE(records[records.size() - 2].content.empty());
+  EXPECT_EQ(records.back().type, 3);
+  EXPECT_EQ(records.back().content, std::string(8, '\0'));
+
+  // FCGI_KEEP_CONN was set.
+  EXPECT_FALSE(connection.Done());
+}
+
+TEST_F(FastCGIConnectionTest, CanHandlePartialRecords) {
+  wf::FastCGIConnection connection(&app_, options_);
+  std::string request = MakeRequest(1, "POST", "/echo", "abcde");
+
+  for (char c : request) {
+    connection.Receive(absl::string_view(&c, 1));
+  }
+
+  EXPECT_THAT(Stdout(TakeRecords(&connection), 1),
+              testing::EndsWith("\r\n\r\nabcde"));
+}
+
+TEST_F(FastCGIConnectionTest, CanMultiplexRequests) {
+  wf::FastCGIConnection connection(&app_, options_);
+
+  // Interleave the records of two requests.
+  connection.Receive(MakeBeginRequest(1, true) + MakeBeginRequest(2, true));
+  connection.Receive(MakeParams(2, {{"REQUEST_METHOD", "GET"},
+                                    {"PATH_INFO", "/"}}));
+  connection.Receive(MakeParams(1, {{"REQUEST_METHOD", "POST"},
+                                    {"PATH_INFO", "/echo"}}));
+  connection.Receive(MakeRecord(5, 1, "first"));
+  connection.Receive(MakeRecord(5, 2, ""));
+  connection.Receive(MakeRecord(5, 1, ""));
+
+  std::vector<Record> records = TakeRecords(&connection);
+  EXPECT_THAT(Stdout(records, 1), testing::EndsWith("\r\n\r\nfirst"));
+  EXPECT_THAT(Stdout(records, 2), testing::EndsWith("\r\n\r\nHello, world!"));
+}
+
+TEST_F(FastCGIConnectionTest, ClosesWithoutKeepConn) {
+  wf::FastCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest(1, "GET", "/", "", false));
+  EXPECT_FALSE(connection.Done());
+
+  TakeRecords(&connection);
+  EXPECT_TRUE(connection.Done());
+}
+
+TEST_F(FastCGIConnectionTest, RejectsUnknownRoles) {
+  wf::FastCGIConnection connection(&app_, options_);
+  std::string body = {0, 2, 1, 0, 0, 0, 0, 0};  // FCGI_AUTHORIZER
+  connection.Receive(MakeRecord(1, 1, body));
+
+  std::vector<Record> records = TakeRecords(&connection);
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].type, 3);
+  EXPECT_EQ(records[0].content[4], 3);  // FCGI_UNKNOWN_ROLE
+}
+
+TEST_F(FastCGIConnectionTest, RejectsLargeBodies) {
+  options_.max_body_size = 4;
+  wf::FastCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest(1, "POST", "/echo", "abcde"));
+
+  EXPECT_THAT(Stdout(TakeRecords(&connection), 1),
+              testing::StartsWith("status: 413 "));
+}
+
+TEST_F(FastCGIConnectionTest, AnswersGetValues) {
+  wf::FastCGIConnection connection(&app_, options_);
+  std::string query = {13, 0};
+  query.append("FCGI_MAX_REQS");
+  query.append({15, 0});
+  query.append("FCGI_MPXS_CONNS");
+  connection.Receive(MakeRecord(9, 0, query));
+
+  std::vector<Record> records = TakeRecords(&connection);
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].type, 10);
+  EXPECT_THAT(records[0].content, testing::HasSubstr("FCGI_MPXS_CONNS1"));
+  EXPECT_THAT(records[0].content, testing::HasSubstr("FCGI_MAX_REQS256"));
+}
+
+TEST_F(FastCGIConnectionTest, StopsReadingWhileRequestsWaitOnHandler) {
+  wf::ResponsePtr held_res;
+  app_.Get("/later", std::make_unique<wf::FProcessor>(
+    [&](wf::RequestPtr req, wf::ResponsePtr res) {
+    held_res = res;
+    return absl::OkStatus();
+  }));
+
+  options_.max_buffered_input = 32;
+  wf::FastCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest(1, "GET", "/later", ""));
+  EXPECT_TRUE(connection.WantsInput());
+
+  connection.Receive(MakeBeginRequest(2, true));
+  connection.Receive(MakeParams(2, {{"REQUEST_METHOD", "POST"},
+                                    {"PATH_INFO", "/echo"}}));
+  connection.Receive(MakeRecord(5, 2, std::string(40, 'x')));
+  EXPECT_FALSE(connection.WantsInput());
+
+  // Once no response is in flight, reading goes on so that the buffered
+  // request can be completed.
+  held_res->End("done").IgnoreError();
+  EXPECT_TRUE(connection.WantsInput());
+
+  connection.Receive(MakeRecord(5, 2, ""));
+  std::vector<Record> records = TakeRecords(&connection);
+  EXPECT_THAT(Stdout(records, 1), testing::EndsWith("\r\n\r\ndone"));
+  EXPECT_THAT(Stdout(records, 2),
+              testing::EndsWith("\r\n\r\n" + std::string(40, 'x')));
+}
+
+TEST_F(FastCGIConnectionTest, StopsReadingWhileResponsesAreUnsent) {
+  options_.max_buffered_output = 16;
+  wf::FastCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest(1, "GET", "/", "") +
+                     MakeRequest(2, "GET", "/", ""));
+  EXPECT_FALSE(connection.WantsInput());
+
+  // The second request waits until the first response has been sent.
+  std::vector<Record> records = TakeRecords(&connection);
+  EXPECT_THAT(Stdout(records, 1), testing::EndsWith("Hello, world!"));
+  EXPECT_TRUE(Stdout(records, 2).empty());
+  EXPECT_TRUE(connection.WantsInput());
+
+  connection.Receive("");
+  EXPECT_THAT(Stdout(TakeRecords(&connection), 2),
+              testing::EndsWith("Hello, world!"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
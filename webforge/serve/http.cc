@@ -0,0 +1,70 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: http.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::HTTPServer and wf::ServeHTTP on top of wf::Server.
+//
+
+#include "webforge/serve/http.h"
+
+#include <iostream>
+#include <memory>
+
+#include "absl/status/status.h"
+
+#include "webforge/serve/http_connection.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/socket.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+namespace {
+
+ListenOptions ListenOptionsFromHTTP(const HTTPServerOptions& options) {
+  ListenOptions listen_options;
+  listen_options.backlog = options.backlog;
+  listen_options.reuse_port = WorkerCount(options.workers) > 1;
+  return listen_options;
+}
+
+}
+
+HTTPServer::HTTPServer(Application* application,
+                       const HTTPServerOptions& options) :
+  Server(options.address, ListenOptionsFromHTTP(options),
+         [application, options]() {
+    return std::make_unique<HTTPConnection>(application, options);
+  }, options.backend, options.idle_timeout) {
+  // Nothing to do.
+}
+
+int ServeHTTP(Application* application, const HTTPServerOptions& options) {
+  absl::Status s = RunWorkers(options.workers, [application, &options]() {
+    return std::make_unique<HTTPServer>(application, options);
+  });
+  if (!s.ok()) {
+    std::cerr << "server stopped: " << s << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+}
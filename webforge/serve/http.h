@@ -0,0 +1,71 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: http.h
+// -----------------------------------------------------------------------------
+//
+// wf::ServeHTTP turns the program into a standalone HTTP/1.1 server. Unlike
+// wf::ServeCGI, the process stays alive between requests, which means that the
+// wf::Application (and therefore its wf::Renderer template cache) is reused
+// by every request instead of being rebuilt from scratch each time.
+//
+// Each worker runs a wf::EventLoop with non-blocking sockets (see server.h),
+// and there is one worker unless HTTPServerOptions::workers asks for more (see
+// workers.h). Each client connection is a wf::HTTPConnection, which supports
+// persistent (keep-alive) connections and pipelined requests.
+//
+// Example use:
+//   int main(int argc, char** argv) {
+//     wf::Application app;
+//
+//     // Set up routes on app
+//
+//     wf::HTTPServerOptions options;
+//     options.address = "127.0.0.1:8080";
+//     options.workers.count = 0;  // One per CPU
+//     return wf::ServeHTTP(&app, options);
+//   }
+//
+
+#ifndef WEBFORGE_SERVE_HTTP_H_
+#define WEBFORGE_SERVE_HTTP_H_
+
+#include "webforge/serve/http_connection.h"
+#include "webforge/serve/server.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+// A wf::Server that speaks HTTP/1.1 to its clients.
+//
+// Most programs want wf::ServeHTTP instead. This class exists for programs that
+// need to stop the server again, like tests and benchmarks.
+class HTTPServer : public Server {
+public:
+  HTTPServer(Application* application,
+             const HTTPServerOptions& options = HTTPServerOptions());
+};
+
+// Serves HTTP requests forever (or until a fatal error occurs).
+//
+// Intended to be called from main() as `return wf::ServeHTTP(...);` - the
+// return value is an exit code.
+int ServeHTTP(Application* application,
+              const HTTPServerOptions& options = HTTPServerOptions());
+
+}
+
+#endif  // WEBFORGE_SERVE_HTTP_H_
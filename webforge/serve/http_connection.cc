@@ -0,0 +1,568 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: http_connection.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::HTTPConnection along with wf::HTTPWriter, the ResponseWriter
+// that frames wf::Response output as HTTP/1.1.
+//
+
+#include "webforge/serve/http_connection.h"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/date.h"
+#include "webforge/http/file.h"
+#include "webforge/http/http.h"
+#include "webforge/http/request_parser.h"
+#include "webforge/http/strings.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+namespace {
+
+// Room left in a serialized head for the headers HTTPWriter adds itself.
+constexpr std::size_t kHeadExtra = 128;
+
+// Returns the current time as an HTTP-Date, re-rendering at most once a second.
+const std::string& CurrentDate() {
+  thread_local int64_t rendered_at = -1;
+  thread_local std::string rendered;
+
+  int64_t now = absl::ToUnixSeconds(absl::Now());
+  if (now != rendered_at) {
+    rendered = HTTPDate().Render();
+    rendered_at = now;
+  }
+
+  return rendered;
+}
+
+absl::string_view StripWhitespace(absl::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+
+  return s;
+}
+
+// Checks whether a comma-separated header value contains `token`.
+bool HasToken(absl::string_view value, absl::string_view token) {
+  for (absl::string_view part : absl::StrSplit(value, ',')) {
+    if (absl::EqualsIgnoreCase(StripWhitespace(part), token)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool WantsKeepAlive(const RequestHead& head) {
+  const absl::string_view* connection = head.Find("Connection");
+
+  if (head.version == "HTTP/1.0") {
+    return connection != nullptr && HasToken(*connection, "keep-alive");
+  }
+
+  return connection == nullptr || !HasToken(*connection, "close");
+}
+
+}
+
+// Frames the output of a single wf::Response as an HTTP/1.1 response.
+//
+// When the response sets a Content-Length, the body is passed straight through
+// to the connection. Otherwise, the body is held back in the hope that the
+// response ends before much of it has been written, so that a Content-Length
+// can be computed for it. Once chunk_size bytes have been held back, or the
+// response is flushed, the head goes out with "Transfer-Encoding: chunked"
+// instead, and the rest of the body follows as chunks of about chunk_size bytes.
+// HTTP/1.0 clients don't understand chunks, so their bodies are always held back
+// until End().
+class HTTPWriter : public ResponseWriter {
+public:
+  HTTPWriter(HTTPConnection* connection, bool keep_alive, bool is_head,
+             bool can_chunk) :
+    connection_(connection), keep_alive_(keep_alive), is_head_(is_head),
+    can_chunk_(can_chunk), buffered_(false), chunked_(false), ended_(false) {
+    // Nothing to do.
+  }
+
+  absl::Status WriteHead(const Response& res) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    // Unless the writer has to frame the body itself, the head goes straight
+    // into the connection's output, where the start of the body will join it
+    // in the same send.
+    bool has_length = res.Headers().contains("content-length");
+    bool has_body = !is_head_ && res.Status() >= 200 && res.Status() != 204 &&
+                    res.Status() != 304;
+    buffered_ = has_body && !has_length;
+
+    std::string* head = connection_->out_.Tail();
+    if (buffered_) {
+      head_.clear();
+      head = &head_;
+    }
+
+    // The connection decides on its own framing, so the application's
+    // Connection and Transfer-Encoding headers are left out. The extra room is
+    // for the Date, Connection and framing headers.
+    ResponseWriter::AppendHead(
+      res, absl::StrFormat("HTTP/1.1 %d %s", res.Status(),
+                           GetStatusReason(res.Status())),
+      {"connection", "transfer-encoding"}, kHeadExtra, head);
+    absl::StrAppend(head, "date: ", CurrentDate(), "\r\n");
+
+    if (!keep_alive_) {
+      absl::StrAppend(head, "connection: close\r\n");
+    } else if (res.Version() == "http/1.0") {
+      absl::StrAppend(head, "connection: keep-alive\r\n");
+    }
+
+    if (!buffered_) {
+      head->append("\r\n");
+    }
+
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    if (!buffered_) {
+      connection_->out_.Tail()->append(chunk.data(), chunk.size());
+      return absl::OkStatus();
+    }
+
+    body_.append(chunk.data(), chunk.size());
+    if (can_chunk_ && body_.size() >= connection_->options_.chunk_size) {
+      WriteBufferedChunk();
+      connection_->NotifyOutput();
+    }
+
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    if (buffered_ && !can_chunk_) {
+      // Held back with the rest of the body until its length is known.
+      return ResponseWriter::WriteFile(std::move(file), offset, length);
+    }
+
+    OutputQueue& out = connection_->out_;
+    if (buffered_) {
+      // The file goes out as a chunk of its own.
+      WriteBufferedChunk();
+      absl::StrAppendFormat(out.Tail(), "%x\r\n", length);
+      out.AppendFile(std::move(file), offset, length);
+      out.Tail()->append("\r\n");
+      return absl::OkStatus();
+    }
+
+    out.AppendFile(std::move(file), offset, length);
+    return absl::OkStatus();
+  }
+
+  absl::Status Flush() override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    if (buffered_ && can_chunk_) {
+      WriteBufferedChunk();
+    }
+
+    connection_->NotifyOutput();
+    return absl::OkStatus();
+  }
+
+  void End() override {
+    if (ended_ || connection_ == nullptr) {
+      return;
+    }
+    ended_ = true;
+
+    std::string& out = *connection_->out_.Tail();
+    if (chunked_) {
+      WriteBufferedChunk();
+      out.append("0\r\n\r\n");
+    } else if (buffered_) {
+      out.append(head_);
+      absl::StrAppend(&out, "content-length: ", body_.size(), "\r\n\r\n");
+      out.append(body_);
+    }
+
+    HTTPConnection* connection = connection_;
+    connection_ = nullptr;
+    connection->FinishResponse(keep_alive_);
+  }
+
+  // Called when the connection goes away before the response has ended.
+  void Detach() {
+    connection_ = nullptr;
+  }
+
+private:
+  // Switches to chunked framing if that hasn't happened yet, and turns
+  // everything held back into a single chunk.
+  void WriteBufferedChunk() {
+    std::string& out = *connection_->out_.Tail();
+    if (!chunked_) {
+      out.append(head_);
+      out.append("transfer-encoding: chunked\r\n\r\n");
+      head_.clear();
+      chunked_ = true;
+    }
+
+    if (body_.empty()) {
+      // An empty chunk would end the body.
+      return;
+    }
+
+    absl::StrAppendFormat(&out, "%x\r\n", body_.size());
+    out.append(body_);
+    out.append("\r\n");
+    body_.clear();
+  }
+
+  HTTPConnection* connection_;
+  bool keep_alive_;
+  bool is_head_;
+  bool can_chunk_;  // The client speaks HTTP/1.1
+  bool buffered_;  // The body is framed by the writer, not the application
+  bool chunked_;  // The head has gone out with chunked framing
+  bool ended_;
+  std::string head_;
+  std::string body_;
+};
+
+HTTPConnection::HTTPConnection(Application* application,
+                               const HTTPServerOptions& options) :
+  application_(application), options_(options), consumed_(0),
+  parser_(options.max_head_size), pending_length_(0),
+  pending_keep_alive_(false), dispatching_(false), closing_(false),
+  eof_(false) {
+  // Nothing to do.
+}
+
+HTTPConnection::~HTTPConnection() {
+  if (active_) {
+    active_->Detach();
+  }
+}
+
+void HTTPConnection::Receive(absl::string_view data) {
+  if (closing_) {
+    // Anything after a request with "Connection: close" is ignored.
+    return;
+  }
+
+  if (consumed_ > 0) {
+    // The parser only keeps offsets, so dropping whole requests in front of a
+    // partial one doesn't invalidate its progress.
+    in_.erase(0, consumed_);
+    consumed_ = 0;
+  }
+
+  in_.append(data.data(), data.size());
+  ProcessRequests();
+}
+
+void HTTPConnection::ReceiveEOF() {
+  // Requests that are already buffered still get their responses.
+  eof_ = true;
+}
+
+absl::string_view HTTPConnection::Output() const {
+  return out_.Bytes();
+}
+
+void HTTPConnection::Sent(std::size_t n) {
+  out_.SentBytes(n);
+}
+
+void HTTPConnection::HoldOutput() {
+  out_.Hold();
+}
+
+const FileRange* HTTPConnection::OutputFile() const {
+  return out_.FrontFile();
+}
+
+void HTTPConnection::SentFile(std::size_t n) {
+  out_.SentFile(n);
+}
+
+bool HTTPConnection::Done() const {
+  return (closing_ || eof_) && !active_ && out_.Empty();
+}
+
+bool HTTPConnection::DoneAfterOutput() const {
+  return (closing_ || eof_) && !active_ && out_.OnlyBytes();
+}
+
+bool HTTPConnection::WantsInput() const {
+  if (out_.BufferedBytes() >= options_.max_buffered_output) {
+    return false;
+  }
+
+  // Without a response in flight, everything complete has been dispatched, and
+  // the rest is bounded by max_head_size and max_body_size.
+  return !active_ || in_.size() - consumed_ < options_.max_buffered_input;
+}
+
+bool HTTPConnection::Busy() const {
+  return active_ != nullptr;
+}
+
+void HTTPConnection::OnOutput(std::function<void()> on_output) {
+  on_output_ = std::move(on_output);
+}
+
+void HTTPConnection::ProcessRequests() {
+  while (!active_ && !closing_ &&
+         out_.BufferedBytes() < options_.max_buffered_output) {
+    absl::string_view in = absl::string_view(in_).substr(consumed_);
+
+    if (!pending_) {
+      absl::StatusOr<std::size_t> size = parser_.Parse(in, &head_);
+      if (!size.ok()) {
+        Reject(size.status());
+        return;
+      }
+
+      if (size.value() == 0) {
+        return;
+      }
+
+      consumed_ += size.value();
+      in.remove_prefix(size.value());
+
+      absl::Status s = StartRequest();
+      if (!s.ok()) {
+        Reject(s);
+        return;
+      }
+
+      const absl::string_view* expect = head_.Find("Expect");
+      if (expect != nullptr &&
+          absl::EqualsIgnoreCase(*expect, "100-continue") &&
+          in.size() < pending_length_) {
+        out_.Tail()->append("HTTP/1.1 100 Continue\r\n\r\n");
+      }
+    }
+
+    if (in.size() < pending_length_) {
+      // Wait for the rest of the body.
+      return;
+    }
+
+    absl::string_view body = in.substr(0, pending_length_);
+    consumed_ += pending_length_;
+    Dispatch(body);
+  }
+}
+
+absl::Status HTTPConnection::StartRequest() {
+  if (head_.version != "HTTP/1.1" && head_.version != "HTTP/1.0") {
+    return absl::FailedPreconditionError("unsupported HTTP version");
+  }
+
+  // Keep-alive connections reuse the previous request's objects, unless the
+  // application is still holding on to them.
+  if (request_ == nullptr || request_.use_count() > 1) {
+    request_ = std::make_shared<Request>();
+  } else {
+    request_->Reset();
+  }
+
+  // wf::Request owns its strings, so the views in head_ are copied here, once
+  // per request, into containers that kept their capacity from the last one.
+  RequestPtr req = request_;
+  req->Method(head_.method);
+  req->Version(head_.version);
+
+  absl::string_view target = head_.target;
+  if (absl::StartsWith(target, "http://") ||
+      absl::StartsWith(target, "https://")) {
+    // absolute-form, as sent to proxies. Reduce it to origin-form.
+    target.remove_prefix(target.find("//") + 2);
+    auto slash = target.find('/');
+    req->Header("Host", target.substr(0, slash));
+    target = slash == absl::string_view::npos ? "/" : target.substr(slash);
+  }
+
+  auto query = target.find('?');
+  if (query != absl::string_view::npos) {
+    ParseQueryString(target.substr(query + 1), req->MutableQuery());
+    target.remove_suffix(target.size() - query);
+  }
+  req->Path(URLDecode(target, false));
+
+  pending_length_ = 0;
+  auto* headers = req->MutableHeaders();
+  for (const HeaderField& field : head_.fields) {
+    if (absl::EqualsIgnoreCase(field.name, "Content-Length")) {
+      uint64_t length;
+      if (!absl::SimpleAtoi(field.value, &length)) {
+        return absl::InvalidArgumentError("malformed Content-Length");
+      }
+
+      if (length > options_.max_body_size) {
+        return absl::OutOfRangeError("request body too large");
+      }
+
+      pending_length_ = length;
+    } else if (absl::EqualsIgnoreCase(field.name, "Transfer-Encoding")) {
+      return absl::UnimplementedError("request bodies must use "
+                                      "Content-Length");
+    } else if (absl::EqualsIgnoreCase(field.name, "Cookie")) {
+      req->Header(field.name, field.value);
+      continue;
+    }
+
+    auto it = headers->try_emplace(CaseInsensitive(field.name), field.value);
+    if (!it.second) {
+      // Repeated fields are equivalent to one comma-separated field.
+      absl::StrAppend(&it.first->second, ", ", field.value);
+    }
+  }
+
+  pending_ = req;
+  pending_keep_alive_ = WantsKeepAlive(head_);
+  return absl::OkStatus();
+}
+
+void HTTPConnection::Dispatch(absl::string_view body) {
+  RequestPtr req = std::move(pending_);
+  pending_ = nullptr;
+  pending_length_ = 0;
+
+  if (body_ == nullptr || body_.use_count() > 1) {
+    body_ = std::make_shared<std::istringstream>(std::string(body));
+  } else {
+    body_->str(std::string(body));
+    body_->clear();
+  }
+  req->Stream(body_);
+
+  if (response_ == nullptr || response_.use_count() > 1) {
+    response_ = Response::FromRequest(*req);
+  } else {
+    response_->Reset(*req);
+  }
+
+  ResponsePtr res = response_;
+  active_ = std::make_shared<HTTPWriter>(this, pending_keep_alive_,
+                                         req->Method() == "head",
+                                         req->Version() == "http/1.1");
+  res->UseWriter(active_);
+
+  dispatching_ = true;
+  application_->Handle(req, res).IgnoreError();
+  dispatching_ = false;
+}
+
+void HTTPConnection::FinishResponse(bool keep_alive) {
+  active_ = nullptr;
+  if (!keep_alive) {
+    closing_ = true;
+  }
+
+  if (dispatching_) {
+    // ProcessRequests is further up the stack and will pick up from here.
+    return;
+  }
+
+  ProcessRequests();
+  NotifyOutput();
+}
+
+void HTTPConnection::NotifyOutput() {
+  if (on_output_) {
+    on_output_();
+  }
+}
+
+void HTTPConnection::Reject(const absl::Status& status) {
+  int code = 400;
+  switch (status.code()) {
+    case absl::StatusCode::kResourceExhausted:
+      code = 431;
+      break;
+    case absl::StatusCode::kOutOfRange:
+      code = 413;
+      break;
+    case absl::StatusCode::kUnimplemented:
+      code = 501;
+      break;
+    case absl::StatusCode::kFailedPrecondition:
+      code = 505;
+      break;
+    default:
+      break;
+  }
+
+  std::string body = absl::StrFormat("%d %s\n", code, GetStatusReason(code));
+  absl::StrAppendFormat(out_.Tail(),
+                        "HTTP/1.1 %d %s\r\n"
+                        "date: %s\r\n"
+                        "content-type: text/plain; charset=utf-8\r\n"
+                        "content-length: %d\r\n"
+                        "connection: close\r\n"
+                        "\r\n"
+                        "%s",
+                        code, GetStatusReason(code), CurrentDate(),
+                        body.size(), body);
+
+  pending_ = nullptr;
+  closing_ = true;
+}
+
+}
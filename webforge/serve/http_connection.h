@@ -0,0 +1,177 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: http_connection.h
+// -----------------------------------------------------------------------------
+//
+// wf::HTTPConnection implements the HTTP/1.1 protocol for a single client
+// connection, without doing any I/O itself (see wf::Connection in server.h).
+// This keeps the protocol logic independent from how the bytes actually move,
+// and lets the tests drive a connection with plain strings.
+//
+// Each complete request is turned into a wf::Request and handed to a
+// wf::Application, exactly like wf::ServeCGI does. Responses are written in
+// order, so pipelined requests are only dispatched once the response before
+// them has ended, and reading stops while too much is buffered (see
+// HTTPServerOptions::max_buffered_input). Consecutive requests on a keep-alive
+// connection reuse the same wf::Request and wf::Response objects (see
+// Request::Reset), as long as the application hasn't held on to them.
+//
+
+#ifndef WEBFORGE_SERVE_HTTP_CONNECTION_H_
+#define WEBFORGE_SERVE_HTTP_CONNECTION_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/http.h"
+#include "webforge/http/request_parser.h"
+#include "webforge/serve/output_queue.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+// Parameters for wf::ServeHTTP and each of its connections.
+struct HTTPServerOptions {
+  // Address to listen on. See wf::Listen for the accepted formats.
+  std::string address = "0.0.0.0:8080";
+
+  // Maximum length of the queue of pending connections (see listen(2)).
+  int backlog = 1024;
+
+  // How many event loops serve requests. See wf::RunWorkers.
+  WorkerOptions workers;
+
+  // How each worker performs socket I/O. See wf::IOBackend.
+  IOBackend backend = IOBackend::kEpoll;
+
+  // Clients are disconnected after this long without any I/O while no response
+  // is being produced, e.g. keep-alive connections between requests.
+  absl::Duration idle_timeout = absl::Seconds(60);
+
+  // Requests with a longer request line plus headers are answered with a 431.
+  std::size_t max_head_size = 16 * 1024;
+
+  // Requests with a longer body are answered with a 413.
+  std::size_t max_body_size = 8 * 1024 * 1024;
+
+  // Response bodies without a Content-Length are sent with chunked
+  // Transfer-Encoding once they exceed this many bytes, in chunks of about this
+  // size. Smaller ones are sent whole, with a Content-Length. Response::Flush()
+  // sends a chunk right away, whatever its size.
+  std::size_t chunk_size = 16 * 1024;
+
+  // The connection stops reading from the client while this many bytes of
+  // pipelined requests are waiting for the response in front of them, so that
+  // a client can't make it buffer without bound.
+  std::size_t max_buffered_input = 64 * 1024;
+
+  // Likewise, while this many bytes of responses are waiting to be sent, the
+  // connection stops reading and doesn't start on further requests, so that a
+  // client that pipelines requests without reading the responses can't either.
+  std::size_t max_buffered_output = 1024 * 1024;
+};
+
+class HTTPWriter;
+
+class HTTPConnection : public Connection {
+public:
+  HTTPConnection(Application* application, const HTTPServerOptions& options);
+  ~HTTPConnection() override;
+
+  HTTPConnection(const HTTPConnection&) = delete;
+  HTTPConnection& operator=(const HTTPConnection&) = delete;
+
+  // See wf::Connection.
+  void Receive(absl::string_view data) override;
+  void ReceiveEOF() override;
+  absl::string_view Output() const override;
+  void Sent(std::size_t n) override;
+  void HoldOutput() override;
+  const FileRange* OutputFile() const override;
+  void SentFile(std::size_t n) override;
+  bool Done() const override;
+  bool DoneAfterOutput() const override;
+  bool WantsInput() const override;
+  bool Busy() const override;
+  void OnOutput(std::function<void()> on_output) override;
+
+private:
+  friend class HTTPWriter;
+
+  // Dispatches as many buffered requests as possible.
+  void ProcessRequests();
+
+  // Turns the request head in head_ into pending_.
+  absl::Status StartRequest();
+
+  void Dispatch(absl::string_view body);
+
+  // Called by the active HTTPWriter once its response has been fully written.
+  void FinishResponse(bool keep_alive);
+
+  // Lets the server know that output is ready before Receive() returns, or
+  // outside of it.
+  void NotifyOutput();
+
+  // Writes a short error response for a request that couldn't be parsed, and
+  // closes the connection.
+  void Reject(const absl::Status& status);
+
+  Application* application_;
+  HTTPServerOptions options_;
+  std::function<void()> on_output_;
+
+  // Received bytes. The first consumed_ of them belong to requests that have
+  // already been dispatched, and are dropped on the next Receive.
+  std::string in_;
+  std::size_t consumed_;
+  OutputQueue out_;
+
+  RequestParser parser_;
+  RequestHead head_;
+
+  // The objects of the most recent request, which are reused for the next one
+  // once nothing else refers to them.
+  RequestPtr request_;
+  ResponsePtr response_;
+  std::shared_ptr<std::istringstream> body_;
+
+  // A request whose head has been parsed, but whose body is incomplete.
+  RequestPtr pending_;
+  std::size_t pending_length_;
+  bool pending_keep_alive_;
+
+  // The writer of the response currently in flight, if any.
+  std::shared_ptr<HTTPWriter> active_;
+
+  bool dispatching_;
+  bool closing_;  // No more requests will be handled
+  bool eof_;  // The client won't send anything else
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_HTTP_CONNECTION_H_
@@ -0,0 +1,305 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: http_connection_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::HTTPConnection by feeding it raw request bytes and
+// inspecting the raw response bytes it produces.
+//
+
+#include "webforge/serve/http_connection.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "webforge/http/http.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+class HTTPConnectionTest : public testing::Test {
+protected:
+  void SetUp() override {
+    app_.Get("/", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->End("Hello, world!").IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    // Never sets a Content-Length, so the connection has to.
+    app_.Get("/stream", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->Write("Hello, ").IgnoreError();
+      res->Write("world!").IgnoreError();
+      res->End();
+      return absl::OkStatus();
+    }));
+
+    app_.Post("/echo", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      std::string body(std::istreambuf_iterator<char>(*req->Stream()), {});
+      res->Header("Content-Type", "text/plain");
+      res->End(body).IgnoreError();
+      return absl::OkStatus();
+    }));
+  }
+
+  // Takes everything the connection wants to send.
+  std::string TakeOutput(wf::HTTPConnection* connection) {
+    std::string output(connection->Output());
+    connection->Sent(output.size());
+    return output;
+  }
+
+  wf::Application app_;
+  wf::HTTPServerOptions options_;
+};
+
+TEST_F(HTTPConnectionTest, CanServeRequest) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+  std::string output = TakeOutput(&connection);
+  EXPECT_THAT(output, testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(output, testing::HasSubstr("content-length: 13\r\n"));
+  EXPECT_THAT(output, testing::EndsWith("\r\n\r\nHello, world!"));
+
+  // HTTP/1.1 connections are persistent by default.
+  EXPECT_FALSE(connection.Done());
+}
+
+TEST_F(HTTPConnectionTest, CanHandlePartialReads) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("POST /echo HTTP/1.1\r\nContent-Le");
+  connection.Receive("ngth: 5\r\n\r\nab");
+  EXPECT_TRUE(connection.Output().empty());
+
+  connection.Receive("cde");
+  EXPECT_THAT(TakeOutput(&connection), testing::EndsWith("\r\n\r\nabcde"));
+}
+
+TEST_F(HTTPConnectionTest, CanHandlePipelinedRequests) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET / HTTP/1.1\r\n\r\n"
+                     "GET /stream HTTP/1.1\r\n\r\n"
+                     "GET /missing HTTP/1.1\r\n\r\n");
+
+  std::string output = TakeOutput(&connection);
+  auto first = output.find("Hello, world!");
+  auto second = output.find("Hello, world!", first + 1);
+  auto third = output.find("HTTP/1.1 500");
+
+  // Responses come back in the same order as the requests.
+  ASSERT_NE(first, std::string::npos);
+  ASSERT_NE(second, std::string::npos);
+  ASSERT_NE(third, std::string::npos);
+  EXPECT_LT(first, second);
+  EXPECT_LT(second, third);
+}
+
+TEST_F(HTTPConnectionTest, ComputesContentLengthWhenMissing) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET /stream HTTP/1.1\r\n\r\n");
+
+  std::string output = TakeOutput(&connection);
+  EXPECT_THAT(output, testing::HasSubstr("content-length: 13\r\n"));
+  EXPECT_THAT(output, testing::EndsWith("\r\n\r\nHello, world!"));
+}
+
+TEST_F(HTTPConnectionTest, SendsLargeBodiesChunked) {
+  options_.chunk_size = 8;
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET /stream HTTP/1.1\r\n\r\n");
+
+  // "Hello, " stays below chunk_size, then "world!" makes it one 13-byte chunk.
+  std::string output = TakeOutput(&connection);
+  EXPECT_THAT(output, testing::HasSubstr("transfer-encoding: chunked\r\n"));
+  EXPECT_THAT(output, testing::Not(testing::HasSubstr("content-length")));
+  EXPECT_THAT(output, testing::EndsWith("\r\n\r\nd\r\nHello, world!\r\n"
+                                        "0\r\n\r\n"));
+
+  // HTTP/1.0 clients don't understand chunks.
+  connection.Receive("GET /stream HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+  EXPECT_THAT(TakeOutput(&connection),
+              testing::HasSubstr("content-length: 13\r\n"));
+}
+
+TEST_F(HTTPConnectionTest, SendsFlushedOutputBeforeResponseEnds) {
+  std::string output_at_flush;
+  wf::HTTPConnection connection(&app_, options_);
+  connection.OnOutput([&]() {
+    output_at_flush = TakeOutput(&connection);
+  });
+
+  app_.Get("/flush", std::make_unique<wf::FProcessor>(
+    [&](wf::RequestPtr req, wf::ResponsePtr res) {
+    res->Write("top").IgnoreError();
+    res->Flush().IgnoreError();
+    EXPECT_THAT(output_at_flush, testing::EndsWith("\r\n\r\n3\r\ntop\r\n"));
+
+    res->End();
+    return absl::OkStatus();
+  }));
+
+  connection.Receive("GET /flush HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(TakeOutput(&connection), "0\r\n\r\n");
+}
+
+TEST_F(HTTPConnectionTest, HonorsConnectionClose) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET / HTTP/1.1\r\nConnection: close\r\n\r\n"
+                     "GET / HTTP/1.1\r\n\r\n");
+
+  std::string output = TakeOutput(&connection);
+  EXPECT_THAT(output, testing::HasSubstr("connection: close\r\n"));
+
+  // The second request must have been ignored.
+  EXPECT_EQ(output.find("HTTP/1.1", 1), std::string::npos);
+  EXPECT_TRUE(connection.Done());
+}
+
+TEST_F(HTTPConnectionTest, ClosesHTTP10ByDefault) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET / HTTP/1.0\r\n\r\n");
+  TakeOutput(&connection);
+  EXPECT_TRUE(connection.Done());
+
+  wf::HTTPConnection keep_alive(&app_, options_);
+  keep_alive.Receive("GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+  EXPECT_THAT(TakeOutput(&keep_alive),
+              testing::HasSubstr("connection: keep-alive\r\n"));
+  EXPECT_FALSE(keep_alive.Done());
+}
+
+TEST_F(HTTPConnectionTest, RejectsMalformedRequests) {
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("NONSENSE\r\n\r\n");
+
+  EXPECT_THAT(TakeOutput(&connection),
+              testing::StartsWith("HTTP/1.1 400 Bad Request\r\n"));
+  EXPECT_TRUE(connection.Done());
+
+  options_.max_head_size = 16;
+  wf::HTTPConnection small(&app_, options_);
+  small.Receive("GET / HTTP/1.1\r\nX-Padding: aaaaaaaaaaaaaaaa");
+
+  EXPECT_THAT(TakeOutput(&small), testing::StartsWith("HTTP/1.1 431 "));
+  EXPECT_TRUE(small.Done());
+}
+
+TEST_F(HTTPConnectionTest, ReusesRequestsOnKeepAlive) {
+  std::vector<wf::Request*> requests;
+  std::vector<bool> had_header;
+  app_.Get("/track", std::make_unique<wf::FProcessor>(
+    [&](wf::RequestPtr req, wf::ResponsePtr res) {
+    requests.push_back(req.get());
+    had_header.push_back(req->Header("X-First").ok());
+    res->End("").IgnoreError();
+    return absl::OkStatus();
+  }));
+
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET /track HTTP/1.1\r\nX-First: 1\r\n\r\n"
+                     "GET /track HTTP/1.1\r\n\r\n");
+
+  // The second request got the same object, without the first one's headers.
+  ASSERT_EQ(requests.size(), 2);
+  EXPECT_EQ(requests[0], requests[1]);
+  EXPECT_TRUE(had_header[0]);
+  EXPECT_FALSE(had_header[1]);
+}
+
+TEST_F(HTTPConnectionTest, IsBusyUntilResponseEnds) {
+  wf::RequestPtr held_req;
+  wf::ResponsePtr held_res;
+  app_.Get("/later", std::make_unique<wf::FProcessor>(
+    [&](wf::RequestPtr req, wf::ResponsePtr res) {
+    held_req = req;
+    held_res = res;
+    return absl::OkStatus();
+  }));
+
+  wf::HTTPConnection connection(&app_, options_);
+  EXPECT_FALSE(connection.Busy());
+
+  connection.Receive("GET /later HTTP/1.1\r\n\r\n");
+  EXPECT_TRUE(connection.Busy());
+
+  wf::Request* first = held_req.get();
+  held_res->End("done").IgnoreError();
+  EXPECT_FALSE(connection.Busy());
+
+  // The application still holds the first request, so it isn't reused.
+  connection.Receive("GET /later HTTP/1.1\r\n\r\n");
+  EXPECT_NE(held_req.get(), first);
+  EXPECT_EQ(first->Path(), "/later");
+}
+
+TEST_F(HTTPConnectionTest, StopsReadingWhilePipelinedRequestsWait) {
+  wf::ResponsePtr held_res;
+  app_.Get("/later", std::make_unique<wf::FProcessor>(
+    [&](wf::RequestPtr req, wf::ResponsePtr res) {
+    held_res = res;
+    return absl::OkStatus();
+  }));
+
+  options_.max_buffered_input = 32;
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET /later HTTP/1.1\r\n\r\n");
+  EXPECT_TRUE(connection.WantsInput());
+
+  connection.Receive("GET / HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+  EXPECT_FALSE(connection.WantsInput());
+
+  // The pipelined requests are dispatched once the response before them ends.
+  held_res->End("done").IgnoreError();
+  EXPECT_TRUE(connection.WantsInput());
+
+  std::string output = TakeOutput(&connection);
+  auto second = output.find("Hello, world!");
+  ASSERT_NE(second, std::string::npos);
+  EXPECT_NE(output.find("Hello, world!", second + 1), std::string::npos);
+}
+
+TEST_F(HTTPConnectionTest, StopsReadingWhileResponsesAreUnsent) {
+  options_.max_buffered_output = 16;
+  wf::HTTPConnection connection(&app_, options_);
+  connection.Receive("GET / HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+
+  // The second request waits until the first response has been sent.
+  std::string output(connection.Output());
+  EXPECT_EQ(output.find("HTTP/1.1", 1), std::string::npos);
+  EXPECT_FALSE(connection.WantsInput());
+
+  connection.Sent(output.size());
+  EXPECT_TRUE(connection.WantsInput());
+
+  connection.Receive("");
+  EXPECT_THAT(TakeOutput(&connection), testing::EndsWith("Hello, world!"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,272 @@
+//
+// -----------------------------------------------------------------------------
+// File: io_uring.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::IOUring on top of the io_uring_setup(2), io_uring_enter(2)
+// and io_uring_register(2) system calls.
+//
+
+#include "webforge/serve/io_uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace wf {
+
+namespace {
+
+int Setup(unsigned entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int Enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                 nullptr, 0);
+}
+
+int Register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+void* MapRing(int fd, std::size_t size, off_t offset) {
+  return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              fd, offset);
+}
+
+}
+
+absl::StatusOr<std::unique_ptr<IOUring>> IOUring::Create(unsigned entries) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = Setup(entries, &params);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "io_uring_setup() failed");
+  }
+
+  std::unique_ptr<IOUring> ring(new IOUring(fd));
+  absl::Status s = ring->Map(params);
+  if (!s.ok()) {
+    return s;
+  }
+
+  return ring;
+}
+
+IOUring::IOUring(int fd) : fd_(fd), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+  cq_ring_(MAP_FAILED), cq_ring_size_(0), sqes_(nullptr), sqes_size_(0),
+  sq_head_(nullptr), sq_tail_(nullptr), sq_array_(nullptr), sq_mask_(0),
+  sq_entries_(0), sqe_tail_(0), cq_head_(nullptr), cq_tail_(nullptr),
+  cqes_(nullptr), cq_mask_(0), buf_ring_(nullptr), buf_ring_size_(0),
+  buffers_(nullptr), buffers_size_(0), buffer_size_(0), buffer_mask_(0) {
+  // Nothing to do.
+}
+
+IOUring::~IOUring() {
+  if (buffers_ != nullptr) {
+    munmap(buffers_, buffers_size_);
+  }
+
+  if (buf_ring_ != nullptr) {
+    munmap(buf_ring_, buf_ring_size_);
+  }
+
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+
+  close(fd_);
+}
+
+absl::Status IOUring::Map(const io_uring_params& params) {
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes +
+                  params.cq_entries * sizeof(io_uring_cqe);
+
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+
+  sq_ring_ = MapRing(fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap(IORING_OFF_SQ_RING) failed");
+  }
+
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = MapRing(fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      return absl::ErrnoToStatus(errno, "mmap(IORING_OFF_CQ_RING) failed");
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = MapRing(fd_, sqes_size_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap(IORING_OFF_SQES) failed");
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sqe_tail_ = *sq_tail_;
+
+  char* cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+  return absl::OkStatus();
+}
+
+io_uring_sqe* IOUring::NextSQE() {
+  io_uring_sqe* sqe;
+  if (!NextSQEs(1, &sqe)) {
+    return nullptr;
+  }
+
+  return sqe;
+}
+
+bool IOUring::NextSQEs(unsigned count, io_uring_sqe** sqes) {
+  if (count > sq_entries_) {
+    return false;
+  }
+
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (sqe_tail_ - head > sq_entries_ - count) {
+    if (!Submit(0).ok()) {
+      return false;
+    }
+
+    head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head > sq_entries_ - count) {
+      return false;
+    }
+  }
+
+  for (unsigned i = 0; i < count; ++i) {
+    unsigned index = sqe_tail_ & sq_mask_;
+    sq_array_[index] = index;
+    ++sqe_tail_;
+
+    sqes[i] = &sqes_[index];
+    memset(sqes[i], 0, sizeof(*sqes[i]));
+  }
+
+  return true;
+}
+
+absl::Status IOUring::Submit(unsigned wait) {
+  unsigned to_submit = sqe_tail_ - *sq_tail_;
+  __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+  unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+  if (Enter(fd_, to_submit, wait, flags) < 0) {
+    // EINTR and EBUSY (too many unreaped completions) are both resolved by
+    // reaping completions and trying again later.
+    if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+      return absl::ErrnoToStatus(errno, "io_uring_enter() failed");
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status IOUring::SetupBuffers(uint16_t group, uint16_t count,
+                                   uint32_t size) {
+  if (count == 0 || (count & (count - 1)) != 0) {
+    return absl::InvalidArgumentError("buffer count must be a power of two");
+  }
+
+  buf_ring_size_ = count * sizeof(io_uring_buf);
+  void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap() of buffer ring failed");
+  }
+  buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+  buffers_size_ = static_cast<std::size_t>(count) * size;
+  void* buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers == MAP_FAILED) {
+    return absl::ErrnoToStatus(errno, "mmap() of buffers failed");
+  }
+  buffers_ = static_cast<char*>(buffers);
+  buffer_size_ = size;
+  buffer_mask_ = count - 1;
+
+  io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+  reg.ring_entries = count;
+  reg.bgid = group;
+  if (Register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    return absl::ErrnoToStatus(errno, "IORING_REGISTER_PBUF_RING failed");
+  }
+
+  // Hand every buffer to the kernel.
+  for (uint16_t id = 0; id < count; ++id) {
+    io_uring_buf* buf = BufferSlot(id);
+    buf->addr = reinterpret_cast<uint64_t>(buffers_ + id * size);
+    buf->len = size;
+    buf->bid = id;
+  }
+  __atomic_store_n(&buf_ring_->tail, count, __ATOMIC_RELEASE);
+
+  return absl::OkStatus();
+}
+
+io_uring_buf* IOUring::BufferSlot(uint16_t index) {
+  // Not &buf_ring_->bufs[index]: when compiled as C++, the flexible array in
+  // <linux/io_uring.h> is preceded by an empty struct, which has a size of one,
+  // so bufs ends up at offset 8 instead of overlaying the tail.
+  return reinterpret_cast<io_uring_buf*>(buf_ring_) + index;
+}
+
+const char* IOUring::Buffer(uint16_t id) const {
+  return buffers_ + static_cast<std::size_t>(id) * buffer_size_;
+}
+
+void IOUring::RecycleBuffer(uint16_t id) {
+  uint16_t tail = buf_ring_->tail;
+  io_uring_buf* buf = BufferSlot(tail & buffer_mask_);
+  buf->addr = reinterpret_cast<uint64_t>(buffers_ + id * buffer_size_);
+  buf->len = buffer_size_;
+  buf->bid = id;
+
+  __atomic_store_n(&buf_ring_->tail, static_cast<uint16_t>(tail + 1),
+                   __ATOMIC_RELEASE);
+}
+
+}
@@ -0,0 +1,121 @@
+//
+// -----------------------------------------------------------------------------
+// File: io_uring.h
+// -----------------------------------------------------------------------------
+//
+// wf::IOUring is a minimal wrapper around a Linux io_uring(7) instance, written
+// against the raw system calls in <linux/io_uring.h> so that liburing isn't
+// required. It only covers what wf::IOUringDriver needs:
+//
+// - Getting submission queue entries (SQEs) and submitting them.
+// - Reaping completion queue entries (CQEs).
+// - A ring of provided buffers, which the kernel picks receive buffers from,
+//   so that idle connections don't each hold on to a buffer of their own.
+//
+// An IOUring is single-threaded: only the thread that runs the driver may call
+// any of its methods.
+//
+
+#ifndef WEBFORGE_SERVE_IO_URING_H_
+#define WEBFORGE_SERVE_IO_URING_H_
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include <cstddef>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace wf {
+
+class IOUring {
+public:
+  // Sets up a ring with room for `entries` submissions at once. Fails on
+  // kernels without io_uring, or where it has been disabled.
+  static absl::StatusOr<std::unique_ptr<IOUring>> Create(unsigned entries);
+
+  ~IOUring();
+
+  IOUring(const IOUring&) = delete;
+  IOUring& operator=(const IOUring&) = delete;
+
+  // Returns a zeroed SQE to fill in. If the submission queue is full, the
+  // queued entries are submitted first. Returns nullptr if that fails.
+  io_uring_sqe* NextSQE();
+
+  // Like NextSQE(), but fills in `count` SQEs at once, so that no submission
+  // can happen in between, e.g. for a linked chain. Returns false, and takes
+  // none, if there isn't room for all of them.
+  bool NextSQEs(unsigned count, io_uring_sqe** sqes);
+
+  // Submits all queued SQEs, and waits until at least `wait` completions are
+  // available.
+  absl::Status Submit(unsigned wait);
+
+  // Calls `fn(const io_uring_cqe&)` for every available completion.
+  template <typename F>
+  void ForEachCompletion(F fn) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+      fn(cqes_[head & cq_mask_]);
+      ++head;
+    }
+
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+  // Registers `count` buffers of `size` bytes each as buffer group `group`.
+  // `count` must be a power of two. Fails on kernels older than 5.19.
+  absl::Status SetupBuffers(uint16_t group, uint16_t count, uint32_t size);
+
+  // Returns the memory of provided buffer `id`.
+  const char* Buffer(uint16_t id) const;
+
+  // Hands provided buffer `id` back to the kernel once it has been consumed.
+  void RecycleBuffer(uint16_t id);
+
+private:
+  explicit IOUring(int fd);
+
+  absl::Status Map(const io_uring_params& params);
+
+  // Returns entry `index` of the provided buffer ring.
+  io_uring_buf* BufferSlot(uint16_t index);
+
+  int fd_;
+
+  void* sq_ring_;
+  std::size_t sq_ring_size_;
+  void* cq_ring_;  // May be the same mapping as sq_ring_
+  std::size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  std::size_t sqes_size_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_array_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned sqe_tail_;  // Tail including entries that haven't been published
+
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  io_uring_cqe* cqes_;
+  unsigned cq_mask_;
+
+  // Provided buffers
+  io_uring_buf_ring* buf_ring_;
+  std::size_t buf_ring_size_;
+  char* buffers_;
+  std::size_t buffers_size_;
+  uint32_t buffer_size_;
+  uint16_t buffer_mask_;
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_IO_URING_H_
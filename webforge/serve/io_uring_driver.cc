@@ -0,0 +1,679 @@
+//
+// -----------------------------------------------------------------------------
+// File: io_uring_driver.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::IOUringDriver.
+//
+
+#include "webforge/serve/io_uring_driver.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+#include "webforge/serve/io_uring.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/timer_wheel.h"
+
+namespace wf {
+
+namespace {
+
+// Submission queue size. Completions are reaped after every batch, so this
+// only bounds how many submissions one batch can make before an early submit.
+const unsigned kRingEntries = 1024;
+
+// Provided receive buffers, shared by every client of the driver.
+const uint16_t kBufferGroup = 0;
+const uint16_t kBufferCount = 256;
+const uint32_t kBufferSize = 16 * 1024;
+
+uint64_t UserData(uint32_t op, uint32_t id) {
+  return (static_cast<uint64_t>(op) << 32) | id;
+}
+
+}
+
+absl::StatusOr<std::unique_ptr<IOUringDriver>> IOUringDriver::Create(
+  int listen_fd, Server::ConnectionFactory factory,
+  absl::Duration idle_timeout) {
+  absl::StatusOr<std::unique_ptr<IOUring>> ring = IOUring::Create(kRingEntries);
+  if (!ring.ok()) {
+    return ring.status();
+  }
+
+  absl::Status s = ring.value()->SetupBuffers(kBufferGroup, kBufferCount,
+                                              kBufferSize);
+  if (!s.ok()) {
+    return s;
+  }
+
+  int wake_fd = eventfd(0, EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    return absl::ErrnoToStatus(errno, "eventfd() failed");
+  }
+
+  std::unique_ptr<IOUringDriver> driver(new IOUringDriver(
+    listen_fd, std::move(factory), std::move(ring.value()), wake_fd,
+    idle_timeout));
+
+  if (idle_timeout != absl::InfiniteDuration()) {
+    driver->idle_timers_ = TimerWheel::ForTimeout(idle_timeout, MonotonicNow());
+
+    absl::StatusOr<int> timer_fd =
+      CreateTickTimer(driver->idle_timers_->Tick());
+    if (!timer_fd.ok()) {
+      return timer_fd.status();
+    }
+    driver->timer_fd_ = timer_fd.value();
+  }
+
+  return driver;
+}
+
+IOUringDriver::IOUringDriver(int listen_fd, Server::ConnectionFactory factory,
+                             std::unique_ptr<IOUring> ring, int wake_fd,
+                             absl::Duration idle_timeout) :
+  listen_fd_(listen_fd), factory_(std::move(factory)), ring_(std::move(ring)),
+  wake_fd_(wake_fd), wake_value_(0), stopped_(false),
+  idle_timeout_(idle_timeout), timer_fd_(-1), timer_value_(0),
+  accept_paused_(false), accepting_(false), multishot_accept_(true),
+  multishot_recv_(true),
+  next_id_(0) {
+  // Nothing to do.
+}
+
+IOUringDriver::~IOUringDriver() {
+  // Tearing the ring down cancels whatever is still in flight, including sends
+  // that read from the buffers of clients_.
+  ring_.reset();
+
+  for (auto& it : clients_) {
+    if (!it.second.closing) {
+      close(it.second.fd);
+    }
+  }
+
+  close(wake_fd_);
+  if (timer_fd_ >= 0) {
+    close(timer_fd_);
+  }
+}
+
+absl::Status IOUringDriver::Run() {
+  ArmWake();
+  ArmTimer();
+  ArmAccept();
+
+  while (!stopped_) {
+    // Every send of this batch goes out with the same io_uring_enter().
+    std::vector<uint32_t> dirty;
+    dirty.swap(dirty_);
+    for (uint32_t id : dirty) {
+      Flush(id);
+    }
+
+    // Also covers an accept that couldn't be submitted last time.
+    if (!accept_paused_) {
+      ArmAccept();
+    }
+
+    absl::Status s = ring_->Submit(dirty_.empty() ? 1 : 0);
+    if (!s.ok()) {
+      return s;
+    }
+
+    ring_->ForEachCompletion([this](const io_uring_cqe& cqe) {
+      HandleCompletion(cqe);
+    });
+  }
+
+  return absl::OkStatus();
+}
+
+void IOUringDriver::Stop() {
+  stopped_ = true;
+
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // Only fails if the counter would overflow, in which case the loop is
+    // already awake.
+  }
+}
+
+void IOUringDriver::Post(std::function<void()> task) {
+  {
+    absl::MutexLock lock(&posted_mutex_);
+    posted_.push_back(std::move(task));
+  }
+
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    // See Stop().
+  }
+}
+
+void IOUringDriver::HandleCompletion(const io_uring_cqe& cqe) {
+  auto op = static_cast<Op>(cqe.user_data >> 32);
+  auto id = static_cast<uint32_t>(cqe.user_data);
+
+  switch (op) {
+    case Op::kWake:
+      RunPostedTasks();
+      if (!stopped_) {
+        ArmWake();
+      }
+      break;
+    case Op::kAccept:
+      HandleAccept(cqe);
+      break;
+    case Op::kRecv:
+      HandleRecv(id, cqe);
+      break;
+    case Op::kSend:
+      HandleSend(id, cqe);
+      break;
+    case Op::kClose:
+      HandleClose(id, cqe);
+      break;
+    case Op::kCancel:
+      break;
+    case Op::kTimer:
+      HandleTimer();
+      break;
+    case Op::kPoll:
+      HandlePoll(id, cqe);
+      break;
+  }
+}
+
+void IOUringDriver::HandleAccept(const io_uring_cqe& cqe) {
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    accepting_ = false;
+  }
+
+  if (cqe.res == -EINVAL && multishot_accept_) {
+    multishot_accept_ = false;
+    ArmAccept();
+    return;
+  }
+
+  if (cqe.res < 0) {
+    if (!accept_reserve_.Recover(listen_fd_,
+                                 absl::ErrnoToStatus(-cqe.res, "accept"))) {
+      // Accepting again right away would fail the same way.
+      accept_paused_ = true;
+      return;
+    }
+
+    ArmAccept();
+    return;
+  }
+
+  int fd = cqe.res;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  uint32_t id = next_id_++;
+  Client& client = clients_[id];
+  client.fd = fd;
+  client.connection = factory_();
+  client.receiving = false;
+  client.paused = false;
+  client.sending = false;
+  client.polling = false;
+  client.closing = false;
+  client.eof = false;
+  client.failed = false;
+
+  // A response that is flushed while it is being produced is sent right away,
+  // so it reaches the client early. Everything else waits for the end of the
+  // batch.
+  client.connection->OnOutput([this, id]() {
+    Flush(id);
+    ring_->Submit(0).IgnoreError();
+    MarkDirty(id);
+  });
+
+  if (idle_timers_) {
+    idle_timers_->Schedule(id, idle_timeout_);
+  }
+
+  ArmRecv(id, &client);
+  ArmAccept();
+}
+
+void IOUringDriver::HandleRecv(uint32_t id, const io_uring_cqe& cqe) {
+  bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+  auto buffer = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    if (has_buffer) {
+      ring_->RecycleBuffer(buffer);
+    }
+    return;
+  }
+  Client& client = it->second;
+
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    client.receiving = false;
+  }
+
+  if (cqe.res > 0 && idle_timers_) {
+    idle_timers_->Schedule(id, idle_timeout_);
+  }
+
+  if (cqe.res > 0) {
+    client.connection->Receive(absl::string_view(ring_->Buffer(buffer),
+                                                 cqe.res));
+    ring_->RecycleBuffer(buffer);
+  } else if (cqe.res == 0) {
+    client.connection->ReceiveEOF();
+    client.eof = true;
+  } else if (cqe.res == -EINVAL && multishot_recv_) {
+    multishot_recv_ = false;
+  } else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+    Abort(id);
+    return;
+  }
+
+  if (has_buffer && cqe.res <= 0) {
+    ring_->RecycleBuffer(buffer);
+  }
+
+  if (!client.receiving && !client.paused && !client.eof && !client.closing &&
+      !client.failed && client.connection->WantsInput()) {
+    ArmRecv(id, &client);
+  }
+
+  MarkDirty(id);
+}
+
+void IOUringDriver::HandleSend(uint32_t id, const io_uring_cqe& cqe) {
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    return;
+  }
+  Client& client = it->second;
+
+  client.sending = false;
+  if (cqe.res > 0 && idle_timers_) {
+    idle_timers_->Schedule(id, idle_timeout_);
+  }
+
+  if (cqe.res < 0) {
+    client.failed = true;
+  } else {
+    client.connection->Sent(cqe.res);
+  }
+
+  MarkDirty(id);
+}
+
+void IOUringDriver::HandleClose(uint32_t id, const io_uring_cqe& cqe) {
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    return;
+  }
+
+  if (cqe.res == -ECANCELED) {
+    // The send linked before it was cut short, so the close never happened.
+    it->second.closing = false;
+    MarkDirty(id);
+    return;
+  }
+
+  clients_.erase(it);
+  if (idle_timers_) {
+    idle_timers_->Cancel(id);
+  }
+
+  accept_paused_ = false;
+}
+
+void IOUringDriver::HandleTimer() {
+  if (!stopped_) {
+    ArmTimer();
+  }
+
+  // Descriptors may also have been freed by something other than our clients.
+  accept_paused_ = false;
+
+  idle_timers_->Advance(MonotonicNow(), [this](uint64_t key) {
+    auto id = static_cast<uint32_t>(key);
+    auto it = clients_.find(id);
+    if (it == clients_.end() || it->second.closing) {
+      return;
+    }
+
+    if (it->second.connection->Busy()) {
+      idle_timers_->Schedule(id, idle_timeout_);
+      return;
+    }
+
+    Abort(id);
+  });
+}
+
+void IOUringDriver::RunPostedTasks() {
+  std::vector<std::function<void()>> tasks;
+  {
+    absl::MutexLock lock(&posted_mutex_);
+    tasks.swap(posted_);
+  }
+
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+void IOUringDriver::HandlePoll(uint32_t id, const io_uring_cqe& cqe) {
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    return;
+  }
+
+  it->second.polling = false;
+  if (cqe.res < 0 && cqe.res != -ECANCELED) {
+    it->second.failed = true;
+  }
+
+  MarkDirty(id);
+}
+
+void IOUringDriver::ArmWake() {
+  io_uring_sqe* sqe = NextSQE(Op::kWake, 0);
+  if (sqe == nullptr) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = wake_fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&wake_value_);
+  sqe->len = sizeof(wake_value_);
+}
+
+void IOUringDriver::ArmTimer() {
+  if (timer_fd_ < 0) {
+    return;
+  }
+
+  io_uring_sqe* sqe = NextSQE(Op::kTimer, 0);
+  if (sqe == nullptr) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = timer_fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&timer_value_);
+  sqe->len = sizeof(timer_value_);
+}
+
+void IOUringDriver::ArmAccept() {
+  if (accepting_) {
+    return;
+  }
+
+  io_uring_sqe* sqe = NextSQE(Op::kAccept, 0);
+  if (sqe == nullptr) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listen_fd_;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  if (multishot_accept_) {
+    sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+  }
+
+  accepting_ = true;
+}
+
+void IOUringDriver::ArmRecv(uint32_t id, Client* client) {
+  io_uring_sqe* sqe = NextSQE(Op::kRecv, id);
+  if (sqe == nullptr) {
+    // Flushing arms the receive again.
+    MarkDirty(id);
+    return;
+  }
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = client->fd;
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  if (multishot_recv_) {
+    sqe->ioprio |= IORING_RECV_MULTISHOT;
+  } else {
+    sqe->len = kBufferSize;
+  }
+
+  client->receiving = true;
+}
+
+void IOUringDriver::ArmPoll(uint32_t id, Client* client) {
+  io_uring_sqe* sqe = NextSQE(Op::kPoll, id);
+  if (sqe == nullptr) {
+    MarkDirty(id);
+    return;
+  }
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = client->fd;
+  sqe->poll32_events = POLLOUT;
+  client->polling = true;
+}
+
+void IOUringDriver::UpdateInput(uint32_t id, Client* client) {
+  if (client->eof || client->closing || client->failed) {
+    return;
+  }
+
+  if (client->paused && client->connection->WantsInput()) {
+    client->paused = false;
+    client->connection->Receive(absl::string_view());
+  }
+
+  if (!client->paused && !client->connection->WantsInput()) {
+    client->paused = true;
+    if (client->receiving) {
+      // A multishot receive would go on filling the connection's buffers. It
+      // stays armed until its final completion comes in.
+      io_uring_sqe* sqe = NextSQE(Op::kCancel, id);
+      if (sqe != nullptr) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = UserData(static_cast<uint32_t>(Op::kRecv), id);
+      }
+    }
+  }
+
+  if (!client->paused && !client->receiving) {
+    ArmRecv(id, client);
+  }
+}
+
+void IOUringDriver::SendFiles(uint32_t id, Client* client) {
+  Connection* connection = client->connection.get();
+  while (const FileRange* range = connection->OutputFile()) {
+    off_t offset = range->offset;
+    ssize_t n = sendfile(client->fd, range->file->Descriptor(), &offset,
+                         range->length);
+    if (n > 0) {
+      connection->SentFile(n);
+      if (idle_timers_) {
+        idle_timers_->Schedule(id, idle_timeout_);
+      }
+      continue;
+    }
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      ArmPoll(id, client);
+      return;
+    }
+
+    // Either the socket failed, or the file was truncated since it was opened.
+    client->failed = true;
+    return;
+  }
+}
+
+void IOUringDriver::Flush(uint32_t id) {
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    return;
+  }
+  Client& client = it->second;
+  UpdateInput(id, &client);
+
+  if (client.sending || client.closing) {
+    // Flushed again once that completes.
+    return;
+  }
+
+  if (client.polling) {
+    if (!client.failed) {
+      // Flushed again once the socket has room.
+      return;
+    }
+
+    // The socket may never get room, so stop waiting for it.
+    io_uring_sqe* sqe = NextSQE(Op::kCancel, id);
+    if (sqe != nullptr) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = UserData(static_cast<uint32_t>(Op::kPoll), id);
+    }
+    client.polling = false;
+  }
+
+  absl::string_view output;
+  if (!client.failed) {
+    SendFiles(id, &client);
+    if (client.polling) {
+      return;
+    }
+
+    output = client.connection->Output();
+  }
+
+  bool done = client.failed || client.connection->DoneAfterOutput();
+  if (output.empty() && !done) {
+    return;
+  }
+
+  if (done && client.receiving) {
+    // An armed receive keeps the socket open even after it is closed.
+    io_uring_sqe* sqe = NextSQE(Op::kCancel, id);
+    if (sqe != nullptr) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = UserData(static_cast<uint32_t>(Op::kRecv), id);
+    }
+    client.receiving = false;
+  }
+
+  // The send and the close of a linked chain are taken together, since the
+  // queue filling up between them would submit the send on its own.
+  bool send = !output.empty() && !client.failed;
+  io_uring_sqe* sqes[2];
+  bool reserved;
+  if (send && done) {
+    reserved = NextSQEs({Op::kSend, Op::kClose}, id, sqes);
+  } else if (send) {
+    reserved = NextSQEs({Op::kSend}, id, sqes);
+  } else {
+    reserved = NextSQEs({Op::kClose}, id, sqes);
+  }
+
+  if (!reserved) {
+    MarkDirty(id);
+    return;
+  }
+
+  if (send) {
+    io_uring_sqe* sqe = sqes[0];
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = client.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(output.data());
+    sqe->len = output.size();
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    if (done) {
+      // A short send breaks the chain, in which case the close is cancelled
+      // and retried once the rest has been sent.
+      sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    client.connection->HoldOutput();
+    client.sending = true;
+  }
+
+  if (done) {
+    io_uring_sqe* sqe = sqes[send ? 1 : 0];
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = client.fd;
+    client.closing = true;
+  }
+}
+
+void IOUringDriver::MarkDirty(uint32_t id) {
+  dirty_.push_back(id);
+}
+
+void IOUringDriver::Abort(uint32_t id) {
+  auto it = clients_.find(id);
+  if (it == clients_.end()) {
+    return;
+  }
+
+  it->second.failed = true;
+  MarkDirty(id);
+}
+
+io_uring_sqe* IOUringDriver::NextSQE(Op op, uint32_t id) {
+  io_uring_sqe* sqe;
+  if (!NextSQEs({op}, id, &sqe)) {
+    return nullptr;
+  }
+
+  return sqe;
+}
+
+bool IOUringDriver::NextSQEs(std::initializer_list<Op> ops, uint32_t id,
+                             io_uring_sqe** sqes) {
+  if (!ring_->NextSQEs(ops.size(), sqes)) {
+    std::cerr << "io_uring submission queue is full" << std::endl;
+    return false;
+  }
+
+  for (Op op : ops) {
+    (*sqes++)->user_data = UserData(static_cast<uint32_t>(op), id);
+  }
+
+  return true;
+}
+
+}
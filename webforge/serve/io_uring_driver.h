@@ -0,0 +1,193 @@
+//
+// -----------------------------------------------------------------------------
+// File: io_uring_driver.h
+// -----------------------------------------------------------------------------
+//
+// wf::IOUringDriver is the io_uring counterpart of the epoll code in
+// wf::Server: it accepts clients on a listening socket and moves bytes between
+// them and their wf::Connection, but it does so with completions instead of
+// readiness notifications.
+//
+// - One multishot accept stays armed on the listening socket.
+// - Each client has one multishot receive armed, which picks its buffer from a
+//   shared ring of provided buffers (see wf::IOUring::SetupBuffers).
+// - Output is sent straight from the connection's buffers, which it holds in
+//   place (see Connection::HoldOutput) until the send completes.
+// - Output is not sent as soon as it is produced. Every connection that
+//   produced output while a batch of completions was being handled is flushed
+//   once at the end of the batch, so a response written in many
+//   Response::Write() chunks goes out as a single send, and the sends of all
+//   connections share a single io_uring_enter(2).
+// - When a connection is done after its final output (e.g. after a response
+//   with "Connection: close"), the send and the close are submitted as one
+//   linked chain.
+// - Files (see Connection::OutputFile) are sent with sendfile(2), since
+//   io_uring has no equivalent that goes straight from a file to a socket.
+//   When the socket is full, a poll is armed and the file is picked up again
+//   once it has room.
+// - Idle timeouts work as in wf::Server, with a read of a timerfd(2) armed to
+//   advance the TimerWheel.
+// - Accepts and receives that can't be submitted because the submission queue
+//   is full are retried after the next batch.
+// - Tasks from other threads (see Post()) are run when the eventfd(2) that
+//   Stop() also uses is read, as in wf::EventLoop.
+//
+// Kernels that reject multishot accept or receive (before 5.19 and 6.0
+// respectively) get single-shot requests that are re-armed after each
+// completion.
+//
+
+#ifndef WEBFORGE_SERVE_IO_URING_DRIVER_H_
+#define WEBFORGE_SERVE_IO_URING_DRIVER_H_
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+#include "webforge/serve/io_uring.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/socket.h"
+#include "webforge/serve/timer_wheel.h"
+
+namespace wf {
+
+class IOUringDriver {
+public:
+  // Creates a driver for `listen_fd`, which stays owned by the caller. Fails if
+  // the kernel doesn't support io_uring with provided buffer rings.
+  //
+  // `idle_timeout` means the same as for wf::Server.
+  static absl::StatusOr<std::unique_ptr<IOUringDriver>> Create(
+    int listen_fd, Server::ConnectionFactory factory,
+    absl::Duration idle_timeout);
+
+  ~IOUringDriver();
+
+  IOUringDriver(const IOUringDriver&) = delete;
+  IOUringDriver& operator=(const IOUringDriver&) = delete;
+
+  // Handles connections until Stop() is called.
+  absl::Status Run();
+
+  // Makes Run() return. Thread-safe.
+  void Stop();
+
+  // Queues `task` to be run on the thread that calls Run(). Thread-safe.
+  void Post(std::function<void()> task);
+
+private:
+  // What a submission was for. Stored in the upper half of its user_data, with
+  // the client ID in the lower half.
+  enum class Op : uint32_t {
+    kWake,
+    kAccept,
+    kRecv,
+    kSend,
+    kClose,
+    kCancel,
+    kTimer,
+    kPoll,
+  };
+
+  struct Client {
+    int fd;
+    std::unique_ptr<Connection> connection;
+    bool receiving;  // A receive is armed
+    bool paused;  // Not receiving, because the connection doesn't want input
+    bool sending;  // A send of the connection's held Output() is in flight
+    bool polling;  // Waiting for room in the socket to send a file
+    bool closing;  // A close has been submitted
+    bool eof;
+    bool failed;  // The socket is broken; close it as soon as possible
+  };
+
+  IOUringDriver(int listen_fd, Server::ConnectionFactory factory,
+                std::unique_ptr<IOUring> ring, int wake_fd,
+                absl::Duration idle_timeout);
+
+  void HandleCompletion(const io_uring_cqe& cqe);
+  void HandleAccept(const io_uring_cqe& cqe);
+  void HandleRecv(uint32_t id, const io_uring_cqe& cqe);
+  void HandleSend(uint32_t id, const io_uring_cqe& cqe);
+  void HandleClose(uint32_t id, const io_uring_cqe& cqe);
+  void HandleTimer();
+  void RunPostedTasks();
+  void HandlePoll(uint32_t id, const io_uring_cqe& cqe);
+
+  void ArmWake();
+  void ArmTimer();
+  void ArmAccept();
+  void ArmRecv(uint32_t id, Client* client);
+  void ArmPoll(uint32_t id, Client* client);
+
+  // Stops or resumes receiving for a client, depending on whether its
+  // connection wants input.
+  void UpdateInput(uint32_t id, Client* client);
+
+  // Sends the files at the front of the output of a client, for as long as the
+  // socket takes them.
+  void SendFiles(uint32_t id, Client* client);
+
+  // Submits whatever output client `id` has, and closes it once it is done.
+  void Flush(uint32_t id);
+
+  // Flushes a client at the end of the current batch of completions.
+  void MarkDirty(uint32_t id);
+
+  // Closes a client whose socket failed, without sending anything else.
+  void Abort(uint32_t id);
+
+  io_uring_sqe* NextSQE(Op op, uint32_t id);
+
+  // Takes an SQE for each of `ops` at once (see IOUring::NextSQEs), or none.
+  bool NextSQEs(std::initializer_list<Op> ops, uint32_t id,
+                io_uring_sqe** sqes);
+
+  int listen_fd_;
+  Server::ConnectionFactory factory_;
+
+  // Destroyed explicitly before clients_, whose output in-flight sends read.
+  std::unique_ptr<IOUring> ring_;
+
+  int wake_fd_;
+  uint64_t wake_value_;  // Target of the armed eventfd read
+  std::atomic<bool> stopped_;
+
+  absl::Mutex posted_mutex_;
+  std::vector<std::function<void()>> posted_ ABSL_GUARDED_BY(posted_mutex_);
+
+  absl::Duration idle_timeout_;
+  int timer_fd_;  // Advances idle_timers_, if there is an idle timeout
+  uint64_t timer_value_;  // Target of the armed timerfd read
+  std::unique_ptr<TimerWheel> idle_timers_;  // Keyed by client ID
+
+  // As in wf::Server. While accepting is paused, it resumes once a client is
+  // closed or the idle timer ticks.
+  AcceptReserve accept_reserve_;
+  bool accept_paused_;
+
+  bool accepting_;  // An accept is armed
+  bool multishot_accept_;
+  bool multishot_recv_;
+
+  uint32_t next_id_;
+  absl::flat_hash_map<uint32_t, Client> clients_;
+  std::vector<uint32_t> dirty_;
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_IO_URING_DRIVER_H_
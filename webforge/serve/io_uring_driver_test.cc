@@ -0,0 +1,243 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: io_uring_driver_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::IOUringDriver by serving wf::HTTPConnections on a
+// loopback socket and talking to it as a client would. The tests are skipped
+// where io_uring isn't available.
+//
+
+#include "webforge/serve/io_uring_driver.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "webforge/http/http.h"
+#include "webforge/serve/http_connection.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/socket.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+namespace {
+
+// Big enough that sending it takes several sends, while the responses behind
+// it are queued.
+const std::size_t kLargeBodySize = 4 * 1024 * 1024;
+
+}
+
+class IOUringDriverTest : public testing::Test {
+protected:
+  void SetUp() override {
+    app_.Get("/", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->End("Hello, world!").IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    app_.Get("/large", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->End(std::string(kLargeBodySize, 'x')).IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    absl::StatusOr<int> listen_fd = wf::Listen("127.0.0.1:0");
+    ASSERT_TRUE(listen_fd.ok()) << listen_fd.status();
+    listen_fd_ = listen_fd.value();
+
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    ASSERT_EQ(getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                          &length), 0);
+    port_ = address.sin_port;
+
+    absl::StatusOr<std::unique_ptr<wf::IOUringDriver>> driver =
+      wf::IOUringDriver::Create(listen_fd_, [this]() {
+        return std::make_unique<wf::HTTPConnection>(&app_, options_);
+      }, absl::InfiniteDuration());
+    if (!driver.ok()) {
+      GTEST_SKIP() << "io_uring is unavailable: " << driver.status();
+    }
+
+    driver_ = std::move(driver.value());
+    thread_ = std::thread([this]() {
+      EXPECT_TRUE(driver_->Run().ok());
+    });
+  }
+
+  void TearDown() override {
+    if (driver_) {
+      driver_->Stop();
+      thread_.join();
+      driver_.reset();
+    }
+
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+    }
+  }
+
+  // Returns a blocking socket connected to the driver, which gives up on reads
+  // that take too long rather than hanging the test.
+  int Connect() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = port_;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) < 0) {
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  static void Send(int fd, absl::string_view data) {
+    while (!data.empty()) {
+      ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+      ASSERT_GT(n, 0);
+      data.remove_prefix(n);
+    }
+  }
+
+  // Reads one response, framed by its Content-Length.
+  static std::string ReadResponse(int fd) {
+    std::string response;
+    std::size_t end = std::string::npos;
+    while (end == std::string::npos || response.size() < end) {
+      char buffer[4096];
+      ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        break;
+      }
+      response.append(buffer, n);
+
+      std::size_t head_end = response.find("\r\n\r\n");
+      std::size_t header = response.find("content-length: ");
+      if (end == std::string::npos && head_end != std::string::npos &&
+          header < head_end) {
+        std::size_t start = header + sizeof("content-length: ") - 1;
+        std::size_t length;
+        if (!absl::SimpleAtoi(absl::string_view(response).substr(
+              start, response.find("\r\n", start) - start), &length)) {
+          break;
+        }
+        end = head_end + 4 + length;
+      }
+    }
+
+    return response;
+  }
+
+  // Reads until the driver closes the connection.
+  static std::string ReadAll(int fd) {
+    std::string data;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      data.append(buffer, n);
+    }
+
+    // A read that timed out means the connection was never closed.
+    EXPECT_EQ(n, 0);
+    return data;
+  }
+
+  wf::Application app_;
+  wf::HTTPServerOptions options_;
+  int listen_fd_ = -1;
+  in_port_t port_;
+  std::unique_ptr<wf::IOUringDriver> driver_;
+  std::thread thread_;
+};
+
+TEST_F(IOUringDriverTest, KeepsConnectionsAlive) {
+  int fd = Connect();
+  ASSERT_GE(fd, 0);
+
+  for (int i = 0; i < 3; ++i) {
+    Send(fd, "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::string response = ReadResponse(fd);
+    EXPECT_THAT(response, testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_THAT(response, testing::EndsWith("\r\n\r\nHello, world!"));
+  }
+
+  close(fd);
+}
+
+TEST_F(IOUringDriverTest, ClosesAfterConnectionClose) {
+  int fd = Connect();
+  ASSERT_GE(fd, 0);
+
+  Send(fd, "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  std::string response = ReadAll(fd);
+  EXPECT_THAT(response, testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response, testing::EndsWith("\r\n\r\nHello, world!"));
+
+  close(fd);
+}
+
+TEST_F(IOUringDriverTest, AnswersPipelinedRequestsInOrder) {
+  int fd = Connect();
+  ASSERT_GE(fd, 0);
+
+  // The responses behind the large one are produced while it is being sent.
+  Send(fd, "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+           "GET /large HTTP/1.1\r\nHost: localhost\r\n\r\n"
+           "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  std::string output = ReadAll(fd);
+
+  std::size_t first = output.find("\r\n\r\nHello, world!");
+  std::size_t large = output.find(std::string(kLargeBodySize, 'x'));
+  std::size_t last = output.rfind("\r\n\r\nHello, world!");
+  ASSERT_NE(first, std::string::npos);
+  ASSERT_NE(large, std::string::npos);
+  EXPECT_LT(first, large);
+  EXPECT_LT(large, last);
+  EXPECT_THAT(output, testing::EndsWith("\r\n\r\nHello, world!"));
+
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
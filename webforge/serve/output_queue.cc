@@ -0,0 +1,140 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: output_queue.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::OutputQueue.
+//
+
+#include "webforge/serve/output_queue.h"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/file.h"
+
+namespace wf {
+
+OutputQueue::OutputQueue() : segments_(1), held_(false) {
+  // Nothing to do.
+}
+
+std::string* OutputQueue::Tail() {
+  // Appending to the held segment could reallocate its bytes. The segments
+  // themselves stay put, since a deque never moves its elements.
+  if (segments_.back().file.file != nullptr ||
+      (held_ && segments_.size() == 1)) {
+    segments_.emplace_back();
+  }
+
+  return &segments_.back().bytes;
+}
+
+void OutputQueue::AppendFile(std::shared_ptr<const File> file, off_t offset,
+                             std::size_t length) {
+  if (length == 0) {
+    return;
+  }
+
+  if (segments_.back().file.file != nullptr) {
+    segments_.emplace_back();
+  }
+
+  FileRange& range = segments_.back().file;
+  range.file = std::move(file);
+  range.offset = offset;
+  range.length = length;
+}
+
+absl::string_view OutputQueue::Bytes() const {
+  return segments_.front().bytes;
+}
+
+const FileRange* OutputQueue::FrontFile() const {
+  const Segment& front = segments_.front();
+  if (!front.bytes.empty() || front.file.file == nullptr) {
+    return nullptr;
+  }
+
+  return &front.file;
+}
+
+void OutputQueue::SentBytes(std::size_t n) {
+  segments_.front().bytes.erase(0, n);
+  held_ = false;
+  PopSent();
+}
+
+void OutputQueue::SentFile(std::size_t n) {
+  FileRange& range = segments_.front().file;
+  range.offset += n;
+  range.length -= n;
+  if (range.length == 0) {
+    range.file = nullptr;
+  }
+
+  PopSent();
+}
+
+void OutputQueue::Hold() {
+  held_ = true;
+}
+
+bool OutputQueue::Empty() const {
+  return segments_.size() == 1 && segments_.front().bytes.empty() &&
+         segments_.front().file.file == nullptr;
+}
+
+bool OutputQueue::OnlyBytes() const {
+  if (segments_.front().file.file != nullptr) {
+    return false;
+  }
+
+  // Holding the front segment may have started one that is still empty.
+  for (std::size_t i = 1; i < segments_.size(); ++i) {
+    if (!segments_[i].bytes.empty() || segments_[i].file.file != nullptr) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::size_t OutputQueue::BufferedBytes() const {
+  std::size_t size = 0;
+  for (const Segment& segment : segments_) {
+    size += segment.bytes.size();
+  }
+
+  return size;
+}
+
+void OutputQueue::PopSent() {
+  const Segment& front = segments_.front();
+  if (segments_.size() > 1 && front.bytes.empty() &&
+      front.file.file == nullptr) {
+    segments_.pop_front();
+  }
+}
+
+}
@@ -0,0 +1,107 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: output_queue.h
+// -----------------------------------------------------------------------------
+//
+// wf::OutputQueue holds the output of a wf::Connection that is waiting to be
+// sent: mostly bytes, but also ranges of files that the server sends with
+// sendfile(2), so that their contents never have to be copied into the queue.
+//
+// The queue is a list of segments, each of which is some bytes followed by an
+// optional file range. Bytes are always appended to the last segment, and
+// queueing a file closes that segment off.
+//
+
+#ifndef WEBFORGE_SERVE_OUTPUT_QUEUE_H_
+#define WEBFORGE_SERVE_OUTPUT_QUEUE_H_
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/file.h"
+
+namespace wf {
+
+// Part of a file waiting to be sent.
+struct FileRange {
+  std::shared_ptr<const File> file;
+  off_t offset;
+  std::size_t length;
+};
+
+class OutputQueue {
+public:
+  OutputQueue();
+
+  // Returns the buffer to append bytes to, so that they are sent after
+  // everything queued so far.
+  std::string* Tail();
+
+  // Queues `length` bytes of `file`, starting at `offset`, after everything
+  // queued so far.
+  void AppendFile(std::shared_ptr<const File> file, off_t offset,
+                  std::size_t length);
+
+  // Returns the bytes at the front of the queue, up to the first file.
+  absl::string_view Bytes() const;
+
+  // Returns the file range at the front of the queue, if Bytes() is empty and
+  // one is queued. Returns nullptr otherwise.
+  const FileRange* FrontFile() const;
+
+  // Drop the first `n` bytes of Bytes() and FrontFile() respectively, after
+  // they have been sent.
+  void SentBytes(std::size_t n);
+  void SentFile(std::size_t n);
+
+  // Keeps the bytes that Bytes() returns where they are until the next call to
+  // SentBytes(), for a send that reads them after Hold() returns. Bytes
+  // appended in the meantime go into a segment of their own.
+  void Hold();
+
+  bool Empty() const;
+
+  // Returns true if nothing is queued after Bytes().
+  bool OnlyBytes() const;
+
+  // Returns the number of bytes queued, not counting file ranges, which take
+  // no memory of their own.
+  std::size_t BufferedBytes() const;
+
+private:
+  struct Segment {
+    std::string bytes;
+    FileRange file;  // file.file is null if the segment has no file
+  };
+
+  // Drops the front segment once it has been sent entirely, unless it is the
+  // only one.
+  void PopSent();
+
+  std::deque<Segment> segments_;  // Never empty
+  bool held_;  // The front segment's bytes mustn't move
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_OUTPUT_QUEUE_H_
@@ -0,0 +1,131 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: output_queue_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests how wf::OutputQueue orders bytes and file ranges.
+//
+
+#include "webforge/serve/output_queue.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include <gtest/gtest.h>
+
+#include "webforge/http/file.h"
+
+class OutputQueueTest : public testing::Test {
+protected:
+  void SetUp() override {
+    std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "output_queue_test.txt";
+    std::ofstream(path) << "0123456789";
+
+    absl::StatusOr<std::shared_ptr<const wf::File>> file = wf::File::Open(path);
+    ASSERT_TRUE(file.ok());
+    file_ = file.value();
+  }
+
+  std::shared_ptr<const wf::File> file_;
+};
+
+TEST_F(OutputQueueTest, SendsBytesAndFilesInOrder) {
+  wf::OutputQueue queue;
+  queue.Tail()->append("head");
+  queue.AppendFile(file_, 2, 5);
+  queue.Tail()->append("tail");
+  EXPECT_EQ(queue.BufferedBytes(), 8);
+
+  EXPECT_EQ(queue.Bytes(), "head");
+  EXPECT_EQ(queue.FrontFile(), nullptr);
+  queue.SentBytes(4);
+
+  const wf::FileRange* range = queue.FrontFile();
+  ASSERT_NE(range, nullptr);
+  EXPECT_EQ(range->file, file_);
+  EXPECT_EQ(range->offset, 2);
+  EXPECT_EQ(range->length, 5);
+  EXPECT_TRUE(queue.Bytes().empty());
+
+  queue.SentFile(3);
+  range = queue.FrontFile();
+  ASSERT_NE(range, nullptr);
+  EXPECT_EQ(range->offset, 5);
+  EXPECT_EQ(range->length, 2);
+
+  queue.SentFile(2);
+  EXPECT_EQ(queue.FrontFile(), nullptr);
+  EXPECT_EQ(queue.Bytes(), "tail");
+
+  queue.SentBytes(4);
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST_F(OutputQueueTest, SendsConsecutiveFiles) {
+  wf::OutputQueue queue;
+  queue.AppendFile(file_, 0, 10);
+  queue.AppendFile(file_, 0, 4);
+  EXPECT_FALSE(queue.Empty());
+
+  ASSERT_NE(queue.FrontFile(), nullptr);
+  EXPECT_EQ(queue.FrontFile()->length, 10);
+  queue.SentFile(10);
+
+  ASSERT_NE(queue.FrontFile(), nullptr);
+  EXPECT_EQ(queue.FrontFile()->length, 4);
+  queue.SentFile(4);
+
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST_F(OutputQueueTest, HeldBytesStayInPlace) {
+  wf::OutputQueue queue;
+  queue.Tail()->append("head");
+  EXPECT_TRUE(queue.OnlyBytes());
+
+  queue.Hold();
+  const char* held = queue.Bytes().data();
+  queue.Tail()->append(std::string(4096, 'x'));
+  EXPECT_EQ(queue.Bytes().data(), held);
+  EXPECT_EQ(queue.Bytes(), "head");
+  EXPECT_FALSE(queue.OnlyBytes());
+  EXPECT_EQ(queue.BufferedBytes(), 4100);
+
+  // A short send lets go of the rest, which the next send holds again.
+  queue.SentBytes(2);
+  EXPECT_EQ(queue.Bytes(), "ad");
+  queue.SentBytes(2);
+  EXPECT_EQ(queue.Bytes(), std::string(4096, 'x'));
+  EXPECT_TRUE(queue.OnlyBytes());
+
+  queue.Hold();
+  queue.AppendFile(file_, 0, 10);
+  EXPECT_FALSE(queue.OnlyBytes());
+  queue.SentBytes(4096);
+  ASSERT_NE(queue.FrontFile(), nullptr);
+  queue.SentFile(10);
+  EXPECT_TRUE(queue.Empty());
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,426 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: scgi.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::SCGIConnection, wf::SCGIServer and wf::ServeSCGI.
+//
+// The protocol is described at https://python.ca/scgi/protocol.txt
+//
+
+#include "webforge/serve/scgi.h"
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <ios>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+
+#include "webforge/http/file.h"
+#include "webforge/http/http.h"
+#include "webforge/http/strings.h"
+#include "webforge/serve/cgi.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/socket.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+namespace {
+
+ListenOptions ListenOptionsFromSCGI(const SCGIServerOptions& options) {
+  ListenOptions listen_options;
+  listen_options.backlog = options.backlog;
+  listen_options.reuse_port = WorkerCount(options.workers) > 1;
+  return listen_options;
+}
+
+// Holds the buffer a request was received into, and reads its body from it.
+class BodyBuffer : public std::streambuf {
+public:
+  BodyBuffer(std::string buffer, std::size_t offset, std::size_t length) :
+    buffer_(std::move(buffer)) {
+    char* begin = buffer_.data() + offset;
+    setg(begin, begin, begin + length);
+  }
+
+protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                   std::ios_base::openmode which) override {
+    off_type base = 0;
+    if (dir == std::ios_base::cur) {
+      base = gptr() - eback();
+    } else if (dir == std::ios_base::end) {
+      base = egptr() - eback();
+    }
+
+    return seekpos(base + off, which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    if (!(which & std::ios_base::in) || pos < 0 || pos > egptr() - eback()) {
+      return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + pos, egptr());
+    return pos;
+  }
+
+private:
+  std::string buffer_;
+};
+
+// The request body, without copying it out of the buffer it was received into.
+class BodyStream : private BodyBuffer, public std::istream {
+public:
+  BodyStream(std::string buffer, std::size_t offset, std::size_t length) :
+    BodyBuffer(std::move(buffer), offset, length),
+    std::istream(static_cast<BodyBuffer*>(this)) {
+    // Nothing to do.
+  }
+};
+
+}
+
+// Writes the output of the wf::Response in the same format a CGI program would
+// write to stdout.
+class SCGIWriter : public ResponseWriter {
+public:
+  explicit SCGIWriter(SCGIConnection* connection) :
+    connection_(connection), ended_(false) {
+    // Nothing to do.
+  }
+
+  absl::Status WriteHead(const Response& res) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    AppendCGIHead(res, connection_->out_.Tail());
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    connection_->out_.Tail()->append(chunk.data(), chunk.size());
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length) override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    connection_->out_.AppendFile(std::move(file), offset, length);
+    return absl::OkStatus();
+  }
+
+  absl::Status Flush() override {
+    if (connection_ == nullptr) {
+      return absl::UnavailableError("connection closed");
+    }
+
+    // Output isn't held back, so only the server needs to know.
+    if (connection_->on_output_) {
+      connection_->on_output_();
+    }
+
+    return absl::OkStatus();
+  }
+
+  void End() override {
+    if (ended_ || connection_ == nullptr) {
+      return;
+    }
+    ended_ = true;
+
+    SCGIConnection* connection = connection_;
+    connection_ = nullptr;
+    connection->FinishResponse();
+  }
+
+  // Called when the connection goes away before the response has ended.
+  void Detach() {
+    connection_ = nullptr;
+  }
+
+private:
+  SCGIConnection* connection_;
+  bool ended_;
+};
+
+SCGIConnection::SCGIConnection(Application* application,
+                               const SCGIServerOptions& options) :
+  application_(application), options_(options), head_offset_(0),
+  head_length_(0), body_offset_(0), body_length_(0), dispatching_(false),
+  closing_(false), eof_(false) {
+  // Nothing to do.
+}
+
+SCGIConnection::~SCGIConnection() {
+  if (writer_) {
+    writer_->Detach();
+  }
+}
+
+void SCGIConnection::Receive(absl::string_view data) {
+  if (closing_ || writer_) {
+    // There is only one request per connection.
+    return;
+  }
+
+  in_.append(data.data(), data.size());
+
+  if (!req_) {
+    absl::Status s = ParseHead();
+    if (!s.ok()) {
+      Reject(s);
+      return;
+    }
+
+    if (!req_) {
+      // Wait for the rest of the netstring.
+      return;
+    }
+  }
+
+  if (in_.size() - body_offset_ >= body_length_) {
+    Dispatch();
+  }
+}
+
+void SCGIConnection::ReceiveEOF() {
+  eof_ = true;
+}
+
+absl::string_view SCGIConnection::Output() const {
+  return out_.Bytes();
+}
+
+void SCGIConnection::Sent(std::size_t n) {
+  out_.SentBytes(n);
+}
+
+void SCGIConnection::HoldOutput() {
+  out_.Hold();
+}
+
+const FileRange* SCGIConnection::OutputFile() const {
+  return out_.FrontFile();
+}
+
+void SCGIConnection::SentFile(std::size_t n) {
+  out_.SentFile(n);
+}
+
+bool SCGIConnection::Done() const {
+  return (closing_ || (eof_ && !writer_)) && out_.Empty();
+}
+
+bool SCGIConnection::DoneAfterOutput() const {
+  return (closing_ || (eof_ && !writer_)) && out_.OnlyBytes();
+}
+
+bool SCGIConnection::Busy() const {
+  return writer_ != nullptr;
+}
+
+void SCGIConnection::OnOutput(std::function<void()> on_output) {
+  on_output_ = std::move(on_output);
+}
+
+absl::Status SCGIConnection::ParseHead() {
+  if (head_offset_ == 0) {
+    // The netstring starts with its length in decimal, e.g. "70:".
+    auto colon = in_.find(':');
+    if (colon == std::string::npos) {
+      if (in_.size() > 10) {
+        return absl::InvalidArgumentError("malformed netstring length");
+      }
+
+      return absl::OkStatus();
+    }
+
+    std::size_t length = 0;
+    if (colon == 0 || colon > 10) {
+      return absl::InvalidArgumentError("malformed netstring length");
+    }
+
+    for (std::size_t i = 0; i < colon; ++i) {
+      if (in_[i] < '0' || in_[i] > '9') {
+        return absl::InvalidArgumentError("malformed netstring length");
+      }
+
+      length = length * 10 + (in_[i] - '0');
+    }
+
+    if (length > options_.max_head_size) {
+      return absl::ResourceExhaustedError("request head too large");
+    }
+
+    head_offset_ = colon + 1;
+    head_length_ = length;
+  }
+
+  if (in_.size() < head_offset_ + head_length_ + 1) {
+    return absl::OkStatus();
+  }
+
+  if (in_[head_offset_ + head_length_] != ',') {
+    return absl::InvalidArgumentError("malformed netstring");
+  }
+
+  // The headers are NUL-terminated names and values, one after another.
+  absl::string_view headers(in_.data() + head_offset_, head_length_);
+  auto req = std::make_shared<Request>();
+  bool first = true;
+  bool is_scgi = false;
+  std::size_t content_length = 0;
+  while (!headers.empty()) {
+    auto name_end = headers.find('\0');
+    auto value_end = name_end == absl::string_view::npos ?
+                     absl::string_view::npos :
+                     headers.find('\0', name_end + 1);
+    if (value_end == absl::string_view::npos) {
+      return absl::InvalidArgumentError("malformed SCGI header");
+    }
+
+    absl::string_view name = headers.substr(0, name_end);
+    absl::string_view value = headers.substr(name_end + 1,
+                                             value_end - name_end - 1);
+    headers.remove_prefix(value_end + 1);
+
+    if (name == "CONTENT_LENGTH") {
+      if (!absl::SimpleAtoi(value, &content_length)) {
+        return absl::InvalidArgumentError("malformed CONTENT_LENGTH");
+      }
+    } else if (first) {
+      // The specification requires CONTENT_LENGTH to come first.
+      return absl::InvalidArgumentError("CONTENT_LENGTH must come first");
+    } else if (name == "SCGI") {
+      is_scgi = value == "1";
+    }
+    first = false;
+
+    ApplyCGIVariable(name, value, req.get());
+  }
+
+  if (!is_scgi) {
+    return absl::InvalidArgumentError("missing SCGI header");
+  }
+
+  if (content_length > options_.max_body_size) {
+    return absl::OutOfRangeError("request body too large");
+  }
+
+  req_ = std::move(req);
+  body_offset_ = head_offset_ + head_length_ + 1;
+  body_length_ = content_length;
+  return absl::OkStatus();
+}
+
+void SCGIConnection::Dispatch() {
+  // The body stream takes the whole receive buffer over, which only has this
+  // one request in it.
+  RequestPtr req = std::move(req_);
+  req->Stream(std::make_shared<BodyStream>(std::move(in_), body_offset_,
+                                           body_length_));
+  in_.clear();
+
+  ResponsePtr res = Response::FromRequest(*req);
+  writer_ = std::make_shared<SCGIWriter>(this);
+  res->UseWriter(writer_);
+
+  dispatching_ = true;
+  application_->Handle(req, res).IgnoreError();
+  dispatching_ = false;
+}
+
+void SCGIConnection::FinishResponse() {
+  writer_ = nullptr;
+  closing_ = true;
+
+  if (!dispatching_ && on_output_) {
+    on_output_();
+  }
+}
+
+void SCGIConnection::Reject(const absl::Status& status) {
+  int code = 400;
+  switch (status.code()) {
+    case absl::StatusCode::kResourceExhausted:
+      code = 431;
+      break;
+    case absl::StatusCode::kOutOfRange:
+      code = 413;
+      break;
+    default:
+      break;
+  }
+
+  std::string body = absl::StrFormat("%d %s\n", code, GetStatusReason(code));
+  absl::StrAppendFormat(out_.Tail(),
+                        "status: %d %s\r\n"
+                        "content-type: text/plain; charset=utf-8\r\n"
+                        "content-length: %d\r\n"
+                        "\r\n"
+                        "%s",
+                        code, GetStatusReason(code), body.size(), body);
+
+  in_.clear();
+  req_ = nullptr;
+  closing_ = true;
+}
+
+SCGIServer::SCGIServer(Application* application,
+                       const SCGIServerOptions& options) :
+  Server(options.address, ListenOptionsFromSCGI(options),
+         [application, options]() {
+    return std::make_unique<SCGIConnection>(application, options);
+  }, options.backend, options.idle_timeout) {
+  // Nothing to do.
+}
+
+int ServeSCGI(Application* application, const SCGIServerOptions& options) {
+  absl::Status s = RunWorkers(options.workers, [application, &options]() {
+    return std::make_unique<SCGIServer>(application, options);
+  });
+  if (!s.ok()) {
+    std::cerr << "server stopped: " << s << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+}
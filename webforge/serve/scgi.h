@@ -0,0 +1,176 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: scgi.h
+// -----------------------------------------------------------------------------
+//
+// SCGI, or Simple Common Gateway Interface, is a much simpler alternative to
+// FastCGI: the web server opens one connection per request, sends the CGI
+// variables as a netstring followed by the request body, and reads back
+// whatever a CGI program would have written to stdout.
+//
+// wf::ServeSCGI turns the program into a long-running SCGI server, so that no
+// process has to be started per request and the wf::Application is shared by
+// every request. Variables are mapped onto a wf::Request exactly like
+// wf::ServeCGI maps its environment.
+//
+// As with CGI, the web server has to pass PATH_INFO. With nginx:
+//   location / {
+//     include scgi_params;
+//     scgi_param PATH_INFO $uri;
+//     scgi_pass 127.0.0.1:4000;
+//   }
+//
+// Example use:
+//   int main(int argc, char** argv) {
+//     wf::Application app;
+//
+//     // Set up routes on app
+//
+//     return wf::ServeSCGI(&app);
+//   }
+//
+
+#ifndef WEBFORGE_SERVE_SCGI_H_
+#define WEBFORGE_SERVE_SCGI_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/http.h"
+#include "webforge/serve/output_queue.h"
+#include "webforge/serve/server.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+
+namespace wf {
+
+// Parameters for wf::ServeSCGI and each of its connections.
+struct SCGIServerOptions {
+  // Address to listen on. See wf::Listen for the accepted formats.
+  std::string address = "127.0.0.1:4000";
+
+  // Maximum length of the queue of pending connections (see listen(2)).
+  int backlog = 1024;
+
+  // How many event loops serve requests. See wf::RunWorkers.
+  WorkerOptions workers;
+
+  // How each worker performs socket I/O. See wf::IOBackend.
+  IOBackend backend = IOBackend::kEpoll;
+
+  // Web servers are disconnected after this long without any I/O while no
+  // response is being produced.
+  absl::Duration idle_timeout = absl::Seconds(60);
+
+  // Requests with a longer header netstring are answered with a 431.
+  std::size_t max_head_size = 64 * 1024;
+
+  // Requests with a longer body are answered with a 413.
+  std::size_t max_body_size = 8 * 1024 * 1024;
+};
+
+class SCGIWriter;
+
+// Implements SCGI for a single connection, without doing any I/O itself (see
+// wf::Connection in server.h). Every connection carries exactly one request.
+class SCGIConnection : public Connection {
+public:
+  SCGIConnection(Application* application, const SCGIServerOptions& options);
+  ~SCGIConnection() override;
+
+  SCGIConnection(const SCGIConnection&) = delete;
+  SCGIConnection& operator=(const SCGIConnection&) = delete;
+
+  // See wf::Connection.
+  void Receive(absl::string_view data) override;
+  void ReceiveEOF() override;
+  absl::string_view Output() const override;
+  void Sent(std::size_t n) override;
+  void HoldOutput() override;
+  const FileRange* OutputFile() const override;
+  void SentFile(std::size_t n) override;
+  bool Done() const override;
+  bool DoneAfterOutput() const override;
+  bool Busy() const override;
+  void OnOutput(std::function<void()> on_output) override;
+
+private:
+  friend class SCGIWriter;
+
+  // Parses the header netstring once it is complete. Its length is only read
+  // once, so that later calls merely check whether enough has arrived. Headers
+  // are applied straight out of in_, without copying them anywhere else first.
+  absl::Status ParseHead();
+
+  void Dispatch();
+
+  // Called by the SCGIWriter once the response has been fully written.
+  void FinishResponse();
+
+  // Writes a short error response for a request that couldn't be parsed, and
+  // closes the connection.
+  void Reject(const absl::Status& status);
+
+  Application* application_;
+  SCGIServerOptions options_;
+  std::function<void()> on_output_;
+
+  std::string in_;
+  OutputQueue out_;
+
+  // Set once the length of the header netstring has been read.
+  std::size_t head_offset_;  // Where the headers start in in_, or 0
+  std::size_t head_length_;
+
+  // Set once the header netstring has been parsed.
+  RequestPtr req_;
+  std::size_t body_offset_;  // Where the body starts in in_
+  std::size_t body_length_;
+
+  std::shared_ptr<SCGIWriter> writer_;
+
+  bool dispatching_;
+  bool closing_;  // The response is complete, or the request was rejected
+  bool eof_;  // The web server won't send anything else
+};
+
+// A wf::Server that speaks SCGI to web servers.
+//
+// Most programs want wf::ServeSCGI instead. This class exists for programs that
+// need to stop the server again, like tests and benchmarks.
+class SCGIServer : public Server {
+public:
+  SCGIServer(Application* application,
+             const SCGIServerOptions& options = SCGIServerOptions());
+};
+
+// Serves SCGI requests forever (or until a fatal error occurs).
+//
+// Intended to be called from main() as `return wf::ServeSCGI(...);` - the
+// return value is an exit code.
+int ServeSCGI(Application* application,
+              const SCGIServerOptions& options = SCGIServerOptions());
+
+}
+
+#endif  // WEBFORGE_SERVE_SCGI_H_
@@ -0,0 +1,171 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: scgi_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::SCGIConnection by feeding it raw SCGI requests and
+// inspecting the raw responses it produces.
+//
+
+#include "webforge/serve/scgi.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "webforge/http/http.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+namespace {
+
+// Builds a request the way a web server would, with CONTENT_LENGTH first.
+std::string MakeRequest(
+  const std::vector<std::pair<std::string, std::string>>& headers,
+  absl::string_view body) {
+  std::string block;
+  block.append("CONTENT_LENGTH");
+  block.push_back('\0');
+  block.append(absl::StrCat(body.size()));
+  block.push_back('\0');
+  for (const auto& it : headers) {
+    block.append(it.first);
+    block.push_back('\0');
+    block.append(it.second);
+    block.push_back('\0');
+  }
+
+  return absl::StrCat(block.size(), ":", block, ",", body);
+}
+
+}
+
+class SCGIConnectionTest : public testing::Test {
+protected:
+  void SetUp() override {
+    app_.Get("/", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      res->Header("Content-Type", "text/plain");
+      res->End(req->Header("X-Name").value_or("world")).IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    app_.Post("/echo", std::make_unique<wf::FProcessor>(
+      [](wf::RequestPtr req, wf::ResponsePtr res) {
+      std::string body(std::istreambuf_iterator<char>(*req->Stream()), {});
+      res->Header("Content-Type", "text/plain");
+      res->End(body).IgnoreError();
+      return absl::OkStatus();
+    }));
+  }
+
+  // Takes everything the connection wants to send.
+  std::string TakeOutput(wf::SCGIConnection* connection) {
+    std::string output(connection->Output());
+    connection->Sent(output.size());
+    return output;
+  }
+
+  wf::Application app_;
+  wf::SCGIServerOptions options_;
+};
+
+TEST_F(SCGIConnectionTest, CanServeRequest) {
+  wf::SCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest({
+    {"SCGI", "1"},
+    {"REQUEST_METHOD", "GET"},
+    {"PATH_INFO", "/"},
+    {"HTTP_X_NAME", "SCGI"},
+  }, ""));
+
+  std::string output = TakeOutput(&connection);
+  EXPECT_THAT(output, testing::StartsWith("status: 200 OK\r\n"));
+  EXPECT_THAT(output, testing::EndsWith("\r\n\r\nSCGI"));
+
+  // There is only one request per connection.
+  EXPECT_TRUE(connection.Done());
+}
+
+TEST_F(SCGIConnectionTest, CanHandlePartialReads) {
+  wf::SCGIConnection connection(&app_, options_);
+  std::string request = MakeRequest({
+    {"SCGI", "1"},
+    {"REQUEST_METHOD", "POST"},
+    {"PATH_INFO", "/echo"},
+  }, "abcde");
+
+  for (char c : request) {
+    connection.Receive(absl::string_view(&c, 1));
+  }
+
+  EXPECT_THAT(TakeOutput(&connection), testing::EndsWith("\r\n\r\nabcde"));
+}
+
+TEST_F(SCGIConnectionTest, RejectsMalformedRequests) {
+  wf::SCGIConnection missing_scgi(&app_, options_);
+  missing_scgi.Receive(MakeRequest({{"REQUEST_METHOD", "GET"}}, ""));
+  EXPECT_THAT(TakeOutput(&missing_scgi),
+              testing::StartsWith("status: 400 "));
+  EXPECT_TRUE(missing_scgi.Done());
+
+  wf::SCGIConnection bad_length(&app_, options_);
+  bad_length.Receive("12x:");
+  EXPECT_THAT(TakeOutput(&bad_length), testing::StartsWith("status: 400 "));
+
+  options_.max_body_size = 4;
+  wf::SCGIConnection too_large(&app_, options_);
+  too_large.Receive(MakeRequest({{"SCGI", "1"}}, "abcde"));
+  EXPECT_THAT(TakeOutput(&too_large), testing::StartsWith("status: 413 "));
+
+  options_.max_head_size = 8;
+  wf::SCGIConnection head_too_large(&app_, options_);
+  head_too_large.Receive("100:");
+  EXPECT_THAT(TakeOutput(&head_too_large), testing::StartsWith("status: 431 "));
+}
+
+TEST_F(SCGIConnectionTest, CanSeekInBody) {
+  app_.Post("/seek", std::make_unique<wf::FProcessor>(
+    [](wf::RequestPtr req, wf::ResponsePtr res) {
+    std::istream& body = *req->Stream();
+    body.seekg(2);
+    std::string rest(std::istreambuf_iterator<char>(body), {});
+    res->End(rest).IgnoreError();
+    return absl::OkStatus();
+  }));
+
+  wf::SCGIConnection connection(&app_, options_);
+  connection.Receive(MakeRequest({
+    {"SCGI", "1"},
+    {"REQUEST_METHOD", "POST"},
+    {"PATH_INFO", "/seek"},
+  }, "abcde"));
+
+  EXPECT_THAT(TakeOutput(&connection), testing::EndsWith("\r\n\r\ncde"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,447 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: server.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::Server on top of wf::EventLoop.
+//
+
+#include "webforge/serve/server.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <memory>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/file_io_pool.h"
+#include "webforge/serve/event_loop.h"
+#include "webforge/serve/io_uring_driver.h"
+#include "webforge/serve/socket.h"
+#include "webforge/serve/timer_wheel.h"
+
+namespace wf {
+
+namespace {
+
+// Size of the stack buffer that socket reads go through.
+const std::size_t kReadSize = 16 * 1024;
+
+// Upper bound on how much is read from one client before moving on to the next
+// ready descriptor, so one fast client can't starve the rest.
+const std::size_t kMaxReadPerEvent = 256 * 1024;
+
+}
+
+const FileRange* Connection::OutputFile() const {
+  return nullptr;
+}
+
+void Connection::SentFile(std::size_t n) {
+  // Nothing to do.
+}
+
+bool Connection::WantsInput() const {
+  return true;
+}
+
+bool Connection::HasOutput() const {
+  return !Output().empty() || OutputFile() != nullptr;
+}
+
+Server::Server(absl::string_view address, const ListenOptions& listen_options,
+               ConnectionFactory factory, IOBackend backend,
+               absl::Duration idle_timeout) :
+  address_(address), listen_options_(listen_options),
+  factory_(std::move(factory)), backend_(backend),
+  idle_timeout_(idle_timeout), listen_fd_(-1), timer_fd_(-1),
+  accept_paused_(false), receiving_fd_(-1) {
+  // Nothing to do.
+}
+
+Server::~Server() {
+  for (auto& it : clients_) {
+    close(it.first);
+  }
+
+  // Closes the driver's clients before the listening socket goes away.
+  driver_ = nullptr;
+
+  if (timer_fd_ >= 0) {
+    close(timer_fd_);
+  }
+
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+  }
+}
+
+absl::Status Server::Listen() {
+  absl::StatusOr<int> fd = wf::Listen(address_, listen_options_);
+  if (!fd.ok()) {
+    return fd.status();
+  }
+  listen_fd_ = fd.value();
+
+  if (backend_ != IOBackend::kEpoll) {
+    absl::StatusOr<std::unique_ptr<IOUringDriver>> driver =
+      IOUringDriver::Create(listen_fd_, factory_, idle_timeout_);
+    if (driver.ok()) {
+      driver_ = std::move(driver.value());
+      return absl::OkStatus();
+    }
+
+    if (backend_ == IOBackend::kIOUring) {
+      return driver.status();
+    }
+
+    // kAuto falls back to epoll.
+  }
+
+  absl::StatusOr<std::unique_ptr<EventLoop>> loop = EventLoop::Create();
+  if (!loop.ok()) {
+    return loop.status();
+  }
+  loop_ = std::move(loop.value());
+
+  if (idle_timeout_ != absl::InfiniteDuration()) {
+    idle_timers_ = TimerWheel::ForTimeout(idle_timeout_, MonotonicNow());
+
+    absl::StatusOr<int> timer_fd = CreateTickTimer(idle_timers_->Tick());
+    if (!timer_fd.ok()) {
+      return timer_fd.status();
+    }
+    timer_fd_ = timer_fd.value();
+
+    absl::Status s = loop_->Add(timer_fd_, EPOLLIN, [this](uint32_t events) {
+      OnTimer();
+    });
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  return loop_->Add(listen_fd_, EPOLLIN, [this](uint32_t events) {
+    OnAccept();
+  });
+}
+
+const std::string& Server::Address() const {
+  return address_;
+}
+
+uint16_t Server::Port() const {
+  sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  if (listen_fd_ < 0 ||
+      getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+    return 0;
+  }
+
+  if (addr.ss_family == AF_INET) {
+    return ntohs(reinterpret_cast<sockaddr_in*>(&addr)->sin_port);
+  } else if (addr.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port);
+  }
+
+  return 0;
+}
+
+absl::Status Server::Run() {
+  // Static handlers finish their requests on this thread once the file I/O
+  // they handed off is done.
+  if (driver_) {
+    IOUringDriver* driver = driver_.get();
+    FileIOPool::ScopedExecutor executor([driver](FileIOPool::Task task) {
+      driver->Post(std::move(task));
+    });
+
+    return driver_->Run();
+  }
+
+  if (!loop_) {
+    return absl::FailedPreconditionError("server is not listening");
+  }
+
+  EventLoop* loop = loop_.get();
+  FileIOPool::ScopedExecutor executor([loop](FileIOPool::Task task) {
+    loop->Post(std::move(task));
+  });
+
+  return loop_->Run();
+}
+
+void Server::Stop() {
+  if (driver_) {
+    driver_->Stop();
+  } else if (loop_) {
+    loop_->Stop();
+  }
+}
+
+void Server::OnAccept() {
+  while (true) {
+    absl::StatusOr<int> fd = Accept(listen_fd_);
+    if (!fd.ok()) {
+      if (absl::IsUnavailable(fd.status())) {
+        return;
+      }
+
+      if (accept_reserve_.Recover(listen_fd_, fd.status())) {
+        continue;
+      }
+
+      // The listening socket stays readable for as long as the connection is
+      // queued, so stop watching it until a descriptor is freed.
+      if (loop_->Modify(listen_fd_, 0).ok()) {
+        accept_paused_ = true;
+      }
+
+      return;
+    }
+
+    int client_fd = fd.value();
+    Client& client = clients_[client_fd];
+    client.connection = factory_();
+    client.events = EPOLLIN | EPOLLRDHUP;
+    client.eof = false;
+    client.paused = false;
+
+    // Output is sent right away, so that a response flushed while it is being
+    // produced reaches the client early. Everything else waits for Flush():
+    // this is called from deep inside the connection, which Flush() may
+    // destroy, so it runs on the next iteration, or after Receive() returns.
+    client.connection->OnOutput([this, client_fd]() {
+      auto it = clients_.find(client_fd);
+      if (it != clients_.end()) {
+        Send(client_fd, &it->second);
+      }
+
+      if (client_fd != receiving_fd_) {
+        loop_->Post([this, client_fd]() {
+          Flush(client_fd);
+        });
+      }
+    });
+
+    absl::Status s = loop_->Add(client_fd, client.events,
+                                [this, client_fd](uint32_t events) {
+      OnClientEvent(client_fd, events);
+    });
+    if (!s.ok()) {
+      clients_.erase(client_fd);
+      close(client_fd);
+      continue;
+    }
+
+    if (idle_timers_) {
+      idle_timers_->Schedule(client_fd, idle_timeout_);
+    }
+  }
+}
+
+void Server::OnClientEvent(int fd, uint32_t events) {
+  auto it = clients_.find(fd);
+  if (it == clients_.end()) {
+    return;
+  }
+  Connection* connection = it->second.connection.get();
+
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    // Nothing we write now could reach the client anyway.
+    Close(fd);
+    return;
+  }
+
+  if (idle_timers_) {
+    // Every event means the client is making progress one way or another.
+    idle_timers_->Schedule(fd, idle_timeout_);
+  }
+
+  if (events & (EPOLLIN | EPOLLRDHUP)) {
+    char buffer[kReadSize];
+    std::size_t total = 0;
+    receiving_fd_ = fd;
+
+    while (total < kMaxReadPerEvent && connection->WantsInput()) {
+      ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        total += n;
+        connection->Receive(absl::string_view(buffer, n));
+        continue;
+      }
+
+      if (n == 0) {
+        connection->ReceiveEOF();
+        it->second.eof = true;
+        break;
+      }
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        receiving_fd_ = -1;
+        Close(fd);
+        return;
+      }
+
+      break;
+    }
+
+    receiving_fd_ = -1;
+  }
+
+  Flush(fd);
+}
+
+void Server::OnTimer() {
+  uint64_t expirations;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) < 0) {
+    // Spurious wakeup. Advancing the wheel is harmless either way.
+  }
+
+  // Descriptors may also have been freed by something other than our clients.
+  ResumeAccept();
+
+  idle_timers_->Advance(MonotonicNow(), [this](uint64_t key) {
+    int fd = static_cast<int>(key);
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) {
+      return;
+    }
+
+    if (it->second.connection->Busy()) {
+      idle_timers_->Schedule(fd, idle_timeout_);
+      return;
+    }
+
+    Close(fd);
+  });
+}
+
+bool Server::Send(int fd, Client* client) {
+  Connection* connection = client->connection.get();
+  while (connection->HasOutput()) {
+    absl::string_view output = connection->Output();
+    ssize_t n;
+    if (!output.empty()) {
+      n = send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+      if (n >= 0) {
+        connection->Sent(n);
+        continue;
+      }
+    } else {
+      const FileRange* range = connection->OutputFile();
+      off_t offset = range->offset;
+      n = sendfile(fd, range->file->Descriptor(), &offset, range->length);
+      if (n == 0) {
+        // The file was truncated since it was opened, and the length it was
+        // promised with can't be kept anymore.
+        return false;
+      }
+
+      if (n > 0) {
+        connection->SentFile(n);
+        continue;
+      }
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+
+  return true;
+}
+
+void Server::Flush(int fd) {
+  auto it = clients_.find(fd);
+  if (it == clients_.end()) {
+    return;
+  }
+  Client& client = it->second;
+
+  if (!Send(fd, &client)) {
+    Close(fd);
+    return;
+  }
+
+  if (client.paused && client.connection->WantsInput()) {
+    // Sending made room, so the connection may go on with buffered requests.
+    client.paused = false;
+    receiving_fd_ = fd;
+    client.connection->Receive(absl::string_view());
+    receiving_fd_ = -1;
+
+    if (!Send(fd, &client)) {
+      Close(fd);
+      return;
+    }
+  }
+
+  if (client.connection->Done()) {
+    Close(fd);
+    return;
+  }
+
+  // Only ask for EPOLLOUT while there is something to write, and stop asking
+  // for EPOLLIN after EOF or while the connection wants no input, otherwise the
+  // loop would spin on a descriptor that is always ready.
+  client.paused = !client.connection->WantsInput();
+  uint32_t events = client.eof || client.paused ? 0 : EPOLLIN | EPOLLRDHUP;
+  if (client.connection->HasOutput()) {
+    events |= EPOLLOUT;
+  }
+
+  if (events != client.events && loop_->Modify(fd, events).ok()) {
+    client.events = events;
+  }
+}
+
+void Server::Close(int fd) {
+  if (idle_timers_) {
+    idle_timers_->Cancel(fd);
+  }
+
+  loop_->Remove(fd);
+  clients_.erase(fd);
+  close(fd);
+  ResumeAccept();
+}
+
+void Server::ResumeAccept() {
+  if (accept_paused_ && loop_->Modify(listen_fd_, EPOLLIN).ok()) {
+    accept_paused_ = false;
+  }
+}
+
+}
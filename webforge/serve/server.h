@@ -0,0 +1,223 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: server.h
+// -----------------------------------------------------------------------------
+//
+// This file declares the two halves shared by every persistent serve target:
+//
+// - wf::Connection is the protocol side. It speaks one protocol (HTTP/1.1,
+//   FastCGI, ...) for a single client, without doing any I/O itself. Bytes
+//   read from the client go in through Receive(), and bytes to be sent come out
+//   of Output(), along with any files from OutputFile().
+// - wf::Server is the I/O side. It owns a listening socket and a wf::EventLoop,
+//   accepts clients, creates a wf::Connection for each one, and shuttles bytes
+//   between sockets and connections.
+//
+// Adding a new protocol therefore only means writing a new wf::Connection.
+//
+// wf::Server can move bytes with either of two I/O backends (see IOBackend).
+// The protocol side is the same for both. Either way, while Run() is running,
+// file I/O that handlers hand to a wf::FileIOPool comes back to the server's
+// thread to finish.
+//
+
+#ifndef WEBFORGE_SERVE_SERVER_H_
+#define WEBFORGE_SERVE_SERVER_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/serve/event_loop.h"
+#include "webforge/serve/output_queue.h"
+#include "webforge/serve/socket.h"
+#include "webforge/serve/timer_wheel.h"
+
+namespace wf {
+
+class Connection {
+public:
+  virtual ~Connection() = default;
+
+  // Hands bytes read from the client to the connection.
+  //
+  // Every request that is complete after appending `data` is dispatched before
+  // this method returns.
+  virtual void Receive(absl::string_view data) = 0;
+
+  // Tells the connection that the client will not send anything else.
+  virtual void ReceiveEOF() = 0;
+
+  // Returns the bytes that are waiting to be sent to the client.
+  virtual absl::string_view Output() const = 0;
+
+  // Drops the first `n` bytes of Output(), after they have been sent.
+  virtual void Sent(std::size_t n) = 0;
+
+  // Keeps the bytes returned by Output() where they are until the next call to
+  // Sent(), for backends that send straight from them after this returns.
+  // Output produced in the meantime is queued after them.
+  virtual void HoldOutput() = 0;
+
+  // Returns the file range to send once Output() is empty, or nullptr if there
+  // is none. Output() only returns what comes before the file, and continues
+  // with whatever follows it once the file has been sent.
+  //
+  // Connections that never send files don't need to override this.
+  virtual const FileRange* OutputFile() const;
+
+  // Drops the first `n` bytes of OutputFile(), after they have been sent.
+  virtual void SentFile(std::size_t n);
+
+  // Returns true if there are bytes or a file waiting to be sent.
+  bool HasOutput() const;
+
+  // Returns true when all output has been sent and the socket should be
+  // closed.
+  virtual bool Done() const = 0;
+
+  // Returns true if the connection will be Done() as soon as Output() has been
+  // sent, i.e. it won't produce anything else and no file follows.
+  virtual bool DoneAfterOutput() const = 0;
+
+  // Returns false while the connection has buffered as much as it is willing
+  // to, in which case the server stops reading from the client. Once it returns
+  // true again, the server calls Receive() with no data, so that the connection
+  // can go on with whatever it had buffered.
+  //
+  // Connections that never hold back input don't need to override this.
+  virtual bool WantsInput() const;
+
+  // Returns true while the application is still producing a response. Busy
+  // connections are exempt from the idle timeout, since the client has no
+  // reason to send anything in the meantime.
+  virtual bool Busy() const = 0;
+
+  // Sets a function called when output is produced outside of Receive(), e.g.
+  // by a response that ended asynchronously, or when output should go out
+  // before Receive() returns, e.g. a response that was flushed halfway through.
+  // Must be called on the thread that runs the server.
+  virtual void OnOutput(std::function<void()> on_output) = 0;
+};
+
+// How a wf::Server waits for and performs socket I/O.
+enum class IOBackend {
+  // epoll(7) readiness notifications with a recv()/send() call per operation.
+  // Works everywhere.
+  kEpoll,
+
+  // io_uring(7) completions (see io_uring_driver.h), which need far fewer
+  // system calls. Requires Linux 5.19 or newer.
+  kIOUring,
+
+  // kIOUring if the kernel supports it, kEpoll otherwise.
+  kAuto,
+};
+
+class IOUringDriver;
+
+class Server {
+public:
+  using ConnectionFactory = std::function<std::unique_ptr<Connection>()>;
+
+  // Creates a server that listens on `address` (see wf::Listen) and uses
+  // `factory` to create a wf::Connection for each accepted client.
+  //
+  // Clients that aren't Busy() and haven't sent or received anything for
+  // `idle_timeout` are disconnected. This covers both keep-alive connections
+  // that are done, and clients that trickle in a request or stop reading their
+  // response.
+  Server(absl::string_view address, const ListenOptions& listen_options,
+         ConnectionFactory factory, IOBackend backend = IOBackend::kEpoll,
+         absl::Duration idle_timeout = absl::InfiniteDuration());
+  virtual ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Binds the listening socket and sets up the I/O backend.
+  absl::Status Listen();
+
+  const std::string& Address() const;
+
+  // Returns the TCP port the server is bound to, which is useful when binding
+  // to port 0. Returns 0 if the server isn't listening on a TCP socket.
+  uint16_t Port() const;
+
+  // Handles connections until Stop() is called. Listen() must have succeeded.
+  absl::Status Run();
+
+  // Makes Run() return. Thread-safe.
+  void Stop();
+
+private:
+  struct Client {
+    std::unique_ptr<Connection> connection;
+    uint32_t events;  // What the event loop is watching for
+    bool eof;
+    bool paused;  // Not reading, because the connection doesn't want input
+  };
+
+  void OnAccept();
+  void OnClientEvent(int fd, uint32_t events);
+  void OnTimer();
+
+  // Resumes watching the listening socket after OnAccept() stopped it.
+  void ResumeAccept();
+
+  // Sends as much pending output as the socket takes. Returns false if the
+  // socket failed.
+  bool Send(int fd, Client* client);
+
+  // Sends as much pending output as the socket takes, and closes the client if
+  // it is done.
+  void Flush(int fd);
+  void Close(int fd);
+
+  std::string address_;
+  ListenOptions listen_options_;
+  ConnectionFactory factory_;
+  IOBackend backend_;
+  absl::Duration idle_timeout_;
+  int listen_fd_;
+  int timer_fd_;  // Advances idle_timers_, if there is an idle timeout
+
+  // Exactly one of these is set once listening.
+  std::unique_ptr<EventLoop> loop_;
+  std::unique_ptr<IOUringDriver> driver_;
+
+  // Connections are shed through this when descriptors run out. If even that
+  // fails, the listening socket is left alone until a client is closed.
+  AcceptReserve accept_reserve_;
+  bool accept_paused_;
+
+  absl::flat_hash_map<int, Client> clients_;
+  int receiving_fd_;  // The client whose input is being handled, if any
+  std::unique_ptr<TimerWheel> idle_timers_;  // Keyed by descriptor
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_SERVER_H_
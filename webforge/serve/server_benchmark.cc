@@ -0,0 +1,205 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: server_benchmark.cc
+// -----------------------------------------------------------------------------
+//
+// Measures how HTTP throughput scales with the number of workers, for each I/O
+// backend. Each run starts one wf::HTTPServer per worker on the same
+// SO_REUSEPORT address and drives them over loopback with two keep-alive
+// clients per worker.
+//
+// Run with:
+//   bazel run -c opt //webforge/serve:server_benchmark
+//
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include <benchmark/benchmark.h>
+
+#include "webforge/http/http.h"
+#include "webforge/serve/http.h"
+#include "webforge/serve/workers.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+namespace {
+
+constexpr int kRequestsPerClient = 200;
+constexpr absl::string_view kRequest = "GET / HTTP/1.1\r\nHost: bench\r\n\r\n";
+constexpr absl::string_view kBody = "Hello, world!\n";
+
+int Connect(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+// Sends requests one at a time and waits for each response.
+bool RunClient(int fd) {
+  char buffer[4096];
+  for (int i = 0; i < kRequestsPerClient; ++i) {
+    if (send(fd, kRequest.data(), kRequest.size(), MSG_NOSIGNAL) < 0) {
+      return false;
+    }
+
+    std::string response;
+    while (!absl::EndsWith(response, kBody)) {
+      ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        return false;
+      }
+
+      response.append(buffer, n);
+    }
+  }
+
+  return true;
+}
+
+void BM_HTTPWorkers(benchmark::State& state) {
+  int workers = state.range(0);
+  auto backend = static_cast<wf::IOBackend>(state.range(1));
+
+  wf::Application app;
+  app.Get("/", std::make_unique<wf::FProcessor>(
+    [](wf::RequestPtr req, wf::ResponsePtr res) {
+    res->Header("Content-Type", "text/plain");
+    res->End(kBody).IgnoreError();
+    return absl::OkStatus();
+  }));
+
+  wf::HTTPServerOptions options;
+  options.address = "127.0.0.1:0";
+  options.workers.count = workers;
+  options.backend = backend;
+
+  // The first server picks a free port, and the others join it.
+  std::vector<std::unique_ptr<wf::HTTPServer>> servers;
+  for (int i = 0; i < workers; ++i) {
+    servers.push_back(std::make_unique<wf::HTTPServer>(&app, options));
+    absl::Status s = servers.back()->Listen();
+    if (!s.ok()) {
+      state.SkipWithError(s.ToString().c_str());
+      return;
+    }
+
+    options.address = absl::StrCat("127.0.0.1:", servers[0]->Port());
+  }
+
+  std::vector<std::thread> threads;
+  for (auto& server : servers) {
+    wf::HTTPServer* s = server.get();
+    threads.emplace_back([s]() {
+      s->Run().IgnoreError();
+    });
+  }
+
+  std::vector<int> clients;
+  for (int i = 0; i < workers * 2; ++i) {
+    clients.push_back(Connect(servers[0]->Port()));
+  }
+
+  bool ok = true;
+  for (auto _ : state) {
+    std::vector<std::thread> client_threads;
+    std::vector<char> results(clients.size());
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+      client_threads.emplace_back([&clients, &results, i]() {
+        results[i] = clients[i] >= 0 && RunClient(clients[i]);
+      });
+    }
+
+    for (auto& thread : client_threads) {
+      thread.join();
+    }
+
+    for (char result : results) {
+      ok = ok && result;
+    }
+  }
+
+  for (int fd : clients) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  for (auto& server : servers) {
+    server->Stop();
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (!ok) {
+    state.SkipWithError("a client failed");
+    return;
+  }
+
+  state.SetItemsProcessed(state.iterations() * clients.size() *
+                          kRequestsPerClient);
+}
+
+// 1, 2, 4, ... workers, up to one per CPU, with each backend.
+void WorkerCounts(benchmark::internal::Benchmark* b) {
+  wf::WorkerOptions all_cpus;
+  all_cpus.count = 0;
+  int max = wf::WorkerCount(all_cpus);
+
+  b->ArgNames({"workers", "backend"});
+  for (auto backend : {wf::IOBackend::kEpoll, wf::IOBackend::kIOUring}) {
+    for (int workers = 1; workers < max; workers *= 2) {
+      b->Args({workers, static_cast<int64_t>(backend)});
+    }
+
+    b->Args({max, static_cast<int64_t>(backend)});
+  }
+}
+
+}
+
+BENCHMARK(BM_HTTPWorkers)->Apply(WorkerCounts)->UseRealTime();
+
+BENCHMARK_MAIN();
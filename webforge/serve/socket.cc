@@ -0,0 +1,283 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: socket.cc
+// -----------------------------------------------------------------------------
+//
+// Implements the listening socket helpers shared by persistent serve targets.
+//
+
+#include "webforge/serve/socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+namespace {
+
+absl::StatusOr<int> ListenUnix(absl::string_view path,
+                               const ListenOptions& options) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("invalid unix socket path '%s'", path)
+    );
+  }
+  memcpy(addr.sun_path, path.data(), path.size());
+
+  if (options.reuse_port) {
+    // Each socket would unlink the previous one's file instead.
+    return absl::InvalidArgumentError(
+      "SO_REUSEPORT is not supported on unix sockets"
+    );
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "socket() failed");
+  }
+
+  // A stale socket file from a previous run would make bind() fail.
+  unlink(addr.sun_path);
+
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "bind() failed");
+    close(fd);
+    return s;
+  }
+
+  if (listen(fd, options.backlog) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "listen() failed");
+    close(fd);
+    return s;
+  }
+
+  return fd;
+}
+
+absl::StatusOr<int> ListenTCP(absl::string_view address,
+                              const ListenOptions& options) {
+  auto pos = address.rfind(':');
+  if (pos == absl::string_view::npos) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("listen address '%s' has no port", address)
+    );
+  }
+
+  absl::string_view host = address.substr(0, pos);
+  absl::string_view port = address.substr(pos + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host.remove_prefix(1);
+    host.remove_suffix(1);
+  }
+
+  int port_number;
+  if (!absl::SimpleAtoi(port, &port_number) ||
+      port_number < 0 || port_number > 65535) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("invalid port '%s'", port)
+    );
+  }
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+  std::string host_string(host);
+  std::string port_string(port);
+  addrinfo* results = nullptr;
+  int res = getaddrinfo((host.empty() || host == "*") ? nullptr
+                                                      : host_string.c_str(),
+                        port_string.c_str(), &hints, &results);
+  if (res != 0) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("failed to resolve '%s': %s", host, gai_strerror(res))
+    );
+  }
+
+  absl::Status last_error = absl::NotFoundError("no usable address");
+  int fd = -1;
+  for (addrinfo* ai = results; ai != nullptr; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0) {
+      last_error = absl::ErrnoToStatus(errno, "socket() failed");
+      continue;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (options.reuse_port &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+      last_error = absl::ErrnoToStatus(errno, "SO_REUSEPORT failed");
+      close(fd);
+      fd = -1;
+      continue;
+    }
+
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+      last_error = absl::ErrnoToStatus(errno, "bind() failed");
+      close(fd);
+      fd = -1;
+      continue;
+    }
+
+    if (listen(fd, options.backlog) < 0) {
+      last_error = absl::ErrnoToStatus(errno, "listen() failed");
+      close(fd);
+      fd = -1;
+      continue;
+    }
+
+    break;
+  }
+  freeaddrinfo(results);
+
+  if (fd < 0) {
+    return last_error;
+  }
+
+  return fd;
+}
+
+}
+
+absl::StatusOr<int> Listen(absl::string_view address,
+                           const ListenOptions& options) {
+  if (address.find("unix:") == 0) {
+    address.remove_prefix(5);
+    return ListenUnix(address, options);
+  }
+
+  return ListenTCP(address, options);
+}
+
+absl::StatusOr<int> Accept(int listen_fd) {
+  int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return absl::UnavailableError("no pending connections");
+    }
+
+    return absl::ErrnoToStatus(errno, "accept4() failed");
+  }
+
+  // Responses are usually written in one go, so there is no point in letting
+  // Nagle's algorithm hold back the tail end of them. This fails harmlessly on
+  // UNIX domain sockets.
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  return fd;
+}
+
+absl::Status SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) {
+    return absl::ErrnoToStatus(errno, "fcntl(F_GETFL) failed");
+  }
+
+  if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    return absl::ErrnoToStatus(errno, "fcntl(F_SETFL) failed");
+  }
+
+  return absl::OkStatus();
+}
+
+AcceptReserve::AcceptReserve() :
+  fd_(open("/dev/null", O_RDONLY | O_CLOEXEC)),
+  last_log_(absl::InfinitePast()), suppressed_(0) {
+  // Nothing to do.
+}
+
+AcceptReserve::~AcceptReserve() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool AcceptReserve::Recover(int listen_fd, const absl::Status& error) {
+  if (absl::IsUnavailable(error)) {
+    // EAGAIN, or ECONNABORTED when the client gave up before we got to it.
+    return true;
+  }
+
+  Log(error);
+  if (!absl::IsResourceExhausted(error)) {
+    return true;
+  }
+
+  if (fd_ < 0) {
+    // Lost the last time around. Maybe a descriptor has been freed since.
+    fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+
+  close(fd_);
+  int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  int accept_errno = errno;
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  return fd >= 0 || accept_errno == EAGAIN || accept_errno == EWOULDBLOCK;
+}
+
+void AcceptReserve::Log(const absl::Status& error) {
+  absl::Time now = absl::Now();
+  if (now - last_log_ < absl::Seconds(1)) {
+    ++suppressed_;
+    return;
+  }
+
+  std::cerr << "accept failed: " << error;
+  if (suppressed_ > 0) {
+    std::cerr << " (and " << suppressed_ << " more)";
+  }
+  std::cerr << std::endl;
+
+  last_log_ = now;
+  suppressed_ = 0;
+}
+
+}
@@ -0,0 +1,103 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: socket.h
+// -----------------------------------------------------------------------------
+//
+// This file declares a small set of helpers for creating listening sockets.
+// Every persistent serve target (i.e. everything that isn't CGI) needs to bind
+// a socket, make it non-blocking, and accept connections from it, so those
+// steps live here instead of being repeated in each one.
+//
+// Listen addresses are written as strings, either "host:port" for TCP, or
+// "unix:/path/to/socket" for UNIX domain sockets. IPv6 hosts must be wrapped in
+// square brackets, e.g. "[::1]:8080".
+//
+
+#ifndef WEBFORGE_SERVE_SOCKET_H_
+#define WEBFORGE_SERVE_SOCKET_H_
+
+#include <cstddef>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+// Parameters that control how a listening socket is created.
+struct ListenOptions {
+  // Maximum length of the queue of pending connections (see listen(2)).
+  int backlog = 1024;
+
+  // Sets SO_REUSEPORT, allowing several sockets (usually one per
+  // worker) to bind to the same address while the kernel balances incoming
+  // connections between them. Only supported for TCP.
+  bool reuse_port = false;
+};
+
+// Creates a non-blocking, close-on-exec socket listening on `address`.
+//
+// Existing UNIX domain socket files are unlinked before binding. On success,
+// the caller owns the returned file descriptor.
+absl::StatusOr<int> Listen(absl::string_view address,
+                           const ListenOptions& options = ListenOptions());
+
+// Accepts one pending connection from a listening socket.
+//
+// The returned descriptor is non-blocking and close-on-exec. If there are no
+// pending connections, an absl::UnavailableError is returned.
+absl::StatusOr<int> Accept(int listen_fd);
+
+// Sets O_NONBLOCK on a file descriptor.
+absl::Status SetNonBlocking(int fd);
+
+// Deals with errors from accepting connections on behalf of a server.
+//
+// A connection that can't be accepted because the process or the system ran
+// out of file descriptors (EMFILE, ENFILE) stays queued, and keeps the
+// listening socket readable, so a server that simply tried again would spin
+// until some other descriptor is closed. Instead, an AcceptReserve keeps a
+// descriptor in reserve, which it gives up to accept the pending connection and
+// close it right away.
+//
+// Not thread-safe; each server has its own.
+class AcceptReserve {
+public:
+  AcceptReserve();
+  ~AcceptReserve();
+
+  AcceptReserve(const AcceptReserve&) = delete;
+  AcceptReserve& operator=(const AcceptReserve&) = delete;
+
+  // Handles `error` from accepting a connection on `listen_fd`, logging it at
+  // most once a second. Returns true if the server may go on accepting
+  // connections, or false if it should wait until it has closed a descriptor of
+  // its own, e.g. because there was no descriptor in reserve either.
+  bool Recover(int listen_fd, const absl::Status& error);
+
+private:
+  void Log(const absl::Status& error);
+
+  int fd_;  // Reserved descriptor, or -1
+  absl::Time last_log_;
+  std::size_t suppressed_;  // Errors not logged since last_log_
+};
+
+}
+
+#endif  // WEBFORGE_SERVE_SOCKET_H_
@@ -0,0 +1,172 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: timer_wheel.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::TimerWheel.
+//
+
+#include "webforge/serve/timer_wheel.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+TimerWheel::TimerWheel(absl::Duration tick, std::size_t slots,
+                       absl::Time now) :
+  tick_(tick), start_(now), current_(0), slots_(slots) {
+  // Nothing to do.
+}
+
+std::unique_ptr<TimerWheel> TimerWheel::ForTimeout(absl::Duration timeout,
+                                                   absl::Time now) {
+  absl::Duration tick = std::min(timeout / 4, absl::Seconds(1));
+  if (tick <= absl::ZeroDuration()) {
+    tick = absl::Milliseconds(1);
+  }
+
+  absl::Duration remainder;
+  std::size_t slots = absl::IDivDuration(timeout, tick, &remainder) + 2;
+  return std::make_unique<TimerWheel>(tick, slots, now);
+}
+
+void TimerWheel::Schedule(uint64_t key, absl::Duration timeout) {
+  auto it = positions_.find(key);
+  if (it != positions_.end()) {
+    Remove(it->second);
+  }
+
+  // The current tick has already partially passed, so a timer that is rounded
+  // down to it could expire early.
+  int64_t ticks = absl::ToInt64Nanoseconds(absl::Ceil(timeout, tick_)) /
+                  absl::ToInt64Nanoseconds(tick_);
+  uint64_t expiry = current_ + (ticks > 0 ? ticks : 0) + 1;
+
+  std::size_t slot = expiry % slots_.size();
+  positions_[key] = Position{slot, slots_[slot].size()};
+  slots_[slot].push_back(Timer{key, expiry});
+}
+
+void TimerWheel::Cancel(uint64_t key) {
+  auto it = positions_.find(key);
+  if (it == positions_.end()) {
+    return;
+  }
+
+  Remove(it->second);
+  positions_.erase(it);
+}
+
+void TimerWheel::Advance(absl::Time now,
+                         const std::function<void(uint64_t)>& expired) {
+  if (now < start_) {
+    return;
+  }
+
+  absl::Duration remainder;
+  uint64_t target = absl::IDivDuration(now - start_, tick_, &remainder);
+  std::vector<uint64_t> keys;
+
+  while (current_ < target) {
+    ++current_;
+    if (positions_.empty()) {
+      // Nothing can expire, so skip straight to the end.
+      current_ = target;
+      break;
+    }
+
+    std::size_t slot = current_ % slots_.size();
+    std::vector<Timer>& timers = slots_[slot];
+    for (std::size_t i = 0; i < timers.size();) {
+      if (timers[i].expiry > current_) {
+        // Due on a later revolution.
+        ++i;
+        continue;
+      }
+
+      keys.push_back(timers[i].key);
+      positions_.erase(timers[i].key);
+      Remove(Position{slot, i});
+    }
+
+    // Only called now, since the callbacks may modify the slot.
+    for (uint64_t key : keys) {
+      expired(key);
+    }
+    keys.clear();
+  }
+}
+
+std::size_t TimerWheel::Size() const {
+  return positions_.size();
+}
+
+absl::Duration TimerWheel::Tick() const {
+  return tick_;
+}
+
+void TimerWheel::Remove(const Position& position) {
+  // Swap with the last timer of the slot, so removal doesn't shift anything.
+  std::vector<Timer>& timers = slots_[position.slot];
+  if (position.index + 1 != timers.size()) {
+    timers[position.index] = timers.back();
+    positions_[timers[position.index].key].index = position.index;
+  }
+
+  timers.pop_back();
+}
+
+absl::StatusOr<int> CreateTickTimer(absl::Duration tick) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "timerfd_create() failed");
+  }
+
+  itimerspec spec;
+  spec.it_interval = absl::ToTimespec(tick);
+  spec.it_value = spec.it_interval;
+  if (timerfd_settime(fd, 0, &spec, nullptr) < 0) {
+    absl::Status s = absl::ErrnoToStatus(errno, "timerfd_settime() failed");
+    close(fd);
+    return s;
+  }
+
+  return fd;
+}
+
+absl::Time MonotonicNow() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return absl::TimeFromTimespec(ts);
+}
+
+}
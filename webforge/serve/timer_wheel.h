@@ -0,0 +1,110 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: timer_wheel.h
+// -----------------------------------------------------------------------------
+//
+// wf::TimerWheel keeps track of a large number of coarse timeouts, such as the
+// idle timeout of every client connection of a wf::Server. Timers are hashed
+// into a ring of slots by the tick they expire on, so scheduling, rescheduling
+// and cancelling a timer are all O(1), and advancing the wheel only looks at
+// the slots of the ticks that have passed.
+//
+// Timeouts longer than one revolution of the wheel are supported; their timers
+// are simply passed over until the right revolution comes around.
+//
+// A TimerWheel is not thread-safe.
+//
+
+#ifndef WEBFORGE_SERVE_TIMER_WHEEL_H_
+#define WEBFORGE_SERVE_TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+
+namespace wf {
+
+class TimerWheel {
+public:
+  // Creates a wheel of `slots` slots that advances in steps of `tick`, which
+  // is also the precision of its timers. The wheel's clock starts at `now`.
+  TimerWheel(absl::Duration tick, std::size_t slots, absl::Time now);
+
+  // Creates a wheel for timers that all use the same `timeout`. Its ticks are
+  // a quarter of `timeout`, but at most a second, and one revolution covers
+  // `timeout`, so no timer is ever passed over.
+  static std::unique_ptr<TimerWheel> ForTimeout(absl::Duration timeout,
+                                                absl::Time now);
+
+  // Starts a timer for `key` that expires `timeout` from the wheel's current
+  // time, rounded up to a whole tick. Replaces any timer `key` already had.
+  void Schedule(uint64_t key, absl::Duration timeout);
+
+  // Stops the timer for `key`, if there is one.
+  void Cancel(uint64_t key);
+
+  // Moves the wheel's clock forward to `now`, and calls `expired` with the key
+  // of every timer that expired on the way. `expired` may schedule and cancel
+  // timers, including the one that just expired.
+  void Advance(absl::Time now, const std::function<void(uint64_t)>& expired);
+
+  // Returns the number of timers that are scheduled.
+  std::size_t Size() const;
+
+  absl::Duration Tick() const;
+
+private:
+  struct Timer {
+    uint64_t key;
+    uint64_t expiry;  // Tick the timer expires on
+  };
+
+  // Where a timer lives in slots_.
+  struct Position {
+    std::size_t slot;
+    std::size_t index;
+  };
+
+  void Remove(const Position& position);
+
+  absl::Duration tick_;
+  absl::Time start_;
+  uint64_t current_;  // Ticks since start_ that have been processed
+
+  std::vector<std::vector<Timer>> slots_;
+  absl::flat_hash_map<uint64_t, Position> positions_;
+};
+
+// Creates a timerfd(2) that becomes readable every `tick`, for advancing a
+// TimerWheel from an event loop. The caller owns the descriptor.
+absl::StatusOr<int> CreateTickTimer(absl::Duration tick);
+
+// Returns the time of CLOCK_MONOTONIC, which tick timers run on, for creating
+// and advancing a TimerWheel. Unlike absl::Now(), it never jumps when the
+// system clock is set, but only differences between its values mean anything.
+absl::Time MonotonicNow();
+
+}
+
+#endif  // WEBFORGE_SERVE_TIMER_WHEEL_H_
@@ -0,0 +1,108 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: timer_wheel_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::TimerWheel against a fake clock.
+//
+
+#include "webforge/serve/timer_wheel.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "absl/time/time.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+class TimerWheelTest : public testing::Test {
+protected:
+  TimerWheelTest() : start_(absl::FromUnixSeconds(1000)),
+    wheel_(absl::Seconds(1), 8, start_) {
+    // Nothing to do.
+  }
+
+  // Advances the wheel to `seconds` after start_, and returns what expired.
+  std::vector<uint64_t> AdvanceTo(int seconds) {
+    std::vector<uint64_t> expired;
+    wheel_.Advance(start_ + absl::Seconds(seconds), [&expired](uint64_t key) {
+      expired.push_back(key);
+    });
+
+    return expired;
+  }
+
+  absl::Time start_;
+  wf::TimerWheel wheel_;
+};
+
+TEST_F(TimerWheelTest, ExpiresTimersOnTime) {
+  wheel_.Schedule(1, absl::Seconds(2));
+  wheel_.Schedule(2, absl::Seconds(4));
+
+  // Timers never expire early, and at most one tick late.
+  EXPECT_TRUE(AdvanceTo(2).empty());
+  EXPECT_THAT(AdvanceTo(3), testing::ElementsAre(1));
+  EXPECT_THAT(AdvanceTo(10), testing::ElementsAre(2));
+  EXPECT_EQ(wheel_.Size(), 0);
+}
+
+TEST_F(TimerWheelTest, CanRescheduleAndCancel) {
+  wheel_.Schedule(1, absl::Seconds(2));
+  wheel_.Schedule(2, absl::Seconds(2));
+  wheel_.Schedule(3, absl::Seconds(2));
+  wheel_.Cancel(2);
+
+  AdvanceTo(1);
+  wheel_.Schedule(1, absl::Seconds(2));
+
+  EXPECT_THAT(AdvanceTo(3), testing::ElementsAre(3));
+  EXPECT_THAT(AdvanceTo(4), testing::ElementsAre(1));
+  EXPECT_EQ(wheel_.Size(), 0);
+}
+
+TEST_F(TimerWheelTest, HandlesTimeoutsLongerThanOneRevolution) {
+  // 8 slots of a second each, so this lands in the same slot as a 2s timeout.
+  wheel_.Schedule(1, absl::Seconds(10));
+  wheel_.Schedule(2, absl::Seconds(2));
+
+  EXPECT_THAT(AdvanceTo(3), testing::ElementsAre(2));
+  EXPECT_TRUE(AdvanceTo(10).empty());
+  EXPECT_THAT(AdvanceTo(11), testing::ElementsAre(1));
+}
+
+TEST_F(TimerWheelTest, CallbacksCanReschedule) {
+  wheel_.Schedule(1, absl::Seconds(1));
+
+  int fired = 0;
+  for (int second = 1; second <= 6; ++second) {
+    wheel_.Advance(start_ + absl::Seconds(second), [&](uint64_t key) {
+      ++fired;
+      wheel_.Schedule(key, absl::Seconds(1));
+    });
+  }
+
+  // Expires at 2s, 4s and 6s.
+  EXPECT_EQ(fired, 3);
+  EXPECT_EQ(wheel_.Size(), 1);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
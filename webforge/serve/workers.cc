@@ -0,0 +1,251 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: workers.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::RunWorkers with std::thread or fork(2).
+//
+
+#include "webforge/serve/workers.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+#include "webforge/serve/server.h"
+
+namespace wf {
+
+namespace {
+
+// Returns the CPUs the calling process may run on.
+std::vector<int> AllowedCPUs() {
+  std::vector<int> cpus;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+
+  return cpus;
+}
+
+// Pins the calling thread to one CPU.
+absl::Status PinToCPU(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  // On Linux, pid 0 means the calling thread rather than the whole process.
+  if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+    return absl::ErrnoToStatus(errno,
+                               absl::StrFormat("failed to pin to CPU %d", cpu));
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status ListenServer(Server* server) {
+  absl::Status s = server->Listen();
+  if (!s.ok()) {
+    return absl::Status(s.code(), absl::StrCat("failed to listen on ",
+                                               server->Address(), ": ",
+                                               s.message()));
+  }
+
+  return absl::OkStatus();
+}
+
+// Runs one server on the calling thread.
+absl::Status RunWorker(const ServerFactory& factory, int cpu) {
+  if (cpu >= 0) {
+    absl::Status s = PinToCPU(cpu);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  std::unique_ptr<Server> server = factory();
+  absl::Status s = ListenServer(server.get());
+  if (!s.ok()) {
+    return s;
+  }
+
+  return server->Run();
+}
+
+absl::Status RunThreads(int count, const std::vector<int>& cpus,
+                        const ServerFactory& factory) {
+  // Listen on this thread so that a bad address is reported before any worker
+  // has started.
+  std::vector<std::unique_ptr<Server>> servers;
+  for (int i = 0; i < count; ++i) {
+    servers.push_back(factory());
+
+    absl::Status s = ListenServer(servers.back().get());
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  absl::Mutex mutex;
+  absl::Status result;  // Guarded by mutex
+  std::vector<std::thread> threads;
+  for (int i = 0; i < count; ++i) {
+    int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+
+    threads.emplace_back([&, i, cpu]() {
+      absl::Status s = cpu >= 0 ? PinToCPU(cpu) : absl::OkStatus();
+      if (s.ok()) {
+        s = servers[i]->Run();
+      }
+
+      // One worker stopping stops them all.
+      {
+        absl::MutexLock lock(&mutex);
+        if (result.ok()) {
+          result = s;
+        }
+      }
+
+      for (auto& server : servers) {
+        server->Stop();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  absl::MutexLock lock(&mutex);
+  return result;
+}
+
+absl::Status RunProcesses(int count, const std::vector<int>& cpus,
+                          const ServerFactory& factory) {
+  std::vector<pid_t> children;
+  for (int i = 0; i < count; ++i) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      absl::Status s = absl::ErrnoToStatus(errno, "fork() failed");
+      for (pid_t child : children) {
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+      }
+
+      return s;
+    }
+
+    if (pid == 0) {
+      // The server is created after forking, because an epoll instance created
+      // before fork() would be shared by every child.
+      absl::Status s = RunWorker(factory,
+                                 cpus.empty() ? -1 : cpus[i % cpus.size()]);
+      if (!s.ok()) {
+        std::cerr << "worker " << i << ": " << s << std::endl;
+      }
+
+      _exit(s.ok() ? 0 : 1);
+    }
+
+    children.push_back(pid);
+  }
+
+  // One worker stopping stops them all.
+  int status = 0;
+  pid_t stopped;
+  do {
+    stopped = waitpid(-1, &status, 0);
+  } while (stopped < 0 && errno == EINTR);
+
+  for (pid_t child : children) {
+    if (child != stopped) {
+      kill(child, SIGTERM);
+    }
+  }
+
+  for (pid_t child : children) {
+    if (child != stopped) {
+      while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {
+        // Retry.
+      }
+    }
+  }
+
+  if (stopped < 0) {
+    return absl::ErrnoToStatus(errno, "waitpid() failed");
+  }
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    return absl::InternalError(absl::StrFormat("worker process %d failed",
+                                               stopped));
+  }
+
+  return absl::OkStatus();
+}
+
+}
+
+int WorkerCount(const WorkerOptions& options) {
+  if (options.count > 0) {
+    return options.count;
+  }
+
+  int cpus = AllowedCPUs().size();
+  return cpus > 0 ? cpus : 1;
+}
+
+absl::Status RunWorkers(const WorkerOptions& options,
+                        const ServerFactory& factory) {
+  int count = WorkerCount(options);
+
+  std::vector<int> cpus;
+  if (options.pin_cpus) {
+    cpus = AllowedCPUs();
+  }
+
+  if (options.prefork) {
+    return RunProcesses(count, cpus, factory);
+  }
+
+  if (count == 1) {
+    return RunWorker(factory, cpus.empty() ? -1 : cpus[0]);
+  }
+
+  return RunThreads(count, cpus, factory);
+}
+
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: workers.h
+// -----------------------------------------------------------------------------
+//
+// A single wf::Server only ever uses one core, because its wf::EventLoop runs
+// on one thread. wf::RunWorkers scales a serve target across cores by running
+// several independent servers ("workers") side by side, either as threads or
+// as forked processes.
+//
+// Workers share nothing on the request path. Each one binds its own listening
+// socket to the same address with SO_REUSEPORT, so the kernel spreads new
+// connections between them, and each one runs its own event loop. The
+// wf::Application and its wf::Renderer are shared, which is safe because
+// renders don't modify either.
+//
+// SO_REUSEPORT only exists for TCP, so several workers can't listen on a UNIX
+// domain socket.
+//
+
+#ifndef WEBFORGE_SERVE_WORKERS_H_
+#define WEBFORGE_SERVE_WORKERS_H_
+
+#include <functional>
+#include <memory>
+
+#include "absl/status/status.h"
+
+#include "webforge/serve/server.h"
+
+namespace wf {
+
+// Parameters that control how many servers are run, and how.
+struct WorkerOptions {
+  // Number of workers. 0 means one per CPU the process may run on.
+  int count = 1;
+
+  // Runs each worker in a forked process instead of a thread. Processes don't
+  // even share a heap, at the cost of not sharing caches either.
+  bool prefork = false;
+
+  // Pins worker i to the i-th CPU the process may run on, which keeps each
+  // event loop's data in one core's caches.
+  bool pin_cpus = false;
+};
+
+// Returns the number of workers `options` asks for, resolving a count of 0.
+int WorkerCount(const WorkerOptions& options);
+
+// Creates the wf::Server run by one worker.
+using ServerFactory = std::function<std::unique_ptr<Server>()>;
+
+// Runs WorkerCount(options) servers created by `factory` until one of them
+// stops. With more than one worker, `factory` has to create servers whose
+// ListenOptions set reuse_port.
+//
+// A single thread-based worker runs on the calling thread.
+absl::Status RunWorkers(const WorkerOptions& options,
+                        const ServerFactory& factory);
+
+}
+
+#endif  // WEBFORGE_SERVE_WORKERS_H_
@@ -0,0 +1,229 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: workers_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::RunWorkers by running several wf::HTTPServers on one
+// loopback port and talking to them as a client would.
+//
+
+#include "webforge/serve/workers.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "webforge/http/http.h"
+#include "webforge/serve/http.h"
+#include "webforge/serve/server.h"
+#include "webforge/site/application.h"
+#include "webforge/site/processor.h"
+
+namespace {
+
+// How many connections to try before giving up on every worker seeing one. The
+// kernel picks a worker by hashing each connection's addresses, so a few dozen
+// are plenty.
+const int kMaxConnections = 200;
+
+// Sends a request on a new connection to `port`, and returns the response, or
+// an empty string if the connection failed.
+std::string Fetch(in_port_t port, absl::string_view path) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  timeval timeout = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = port;
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    close(fd);
+    return "";
+  }
+
+  std::string request = absl::StrCat("GET ", path, " HTTP/1.1\r\n"
+                                     "Host: localhost\r\n"
+                                     "Connection: close\r\n\r\n");
+  send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+  std::string response;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, n);
+  }
+
+  close(fd);
+  return response;
+}
+
+}
+
+class WorkersTest : public testing::Test {
+protected:
+  void SetUp() override {
+    app_.Get("/", std::make_unique<wf::FProcessor>(
+      [this](wf::RequestPtr req, wf::ResponsePtr res) {
+      {
+        absl::MutexLock lock(&mutex_);
+        threads_.insert(std::this_thread::get_id());
+      }
+
+      res->Header("Content-Type", "text/plain");
+      res->End("Hello, world!").IgnoreError();
+      return absl::OkStatus();
+    }));
+
+    // Stopping from a worker's own thread means no server can be destroyed
+    // while it is being stopped.
+    app_.Get("/stop", std::make_unique<wf::FProcessor>(
+      [this](wf::RequestPtr req, wf::ResponsePtr res) {
+      absl::MutexLock lock(&mutex_);
+      for (wf::Server* server : servers_) {
+        server->Stop();
+      }
+
+      res->End("").IgnoreError();
+      return absl::OkStatus();
+    }));
+  }
+
+  void TearDown() override {
+    if (reserved_fd_ >= 0) {
+      close(reserved_fd_);
+    }
+  }
+
+  // Picks a free loopback port that sockets with SO_REUSEPORT can share. The
+  // port stays reserved by a socket that is bound but never listens, so it
+  // doesn't take any of the connections.
+  in_port_t ReservePort() {
+    reserved_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(reserved_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(reserved_fd_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) < 0 ||
+        getsockname(reserved_fd_, reinterpret_cast<sockaddr*>(&address),
+                    &length) < 0) {
+      return 0;
+    }
+
+    return address.sin_port;
+  }
+
+  // Returns a factory for servers that speak HTTP as `options` say, and
+  // remembers each server so that /stop can stop them.
+  wf::ServerFactory Factory(const wf::HTTPServerOptions& options) {
+    return [this, options]() {
+      auto server = std::make_unique<wf::HTTPServer>(&app_, options);
+
+      absl::MutexLock lock(&mutex_);
+      servers_.push_back(server.get());
+      return server;
+    };
+  }
+
+  wf::Application app_;
+  int reserved_fd_ = -1;
+
+  absl::Mutex mutex_;
+  std::vector<wf::Server*> servers_ ABSL_GUARDED_BY(mutex_);
+  std::set<std::thread::id> threads_ ABSL_GUARDED_BY(mutex_);
+};
+
+TEST_F(WorkersTest, ThreadsShareAPort) {
+  in_port_t port = ReservePort();
+  ASSERT_NE(port, 0);
+
+  wf::HTTPServerOptions options;
+  options.address = absl::StrCat("127.0.0.1:", ntohs(port));
+  options.workers.count = 2;
+
+  absl::Status result;
+  std::thread runner([&]() {
+    result = wf::RunWorkers(options.workers, Factory(options));
+  });
+
+  // Connections are refused until the workers are listening.
+  int handled = 0;
+  for (int i = 0; i < kMaxConnections; ++i) {
+    std::string response = Fetch(port, "/");
+    if (response.empty()) {
+      absl::SleepFor(absl::Milliseconds(10));
+      continue;
+    }
+
+    EXPECT_THAT(response, testing::StartsWith("HTTP/1.1 200 OK\r\n"));
+    EXPECT_THAT(response, testing::EndsWith("\r\n\r\nHello, world!"));
+    ++handled;
+
+    absl::MutexLock lock(&mutex_);
+    if (threads_.size() == 2) {
+      break;
+    }
+  }
+
+  EXPECT_GT(handled, 0);
+  {
+    absl::MutexLock lock(&mutex_);
+    EXPECT_EQ(servers_.size(), 2);
+    EXPECT_EQ(threads_.size(), 2);
+  }
+
+  // One worker stopping stops them all.
+  Fetch(port, "/stop");
+  runner.join();
+  EXPECT_TRUE(result.ok()) << result;
+}
+
+TEST_F(WorkersTest, RejectsSeveralWorkersOnAUnixSocket) {
+  wf::HTTPServerOptions options;
+  options.address = absl::StrCat("unix:", testing::TempDir(), "/workers.sock");
+  options.workers.count = 2;
+
+  absl::Status result = wf::RunWorkers(options.workers, Factory(options));
+  EXPECT_EQ(result.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_THAT(result.message(), testing::HasSubstr("SO_REUSEPORT"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -24,11 +24,16 @@
 
 #include <filesystem>
 #include <memory>
+#include <utility>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 
+#include "webforge/core/asset_map.h"
 #include "webforge/core/renderer.h"
+#include "webforge/core/template_cache.h"
+#include "webforge/core/template_watcher.h"
 #include "webforge/http/http.h"
 #include "webforge/site/middleware.h"
 
@@ -63,6 +68,29 @@ void Application::Post(absl::string_view path, std::unique_ptr<Middleware> mw) {
   router_.Post(path, std::move(mw));
 }
 
+void Application::UseAssetMap(std::shared_ptr<const AssetMap> assets) {
+  renderer_->UseAssetMap(std::move(assets));
+}
+
+void Application::UseTemplateCache(std::shared_ptr<const TemplateCache> cache) {
+  renderer_->UseTemplateCache(std::move(cache));
+}
+
+absl::Status Application::WatchTemplates() {
+  if (template_watcher_ != nullptr) {
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<std::unique_ptr<TemplateWatcher>> watcher =
+    TemplateWatcher::Create(renderer_);
+  if (!watcher.ok()) {
+    return watcher.status();
+  }
+
+  template_watcher_ = std::move(watcher.value());
+  return absl::OkStatus();
+}
+
 void Application::Error(absl::StatusCode code,
                         std::unique_ptr<Middleware> mw) {
   router_.Error(code, std::move(mw));
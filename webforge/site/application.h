@@ -32,7 +32,10 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 
+#include "webforge/core/asset_map.h"
 #include "webforge/core/renderer.h"
+#include "webforge/core/template_cache.h"
+#include "webforge/core/template_watcher.h"
 #include "webforge/http/http.h"
 #include "webforge/site/middleware.h"
 #include "webforge/site/router.h"
@@ -53,6 +56,22 @@ public:
   void Post(std::unique_ptr<Middleware> mw);
   void Post(absl::string_view path, std::unique_ptr<Middleware> mw);
 
+  // Makes the `asset()` template function of the wf::Renderer resolve names
+  // through `assets`. Must be called before requests are handled.
+  void UseAssetMap(std::shared_ptr<const AssetMap> assets);
+
+  // Keeps parsed templates in `cache`, so that later processes load them
+  // instead of parsing them again. Worth it for CGI, where every request is a
+  // new process. Must be called before requests are handled.
+  void UseTemplateCache(std::shared_ptr<const TemplateCache> cache);
+
+  // Reloads templates when they change on disk (see wf::TemplateWatcher), for
+  // as long as the Application exists. Meant for long-running servers.
+  //
+  // The watcher is a thread of the calling process, so workers that are
+  // forked afterwards (see WorkerOptions::prefork) don't see changes.
+  absl::Status WatchTemplates();
+
   // Specifies a handler for when Middleware next's with an error code.
   //
   // See wf::Router::Error
@@ -70,7 +89,10 @@ public:
 
 private:
   Router router_;
+
+  // Shared by every thread that handles requests.
   std::shared_ptr<Renderer> renderer_;
+  std::unique_ptr<TemplateWatcher> template_watcher_;
 };
 
 }
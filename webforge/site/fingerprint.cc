@@ -0,0 +1,129 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fingerprint.cc
+// -----------------------------------------------------------------------------
+//
+// This file implements fingerprinting on top of wf::ScanStaticDirectory, whose
+// ETags double as content hashes.
+//
+
+#include "webforge/site/fingerprint.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+#include "webforge/core/asset_map.h"
+#include "webforge/site/static_cache.h"
+#include "webforge/site/static_manifest.h"
+
+namespace wf {
+
+namespace {
+
+// Hex digits of the content hash that go into a name. 32 bits are plenty to
+// tell the versions of one asset apart.
+constexpr std::size_t kFingerprintSize = 8;
+
+absl::Status Rename(const std::filesystem::path& from,
+                    const std::filesystem::path& to) {
+  std::error_code ec;
+  std::filesystem::rename(from, to, ec);
+  if (ec) {
+    return absl::ErrnoToStatus(ec.value(), absl::StrCat("cannot rename ",
+                                                        from.string()));
+  }
+
+  return absl::OkStatus();
+}
+
+}
+
+std::string FingerprintedName(absl::string_view name,
+                              absl::string_view fingerprint) {
+  // Only the last path segment has an extension, and a leading dot (as in
+  // ".htaccess") doesn't start one.
+  std::size_t slash = name.rfind('/');
+  std::size_t base = slash == absl::string_view::npos ? 0 : slash + 1;
+  std::size_t dot = name.rfind('.');
+  if (dot == absl::string_view::npos || dot <= base) {
+    return absl::StrCat(name, ".", fingerprint);
+  }
+
+  return absl::StrCat(name.substr(0, dot), ".", fingerprint, name.substr(dot));
+}
+
+absl::StatusOr<AssetMap> FingerprintStaticDirectory(
+  const std::filesystem::path& dir) {
+  absl::StatusOr<std::vector<ManifestEntry>> entries =
+    ScanStaticDirectory(dir);
+  if (!entries.ok()) {
+    return entries.status();
+  }
+
+  AssetMap map;
+  for (const ManifestEntry& entry : entries.value()) {
+    // ETags are a quoted hex hash.
+    std::string fingerprint = entry.etag.substr(1, kFingerprintSize);
+
+    // A file that already carries its fingerprint was renamed by an earlier
+    // run; map the name it had back then.
+    std::string infix = absl::StrCat(".", fingerprint);
+    std::size_t pos = entry.path.rfind(infix);
+    if (pos != std::string::npos) {
+      std::string original = entry.path.substr(0, pos) +
+                             entry.path.substr(pos + infix.size());
+      if (FingerprintedName(original, fingerprint) == entry.path) {
+        map.Add(original, entry.path);
+        continue;
+      }
+    }
+
+    std::string fingerprinted = FingerprintedName(entry.path, fingerprint);
+    absl::Status s = Rename(dir / entry.path, dir / fingerprinted);
+    if (!s.ok()) {
+      return s;
+    }
+
+    for (const ManifestVariant& variant : entry.variants) {
+      for (const StaticEncoding& encoding : StaticEncodings()) {
+        if (encoding.coding != variant.coding) {
+          continue;
+        }
+
+        s = Rename(dir / absl::StrCat(entry.path, encoding.suffix),
+                   dir / absl::StrCat(fingerprinted, encoding.suffix));
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+
+    map.Add(entry.path, fingerprinted);
+  }
+
+  return map;
+}
+
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fingerprint.h
+// -----------------------------------------------------------------------------
+//
+// Fingerprinting renames static assets so that their names carry a hash of
+// their content ("app.css" becomes "app.3f9a1c2b.css"). A fingerprinted URL
+// never changes content, so wf::StaticMiddleware lets browsers and CDNs cache
+// it forever, and templates pick up new versions through the `asset()`
+// function (see wf::AssetMap).
+//
+// This is a build step, run by `webforge fingerprint <dir>`.
+//
+
+#ifndef WEBFORGE_SITE_FINGERPRINT_H_
+#define WEBFORGE_SITE_FINGERPRINT_H_
+
+#include <filesystem>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+#include "webforge/core/asset_map.h"
+
+namespace wf {
+
+// Returns `name` with `fingerprint` inserted before its extension, if any.
+std::string FingerprintedName(absl::string_view name,
+                              absl::string_view fingerprint);
+
+// Renames every file in `dir` to its fingerprinted name, along with its
+// precompressed siblings (see wf::StaticEncodings), and returns the map from
+// the old names to the new ones. Files that are already fingerprinted are left
+// alone, but are still mapped, so running this twice is harmless.
+absl::StatusOr<AssetMap> FingerprintStaticDirectory(
+  const std::filesystem::path& dir);
+
+}
+
+#endif  // WEBFORGE_SITE_FINGERPRINT_H_
@@ -0,0 +1,79 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: fingerprint_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests fingerprinting static directories and the maps it emits.
+//
+
+#include "webforge/site/fingerprint.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include <gtest/gtest.h>
+
+#include "webforge/core/asset_map.h"
+
+TEST(FingerprintTest, InsertsFingerprintBeforeExtension) {
+  EXPECT_EQ(wf::FingerprintedName("app.css", "3f9a1c2b"), "app.3f9a1c2b.css");
+  EXPECT_EQ(wf::FingerprintedName("js/app.min.js", "3f9a1c2b"),
+            "js/app.min.3f9a1c2b.js");
+  EXPECT_EQ(wf::FingerprintedName("LICENSE", "3f9a1c2b"), "LICENSE.3f9a1c2b");
+  EXPECT_EQ(wf::FingerprintedName("v1.2/.htaccess", "3f9a1c2b"),
+            "v1.2/.htaccess.3f9a1c2b");
+}
+
+TEST(FingerprintTest, RenamesFilesAndSiblings) {
+  std::filesystem::path dir =
+    std::filesystem::path(testing::TempDir()) / "fingerprint_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "css");
+  std::ofstream(dir / "css" / "app.css") << "body {}";
+  std::ofstream(dir / "css" / "app.css.gz") << "gzipped";
+
+  absl::StatusOr<wf::AssetMap> map = wf::FingerprintStaticDirectory(dir);
+  ASSERT_TRUE(map.ok());
+
+  std::string url = map->URL("css/app.css");
+  ASSERT_NE(url, "/css/app.css");
+  std::string name = url.substr(1);
+  EXPECT_TRUE(map->IsFingerprinted(name));
+  EXPECT_FALSE(map->IsFingerprinted("css/app.css"));
+  EXPECT_TRUE(std::filesystem::exists(dir / name));
+  EXPECT_TRUE(std::filesystem::exists(dir / (name + ".gz")));
+  EXPECT_FALSE(std::filesystem::exists(dir / "css" / "app.css"));
+
+  // A second run finds the same names without renaming anything.
+  absl::StatusOr<wf::AssetMap> again = wf::FingerprintStaticDirectory(dir);
+  ASSERT_TRUE(again.ok());
+  EXPECT_EQ(again->Serialize(), map->Serialize());
+
+  std::ofstream(dir / "assets.json") << map->Serialize();
+  absl::StatusOr<wf::AssetMap> loaded =
+    wf::AssetMap::Load(dir / "assets.json", "/static/");
+  ASSERT_TRUE(loaded.ok());
+  EXPECT_EQ(loaded->URL("css/app.css"), "/static/" + name);
+  EXPECT_EQ(loaded->URL("/img/logo.png"), "/static/img/logo.png");
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
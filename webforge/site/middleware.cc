@@ -23,20 +23,204 @@
 #include "webforge/site/middleware.h"
 
 #include <chrono>
+#include <cstddef>
 #include <string>
 #include <filesystem>
-#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 
+#include "webforge/core/asset_map.h"
+#include "webforge/http/etag.h"
+#include "webforge/http/file.h"
+#include "webforge/http/file_io_pool.h"
 #include "webforge/http/http.h"
 #include "webforge/http/strings.h"
 #include "webforge/http/date.h"
+#include "webforge/site/static_cache.h"
+#include "webforge/site/static_manifest.h"
 
 namespace wf {
 
+namespace {
+
+// Sent with fingerprinted files, whose content is tied to their name.
+constexpr char kImmutableCacheControl[] =
+  "public, max-age=31536000, immutable";
+
+// Opens a file listed in a static manifest, and checks that it is still the one
+// the manifest describes. The manifest doesn't record the mtime of
+// precompressed siblings, so `mtime` is null for those. The file is read into
+// the asset's body if `read` is set, and left open in the asset otherwise.
+absl::StatusOr<std::shared_ptr<StaticAsset>> OpenManifestAsset(
+  const std::filesystem::path& path, std::size_t size, const absl::Time* mtime,
+  absl::string_view mime_type, absl::string_view etag, bool read) {
+  absl::StatusOr<std::shared_ptr<const File>> file = File::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  if (file.value()->Size() != size ||
+      (mtime != nullptr && file.value()->ModifiedTime() != *mtime)) {
+    return absl::FailedPreconditionError(absl::StrCat(
+      path.string(), " changed since the manifest was built"));
+  }
+
+  auto asset = std::make_shared<StaticAsset>();
+  asset->size = size;
+  asset->mtime = file.value()->ModifiedTime();
+  asset->modified_time = asset->mtime;
+  asset->last_modified = asset->modified_time.Render();
+  asset->mime_type = std::string(mime_type);
+  asset->etag = std::string(etag);
+  asset->device = file.value()->Device();
+  asset->inode = file.value()->Inode();
+
+  if (!read) {
+    asset->file = std::move(file).value();
+    return asset;
+  }
+
+  asset->body.resize(size);
+  absl::StatusOr<std::size_t> n = file.value()->Read(0, size,
+                                                     asset->body.data());
+  if (!n.ok()) {
+    return n.status();
+  }
+
+  if (n.value() != size) {
+    return absl::FailedPreconditionError(absl::StrCat(
+      path.string(), " changed since the manifest was built"));
+  }
+
+  return asset;
+}
+
+// Returns the suffix of the precompressed siblings in `coding`, or an empty
+// string if it isn't one of StaticEncodings().
+absl::string_view EncodingSuffix(absl::string_view coding) {
+  for (const StaticEncoding& encoding : StaticEncodings()) {
+    if (encoding.coding == coding) {
+      return encoding.suffix;
+    }
+  }
+
+  return absl::string_view();
+}
+
+// Wraps the writer of a response, and holds its body back until it ends so that
+// an ETag can be computed for it. Gives up and passes everything through as
+// soon as the ETag can't be had cheaply.
+class ETagWriter : public ResponseWriter {
+public:
+  ETagWriter(std::shared_ptr<ResponseWriter> writer, RequestPtr req,
+             Response* res, std::size_t max_body_size) :
+    writer_(std::move(writer)), req_(std::move(req)), res_(res),
+    max_body_size_(max_body_size), passing_(false) {
+    // Nothing to do.
+  }
+
+  absl::Status WriteHead(const Response& res) override {
+    if (res.Status() != 200 || res.Headers().contains("etag")) {
+      passing_ = true;
+      return writer_->WriteHead(res);
+    }
+
+    // Held back until End(), when the ETag is known.
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    if (passing_) {
+      return writer_->WriteChunk(chunk);
+    }
+
+    body_.append(chunk.data(), chunk.size());
+    if (body_.size() > max_body_size_) {
+      return PassThrough();
+    }
+
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteFile(std::shared_ptr<const File> file, off_t offset,
+                         std::size_t length) override {
+    if (!passing_ && body_.size() + length <= max_body_size_) {
+      // Read into body_ through WriteChunk().
+      return ResponseWriter::WriteFile(std::move(file), offset, length);
+    }
+
+    if (!passing_) {
+      absl::Status s = PassThrough();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+
+    return writer_->WriteFile(std::move(file), offset, length);
+  }
+
+  absl::Status Flush() override {
+    if (!passing_) {
+      absl::Status s = PassThrough();
+      if (!s.ok()) {
+        return s;
+      }
+    }
+
+    return writer_->Flush();
+  }
+
+  void End() override {
+    if (!passing_) {
+      std::string etag = StrongETag(body_);
+      res_->Header("ETag", etag);
+
+      if (NotModified(*req_, etag, nullptr)) {
+        res_->Status(304);
+        writer_->WriteHead(*res_).IgnoreError();
+      } else {
+        // The whole body is at hand, so the writer needn't frame it.
+        res_->Header("Content-Length", std::to_string(body_.size()));
+        if (writer_->WriteHead(*res_).ok()) {
+          writer_->WriteChunk(body_).IgnoreError();
+        }
+      }
+    }
+
+    writer_->End();
+  }
+
+private:
+  // Sends the head and whatever was held back, and passes everything else
+  // through from now on.
+  absl::Status PassThrough() {
+    passing_ = true;
+    absl::Status s = writer_->WriteHead(*res_);
+    if (s.ok() && !body_.empty()) {
+      s = writer_->WriteChunk(body_);
+    }
+
+    std::string().swap(body_);
+    return s;
+  }
+
+  std::shared_ptr<ResponseWriter> writer_;
+  RequestPtr req_;
+  Response* res_;  // Owns this writer
+  std::size_t max_body_size_;
+  bool passing_;
+  std::string body_;
+};
+
+}
+
 Middleware::Middleware() {
   // Nothing to do.
 }
@@ -52,8 +236,12 @@ void FMiddleware::operator()(RequestPtr req, ResponsePtr res,
 }
 
 StaticMiddleware::StaticMiddleware(const std::filesystem::path& dir,
-                                   absl::string_view base) :
-  dir_(dir), base_(base) {
+                                   absl::string_view base,
+                                   std::shared_ptr<StaticCache> cache,
+                                   std::shared_ptr<const AssetMap> assets) :
+  dir_(dir), base_(base),
+  cache_(cache != nullptr ? std::move(cache) : StaticCache::Shared()),
+  assets_(std::move(assets)) {
   if (base_.back() != '/') {
     base_.push_back('/');
   }
@@ -113,75 +301,252 @@ void StaticMiddleware::operator()(RequestPtr req, ResponsePtr res,
   }
 
   // Okay, now path is safe.
-  uintmax_t file_size;
-  wf::HTTPDate mtime;
+  bool immutable = assets_ != nullptr &&
+                   assets_->IsFingerprinted(truncated_path);
+
+  cache_->GetAsync(path, [this, immutable, req, res, next](
+    absl::StatusOr<StaticFile> file) {
+    if (absl::IsNotFound(file.status()) ||
+        absl::IsFailedPrecondition(file.status())) {
+      // The file doesn't exist, or isn't a regular file, we'll have to next
+      next(absl::OkStatus());
+      return;
+    }
 
-  if (!std::filesystem::exists(path)) {
-    // The file doesn't exist, we'll have to next
-    next(absl::OkStatus());
-    return;
+    if (!file.ok()) {
+      next(absl::InternalError("failed to open static file"));
+      return;
+    }
+
+    if (immutable) {
+      res->Header("Cache-Control", kImmutableCacheControl);
+    }
+
+    cache_->Send(file.value(), *req, res.get());
+  });
+}
+
+absl::StatusOr<std::unique_ptr<ManifestStaticMiddleware>>
+ManifestStaticMiddleware::Create(const std::filesystem::path& manifest,
+                                 const std::filesystem::path& dir,
+                                 absl::string_view base,
+                                 const ManifestStaticOptions& options) {
+  absl::StatusOr<std::unique_ptr<StaticManifest>> index =
+    StaticManifest::Open(manifest);
+  if (!index.ok()) {
+    return index.status();
   }
 
-  if (!std::filesystem::is_regular_file(path)) {
-    next(absl::OkStatus());
-    return;
+  // Whether a file of `size` bytes still fits in memory. Files that don't are
+  // closed again once checked, and opened by Open() when requested.
+  std::size_t bytes = 0;
+  auto fits = [&](std::size_t size) {
+    if (size > options.max_file_size || size > options.max_bytes - bytes) {
+      return false;
+    }
+
+    bytes += size;
+    return true;
+  };
+
+  std::vector<Asset> assets(index.value()->Size());
+  for (std::size_t i = 0; i < assets.size(); ++i) {
+    ManifestEntry entry = index.value()->Entry(i);
+    assets[i].path = dir / entry.path;
+
+    absl::StatusOr<std::shared_ptr<StaticAsset>> asset =
+      OpenManifestAsset(assets[i].path, entry.size, &entry.mtime,
+                        entry.mime_type, entry.etag, fits(entry.size));
+    if (!asset.ok()) {
+      return asset.status();
+    }
+
+    asset.value()->file = nullptr;
+
+    for (const ManifestVariant& variant : entry.variants) {
+      absl::string_view suffix = EncodingSuffix(variant.coding);
+      if (suffix.empty()) {
+        // Built by a version that knew of more encodings.
+        continue;
+      }
+
+      absl::StatusOr<std::shared_ptr<StaticAsset>> compressed =
+        OpenManifestAsset(absl::StrCat(assets[i].path.string(), suffix),
+                          variant.size, nullptr, entry.mime_type, variant.etag,
+                          fits(variant.size));
+      if (!compressed.ok()) {
+        return compressed.status();
+      }
+
+      compressed.value()->file = nullptr;
+      asset.value()->encodings.push_back(variant.coding);
+      assets[i].variants.push_back(std::move(compressed).value());
+    }
+
+    assets[i].asset = std::move(asset).value();
   }
 
-  try {
-    file_size = std::filesystem::file_size(path);
-  } catch (...) {
-    next(absl::InternalError("file_size threw"));
+  return std::unique_ptr<ManifestStaticMiddleware>(
+    new ManifestStaticMiddleware(std::move(index).value(), std::move(assets),
+                                 base, options));
+}
+
+ManifestStaticMiddleware::ManifestStaticMiddleware(
+  std::unique_ptr<StaticManifest> manifest, std::vector<Asset> assets,
+  absl::string_view base, const ManifestStaticOptions& options) :
+  manifest_(std::move(manifest)), assets_(std::move(assets)), base_(base),
+  options_(options),
+  io_pool_(options.io_pool != nullptr ? options.io_pool
+                                      : FileIOPool::Shared()) {
+  if (base_.back() != '/') {
+    base_.push_back('/');
+  }
+}
+
+void ManifestStaticMiddleware::Open(std::size_t index, std::size_t variant,
+                                    std::shared_ptr<const StaticAsset> asset,
+                                    OpenCallback done) {
+  if (asset->body.size() == asset->size) {
+    done(std::move(asset));
     return;
   }
 
-  try {
-    mtime = std::filesystem::last_write_time(path);
-  } catch (...) {
-    next(absl::InternalError("last_write_time threw"));
+  OpenKey key(index, variant);
+  std::shared_ptr<const StaticAsset> open;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = open_.find(key);
+    if (it != open_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      open = it->second.asset;
+    }
+  }
+
+  if (open != nullptr) {
+    done(std::move(open));
     return;
   }
 
-  res->Header("Content-Length", std::to_string(file_size));
-  res->Header("Content-Type", GetMimeType(path.string()));
-  res->Header("Last-Modified", mtime.Render());
-
-  if (req->Header("If-Modified-Since").status().ok()) {
-    absl::StatusOr<HTTPDate> ims_date = wf::HTTPDate::FromString(
-      req->Header("If-Modified-Since").value());
-    
-    // If the time data is malformed, we don't care. Don't error out here.
-    if (ims_date.ok()) {
-      if (mtime <= ims_date.value()) {
-        // Client has a cached copy of this file already.
-        res->Status(304);
-        res->End();
-        return;
-      }
+  std::filesystem::path path = assets_[index].path;
+  if (variant > 0) {
+    path += std::string(EncodingSuffix(
+      assets_[index].asset->encodings[variant - 1]));
+  }
+
+  // Opening a file can block on a slow disk, which would hold up every other
+  // connection of the event loop, so it happens on the pool.
+  auto opened =
+    std::make_shared<absl::StatusOr<std::shared_ptr<StaticAsset>>>();
+  io_pool_->Run([path, asset, opened]() {
+    *opened = OpenManifestAsset(path, asset->size, &asset->mtime,
+                                asset->mime_type, asset->etag, false);
+  }, [this, key, asset, opened, done = std::move(done)]() {
+    if (!opened->ok()) {
+      done(opened->status());
+      return;
     }
+
+    opened->value()->encodings = asset->encodings;
+    done(KeepOpen(key, std::move(opened->value())));
+  });
+}
+
+std::shared_ptr<const StaticAsset> ManifestStaticMiddleware::KeepOpen(
+  const OpenKey& key, std::shared_ptr<const StaticAsset> opened) {
+  absl::MutexLock lock(&mutex_);
+  auto [it, inserted] = open_.try_emplace(key);
+  if (inserted) {
+    lru_.push_front(key);
+    it->second.asset = std::move(opened);
+    it->second.lru = lru_.begin();
+  } else {
+    // Another request opened it in the meantime.
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+  }
+
+  // Files that are still being sent stay open until their responses are done
+  // with them.
+  std::shared_ptr<const StaticAsset> result = it->second.asset;
+  while (lru_.size() > options_.max_open_files) {
+    open_.erase(lru_.back());
+    lru_.pop_back();
   }
 
-  std::ifstream file(path);
-  if (!file.is_open()) {
-    next(absl::InternalError("failed to open static file"));
+  return result;
+}
+
+void ManifestStaticMiddleware::operator()(RequestPtr req, ResponsePtr res,
+                                          Middleware::NextFn next) {
+  if (req->Path().find(base_) != 0) {
+    next(absl::OkStatus());
+    return;
+  }
+
+  absl::string_view path = req->Path();
+  path.remove_prefix(base_.size());
+  while (!path.empty() && path.front() == '/') {
+    path.remove_prefix(1);
+  }
+
+  // Only paths that are in the manifest are ever served, so there is no way to
+  // escape the directory.
+  std::size_t index;
+  if (!manifest_->Find(path, &index)) {
+    next(absl::OkStatus());
     return;
   }
 
-  res->WriteHead().IgnoreError();
+  if (req->Method() != CaseInsensitive("GET") &&
+      req->Method() != CaseInsensitive("HEAD")) {
+    next(absl::UnavailableError("must use GET or HEAD for resource"));
+    return;
+  }
 
-  // Read file 4KB at a time.
-  const std::size_t buffer_size = 4096;
-  std::string buffer(buffer_size, 0x00);
-  do {
-    file.read(buffer.data(), buffer_size);
+  const Asset& asset = assets_[index];
+  std::size_t variant = 0;
+  std::string encoding;
+  absl::StatusOr<const std::string> accept = req->Header("Accept-Encoding");
+  if (!asset.variants.empty() && accept.ok()) {
+    encoding = ChooseEncoding(accept.value(), asset.asset->encodings);
+    for (std::size_t i = 0; i < asset.variants.size(); ++i) {
+      if (asset.asset->encodings[i] == encoding) {
+        variant = i + 1;
+      }
+    }
+  }
 
-    absl::string_view buf_sv(buffer);
-    buf_sv.remove_suffix(buffer_size - file.gcount());
+  Open(index, variant, variant == 0 ? asset.asset : asset.variants[variant - 1],
+       [this, index, variant, encoding, req, res, next](
+         absl::StatusOr<std::shared_ptr<const StaticAsset>> body) {
+    if (!body.ok()) {
+      next(absl::InternalError("failed to open static file"));
+      return;
+    }
 
-    res->Write(buf_sv).IgnoreError();
-  } while (!file.eof());
+    if (variant == 0) {
+      SendStaticAsset(*body.value(), nullptr, encoding, *req, res.get());
+    } else {
+      SendStaticAsset(*assets_[index].asset, body.value().get(), encoding,
+                      *req, res.get());
+    }
+  });
+}
 
-  res->End();
+ETagMiddleware::ETagMiddleware(std::size_t max_body_size) :
+  max_body_size_(max_body_size) {
+  // Nothing to do.
 }
 
+void ETagMiddleware::operator()(RequestPtr req, ResponsePtr res,
+                                Middleware::NextFn next) {
+  // HEAD responses have no body to compute an ETag from, and other methods
+  // can't be answered with a 304.
+  if (req->Method() == CaseInsensitive("GET") && !res->HeadWritten()) {
+    res->UseWriter(std::make_shared<ETagWriter>(res->Writer(), req, res.get(),
+                                                max_body_size_));
+  }
+
+  next(absl::OkStatus());
 }
 
+}
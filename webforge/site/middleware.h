@@ -26,14 +26,27 @@
 #ifndef WEBFORGE_SITE_MIDDLEWARE_H_
 #define WEBFORGE_SITE_MIDDLEWARE_H_
 
+#include <cstddef>
 #include <filesystem>
 #include <functional>
+#include <list>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 
+#include "webforge/core/asset_map.h"
+#include "webforge/http/file_io_pool.h"
 #include "webforge/http/http.h"
+#include "webforge/site/static_cache.h"
+#include "webforge/site/static_manifest.h"
 
 namespace wf {
 
@@ -82,14 +95,137 @@ public:
   // directory to take static files from. `base` defines a base URL path that
   // the files should be accessible at. Requests that match beyond the base will
   // have the base prefix removed before appending it to `dir`.
+  //
+  // Files are looked up in `cache`, or in StaticCache::Shared() if it is null.
+  //
+  // Files that `assets` names as fingerprinted (see fingerprint.h) never change,
+  // and are sent with a Cache-Control that lets clients keep them for a year
+  // without revalidating.
   StaticMiddleware(const std::filesystem::path& dir,
-                   absl::string_view base = "/");
+                   absl::string_view base = "/",
+                   std::shared_ptr<StaticCache> cache = nullptr,
+                   std::shared_ptr<const AssetMap> assets = nullptr);
 
   void operator()(RequestPtr req, ResponsePtr res, NextFn next) override;
 
 private:
   std::filesystem::path dir_;
   std::string base_;
+  std::shared_ptr<StaticCache> cache_;
+  std::shared_ptr<const AssetMap> assets_;
+};
+
+struct ManifestStaticOptions {
+  // Upper bound on the total size of the files read into memory up front.
+  std::size_t max_bytes = 64 * 1024 * 1024;
+
+  // Files larger than this are sent from disk instead of being read.
+  std::size_t max_file_size = 1024 * 1024;
+
+  // Upper bound on the number of files kept open to be sent from disk.
+  std::size_t max_open_files = 256;
+
+  // Opens the files that weren't read up front. Null means
+  // FileIOPool::Shared().
+  std::shared_ptr<FileIOPool> io_pool;
+};
+
+// Defines a Middleware that serves the static files listed in a prebuilt
+// manifest (see static_manifest.h), for deploys whose assets never change while
+// the server runs.
+//
+// Every file is checked against the manifest when the middleware is created,
+// and small ones are read into memory until ManifestStaticOptions::max_bytes is
+// reached. Requests for those are then answered from the manifest's perfect
+// hash table without any filesystem calls. The remaining files, along with
+// their precompressed siblings, are opened the first time they are requested:
+// on ManifestStaticOptions::io_pool, as wf::StaticMiddleware does, with the
+// request resuming on its event loop once the file is open. They are kept open
+// for the next requests in a cache of up to
+// ManifestStaticOptions::max_open_files, which closes the least recently used
+// ones. Paths that aren't in the manifest are passed on to the next handler.
+class ManifestStaticMiddleware : public Middleware {
+public:
+  using NextFn = Middleware::NextFn;
+
+  // Loads the manifest at `manifest`, which was built from `dir`, and checks
+  // every file it lists. `base` means the same as for wf::StaticMiddleware.
+  //
+  // Fails if a file is missing or has changed since the manifest was built.
+  static absl::StatusOr<std::unique_ptr<ManifestStaticMiddleware>> Create(
+    const std::filesystem::path& manifest, const std::filesystem::path& dir,
+    absl::string_view base = "/",
+    const ManifestStaticOptions& options = ManifestStaticOptions());
+
+  void operator()(RequestPtr req, ResponsePtr res, NextFn next) override;
+
+private:
+  // A file, and its precompressed siblings in the order of its encodings.
+  // Those that weren't read have neither a body nor a file (see Open()).
+  struct Asset {
+    std::filesystem::path path;
+    std::shared_ptr<const StaticAsset> asset;
+    std::vector<std::shared_ptr<const StaticAsset>> variants;
+  };
+
+  // A file that is kept open, by manifest index and variant (0 for the file
+  // itself, or 1 plus the index of its precompressed sibling).
+  using OpenKey = std::pair<std::size_t, std::size_t>;
+  struct OpenEntry {
+    std::shared_ptr<const StaticAsset> asset;
+    std::list<OpenKey>::iterator lru;  // Position in lru_
+  };
+
+  ManifestStaticMiddleware(std::unique_ptr<StaticManifest> manifest,
+                           std::vector<Asset> assets, absl::string_view base,
+                           const ManifestStaticOptions& options);
+
+  using OpenCallback = std::function<void(
+    absl::StatusOr<std::shared_ptr<const StaticAsset>>)>;
+
+  // Calls `done` with `asset` if it was read into memory. Otherwise, calls it
+  // with a copy of `asset` that carries its open file, opening it on the I/O
+  // pool first if it isn't open already.
+  void Open(std::size_t index, std::size_t variant,
+            std::shared_ptr<const StaticAsset> asset, OpenCallback done);
+
+  // Keeps `opened` open as variant `key`, unless another request opened it
+  // first, and returns whichever is kept.
+  std::shared_ptr<const StaticAsset> KeepOpen(
+    const OpenKey& key, std::shared_ptr<const StaticAsset> opened);
+
+  std::unique_ptr<StaticManifest> manifest_;
+  std::vector<Asset> assets_;  // By manifest index
+  std::string base_;
+  ManifestStaticOptions options_;
+  std::shared_ptr<FileIOPool> io_pool_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<OpenKey, OpenEntry> open_ ABSL_GUARDED_BY(mutex_);
+  std::list<OpenKey> lru_ ABSL_GUARDED_BY(mutex_);  // Most recent first
+};
+
+// Defines a Middleware that gives the responses of the handlers after it a
+// strong ETag, computed from their body, and turns them into a 304 when the
+// client's If-None-Match already names it.
+//
+// This is meant for rendered output, e.g. that of a wf::DynamicProcessor, whose
+// body can't be known without producing it: the body is held back until the
+// response ends, so only sending it is saved, not rendering it. Responses that
+// come with an ETag of their own (such as static files, which answer
+// If-None-Match before touching their body) and responses other than 200s are
+// left alone. So are bodies larger than `max_body_size`, and responses that are
+// flushed, since holding those back would defeat their purpose.
+class ETagMiddleware : public Middleware {
+public:
+  using NextFn = Middleware::NextFn;
+
+  explicit ETagMiddleware(std::size_t max_body_size = 1024 * 1024);
+
+  void operator()(RequestPtr req, ResponsePtr res, NextFn next) override;
+
+private:
+  std::size_t max_body_size_;
 };
 
 }
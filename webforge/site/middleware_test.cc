@@ -0,0 +1,205 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+//
+// -----------------------------------------------------------------------------
+// File: middleware_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::ETagMiddleware by running handlers behind it and looking
+// at what reaches the writer underneath.
+//
+
+#include "webforge/site/middleware.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include <gtest/gtest.h>
+
+#include "webforge/http/etag.h"
+#include "webforge/http/http.h"
+
+// Records what a response sends.
+class RecordingWriter : public wf::ResponseWriter {
+public:
+  absl::Status WriteHead(const wf::Response& res) override {
+    status = res.Status();
+    headers = res.Headers();
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    body.append(chunk.data(), chunk.size());
+    return absl::OkStatus();
+  }
+
+  absl::Status Flush() override {
+    ++flushes;
+    return absl::OkStatus();
+  }
+
+  void End() override {
+    ended = true;
+  }
+
+  // The value of header `name`, or "" if it wasn't sent.
+  std::string Header(const std::string& name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? "" : it->second;
+  }
+
+  int status = 0;
+  absl::flat_hash_map<std::string, std::string> headers;
+  std::string body;
+  int flushes = 0;
+  bool ended = false;
+};
+
+class ETagMiddlewareTest : public testing::Test {
+protected:
+  // Runs `handler` behind `middleware` for a request with `method` and, unless
+  // it is empty, `if_none_match`.
+  std::shared_ptr<RecordingWriter> Serve(
+    wf::ETagMiddleware* middleware, absl::string_view method,
+    absl::string_view if_none_match,
+    const std::function<void(wf::Response*)>& handler) {
+    auto req = std::make_shared<wf::Request>();
+    req->Method(method);
+    req->Path("/");
+    req->Version("HTTP/1.1");
+    if (!if_none_match.empty()) {
+      req->Header("If-None-Match", if_none_match);
+    }
+
+    auto res = std::make_shared<wf::Response>();
+    auto writer = std::make_shared<RecordingWriter>();
+    res->UseWriter(writer);
+
+    absl::Status next_status = absl::UnknownError("next wasn't called");
+    (*middleware)(req, res, [&](absl::Status s) { next_status = s; });
+    EXPECT_TRUE(next_status.ok()) << next_status;
+
+    handler(res.get());
+    EXPECT_TRUE(writer->ended);
+    return writer;
+  }
+
+  std::shared_ptr<RecordingWriter> Get(
+    wf::ETagMiddleware* middleware,
+    const std::function<void(wf::Response*)>& handler) {
+    return Serve(middleware, "GET", "", handler);
+  }
+
+  static void Hello(wf::Response* res) {
+    res->Write("Hello, ").IgnoreError();
+    res->End("world!").IgnoreError();
+  }
+};
+
+TEST_F(ETagMiddlewareTest, AddsETagTo200s) {
+  wf::ETagMiddleware middleware;
+  std::shared_ptr<RecordingWriter> writer = Get(&middleware, Hello);
+
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("etag"), wf::StrongETag("Hello, world!"));
+  EXPECT_EQ(writer->Header("content-length"), "13");
+  EXPECT_EQ(writer->body, "Hello, world!");
+}
+
+TEST_F(ETagMiddlewareTest, AnswersMatchingIfNoneMatchWith304) {
+  wf::ETagMiddleware middleware;
+  std::string etag = wf::StrongETag("Hello, world!");
+
+  std::shared_ptr<RecordingWriter> writer =
+    Serve(&middleware, "GET", etag, Hello);
+  EXPECT_EQ(writer->status, 304);
+  EXPECT_EQ(writer->Header("etag"), etag);
+  EXPECT_TRUE(writer->body.empty());
+
+  // Any other ETag gets the full response.
+  writer = Serve(&middleware, "GET", "\"stale\"", Hello);
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->body, "Hello, world!");
+}
+
+TEST_F(ETagMiddlewareTest, LeavesResponsesWithTheirOwnETagAlone) {
+  wf::ETagMiddleware middleware;
+  std::shared_ptr<RecordingWriter> writer =
+    Get(&middleware, [](wf::Response* res) {
+    res->Header("ETag", "\"own\"");
+    Hello(res);
+  });
+
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("etag"), "\"own\"");
+  EXPECT_EQ(writer->body, "Hello, world!");
+}
+
+TEST_F(ETagMiddlewareTest, LeavesNon200sAlone) {
+  wf::ETagMiddleware middleware;
+  std::shared_ptr<RecordingWriter> writer =
+    Get(&middleware, [](wf::Response* res) {
+    res->Status(404);
+    res->End("Not found").IgnoreError();
+  });
+
+  EXPECT_EQ(writer->status, 404);
+  EXPECT_EQ(writer->Header("etag"), "");
+  EXPECT_EQ(writer->body, "Not found");
+}
+
+TEST_F(ETagMiddlewareTest, LeavesLargeBodiesAlone) {
+  wf::ETagMiddleware middleware(4);
+  std::shared_ptr<RecordingWriter> writer = Get(&middleware, Hello);
+
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("etag"), "");
+  EXPECT_EQ(writer->body, "Hello, world!");
+}
+
+TEST_F(ETagMiddlewareTest, LeavesFlushedResponsesAlone) {
+  wf::ETagMiddleware middleware;
+  std::shared_ptr<RecordingWriter> writer =
+    Get(&middleware, [](wf::Response* res) {
+    res->Write("Hello, ").IgnoreError();
+    res->Flush().IgnoreError();
+    res->End("world!").IgnoreError();
+  });
+
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("etag"), "");
+  EXPECT_EQ(writer->body, "Hello, world!");
+  EXPECT_EQ(writer->flushes, 1);
+}
+
+TEST_F(ETagMiddlewareTest, LeavesOtherMethodsAlone) {
+  wf::ETagMiddleware middleware;
+  std::shared_ptr<RecordingWriter> writer =
+    Serve(&middleware, "POST", wf::StrongETag("Hello, world!"), Hello);
+
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("etag"), "");
+  EXPECT_EQ(writer->body, "Hello, world!");
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -24,8 +24,9 @@
 
 #include <chrono>
 #include <filesystem>
-#include <fstream>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -36,6 +37,7 @@
 #include "webforge/http/date.h"
 #include "webforge/http/strings.h"
 #include "webforge/site/middleware.h"
+#include "webforge/site/static_cache.h"
 
 namespace wf {
 
@@ -63,77 +65,47 @@ absl::Status FProcessor::operator()(RequestPtr req, ResponsePtr res) {
   return processor_(req, res);
 }
 
-StaticProcessor::StaticProcessor(const std::filesystem::path& filename) :
-  filename_(filename) {
+StaticProcessor::StaticProcessor(const std::filesystem::path& filename,
+                                 std::shared_ptr<StaticCache> cache) :
+  filename_(filename),
+  cache_(cache != nullptr ? std::move(cache) : StaticCache::Shared()) {
   // Nothing to do.
 }
 
-absl::Status StaticProcessor::operator()(RequestPtr req, ResponsePtr res) {
+void StaticProcessor::operator()(RequestPtr req, ResponsePtr res,
+                                 Middleware::NextFn next) {
   std::filesystem::path filepath = res->ComponentPath() / filename_;
-  uintmax_t file_size;
-  wf::HTTPDate mtime;
 
-  if (!std::filesystem::exists(filepath)) {
-    return absl::InternalError("static file does not exist");
-  }
+  cache_->GetAsync(filepath, [this, req, res, next](
+    absl::StatusOr<StaticFile> file) {
+    absl::Status s = Send(file, *req, res.get());
+    if (!s.ok()) {
+      next(s);
+    }
+  });
+}
 
-  if (!std::filesystem::is_regular_file(filepath)) {
-    return absl::InternalError("static filepath is not a regular file");
-  }
+absl::Status StaticProcessor::operator()(RequestPtr req, ResponsePtr res) {
+  std::filesystem::path filepath = res->ComponentPath() / filename_;
 
-  try {
-    file_size = std::filesystem::file_size(filepath);
-  } catch (...) {
-    // An error occurred.
-    return absl::InternalError("file_size threw");
-  }
+  return Send(cache_->GetFile(filepath), *req, res.get());
+}
 
-  try {
-    mtime = std::filesystem::last_write_time(filepath);
-  } catch (...) {
-    return absl::InternalError("last_write_time threw");
+absl::Status StaticProcessor::Send(const absl::StatusOr<StaticFile>& file,
+                                   const Request& req, Response* res) {
+  if (absl::IsNotFound(file.status())) {
+    return absl::InternalError("static file does not exist");
   }
 
-  res->Header("Content-Length", std::to_string(file_size));
-  res->Header("Content-Type", GetMimeType(filepath.string()));
-  res->Header("Last-Modified", mtime.Render());
-
-  if (req->Header("If-Modified-Since").status().ok()) {
-    absl::StatusOr<HTTPDate> ims_date =
-      wf::HTTPDate::FromString(req->Header("If-Modified-Since").value());
-
-    // If the time data is malformed, we don't care. Don't error out here.
-    if (ims_date.ok()) {
-      if (mtime <= ims_date.value()) {
-        // Client has a cached copy of this file already.
-        res->Status(304);
-        res->End();
-        return absl::OkStatus();
-      }
-    }
+  if (absl::IsFailedPrecondition(file.status())) {
+    return absl::InternalError("static filepath is not a regular file");
   }
 
-  std::ifstream file(filepath);
-  if (!file.is_open()) {
+  if (!file.ok()) {
     return absl::InternalError("failed to open static file");
   }
 
-  res->WriteHead().IgnoreError();
-
-  // Read file 4KB at a time.
-  const std::size_t buffer_size = 4096;
-  std::string buffer(buffer_size, 0x00);
-  do {
-    file.read(buffer.data(), buffer_size);
-
-    absl::string_view buf_sv(buffer);
-    buf_sv.remove_suffix(buffer_size - file.gcount());
-
-    res->Write(buf_sv).IgnoreError();
-  } while (!file.eof());
-
-  res->End();
-
+  cache_->Send(file.value(), req, res);
   return absl::OkStatus();
 }
 
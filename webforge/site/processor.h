@@ -28,13 +28,16 @@
 
 #include <filesystem>
 #include <functional>
+#include <memory>
 
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 
 #include "webforge/core/data.pb.h"
 #include "webforge/http/http.h"
 #include "webforge/site/middleware.h"
+#include "webforge/site/static_cache.h"
 
 namespace wf {
 
@@ -71,15 +74,32 @@ private:
 // Defines a Processor that sends a static file.
 class StaticProcessor : public Processor {
 public:
-  StaticProcessor(const std::filesystem::path& filename);
+  // The file is looked up in `cache`, or in StaticCache::Shared() if it is
+  // null.
+  StaticProcessor(const std::filesystem::path& filename,
+                  std::shared_ptr<StaticCache> cache = nullptr);
 
+  // Overridden, unlike in other processors, so that the file can be looked up
+  // with StaticCache::GetAsync and the response finished later.
+  void operator()(RequestPtr req, ResponsePtr res,
+                  Middleware::NextFn next) override;
+
+  // Looks the file up synchronously.
   absl::Status operator()(RequestPtr req, ResponsePtr res) override;
 
 private:
+  // Sends `file`, or returns why it can't.
+  absl::Status Send(const absl::StatusOr<StaticFile>& file, const Request& req,
+                    Response* res);
+
   std::filesystem::path filename_;
+  std::shared_ptr<StaticCache> cache_;
 };
 
 // Defines a Processor that renders a dynamic file (template)
+//
+// Rendered pages carry no ETag. Put a wf::ETagMiddleware in front of the
+// processor to give them one, and to answer If-None-Match with a 304.
 class DynamicProcessor : public Processor {
 public:
   using AddDataFn = std::function<void(absl::string_view,
@@ -214,26 +214,27 @@ absl::Status Router::Handle(RequestPtr req, ResponsePtr res) {
 
 Middleware::NextFn Router::NextFactory(std::size_t index, RequestPtr req,
                                        ResponsePtr res,
-                                       std::shared_ptr<bool> stack_flag,
+                                       std::shared_ptr<CallState> call_state,
                                        Middleware::NextFn old_next) {
-  return [this, index, req, res, old_next, stack_flag](absl::Status s) {
+  return [this, index, req, res, old_next, call_state](absl::Status s) {
     if (!s.ok()) {
       // An error occurred in processing, bail.
       old_next(s);
       return;
     }
 
-    // The purpose of the stack_flag bool is to prevent the call stack from
-    // going to the moon. The way it works is that the previous next function
-    // created something akin to a CondVar, and set it to true. After calling
-    // the middleware, it checks to see if the value has changed. If it has,
-    // then it knows that next was called before the middleware returned, i.e.,
+    // The purpose of call_state is to prevent the call stack from going to the
+    // moon. The way it works is that the previous next function created
+    // something akin to a CondVar, and set it to kRunning. After calling the
+    // middleware, it checks to see if the value has changed. If it has, then it
+    // knows that next was called before the middleware returned, i.e.,
     // synchronously. This signals then that we need to continue the for loop.
-    // Here, we set the value to false and return if that is the situation we're
-    // in.
-    if (stack_flag) {
-      if (*stack_flag) {
-        *stack_flag = false;
+    // Here, we set the value to kNextCalled and return if that is the situation
+    // we're in. If the middleware has already returned, next was called
+    // asynchronously, and nobody is left to continue the loop but us.
+    if (call_state) {
+      if (*call_state == CallState::kRunning) {
+        *call_state = CallState::kNextCalled;
         return;
       }
     }
@@ -244,11 +245,13 @@ Middleware::NextFn Router::NextFactory(std::size_t index, RequestPtr req,
       }
 
       // This route matches.
-      auto new_stack_flag = std::make_shared<bool>(true);
+      auto new_call_state = std::make_shared<CallState>(CallState::kRunning);
       (*(routes_[i].second))(req, res, NextFactory(i + 1, req, res,
-                                                   new_stack_flag, old_next));
-      if (*new_stack_flag) {
+                                                   new_call_state, old_next));
+      if (*new_call_state == CallState::kRunning) {
         // next has not yet been called, so we should stop trying to run routes.
+        // If it is called later, it picks up from here.
+        *new_call_state = CallState::kReturned;
         return;
       }
     }
@@ -149,9 +149,16 @@ public:
   absl::Status Handle(RequestPtr req, ResponsePtr res);
 
 private:
+  // Where a middleware is at with the next function it was given.
+  enum class CallState {
+    kRunning,  // Still on the stack, and hasn't called next
+    kNextCalled,  // Called next before returning
+    kReturned,  // Returned without calling next, which may come later
+  };
+
   Middleware::NextFn NextFactory(std::size_t index, RequestPtr req,
                                  ResponsePtr res,
-                                 std::shared_ptr<bool> stack_flag,
+                                 std::shared_ptr<CallState> call_state,
                                  Middleware::NextFn old_next);
 
   std::vector<std::pair<Route, std::unique_ptr<Middleware>>> routes_;
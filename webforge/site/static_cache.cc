@@ -0,0 +1,811 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_cache.cc
+// -----------------------------------------------------------------------------
+//
+// Implements wf::StaticCache and the free functions that go with it.
+//
+
+#include "webforge/site/static_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/date.h"
+#include "webforge/http/etag.h"
+#include "webforge/http/file.h"
+#include "webforge/http/file_io_pool.h"
+#include "webforge/http/http.h"
+#include "webforge/http/strings.h"
+
+namespace wf {
+
+namespace {
+
+// Precompressed siblings that are looked for, in order of preference.
+constexpr StaticEncoding kEncodings[] = {
+  {"br", ".br"},
+  {"zstd", ".zst"},
+  {"gzip", ".gz"},
+};
+
+absl::string_view SuffixOf(absl::string_view coding) {
+  for (const StaticEncoding& encoding : kEncodings) {
+    if (encoding.coding == coding) {
+      return encoding.suffix;
+    }
+  }
+
+  return "";
+}
+
+// Returns the quality `accept_encoding` gives `coding`, from 0 (not acceptable)
+// to 1.
+double QualityOf(absl::string_view accept_encoding, absl::string_view coding) {
+  double wildcard = 0;
+  for (absl::string_view part : absl::StrSplit(accept_encoding, ',')) {
+    std::pair<absl::string_view, absl::string_view> name_params =
+      absl::StrSplit(part, absl::MaxSplits(';', 1));
+    absl::string_view name = absl::StripAsciiWhitespace(name_params.first);
+
+    double q = 1;
+    for (absl::string_view param : absl::StrSplit(name_params.second, ';')) {
+      param = absl::StripAsciiWhitespace(param);
+      if (absl::StartsWithIgnoreCase(param, "q=") &&
+          !absl::SimpleAtod(param.substr(2), &q)) {
+        q = 0;
+      }
+    }
+
+    if (absl::EqualsIgnoreCase(name, coding) ||
+        (coding == "gzip" && absl::EqualsIgnoreCase(name, "x-gzip"))) {
+      return q;
+    }
+
+    if (name == "*") {
+      wildcard = q;
+    }
+  }
+
+  return wildcard;
+}
+
+// How much of a large file is read at a time to compute its ETag.
+constexpr std::size_t kHashBufferSize = 64 * 1024;
+
+// Upper bound on the ranges of a single Range header. Anything more is more
+// likely an attempt to make the server do a lot of work for little than a
+// legitimate request.
+constexpr std::size_t kMaxRanges = 16;
+
+// Checks whether the If-Range header of `req`, if any, matches the
+// representation about to be sent. If it doesn't, the client's partial copy is
+// stale and the Range header has to be ignored.
+bool IfRangeMatches(const Request& req, absl::string_view etag,
+                    absl::string_view last_modified) {
+  absl::StatusOr<const std::string> if_range = req.Header("If-Range");
+  if (!if_range.ok()) {
+    return true;
+  }
+
+  // Only strong validators count: a weak ETag never matches, and a date has to
+  // be exactly the one that was sent.
+  absl::string_view validator = absl::StripAsciiWhitespace(if_range.value());
+  if (absl::StartsWith(validator, "\"") || absl::StartsWith(validator, "W/")) {
+    return validator == etag;
+  }
+
+  return validator == last_modified;
+}
+
+// The contents of an asset that is held in memory, one way or another.
+absl::string_view ContentsOf(const StaticAsset& asset) {
+  if (asset.mapping != nullptr) {
+    return asset.mapping->Contents();
+  }
+
+  return asset.body;
+}
+
+// Checks whether `asset` counts against StaticCacheOptions::max_open_files.
+bool IsLarge(const StaticAsset& asset) {
+  return asset.file != nullptr || asset.mapping != nullptr;
+}
+
+// Writes the bytes of `body` that `range` covers.
+void WriteRange(const StaticAsset& body, const ByteRange& range,
+                Response* res) {
+  if (body.file != nullptr) {
+    res->WriteFile(body.file, range.offset, range.length).IgnoreError();
+  } else {
+    res->Write(ContentsOf(body).substr(range.offset, range.length))
+      .IgnoreError();
+  }
+}
+
+std::string ContentRange(const ByteRange& range, std::size_t size) {
+  return absl::StrCat("bytes ", range.offset, "-",
+                      range.offset + range.length - 1, "/", size);
+}
+
+// Sends `ranges` of `body` as a 206. A single range is sent as is, and several
+// as a multipart/byteranges body whose parts each carry `content_type`.
+void SendRanges(const StaticAsset& body, const std::vector<ByteRange>& ranges,
+                absl::string_view content_type, Response* res) {
+  res->Status(206);
+
+  if (ranges.size() == 1) {
+    res->Header("Content-Range", ContentRange(ranges[0], body.size));
+    res->Header("Content-Length", std::to_string(ranges[0].length));
+    WriteRange(body, ranges[0], res);
+    res->End();
+    return;
+  }
+
+  // The boundary must not show up in any of the parts. Nothing stops a file
+  // from containing one on purpose, but it can't know which one will be used.
+  static std::atomic<uint64_t> counter(0);
+  std::string boundary = absl::StrFormat(
+    "%016x%08x", absl::ToUnixNanos(absl::Now()),
+    counter.fetch_add(1, std::memory_order_relaxed));
+
+  // Every part head is rendered up front, since Content-Length has to be known
+  // before any of them is sent.
+  std::vector<std::string> heads;
+  heads.reserve(ranges.size());
+  std::string trailer = absl::StrCat("\r\n--", boundary, "--\r\n");
+  std::size_t length = trailer.size();
+  for (const ByteRange& range : ranges) {
+    heads.push_back(absl::StrCat(
+      heads.empty() ? "" : "\r\n", "--", boundary, "\r\n",
+      "Content-Type: ", content_type, "\r\n",
+      "Content-Range: ", ContentRange(range, body.size), "\r\n\r\n"));
+    length += heads.back().size() + range.length;
+  }
+
+  res->Header("Content-Type",
+              absl::StrCat("multipart/byteranges; boundary=", boundary));
+  res->Header("Content-Length", std::to_string(length));
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    res->Write(heads[i]).IgnoreError();
+    WriteRange(body, ranges[i], res);
+  }
+
+  res->End(trailer).IgnoreError();
+}
+
+// Finds the nearest directory above `path` that exists, and its mtime.
+bool StatParent(const std::filesystem::path& path, std::string* dir,
+                absl::Time* mtime) {
+  std::filesystem::path parent = path.parent_path();
+  while (true) {
+    struct stat st;
+    if (fstatat(AT_FDCWD, parent.c_str(), &st, 0) == 0) {
+      if (!S_ISDIR(st.st_mode)) {
+        return false;
+      }
+
+      *dir = parent.string();
+      *mtime = absl::TimeFromTimespec(st.st_mtim);
+      return true;
+    }
+
+    if ((errno != ENOENT && errno != ENOTDIR) || !parent.has_relative_path()) {
+      return false;
+    }
+
+    parent = parent.parent_path();
+  }
+}
+
+// Checks whether `st` still describes the file `asset` was loaded from.
+bool Unchanged(const StaticAsset& asset, const struct stat& st) {
+  return S_ISREG(st.st_mode) && st.st_dev == asset.device &&
+         st.st_ino == asset.inode &&
+         static_cast<std::size_t>(st.st_size) == asset.size &&
+         absl::TimeFromTimespec(st.st_mtim) == asset.mtime;
+}
+
+}
+
+StaticCache::StaticCache(const StaticCacheOptions& options) :
+  options_(options),
+  io_pool_(options.io_pool != nullptr ? options.io_pool
+                                      : FileIOPool::Shared()),
+  bytes_(0), open_files_(0) {
+  // Nothing to do.
+}
+
+std::shared_ptr<StaticCache> StaticCache::Shared() {
+  static std::shared_ptr<StaticCache> cache = std::make_shared<StaticCache>();
+  return cache;
+}
+
+absl::StatusOr<std::shared_ptr<const StaticAsset>> StaticCache::Get(
+  const std::filesystem::path& path) {
+  return Lookup(path, true);
+}
+
+absl::StatusOr<StaticFile> StaticCache::GetFile(
+  const std::filesystem::path& path) {
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> asset =
+    Lookup(path, true);
+  if (!asset.ok()) {
+    return asset.status();
+  }
+
+  StaticFile file;
+  file.asset = std::move(asset).value();
+  for (const std::string& encoding : file.asset->encodings) {
+    absl::StatusOr<std::shared_ptr<const StaticAsset>> variant =
+      Lookup(absl::StrCat(path.string(), SuffixOf(encoding)), false);
+    file.variants.push_back(variant.ok() ? std::move(variant).value()
+                                         : nullptr);
+  }
+
+  return file;
+}
+
+void StaticCache::GetAsync(const std::filesystem::path& path,
+                           GetCallback done) {
+  auto result = std::make_shared<absl::StatusOr<StaticFile>>();
+  if (FreshFile(path, absl::Now(), result.get())) {
+    done(std::move(*result));
+    return;
+  }
+
+  io_pool_->Run([this, path, result]() {
+    *result = GetFile(path);
+  }, [result, done = std::move(done)]() {
+    done(std::move(*result));
+  });
+}
+
+void StaticCache::Send(const StaticFile& file, const Request& req,
+                       Response* res) {
+  const StaticAsset* variant = nullptr;
+  std::string encoding;
+  absl::StatusOr<const std::string> accept = req.Header("Accept-Encoding");
+  if (!file.variants.empty() && accept.ok()) {
+    std::vector<std::string> available;
+    for (std::size_t i = 0; i < file.variants.size(); ++i) {
+      if (file.variants[i] != nullptr) {
+        available.push_back(file.asset->encodings[i]);
+      }
+    }
+
+    encoding = ChooseEncoding(accept.value(), available);
+    for (std::size_t i = 0; i < file.variants.size(); ++i) {
+      if (file.variants[i] != nullptr &&
+          file.asset->encodings[i] == encoding) {
+        variant = file.variants[i].get();
+      }
+    }
+  }
+
+  SendStaticAsset(*file.asset, variant, encoding, req, res);
+}
+
+absl::StatusOr<std::shared_ptr<const StaticAsset>> StaticCache::Lookup(
+  const std::filesystem::path& path, bool find_encodings) {
+  std::string key = path.string();
+  absl::Time now = absl::Now();
+
+  if (KnownMissing(key, now)) {
+    return absl::NotFoundError("no such file");
+  }
+
+  std::shared_ptr<const StaticAsset> cached;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      Touch(&it->second);
+      if (now - it->second.checked_at < options_.revalidate_interval) {
+        return it->second.asset;
+      }
+
+      cached = it->second.asset;
+    }
+  }
+
+  if (cached) {
+    struct stat st;
+    if (fstatat(AT_FDCWD, key.c_str(), &st, 0) == 0 && Unchanged(*cached, st)) {
+      absl::MutexLock lock(&mutex_);
+      auto it = entries_.find(key);
+      if (it != entries_.end() && it->second.asset == cached) {
+        it->second.checked_at = now;
+      }
+
+      return cached;
+    }
+  }
+
+  // Taken before looking for the file, so that if it shows up in the meantime,
+  // the directory has changed by the time the miss is checked.
+  Miss miss;
+  bool have_dir = options_.max_misses > 0 &&
+                  StatParent(path, &miss.dir, &miss.dir_mtime);
+
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> asset =
+    Load(path, find_encodings);
+  if (!asset.ok()) {
+    absl::MutexLock lock(&mutex_);
+    if (cached) {
+      Erase(key);
+    }
+
+    if (absl::IsNotFound(asset.status()) && have_dir) {
+      if (misses_.size() >= options_.max_misses) {
+        // Whichever comes first; the order of a hash map is as good as random.
+        misses_.erase(misses_.begin());
+      }
+
+      miss.checked_at = now;
+      misses_[key] = std::move(miss);
+    }
+
+    return asset.status();
+  }
+
+  Insert(key, asset.value(), now);
+  return asset;
+}
+
+bool StaticCache::Fresh(
+  const std::string& key, absl::Time now,
+  absl::StatusOr<std::shared_ptr<const StaticAsset>>* result) {
+  absl::MutexLock lock(&mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end() &&
+      now - it->second.checked_at < options_.revalidate_interval) {
+    Touch(&it->second);
+    *result = it->second.asset;
+    return true;
+  }
+
+  auto miss = misses_.find(key);
+  if (miss != misses_.end() &&
+      now - miss->second.checked_at < options_.revalidate_interval) {
+    *result = absl::NotFoundError("no such file");
+    return true;
+  }
+
+  return false;
+}
+
+bool StaticCache::FreshFile(const std::filesystem::path& path,
+                            absl::Time now,
+                            absl::StatusOr<StaticFile>* result) {
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> asset;
+  if (!Fresh(path.string(), now, &asset)) {
+    return false;
+  }
+
+  if (!asset.ok()) {
+    *result = asset.status();
+    return true;
+  }
+
+  StaticFile file;
+  file.asset = std::move(asset).value();
+  for (const std::string& encoding : file.asset->encodings) {
+    absl::StatusOr<std::shared_ptr<const StaticAsset>> variant;
+    if (!Fresh(absl::StrCat(path.string(), SuffixOf(encoding)), now,
+               &variant)) {
+      return false;
+    }
+
+    file.variants.push_back(variant.ok() ? std::move(variant).value()
+                                         : nullptr);
+  }
+
+  *result = std::move(file);
+  return true;
+}
+
+bool StaticCache::KnownMissing(const std::string& path, absl::Time now) {
+  Miss miss;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = misses_.find(path);
+    if (it == misses_.end()) {
+      return false;
+    }
+
+    if (now - it->second.checked_at < options_.revalidate_interval) {
+      return true;
+    }
+
+    miss = it->second;
+  }
+
+  std::string dir;
+  absl::Time dir_mtime;
+  bool unchanged = StatParent(path, &dir, &dir_mtime) && dir == miss.dir &&
+                   dir_mtime == miss.dir_mtime;
+
+  absl::MutexLock lock(&mutex_);
+  auto it = misses_.find(path);
+  if (it != misses_.end()) {
+    if (unchanged) {
+      it->second.checked_at = now;
+    } else {
+      misses_.erase(it);
+    }
+  }
+
+  return unchanged;
+}
+
+std::size_t StaticCache::Bytes() const {
+  absl::MutexLock lock(&mutex_);
+  return bytes_;
+}
+
+absl::StatusOr<std::shared_ptr<const StaticAsset>> StaticCache::Load(
+  const std::filesystem::path& path, bool find_encodings) {
+  absl::StatusOr<std::shared_ptr<const File>> file = File::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  auto asset = std::make_shared<StaticAsset>();
+  asset->size = file.value()->Size();
+  asset->mtime = file.value()->ModifiedTime();
+  asset->modified_time = asset->mtime;
+  asset->last_modified = asset->modified_time.Render();
+  asset->mime_type = GetMimeType(path.string());
+  asset->device = file.value()->Device();
+  asset->inode = file.value()->Inode();
+
+  for (const StaticEncoding& encoding : kEncodings) {
+    if (!find_encodings) {
+      break;
+    }
+
+    std::string sibling = absl::StrCat(path.string(), encoding.suffix);
+    struct stat st;
+    if (fstatat(AT_FDCWD, sibling.c_str(), &st, 0) == 0 &&
+        S_ISREG(st.st_mode) &&
+        absl::TimeFromTimespec(st.st_mtim) >= asset->mtime) {
+      asset->encodings.emplace_back(encoding.coding);
+    }
+  }
+
+  if (asset->size > options_.max_file_size &&
+      asset->size <= options_.max_mapped_size) {
+    absl::StatusOr<std::shared_ptr<const MappedFile>> mapping =
+      Map(*file.value());
+
+    // If the file can't be mapped, it's sent from disk instead.
+    if (mapping.ok()) {
+      asset->mapping = std::move(mapping).value();
+      asset->etag = StrongETag(asset->mapping->Contents());
+      return asset;
+    }
+  }
+
+  if (asset->size > options_.max_file_size) {
+    // Hashed once here, a piece at a time, so that it never has to be again
+    // while the file stays the same.
+    ETagHasher hasher;
+    std::string buffer(kHashBufferSize, '\0');
+    for (std::size_t offset = 0; offset < asset->size;) {
+      absl::StatusOr<std::size_t> n = file.value()->Read(
+        offset, buffer.size(), buffer.data());
+      if (!n.ok()) {
+        return n.status();
+      }
+
+      if (n.value() == 0) {
+        break;
+      }
+
+      hasher.Update(absl::string_view(buffer.data(), n.value()));
+      offset += n.value();
+    }
+
+    asset->etag = hasher.Finish();
+    asset->file = std::move(file).value();
+    return asset;
+  }
+
+  asset->body.resize(asset->size);
+  absl::StatusOr<std::size_t> n = file.value()->Read(0, asset->size,
+                                                     asset->body.data());
+  if (!n.ok()) {
+    return n.status();
+  }
+
+  // The file may have shrunk since it was opened.
+  asset->body.resize(n.value());
+  asset->size = n.value();
+  asset->etag = StrongETag(asset->body);
+  return asset;
+}
+
+absl::StatusOr<std::shared_ptr<const MappedFile>> StaticCache::Map(
+  const File& file) {
+  std::tuple<dev_t, ino_t, absl::Time> key(file.Device(), file.Inode(),
+                                           file.ModifiedTime());
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = mappings_.find(key);
+    if (it != mappings_.end()) {
+      std::shared_ptr<const MappedFile> mapping = it->second.lock();
+      if (mapping != nullptr) {
+        return mapping;
+      }
+    }
+  }
+
+  absl::StatusOr<std::shared_ptr<const MappedFile>> mapping =
+    MappedFile::Map(file);
+  if (!mapping.ok()) {
+    return mapping.status();
+  }
+
+  absl::MutexLock lock(&mutex_);
+  absl::erase_if(mappings_, [](const auto& entry) {
+    return entry.second.expired();
+  });
+
+  // Another thread may have mapped the same file in the meantime.
+  auto [it, inserted] = mappings_.try_emplace(key, mapping.value());
+  if (!inserted) {
+    std::shared_ptr<const MappedFile> existing = it->second.lock();
+    if (existing != nullptr) {
+      return existing;
+    }
+
+    it->second = mapping.value();
+  }
+
+  return mapping;
+}
+
+void StaticCache::Insert(const std::string& key,
+                         std::shared_ptr<const StaticAsset> asset,
+                         absl::Time now) {
+  absl::MutexLock lock(&mutex_);
+  Erase(key);
+
+  if (asset->body.size() > options_.max_bytes ||
+      (IsLarge(*asset) && options_.max_open_files == 0)) {
+    return;
+  }
+
+  Entry& entry = entries_[key];
+  lru_.push_front(key);
+  entry.lru = lru_.begin();
+  bytes_ += asset->body.size();
+  if (IsLarge(*asset)) {
+    ++open_files_;
+    large_lru_.push_front(key);
+    entry.large_lru = large_lru_.begin();
+  }
+
+  entry.asset = std::move(asset);
+  entry.checked_at = now;
+
+  while (bytes_ > options_.max_bytes) {
+    std::string oldest = lru_.back();
+    Erase(oldest);
+  }
+
+  // Small files hold no descriptor, so evicting them wouldn't help.
+  while (open_files_ > options_.max_open_files) {
+    std::string oldest = large_lru_.back();
+    Erase(oldest);
+  }
+}
+
+void StaticCache::Erase(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return;
+  }
+
+  bytes_ -= it->second.asset->body.size();
+  if (IsLarge(*it->second.asset)) {
+    --open_files_;
+    large_lru_.erase(it->second.large_lru);
+  }
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void StaticCache::Touch(Entry* entry) {
+  lru_.splice(lru_.begin(), lru_, entry->lru);
+  if (IsLarge(*entry->asset)) {
+    large_lru_.splice(large_lru_.begin(), large_lru_, entry->large_lru);
+  }
+}
+
+absl::Span<const StaticEncoding> StaticEncodings() {
+  return kEncodings;
+}
+
+std::string ChooseEncoding(absl::string_view accept_encoding,
+                           const std::vector<std::string>& available) {
+  std::string best;
+  double best_q = 0;
+  for (const std::string& coding : available) {
+    double q = QualityOf(accept_encoding, coding);
+    if (q > best_q) {
+      best = coding;
+      best_q = q;
+    }
+  }
+
+  return best;
+}
+
+void SendStaticAsset(const StaticAsset& asset, const StaticAsset* variant,
+                     absl::string_view encoding, const Request& req,
+                     Response* res) {
+  if (!asset.encodings.empty()) {
+    // Caches between here and the client have to tell encodings apart.
+    res->Header("Vary", "Accept-Encoding");
+  }
+
+  const StaticAsset& body = variant != nullptr ? *variant : asset;
+  res->Header("Accept-Ranges", "bytes");
+  res->Header("Content-Length", std::to_string(body.size));
+  res->Header("Content-Type", asset.mime_type);
+  res->Header("Last-Modified", asset.last_modified);
+
+  // Each encoding has its own ETag, since the hash is over the bytes sent.
+  res->Header("ETag", body.etag);
+  if (variant != nullptr) {
+    res->Header("Content-Encoding", encoding);
+  }
+
+  if (NotModified(req, body.etag, &asset.modified_time)) {
+    // Client has a cached copy of this file already.
+    res->Status(304);
+    res->End();
+    return;
+  }
+
+  // Range only applies to GET (RFC 9110 section 14.2).
+  absl::StatusOr<const std::string> range = req.Header("Range");
+  if (range.ok() && req.Method() == CaseInsensitive("GET") &&
+      IfRangeMatches(req, body.etag, asset.last_modified)) {
+    std::vector<ByteRange> ranges;
+    absl::Status s = ParseRange(range.value(), body.size, &ranges);
+    if (absl::IsOutOfRange(s)) {
+      res->Status(416);
+      res->Header("Content-Range", absl::StrCat("bytes */", body.size));
+      res->End("").IgnoreError();
+      return;
+    }
+
+    // A malformed Range header is ignored, and the whole file is sent.
+    if (s.ok()) {
+      SendRanges(body, ranges, absl::StrCat(asset.mime_type, "; charset=",
+                                            res->Charset()), res);
+      return;
+    }
+  }
+
+  if (body.file != nullptr) {
+    res->WriteFile(body.file, 0, body.size).IgnoreError();
+    res->End();
+    return;
+  }
+
+  res->End(ContentsOf(body)).IgnoreError();
+}
+
+absl::Status ParseRange(absl::string_view range, std::size_t size,
+                        std::vector<ByteRange>* ranges) {
+  ranges->clear();
+
+  range = absl::StripAsciiWhitespace(range);
+  if (!absl::StartsWithIgnoreCase(range, "bytes=")) {
+    return absl::InvalidArgumentError("range unit is not bytes");
+  }
+  range.remove_prefix(6);
+
+  std::size_t specs = 0;
+  for (absl::string_view spec : absl::StrSplit(range, ',')) {
+    spec = absl::StripAsciiWhitespace(spec);
+    if (spec.empty()) {
+      // Empty list elements are allowed, and mean nothing.
+      continue;
+    }
+
+    if (++specs > kMaxRanges) {
+      return absl::InvalidArgumentError("too many ranges");
+    }
+
+    std::size_t dash = spec.find('-');
+    if (dash == absl::string_view::npos) {
+      return absl::InvalidArgumentError("range has no '-'");
+    }
+
+    absl::string_view first = spec.substr(0, dash);
+    absl::string_view last = spec.substr(dash + 1);
+    uint64_t first_value = 0;
+    uint64_t last_value = 0;
+    if ((!first.empty() && !absl::SimpleAtoi(first, &first_value)) ||
+        (!last.empty() && !absl::SimpleAtoi(last, &last_value)) ||
+        (first.empty() && last.empty())) {
+      return absl::InvalidArgumentError("malformed range");
+    }
+
+    if (first.empty()) {
+      // A suffix: the last `last_value` bytes.
+      if (last_value == 0 || size == 0) {
+        continue;
+      }
+
+      std::size_t length = std::min<uint64_t>(last_value, size);
+      ranges->push_back(ByteRange{size - length, length});
+      continue;
+    }
+
+    if (!last.empty() && last_value < first_value) {
+      return absl::InvalidArgumentError("range ends before it starts");
+    }
+
+    if (first_value >= size) {
+      continue;
+    }
+
+    uint64_t end = last.empty() ? size - 1 : std::min<uint64_t>(last_value,
+                                                                 size - 1);
+    ranges->push_back(ByteRange{first_value, end - first_value + 1});
+  }
+
+  if (ranges->empty()) {
+    return absl::OutOfRangeError("no satisfiable range");
+  }
+
+  return absl::OkStatus();
+}
+
+}
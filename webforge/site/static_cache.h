@@ -0,0 +1,319 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_cache.h
+// -----------------------------------------------------------------------------
+//
+// wf::StaticCache keeps static assets in memory, along with everything needed
+// to send them: the pre-rendered Last-Modified header, the MIME type, and a
+// strong ETag computed from the contents (see wf::StrongETag), which is only
+// recomputed when the file changes. wf::StaticMiddleware and
+// wf::StaticProcessor look files up in it, so that hot CSS, JS and images are
+// served without touching the filesystem.
+//
+// Entries aren't trusted forever. An entry that was last checked more than
+// StaticCacheOptions::revalidate_interval ago is checked again with a single
+// fstatat(2), and reloaded if the file changed (a different size, mtime or
+// inode, which catches files replaced by rename(2)).
+//
+// The cache is bounded by the total size of the files it holds, and evicts the
+// least recently used entries to stay below it. Files larger than
+// StaticCacheOptions::max_file_size are never held in memory; their assets
+// carry the open wf::File instead, so that they can be sent with
+// wf::Response::WriteFile, and are bounded by count instead.
+//
+// Optionally, files up to StaticCacheOptions::max_mapped_size are mapped into
+// memory rather than sent from disk (see wf::MappedFile), and written out of
+// the mapping like any other bytes. This suits writers that can't hand a file
+// to the kernel, such as those of CGI programs, which would otherwise read it
+// into a fresh buffer on every request. Mappings are shared by everything that
+// maps the same version of a file, as told by its device, inode and mtime, and
+// go away once the last asset using them does.
+//
+// Static files can come with precompressed siblings, such as style.css.br and
+// style.css.gz next to style.css, which are produced once at build or deploy
+// time instead of compressing on every request. Which siblings exist is checked
+// whenever a file is loaded, and StaticCache::Send picks the best one the
+// client accepts. Siblings older than the file itself are ignored, as they are
+// most likely left over from a previous version.
+//
+// Large files are often fetched in pieces, e.g. by video players and resumed
+// downloads, so StaticCache::Send also answers Range requests: a single range
+// gets a 206 with the bytes it covers, several get a multipart/byteranges body,
+// and ranges that lie entirely past the end of the file get a 416. Ranges of
+// uncached files are sent straight from disk with wf::Response::WriteFile.
+//
+// Misses are remembered as well, since wf::StaticMiddleware usually sits in
+// front of dynamic routes and would otherwise look for a file on every one of
+// their requests. A path that wasn't found is reported missing without touching
+// the filesystem for StaticCacheOptions::revalidate_interval. After that, the
+// miss is checked by comparing the mtime of the nearest directory above it that
+// exists, which changes whenever an entry is added to or removed from it.
+//
+// Handlers that run on an event loop use StaticCache::GetAsync, which answers
+// from memory when it can, and hands anything that needs the filesystem to a
+// wf::FileIOPool so that a cold file doesn't stall the loop.
+//
+// By default, every static handler in the process shares StaticCache::Shared().
+// The cache is thread-safe.
+//
+
+#ifndef WEBFORGE_SITE_STATIC_CACHE_H_
+#define WEBFORGE_SITE_STATIC_CACHE_H_
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+
+#include "webforge/http/date.h"
+#include "webforge/http/file.h"
+#include "webforge/http/file_io_pool.h"
+#include "webforge/http/http.h"
+
+namespace wf {
+
+struct StaticCacheOptions {
+  // Upper bound on the total size of the files held in memory.
+  std::size_t max_bytes = 64 * 1024 * 1024;
+
+  // Files larger than this are sent from disk instead of being cached.
+  std::size_t max_file_size = 1024 * 1024;
+
+  // Files larger than max_file_size, but no larger than this, are mapped into
+  // memory instead of being sent from disk. 0 turns mapping off.
+  std::size_t max_mapped_size = 0;
+
+  // Upper bound on the number of large files kept open or mapped, so that
+  // their ETags don't have to be computed again on every request.
+  std::size_t max_open_files = 256;
+
+  // How long an entry is served without checking whether its file changed.
+  // Also applies to remembered misses.
+  absl::Duration revalidate_interval = absl::Seconds(2);
+
+  // Upper bound on the number of paths remembered as missing.
+  std::size_t max_misses = 4096;
+
+  // Runs the filesystem calls of StaticCache::GetAsync. Null means
+  // FileIOPool::Shared().
+  std::shared_ptr<FileIOPool> io_pool;
+};
+
+// One version of a static file, ready to be sent.
+struct StaticAsset {
+  std::string body;  // The whole file, unless it was too large to cache
+  std::shared_ptr<const File> file;  // Set instead of body for large files
+  std::shared_ptr<const MappedFile> mapping;  // Or this, see max_mapped_size
+
+  std::size_t size;
+  HTTPDate modified_time;
+  std::string last_modified;  // modified_time, rendered
+  std::string mime_type;
+  std::string etag;  // A hash of the contents
+
+  // Content codings that have a precompressed sibling, in order of preference,
+  // e.g. "br" if there is a style.css.br next to style.css.
+  std::vector<std::string> encodings;
+
+  // What the file looked like when it was loaded, for revalidation.
+  dev_t device;
+  ino_t inode;
+  absl::Time mtime;  // Unlike modified_time, not truncated to seconds
+};
+
+// An asset along with the precompressed siblings that were looked up with it,
+// which is everything StaticCache::Send needs.
+struct StaticFile {
+  std::shared_ptr<const StaticAsset> asset;
+
+  // By asset->encodings. Null for siblings that have gone missing.
+  std::vector<std::shared_ptr<const StaticAsset>> variants;
+};
+
+class StaticCache {
+public:
+  explicit StaticCache(
+    const StaticCacheOptions& options = StaticCacheOptions());
+
+  StaticCache(const StaticCache&) = delete;
+  StaticCache& operator=(const StaticCache&) = delete;
+
+  // The cache shared by static handlers that aren't given one of their own.
+  static std::shared_ptr<StaticCache> Shared();
+
+  // Returns the asset for the regular file at `path`, loading it if it isn't
+  // cached or has changed since it was.
+  //
+  // Returns an absl::NotFoundError if there is no such file, and an
+  // absl::FailedPreconditionError if `path` is not a regular file.
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> Get(
+    const std::filesystem::path& path);
+
+  // Get(), along with the precompressed siblings of the file.
+  absl::StatusOr<StaticFile> GetFile(const std::filesystem::path& path);
+
+  using GetCallback = std::function<void(absl::StatusOr<StaticFile>)>;
+
+  // GetFile(), without blocking the calling thread on the filesystem. If the
+  // file and its siblings are known without touching it, `done` is called right
+  // away. Otherwise, they are looked up on the I/O pool, and `done` is called
+  // afterwards on the calling thread (see wf::FileIOPool).
+  void GetAsync(const std::filesystem::path& path, GetCallback done);
+
+  // Sends `file`, which GetFile() or GetAsync() returned, as the response to
+  // `req`, or a 304 if the client's copy, according to If-None-Match or
+  // If-Modified-Since (see wf::NotModified), is still fresh.
+  //
+  // If the client accepts one of the file's precompressed encodings, the
+  // sibling is sent instead, with a Content-Encoding header. Only the siblings
+  // in `file` are considered, so sending never touches the filesystem.
+  //
+  // The Range header of a GET is honored unless an If-Range header says the
+  // client's copy is out of date, in which case the whole file is sent.
+  void Send(const StaticFile& file, const Request& req, Response* res);
+
+  // Total size of the files held in memory.
+  std::size_t Bytes() const;
+
+private:
+  struct Entry {
+    std::shared_ptr<const StaticAsset> asset;
+    absl::Time checked_at;
+    std::list<std::string>::iterator lru;  // Position in lru_
+    std::list<std::string>::iterator large_lru;  // Position in large_lru_
+  };
+
+  // A path that wasn't found.
+  struct Miss {
+    std::string dir;  // Nearest directory above the path that exists
+    absl::Time dir_mtime;
+    absl::Time checked_at;
+  };
+
+  // Sets `result` and returns true if `key` is cached, or remembered as
+  // missing, and doesn't need to be checked yet.
+  bool Fresh(const std::string& key, absl::Time now,
+             absl::StatusOr<std::shared_ptr<const StaticAsset>>* result);
+
+  // Fresh(), for a file along with all of its siblings.
+  bool FreshFile(const std::filesystem::path& path, absl::Time now,
+                 absl::StatusOr<StaticFile>* result);
+
+  // Get(), but siblings are only looked for if `find_encodings` is set.
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> Lookup(
+    const std::filesystem::path& path, bool find_encodings);
+
+  absl::StatusOr<std::shared_ptr<const StaticAsset>> Load(
+    const std::filesystem::path& path, bool find_encodings);
+
+  // Checks whether `path` is remembered as missing, and still is.
+  bool KnownMissing(const std::string& path, absl::Time now);
+
+  // Maps `file`, or returns the mapping of the same version of it that is
+  // already in use.
+  absl::StatusOr<std::shared_ptr<const MappedFile>> Map(const File& file);
+
+  // Caches `asset` as the current version of `key`, and evicts whatever no
+  // longer fits.
+  void Insert(const std::string& key, std::shared_ptr<const StaticAsset> asset,
+              absl::Time now);
+  void Erase(const std::string& key) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Marks `entry` as the most recently used.
+  void Touch(Entry* entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  StaticCacheOptions options_;
+  std::shared_ptr<FileIOPool> io_pool_;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  std::list<std::string> lru_ ABSL_GUARDED_BY(mutex_);  // Most recent first
+
+  // The entries that count against max_open_files, most recent first, so
+  // that going over it only evicts those.
+  std::list<std::string> large_lru_ ABSL_GUARDED_BY(mutex_);
+  std::size_t bytes_ ABSL_GUARDED_BY(mutex_);
+  std::size_t open_files_ ABSL_GUARDED_BY(mutex_);
+
+  absl::flat_hash_map<std::string, Miss> misses_ ABSL_GUARDED_BY(mutex_);
+
+  // Keyed by device, inode and mtime. Entries whose mapping is gone are
+  // cleaned up whenever a new one is added.
+  absl::flat_hash_map<std::tuple<dev_t, ino_t, absl::Time>,
+                      std::weak_ptr<const MappedFile>> mappings_
+    ABSL_GUARDED_BY(mutex_);
+};
+
+// A content coding that static files can be precompressed in, and the suffix
+// that marks their precompressed siblings, e.g. {"gzip", ".gz"}.
+struct StaticEncoding {
+  absl::string_view coding;
+  absl::string_view suffix;
+};
+
+// Every StaticEncoding that is looked for, in order of preference.
+absl::Span<const StaticEncoding> StaticEncodings();
+
+// Sends `asset` as the response to `req`, as StaticCache::Send does. `variant`,
+// if not null, is the precompressed sibling in `encoding` to send instead.
+//
+// For static handlers that find their assets some other way than through a
+// StaticCache.
+void SendStaticAsset(const StaticAsset& asset, const StaticAsset* variant,
+                     absl::string_view encoding, const Request& req,
+                     Response* res);
+
+// Returns the content coding out of `available` that `accept_encoding`, the
+// value of an Accept-Encoding header, rates highest. Ties go to whichever comes
+// first in `available`. Returns an empty string if none is acceptable.
+std::string ChooseEncoding(absl::string_view accept_encoding,
+                           const std::vector<std::string>& available);
+
+// A run of bytes out of a representation.
+struct ByteRange {
+  std::size_t offset;
+  std::size_t length;
+};
+
+// Resolves `range`, the value of a Range header, against a representation of
+// `size` bytes. Ranges that can't be satisfied are left out of `ranges`, and
+// the rest are clamped to the end of the representation.
+//
+// Returns an absl::OutOfRangeError if none of the ranges can be satisfied, and
+// an absl::InvalidArgumentError if `range` is malformed, isn't in bytes, or
+// asks for too many ranges. The header has to be ignored in the latter case.
+absl::Status ParseRange(absl::string_view range, std::size_t size,
+                        std::vector<ByteRange>* ranges);
+
+}
+
+#endif  // WEBFORGE_SITE_STATIC_CACHE_H_
@@ -0,0 +1,470 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_cache_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests wf::StaticCache against files in a scratch directory.
+//
+
+#include "webforge/site/static_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include <gtest/gtest.h>
+
+#include "webforge/http/etag.h"
+#include "webforge/http/file_io_pool.h"
+#include "webforge/http/http.h"
+
+// Records what a response sends.
+class RecordingWriter : public wf::ResponseWriter {
+public:
+  absl::Status WriteHead(const wf::Response& res) override {
+    status = res.Status();
+    headers = res.Headers();
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    body.append(chunk.data(), chunk.size());
+    return absl::OkStatus();
+  }
+
+  void End() override {}
+
+  // The value of header `name`, or "" if it wasn't sent.
+  std::string Header(const std::string& name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? "" : it->second;
+  }
+
+  int status = 0;
+  absl::flat_hash_map<std::string, std::string> headers;
+  std::string body;
+};
+
+class StaticCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(testing::TempDir()) / "static_cache_test";
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  std::filesystem::path WriteFile(const std::string& name,
+                                  const std::string& contents) {
+    std::filesystem::path path = dir_ / name;
+    std::ofstream(path) << contents;
+    return path;
+  }
+
+  // Sends `file` in response to a `method` request with `headers`.
+  static std::shared_ptr<RecordingWriter> Send(
+    wf::StaticCache* cache, const wf::StaticFile& file,
+    const std::vector<std::pair<std::string, std::string>>& headers,
+    absl::string_view method = "GET") {
+    auto req = std::make_shared<wf::Request>();
+    req->Method(method);
+    req->Path("/");
+    req->Version("HTTP/1.1");
+    for (const auto& [name, value] : headers) {
+      req->Header(name, value);
+    }
+
+    auto res = std::make_shared<wf::Response>();
+    auto writer = std::make_shared<RecordingWriter>();
+    res->UseWriter(writer);
+    cache->Send(file, *req, res.get());
+    return writer;
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(StaticCacheTest, CachesFileWithHeaders) {
+  wf::StaticCache cache;
+  std::filesystem::path path = WriteFile("style.css", "body {}");
+
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> first =
+    cache.Get(path);
+  ASSERT_TRUE(first.ok());
+  EXPECT_EQ(first.value()->body, "body {}");
+  EXPECT_EQ(first.value()->size, 7);
+  EXPECT_EQ(first.value()->mime_type, "text/css");
+  EXPECT_FALSE(first.value()->last_modified.empty());
+  EXPECT_FALSE(first.value()->etag.empty());
+  EXPECT_EQ(cache.Bytes(), 7);
+
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> second =
+    cache.Get(path);
+  ASSERT_TRUE(second.ok());
+  EXPECT_EQ(second.value(), first.value());
+}
+
+TEST_F(StaticCacheTest, ReloadsChangedFiles) {
+  wf::StaticCacheOptions options;
+  options.revalidate_interval = absl::ZeroDuration();
+  wf::StaticCache cache(options);
+
+  std::filesystem::path path = WriteFile("app.js", "one");
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> first =
+    cache.Get(path);
+  ASSERT_TRUE(first.ok());
+
+  // Replaced by a different file, as deploys tend to do.
+  std::filesystem::path next = WriteFile("app.js.new", "two!");
+  std::filesystem::rename(next, path);
+
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> second =
+    cache.Get(path);
+  ASSERT_TRUE(second.ok());
+  EXPECT_EQ(second.value()->body, "two!");
+  EXPECT_EQ(cache.Bytes(), 4);
+
+  std::filesystem::remove(path);
+  EXPECT_TRUE(absl::IsNotFound(cache.Get(path).status()));
+  EXPECT_EQ(cache.Bytes(), 0);
+}
+
+TEST_F(StaticCacheTest, EvictsLeastRecentlyUsed) {
+  wf::StaticCacheOptions options;
+  options.max_bytes = 10;
+  wf::StaticCache cache(options);
+
+  std::filesystem::path a = WriteFile("a.txt", "aaaa");
+  std::filesystem::path b = WriteFile("b.txt", "bbbb");
+  std::filesystem::path c = WriteFile("c.txt", "cccc");
+
+  std::shared_ptr<const wf::StaticAsset> first = cache.Get(a).value();
+  cache.Get(b).IgnoreError();
+  EXPECT_EQ(cache.Get(a).value(), first);
+
+  // b is the least recently used, so it makes room for c.
+  cache.Get(c).IgnoreError();
+  EXPECT_EQ(cache.Bytes(), 8);
+  EXPECT_EQ(cache.Get(a).value(), first);
+}
+
+TEST_F(StaticCacheTest, EvictsOnlyLargeFilesPastOpenFileBound) {
+  wf::StaticCacheOptions options;
+  options.max_file_size = 4;
+  options.max_open_files = 1;
+  wf::StaticCache cache(options);
+
+  std::filesystem::path small = WriteFile("small.txt", "tiny");
+  std::filesystem::path first = WriteFile("first.mp4", "too large");
+  std::filesystem::path second = WriteFile("second.mp4", "also too large");
+
+  std::shared_ptr<const wf::StaticAsset> kept = cache.Get(small).value();
+  std::shared_ptr<const wf::StaticAsset> evicted = cache.Get(first).value();
+  cache.Get(second).IgnoreError();
+
+  // The small file is the least recently used, but holds no descriptor.
+  EXPECT_EQ(cache.Get(small).value(), kept);
+  EXPECT_EQ(cache.Bytes(), 4);
+  EXPECT_NE(cache.Get(first).value(), evicted);
+}
+
+TEST_F(StaticCacheTest, SendsLargeFilesFromDisk) {
+  wf::StaticCacheOptions options;
+  options.max_file_size = 4;
+  wf::StaticCache cache(options);
+
+  std::filesystem::path path = WriteFile("video.mp4", "too large");
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> asset =
+    cache.Get(path);
+  ASSERT_TRUE(asset.ok());
+  EXPECT_TRUE(asset.value()->body.empty());
+  ASSERT_NE(asset.value()->file, nullptr);
+  EXPECT_EQ(asset.value()->size, 9);
+  EXPECT_EQ(asset.value()->etag, wf::StrongETag("too large"));
+  EXPECT_EQ(cache.Bytes(), 0);
+
+  // Kept open, so that the file isn't hashed again.
+  EXPECT_EQ(cache.Get(path).value(), asset.value());
+
+  EXPECT_TRUE(absl::IsFailedPrecondition(cache.Get(dir_).status()));
+}
+
+TEST_F(StaticCacheTest, MapsMidSizedFiles) {
+  wf::StaticCacheOptions options;
+  options.max_file_size = 4;
+  options.max_mapped_size = 64;
+  wf::StaticCache cache(options);
+
+  std::filesystem::path path = WriteFile("app.wasm", "mid-sized");
+  std::filesystem::create_hard_link(path, dir_ / "link.wasm");
+
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> asset =
+    cache.Get(path);
+  ASSERT_TRUE(asset.ok());
+  EXPECT_TRUE(asset.value()->body.empty());
+  EXPECT_EQ(asset.value()->file, nullptr);
+  ASSERT_NE(asset.value()->mapping, nullptr);
+  EXPECT_EQ(asset.value()->mapping->Contents(), "mid-sized");
+  EXPECT_EQ(cache.Bytes(), 0);
+
+  // Both names lead to the same file, so they share its mapping.
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> link =
+    cache.Get(dir_ / "link.wasm");
+  ASSERT_TRUE(link.ok());
+  EXPECT_EQ(link.value()->mapping, asset.value()->mapping);
+}
+
+TEST_F(StaticCacheTest, RemembersMisses) {
+  wf::StaticCacheOptions options;
+  options.revalidate_interval = absl::Hours(1);
+  wf::StaticCache trusting(options);
+  options.revalidate_interval = absl::ZeroDuration();
+  wf::StaticCache checking(options);
+
+  std::filesystem::path path = dir_ / "js" / "late.js";
+  EXPECT_TRUE(absl::IsNotFound(trusting.Get(path).status()));
+  EXPECT_TRUE(absl::IsNotFound(checking.Get(path).status()));
+
+  std::filesystem::create_directories(dir_ / "js");
+  WriteFile("js/late.js", "late");
+
+  // One still trusts its miss, the other notices the new directory.
+  EXPECT_TRUE(absl::IsNotFound(trusting.Get(path).status()));
+  EXPECT_TRUE(checking.Get(path).ok());
+}
+
+TEST_F(StaticCacheTest, FindsPrecompressedSiblings) {
+  wf::StaticCache cache;
+  std::filesystem::path path = WriteFile("app.js", "let x = 1;");
+  WriteFile("app.js.gz", "gzipped");
+  WriteFile("app.js.br", "brotli");
+
+  absl::StatusOr<std::shared_ptr<const wf::StaticAsset>> asset =
+    cache.Get(path);
+  ASSERT_TRUE(asset.ok());
+  EXPECT_EQ(asset.value()->encodings,
+            std::vector<std::string>({"br", "gzip"}));
+}
+
+TEST_F(StaticCacheTest, SendsOnlySiblingsLookedUpWithTheFile) {
+  wf::StaticCache cache;
+  std::filesystem::path path = WriteFile("app.js", "let x = 1;");
+  WriteFile("app.js.gz", "gzipped");
+  WriteFile("app.js.br", "brotli");
+
+  absl::StatusOr<wf::StaticFile> file = cache.GetFile(path);
+  ASSERT_TRUE(file.ok());
+  ASSERT_EQ(file.value().variants.size(), 2);
+
+  std::shared_ptr<RecordingWriter> writer =
+    Send(&cache, file.value(), {{"Accept-Encoding", "gzip, br"}});
+  EXPECT_EQ(writer->Header("content-encoding"), "br");
+  EXPECT_EQ(writer->body, "brotli");
+
+  // A sibling that wasn't found with the file isn't looked for again.
+  file.value().variants[0] = nullptr;
+  writer = Send(&cache, file.value(), {{"Accept-Encoding", "gzip, br"}});
+  EXPECT_EQ(writer->Header("content-encoding"), "gzip");
+  EXPECT_EQ(writer->body, "gzipped");
+
+  writer = Send(&cache, file.value(), {{"Accept-Encoding", "br"}});
+  EXPECT_EQ(writer->Header("content-encoding"), "");
+  EXPECT_EQ(writer->body, "let x = 1;");
+}
+
+TEST_F(StaticCacheTest, SendsSingleRange) {
+  wf::StaticCacheOptions options;
+  options.max_file_size = 10;
+  wf::StaticCache cache(options);
+
+  // Both from memory and from disk.
+  for (const std::string& name : {"digits.txt", "digits-large.txt"}) {
+    std::string contents = name == "digits.txt" ? "0123456789"
+                                                : "0123456789abcdef";
+    absl::StatusOr<wf::StaticFile> file =
+      cache.GetFile(WriteFile(name, contents));
+    ASSERT_TRUE(file.ok());
+
+    std::shared_ptr<RecordingWriter> writer =
+      Send(&cache, file.value(), {{"Range", "bytes=2-5"}});
+    EXPECT_EQ(writer->status, 206);
+    EXPECT_EQ(writer->Header("content-range"),
+              absl::StrCat("bytes 2-5/", contents.size()));
+    EXPECT_EQ(writer->Header("content-length"), "4");
+    EXPECT_EQ(writer->body, "2345");
+  }
+}
+
+TEST_F(StaticCacheTest, SendsMultipleRangesAsMultipart) {
+  wf::StaticCache cache;
+  absl::StatusOr<wf::StaticFile> file =
+    cache.GetFile(WriteFile("digits.txt", "0123456789"));
+  ASSERT_TRUE(file.ok());
+
+  std::shared_ptr<RecordingWriter> writer =
+    Send(&cache, file.value(), {{"Range", "bytes=0-1, 8-"}});
+  EXPECT_EQ(writer->status, 206);
+
+  std::string content_type = writer->Header("content-type");
+  std::string prefix = "multipart/byteranges; boundary=";
+  ASSERT_TRUE(absl::StartsWith(content_type, prefix));
+  std::string boundary = content_type.substr(
+    prefix.size(), content_type.find(';', prefix.size()) - prefix.size());
+
+  EXPECT_EQ(writer->body, absl::StrCat(
+    "--", boundary, "\r\n",
+    "Content-Type: text/plain; charset=utf-8\r\n",
+    "Content-Range: bytes 0-1/10\r\n\r\n",
+    "01\r\n",
+    "--", boundary, "\r\n",
+    "Content-Type: text/plain; charset=utf-8\r\n",
+    "Content-Range: bytes 8-9/10\r\n\r\n",
+    "89\r\n",
+    "--", boundary, "--\r\n"));
+  EXPECT_EQ(writer->Header("content-length"),
+            std::to_string(writer->body.size()));
+}
+
+TEST_F(StaticCacheTest, RejectsUnsatisfiableRanges) {
+  wf::StaticCache cache;
+  absl::StatusOr<wf::StaticFile> file =
+    cache.GetFile(WriteFile("digits.txt", "0123456789"));
+  ASSERT_TRUE(file.ok());
+
+  std::shared_ptr<RecordingWriter> writer =
+    Send(&cache, file.value(), {{"Range", "bytes=10-"}});
+  EXPECT_EQ(writer->status, 416);
+  EXPECT_EQ(writer->Header("content-range"), "bytes */10");
+  EXPECT_TRUE(writer->body.empty());
+}
+
+TEST_F(StaticCacheTest, SendsWholeFileWhenIfRangeDoesNotMatch) {
+  wf::StaticCache cache;
+  absl::StatusOr<wf::StaticFile> file =
+    cache.GetFile(WriteFile("digits.txt", "0123456789"));
+  ASSERT_TRUE(file.ok());
+
+  std::shared_ptr<RecordingWriter> writer = Send(&cache, file.value(), {
+    {"Range", "bytes=2-5"}, {"If-Range", "\"stale\""}});
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("content-range"), "");
+  EXPECT_EQ(writer->body, "0123456789");
+
+  writer = Send(&cache, file.value(), {
+    {"Range", "bytes=2-5"}, {"If-Range", file.value().asset->etag}});
+  EXPECT_EQ(writer->status, 206);
+  EXPECT_EQ(writer->body, "2345");
+}
+
+TEST_F(StaticCacheTest, IgnoresRangeOutsideGet) {
+  wf::StaticCache cache;
+  absl::StatusOr<wf::StaticFile> file =
+    cache.GetFile(WriteFile("digits.txt", "0123456789"));
+  ASSERT_TRUE(file.ok());
+
+  std::shared_ptr<RecordingWriter> writer =
+    Send(&cache, file.value(), {{"Range", "bytes=2-5"}}, "HEAD");
+  EXPECT_EQ(writer->status, 200);
+  EXPECT_EQ(writer->Header("content-range"), "");
+  EXPECT_EQ(writer->Header("content-length"), "10");
+}
+
+TEST_F(StaticCacheTest, LoadsOnIOPoolWithExecutor) {
+  wf::StaticCache cache;
+  std::filesystem::path path = WriteFile("lazy.css", "p {}");
+
+  absl::Mutex mutex;
+  std::vector<wf::FileIOPool::Task> posted;
+  wf::FileIOPool::ScopedExecutor executor([&](wf::FileIOPool::Task task) {
+    absl::MutexLock lock(&mutex);
+    posted.push_back(std::move(task));
+  });
+
+  // Not cached yet, so the file is loaded on the pool, and the result is only
+  // delivered through the executor.
+  absl::StatusOr<wf::StaticFile> file = absl::UnknownError("not called");
+  cache.GetAsync(path, [&](auto result) { file = std::move(result); });
+  EXPECT_TRUE(absl::IsUnknown(file.status()));
+
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(+[](std::vector<wf::FileIOPool::Task>* p) {
+      return !p->empty();
+    }, &posted));
+    posted.front()();
+  }
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ(file.value().asset->body, "p {}");
+
+  // Now it is, so the answer comes right away.
+  file = absl::UnknownError("not called");
+  cache.GetAsync(path, [&](auto result) { file = std::move(result); });
+  EXPECT_TRUE(file.ok());
+}
+
+TEST(ChooseEncodingTest, PrefersHighestQuality) {
+  std::vector<std::string> available = {"br", "zstd", "gzip"};
+
+  EXPECT_EQ(wf::ChooseEncoding("gzip, deflate, br", available), "br");
+  EXPECT_EQ(wf::ChooseEncoding("gzip;q=1.0, br;q=0.5", available), "gzip");
+  EXPECT_EQ(wf::ChooseEncoding("br;q=0, *;q=0.1", available), "zstd");
+  EXPECT_EQ(wf::ChooseEncoding("x-gzip", available), "gzip");
+  EXPECT_EQ(wf::ChooseEncoding("identity", available), "");
+  EXPECT_EQ(wf::ChooseEncoding("br", {"gzip"}), "");
+}
+
+TEST(ParseRangeTest, ResolvesRangesAgainstSize) {
+  std::vector<wf::ByteRange> ranges;
+
+  ASSERT_TRUE(wf::ParseRange("bytes=0-99, 900-, -50", 1000, &ranges).ok());
+  ASSERT_EQ(ranges.size(), 3);
+  EXPECT_EQ(ranges[0].offset, 0);
+  EXPECT_EQ(ranges[0].length, 100);
+  EXPECT_EQ(ranges[1].offset, 900);
+  EXPECT_EQ(ranges[1].length, 100);
+  EXPECT_EQ(ranges[2].offset, 950);
+  EXPECT_EQ(ranges[2].length, 50);
+
+  // Clamped to the end, with unsatisfiable ranges left out.
+  ASSERT_TRUE(wf::ParseRange("bytes=500-2000, 1000-", 1000, &ranges).ok());
+  ASSERT_EQ(ranges.size(), 1);
+  EXPECT_EQ(ranges[0].length, 500);
+
+  EXPECT_TRUE(absl::IsOutOfRange(
+    wf::ParseRange("bytes=1000-", 1000, &ranges)));
+  EXPECT_TRUE(absl::IsInvalidArgument(
+    wf::ParseRange("items=0-1", 1000, &ranges)));
+  EXPECT_TRUE(absl::IsInvalidArgument(
+    wf::ParseRange("bytes=5-1", 1000, &ranges)));
+  EXPECT_TRUE(absl::IsInvalidArgument(
+    wf::ParseRange("bytes=-", 1000, &ranges)));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,530 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_manifest.cc
+// -----------------------------------------------------------------------------
+//
+// Implements building, serializing and reading static manifests. The perfect
+// hash is built with "hash, displace and compress": keys are spread over
+// buckets, and each bucket, largest first, gets the first seed that sends all
+// of its keys to free slots.
+//
+
+#include "webforge/site/static_manifest.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/etag.h"
+#include "webforge/http/file.h"
+#include "webforge/http/strings.h"
+#include "webforge/site/static_cache.h"
+
+namespace wf {
+
+struct StaticManifest::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t bucket_count;
+  uint32_t variant_count;
+  uint64_t seeds_offset;
+  uint64_t entries_offset;
+  uint64_t variants_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+};
+
+struct StaticManifest::RawEntry {
+  uint32_t path_offset;
+  uint32_t path_size;
+  uint32_t mime_offset;
+  uint32_t mime_size;
+  uint32_t etag_offset;
+  uint32_t etag_size;
+  uint32_t variants_begin;
+  uint32_t variants_count;
+  uint64_t size;
+  int64_t mtime_nanos;
+};
+
+struct StaticManifest::RawVariant {
+  uint32_t coding_offset;
+  uint32_t coding_size;
+  uint32_t etag_offset;
+  uint32_t etag_size;
+  uint64_t size;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'W', 'F', 'S', 'T', 'A', 'T', 'I', 'C'};
+constexpr uint32_t kVersion = 1;
+
+// Keys per bucket, on average.
+constexpr std::size_t kBucketSize = 4;
+
+// Seeds tried per bucket before giving up.
+constexpr uint32_t kMaxSeed = 1 << 24;
+
+// How much of a file is read at a time to compute its ETag.
+constexpr std::size_t kHashBufferSize = 64 * 1024;
+
+// FNV-1a, finished with the MurmurHash3 mixer so that the low bits, which the
+// modulo keeps, depend on every byte. It has to stay the same for manifests to
+// stay readable.
+uint64_t Hash(absl::string_view key, uint32_t seed) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ULL;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+std::size_t AlignUp(std::size_t n) {
+  return (n + 7) & ~static_cast<std::size_t>(7);
+}
+
+// What a scan found out about a single file.
+struct ScannedFile {
+  std::size_t size;
+  absl::Time mtime;
+  std::string etag;
+};
+
+absl::StatusOr<ScannedFile> ScanFile(const std::filesystem::path& path) {
+  absl::StatusOr<std::shared_ptr<const File>> file = File::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  ScannedFile scanned;
+  scanned.size = file.value()->Size();
+  scanned.mtime = file.value()->ModifiedTime();
+
+  ETagHasher hasher;
+  std::string buffer(kHashBufferSize, '\0');
+  for (std::size_t offset = 0; offset < scanned.size;) {
+    absl::StatusOr<std::size_t> n = file.value()->Read(offset, buffer.size(),
+                                                       buffer.data());
+    if (!n.ok()) {
+      return n.status();
+    }
+
+    if (n.value() == 0) {
+      break;
+    }
+
+    hasher.Update(absl::string_view(buffer.data(), n.value()));
+    offset += n.value();
+  }
+
+  scanned.etag = hasher.Finish();
+  return scanned;
+}
+
+// Collects strings into one block, storing each distinct one once.
+class StringTable {
+public:
+  // Returns false if the table outgrew 32-bit offsets.
+  bool Add(absl::string_view s, uint32_t* offset, uint32_t* size) {
+    auto it = offsets_.find(s);
+    if (it == offsets_.end()) {
+      if (data_.size() + s.size() > UINT32_MAX) {
+        return false;
+      }
+
+      it = offsets_.emplace(std::string(s), data_.size()).first;
+      data_.append(s.data(), s.size());
+    }
+
+    *offset = it->second;
+    *size = s.size();
+    return true;
+  }
+
+  const std::string& Data() const {
+    return data_;
+  }
+
+private:
+  std::string data_;
+  absl::flat_hash_map<std::string, uint32_t> offsets_;
+};
+
+}
+
+absl::StatusOr<std::vector<ManifestEntry>> ScanStaticDirectory(
+  const std::filesystem::path& dir) {
+  std::error_code ec;
+  absl::flat_hash_map<std::string, ScannedFile> files;
+  for (std::filesystem::recursive_directory_iterator it(dir, ec), end;
+       !ec && it != end; it.increment(ec)) {
+    if (!it->is_regular_file(ec)) {
+      continue;
+    }
+
+    absl::StatusOr<ScannedFile> scanned = ScanFile(it->path());
+    if (!scanned.ok()) {
+      return scanned.status();
+    }
+
+    files.emplace(it->path().lexically_relative(dir).generic_string(),
+                  std::move(scanned).value());
+  }
+
+  if (ec) {
+    return absl::ErrnoToStatus(ec.value(),
+                               absl::StrCat("cannot scan ", dir.string()));
+  }
+
+  // Whether `sibling` is a precompressed variant of another file.
+  auto is_variant = [&files](const std::string& sibling,
+                             const ScannedFile& scanned) {
+    for (const StaticEncoding& encoding : StaticEncodings()) {
+      if (!absl::EndsWith(sibling, encoding.suffix)) {
+        continue;
+      }
+
+      auto it = files.find(absl::string_view(sibling).substr(
+        0, sibling.size() - encoding.suffix.size()));
+      if (it != files.end() && scanned.mtime >= it->second.mtime) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  std::vector<ManifestEntry> entries;
+  for (const auto& [path, scanned] : files) {
+    if (is_variant(path, scanned)) {
+      continue;
+    }
+
+    ManifestEntry entry;
+    entry.path = path;
+    entry.size = scanned.size;
+    entry.mtime = scanned.mtime;
+    entry.mime_type = GetMimeType(path);
+    entry.etag = scanned.etag;
+
+    for (const StaticEncoding& encoding : StaticEncodings()) {
+      auto it = files.find(absl::StrCat(path, encoding.suffix));
+      if (it != files.end() && it->second.mtime >= scanned.mtime) {
+        entry.variants.push_back(ManifestVariant{
+          std::string(encoding.coding), it->second.size, it->second.etag});
+      }
+    }
+
+    entries.push_back(std::move(entry));
+  }
+
+  // So that the same directory always makes the same manifest.
+  std::sort(entries.begin(), entries.end(),
+            [](const ManifestEntry& a, const ManifestEntry& b) {
+    return a.path < b.path;
+  });
+
+  return entries;
+}
+
+absl::StatusOr<std::string> SerializeStaticManifest(
+  const std::vector<ManifestEntry>& entries) {
+  std::size_t n = entries.size();
+  if (n > UINT32_MAX / 2) {
+    return absl::InvalidArgumentError("too many entries for a manifest");
+  }
+
+  // Spread the keys over buckets, and seed the largest buckets first, while
+  // there are still plenty of free slots.
+  uint32_t bucket_count = n / kBucketSize + 1;
+  std::vector<std::vector<uint32_t>> buckets(bucket_count);
+  for (uint32_t i = 0; i < n; ++i) {
+    buckets[Hash(entries[i].path, 0) % bucket_count].push_back(i);
+  }
+
+  std::vector<uint32_t> order(bucket_count);
+  for (uint32_t b = 0; b < bucket_count; ++b) {
+    order[b] = b;
+  }
+  std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a,
+                                                          uint32_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  std::vector<uint32_t> seeds(bucket_count, 0);
+  std::vector<uint32_t> slot_of(n);
+  std::vector<bool> taken(n, false);
+  std::vector<uint32_t> slots;
+  for (uint32_t b : order) {
+    if (buckets[b].empty()) {
+      break;
+    }
+
+    uint32_t seed = 1;
+    for (; seed < kMaxSeed; ++seed) {
+      slots.clear();
+      for (uint32_t i : buckets[b]) {
+        uint32_t slot = Hash(entries[i].path, seed) % n;
+        if (taken[slot] ||
+            std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          break;
+        }
+
+        slots.push_back(slot);
+      }
+
+      if (slots.size() == buckets[b].size()) {
+        break;
+      }
+    }
+
+    if (seed == kMaxSeed) {
+      return absl::InternalError("no perfect hash found for the manifest");
+    }
+
+    seeds[b] = seed;
+    for (std::size_t k = 0; k < slots.size(); ++k) {
+      taken[slots[k]] = true;
+      slot_of[buckets[b][k]] = slots[k];
+    }
+  }
+
+  // Lay the entries out in slot order, and their variants next to each other.
+  StringTable strings;
+  std::vector<StaticManifest::RawEntry> raw_entries(n);
+  std::vector<StaticManifest::RawVariant> raw_variants;
+  for (uint32_t i = 0; i < n; ++i) {
+    const ManifestEntry& entry = entries[i];
+    StaticManifest::RawEntry& raw = raw_entries[slot_of[i]];
+    raw.size = entry.size;
+    raw.mtime_nanos = absl::ToUnixNanos(entry.mtime);
+    raw.variants_begin = raw_variants.size();
+    raw.variants_count = entry.variants.size();
+
+    bool ok = strings.Add(entry.path, &raw.path_offset, &raw.path_size) &&
+              strings.Add(entry.mime_type, &raw.mime_offset, &raw.mime_size) &&
+              strings.Add(entry.etag, &raw.etag_offset, &raw.etag_size);
+    for (const ManifestVariant& variant : entry.variants) {
+      StaticManifest::RawVariant& raw_variant = raw_variants.emplace_back();
+      raw_variant.size = variant.size;
+      ok = ok && strings.Add(variant.coding, &raw_variant.coding_offset,
+                             &raw_variant.coding_size) &&
+           strings.Add(variant.etag, &raw_variant.etag_offset,
+                       &raw_variant.etag_size);
+    }
+
+    if (!ok) {
+      return absl::InvalidArgumentError("too much text for a manifest");
+    }
+  }
+
+  StaticManifest::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entry_count = n;
+  header.bucket_count = bucket_count;
+  header.variant_count = raw_variants.size();
+  header.seeds_offset = sizeof(header);
+  header.entries_offset = AlignUp(header.seeds_offset +
+                                  bucket_count * sizeof(uint32_t));
+  header.variants_offset = header.entries_offset +
+                           n * sizeof(StaticManifest::RawEntry);
+  header.strings_offset = header.variants_offset +
+                          raw_variants.size() *
+                          sizeof(StaticManifest::RawVariant);
+  header.strings_size = strings.Data().size();
+
+  std::string out(header.strings_offset + header.strings_size, '\0');
+  memcpy(out.data(), &header, sizeof(header));
+  memcpy(out.data() + header.seeds_offset, seeds.data(),
+         seeds.size() * sizeof(uint32_t));
+  memcpy(out.data() + header.entries_offset, raw_entries.data(),
+         raw_entries.size() * sizeof(StaticManifest::RawEntry));
+  memcpy(out.data() + header.variants_offset, raw_variants.data(),
+         raw_variants.size() * sizeof(StaticManifest::RawVariant));
+  memcpy(out.data() + header.strings_offset, strings.Data().data(),
+         strings.Data().size());
+  return out;
+}
+
+absl::StatusOr<std::unique_ptr<StaticManifest>> StaticManifest::Open(
+  const std::filesystem::path& path) {
+  absl::StatusOr<std::shared_ptr<const File>> file = File::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  absl::StatusOr<std::shared_ptr<const MappedFile>> mapping =
+    MappedFile::Map(*file.value());
+  if (!mapping.ok()) {
+    return mapping.status();
+  }
+
+  std::unique_ptr<StaticManifest> manifest(
+    new StaticManifest(std::move(mapping).value()));
+  absl::Status s = manifest->Validate();
+  if (!s.ok()) {
+    return s;
+  }
+
+  return manifest;
+}
+
+StaticManifest::StaticManifest(std::shared_ptr<const MappedFile> mapping) :
+  mapping_(std::move(mapping)), header_(nullptr), seeds_(nullptr),
+  entries_(nullptr), variants_(nullptr) {
+  // Nothing to do.
+}
+
+std::size_t StaticManifest::Size() const {
+  return header_->entry_count;
+}
+
+bool StaticManifest::Find(absl::string_view path, std::size_t* index) const {
+  if (header_->entry_count == 0) {
+    return false;
+  }
+
+  uint32_t seed = seeds_[Hash(path, 0) % header_->bucket_count];
+  std::size_t slot = Hash(path, seed) % header_->entry_count;
+
+  // Paths that aren't in the manifest land on some entry too.
+  const RawEntry& entry = entries_[slot];
+  if (String(entry.path_offset, entry.path_size) != path) {
+    return false;
+  }
+
+  *index = slot;
+  return true;
+}
+
+ManifestEntry StaticManifest::Entry(std::size_t index) const {
+  const RawEntry& raw = entries_[index];
+
+  ManifestEntry entry;
+  entry.path = std::string(String(raw.path_offset, raw.path_size));
+  entry.size = raw.size;
+  entry.mtime = absl::FromUnixNanos(raw.mtime_nanos);
+  entry.mime_type = std::string(String(raw.mime_offset, raw.mime_size));
+  entry.etag = std::string(String(raw.etag_offset, raw.etag_size));
+
+  for (uint32_t i = 0; i < raw.variants_count; ++i) {
+    const RawVariant& variant = variants_[raw.variants_begin + i];
+    entry.variants.push_back(ManifestVariant{
+      std::string(String(variant.coding_offset, variant.coding_size)),
+      variant.size,
+      std::string(String(variant.etag_offset, variant.etag_size))});
+  }
+
+  return entry;
+}
+
+absl::Status StaticManifest::Validate() {
+  absl::string_view data = mapping_->Contents();
+  if (data.size() < sizeof(Header)) {
+    return absl::DataLossError("manifest is truncated");
+  }
+
+  header_ = reinterpret_cast<const Header*>(data.data());
+  if (memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0) {
+    return absl::InvalidArgumentError("not a static manifest");
+  }
+
+  if (header_->version != kVersion) {
+    return absl::FailedPreconditionError("unsupported manifest version");
+  }
+
+  // Every section has to lie within the file, in order, and aligned.
+  uint64_t size = data.size();
+  const Header& h = *header_;
+  if (h.bucket_count == 0 || h.seeds_offset != sizeof(Header) ||
+      h.entries_offset % 8 != 0 ||
+      h.entries_offset < h.seeds_offset +
+                         uint64_t{h.bucket_count} * sizeof(uint32_t) ||
+      h.variants_offset != h.entries_offset +
+                           uint64_t{h.entry_count} * sizeof(RawEntry) ||
+      h.strings_offset != h.variants_offset +
+                          uint64_t{h.variant_count} * sizeof(RawVariant) ||
+      h.strings_offset > size || h.strings_size != size - h.strings_offset) {
+    return absl::DataLossError("manifest sections are corrupt");
+  }
+
+  seeds_ = reinterpret_cast<const uint32_t*>(data.data() + h.seeds_offset);
+  entries_ = reinterpret_cast<const RawEntry*>(data.data() + h.entries_offset);
+  variants_ = reinterpret_cast<const RawVariant*>(data.data() +
+                                                  h.variants_offset);
+  strings_ = data.substr(h.strings_offset);
+
+  // Checked once here, so that lookups don't have to.
+  auto in_strings = [this](uint32_t offset, uint32_t size) {
+    return uint64_t{offset} + size <= strings_.size();
+  };
+
+  for (uint32_t i = 0; i < h.entry_count; ++i) {
+    const RawEntry& entry = entries_[i];
+    if (!in_strings(entry.path_offset, entry.path_size) ||
+        !in_strings(entry.mime_offset, entry.mime_size) ||
+        !in_strings(entry.etag_offset, entry.etag_size) ||
+        uint64_t{entry.variants_begin} + entry.variants_count >
+          h.variant_count) {
+      return absl::DataLossError("manifest entry is corrupt");
+    }
+  }
+
+  for (uint32_t i = 0; i < h.variant_count; ++i) {
+    const RawVariant& variant = variants_[i];
+    if (!in_strings(variant.coding_offset, variant.coding_size) ||
+        !in_strings(variant.etag_offset, variant.etag_size)) {
+      return absl::DataLossError("manifest variant is corrupt");
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+absl::string_view StaticManifest::String(uint32_t offset,
+                                         uint32_t size) const {
+  return strings_.substr(offset, size);
+}
+
+}
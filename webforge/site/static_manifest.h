@@ -0,0 +1,135 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_manifest.h
+// -----------------------------------------------------------------------------
+//
+// A static manifest is a prebuilt index of a directory of static files, for
+// deploys whose assets are fixed at release time. It records everything that
+// wf::StaticCache would otherwise find out on the request path: each file's
+// size, mtime, MIME type and ETag, and the same for its precompressed siblings.
+//
+// Manifests are built by `webforge manifest` (see wf::ScanStaticDirectory and
+// wf::SerializeStaticManifest) and read by wf::ManifestStaticMiddleware, which
+// maps them in with a single mmap(2) and finds paths through a minimal perfect
+// hash table, so that looking a path up never allocates or touches the
+// filesystem.
+//
+// The format is, in the byte order of the machine that built it:
+//
+// - A 64-byte header: the magic "WFSTATIC", a version, the entry, bucket and
+//   variant counts, and the offsets of the sections below.
+// - One 32-bit seed per hash bucket. A path's bucket is its unseeded hash
+//   modulo the bucket count, and its entry is its hash with the bucket's seed
+//   modulo the entry count.
+// - The entries, in hash table order.
+// - The precompressed variants of every entry, grouped by entry.
+// - The strings (paths, MIME types, ETags and content codings) the entries and
+//   variants point into.
+//
+
+#ifndef WEBFORGE_SITE_STATIC_MANIFEST_H_
+#define WEBFORGE_SITE_STATIC_MANIFEST_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+#include "webforge/http/file.h"
+
+namespace wf {
+
+// A precompressed sibling of a static file.
+struct ManifestVariant {
+  std::string coding;  // e.g. "gzip"
+  std::size_t size;
+  std::string etag;
+};
+
+// A static file, as recorded in a manifest.
+struct ManifestEntry {
+  std::string path;  // Relative to the directory, with '/' separators
+  std::size_t size;
+  absl::Time mtime;
+  std::string mime_type;
+  std::string etag;
+  std::vector<ManifestVariant> variants;  // In order of preference
+};
+
+// Walks `dir` and describes every regular file in it. Precompressed siblings
+// (see wf::StaticEncodings) are listed as variants of the file they belong to,
+// if it exists and they are at least as new, and as files of their own
+// otherwise.
+absl::StatusOr<std::vector<ManifestEntry>> ScanStaticDirectory(
+  const std::filesystem::path& dir);
+
+// Serializes `entries` into a manifest. Fails if no perfect hash could be found
+// for their paths, which in practice never happens.
+absl::StatusOr<std::string> SerializeStaticManifest(
+  const std::vector<ManifestEntry>& entries);
+
+class StaticManifest {
+public:
+  // Maps in and validates the manifest at `path`.
+  static absl::StatusOr<std::unique_ptr<StaticManifest>> Open(
+    const std::filesystem::path& path);
+
+  StaticManifest(const StaticManifest&) = delete;
+  StaticManifest& operator=(const StaticManifest&) = delete;
+
+  // Number of entries.
+  std::size_t Size() const;
+
+  // Finds the entry for `path`, and sets `index` to its position. Returns false
+  // if the manifest has no such path.
+  bool Find(absl::string_view path, std::size_t* index) const;
+
+  // Decodes the entry at `index`, which must be less than Size().
+  ManifestEntry Entry(std::size_t index) const;
+
+private:
+  struct Header;
+  struct RawEntry;
+  struct RawVariant;
+
+  friend absl::StatusOr<std::string> SerializeStaticManifest(
+    const std::vector<ManifestEntry>& entries);
+
+  explicit StaticManifest(std::shared_ptr<const MappedFile> mapping);
+
+  absl::Status Validate();
+  absl::string_view String(uint32_t offset, uint32_t size) const;
+
+  std::shared_ptr<const MappedFile> mapping_;
+  const Header* header_;
+  const uint32_t* seeds_;
+  const RawEntry* entries_;
+  const RawVariant* variants_;
+  absl::string_view strings_;
+};
+
+}
+
+#endif  // WEBFORGE_SITE_STATIC_MANIFEST_H_
@@ -0,0 +1,267 @@
+// Copyright (C) 2025 Adrian Gjerstad
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+// File: static_manifest_test.cc
+// -----------------------------------------------------------------------------
+//
+// This file tests building, writing and reading static manifests, and serving
+// them with wf::ManifestStaticMiddleware.
+//
+
+#include "webforge/site/static_manifest.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include <gtest/gtest.h>
+
+#include "webforge/http/file_io_pool.h"
+#include "webforge/http/http.h"
+#include "webforge/site/middleware.h"
+
+// Collects the body of a response.
+class BodyWriter : public wf::ResponseWriter {
+public:
+  absl::Status WriteHead(const wf::Response& res) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteChunk(absl::string_view chunk) override {
+    body_.append(chunk.data(), chunk.size());
+    return absl::OkStatus();
+  }
+
+  void End() override {}
+
+  const std::string& Body() const {
+    return body_;
+  }
+
+private:
+  std::string body_;
+};
+
+class StaticManifestTest : public testing::Test {
+protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(testing::TempDir()) / "static_manifest_test";
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_ / "files" / "css");
+  }
+
+  void WriteFile(const std::filesystem::path& path,
+                 const std::string& contents) {
+    std::ofstream(path, std::ios::binary) << contents;
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(StaticManifestTest, IndexesDirectory) {
+  WriteFile(dir_ / "files" / "index.html", "<p>hi</p>");
+  WriteFile(dir_ / "files" / "css" / "app.css", "body {}");
+  WriteFile(dir_ / "files" / "css" / "app.css.gz", "gzipped");
+
+  absl::StatusOr<std::vector<wf::ManifestEntry>> entries =
+    wf::ScanStaticDirectory(dir_ / "files");
+  ASSERT_TRUE(entries.ok());
+  ASSERT_EQ(entries->size(), 2);
+
+  absl::StatusOr<std::string> bytes = wf::SerializeStaticManifest(*entries);
+  ASSERT_TRUE(bytes.ok());
+  WriteFile(dir_ / "manifest", *bytes);
+
+  absl::StatusOr<std::unique_ptr<wf::StaticManifest>> manifest =
+    wf::StaticManifest::Open(dir_ / "manifest");
+  ASSERT_TRUE(manifest.ok());
+  EXPECT_EQ(manifest.value()->Size(), 2);
+
+  std::size_t index;
+  ASSERT_TRUE(manifest.value()->Find("css/app.css", &index));
+  wf::ManifestEntry entry = manifest.value()->Entry(index);
+  EXPECT_EQ(entry.path, "css/app.css");
+  EXPECT_EQ(entry.size, 7);
+  EXPECT_EQ(entry.mime_type, "text/css");
+  EXPECT_EQ(entry.etag, (*entries)[0].etag);
+  ASSERT_EQ(entry.variants.size(), 1);
+  EXPECT_EQ(entry.variants[0].coding, "gzip");
+  EXPECT_EQ(entry.variants[0].size, 7);
+
+  EXPECT_TRUE(manifest.value()->Find("index.html", &index));
+  EXPECT_FALSE(manifest.value()->Find("css/app.css.gz", &index));
+  EXPECT_FALSE(manifest.value()->Find("missing.js", &index));
+}
+
+TEST_F(StaticManifestTest, FindsEveryEntryOfLargeManifest) {
+  std::vector<wf::ManifestEntry> entries(5000);
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    entries[i].path = "assets/" + std::to_string(i) + ".js";
+    entries[i].size = i;
+    entries[i].mime_type = "text/javascript";
+    entries[i].etag = "\"" + std::to_string(i) + "\"";
+  }
+
+  absl::StatusOr<std::string> bytes = wf::SerializeStaticManifest(entries);
+  ASSERT_TRUE(bytes.ok());
+  WriteFile(dir_ / "manifest", *bytes);
+
+  absl::StatusOr<std::unique_ptr<wf::StaticManifest>> manifest =
+    wf::StaticManifest::Open(dir_ / "manifest");
+  ASSERT_TRUE(manifest.ok());
+
+  for (const wf::ManifestEntry& entry : entries) {
+    std::size_t index;
+    ASSERT_TRUE(manifest.value()->Find(entry.path, &index)) << entry.path;
+    EXPECT_EQ(manifest.value()->Entry(index).size, entry.size);
+  }
+}
+
+TEST_F(StaticManifestTest, RejectsCorruptManifests) {
+  absl::StatusOr<std::string> bytes = wf::SerializeStaticManifest({});
+  ASSERT_TRUE(bytes.ok());
+
+  WriteFile(dir_ / "truncated", bytes->substr(0, 20));
+  EXPECT_FALSE(wf::StaticManifest::Open(dir_ / "truncated").ok());
+
+  WriteFile(dir_ / "garbage", std::string(bytes->size(), 'x'));
+  EXPECT_FALSE(wf::StaticManifest::Open(dir_ / "garbage").ok());
+
+  WriteFile(dir_ / "empty", *bytes);
+  absl::StatusOr<std::unique_ptr<wf::StaticManifest>> manifest =
+    wf::StaticManifest::Open(dir_ / "empty");
+  ASSERT_TRUE(manifest.ok());
+
+  std::size_t index;
+  EXPECT_FALSE(manifest.value()->Find("anything", &index));
+}
+
+TEST_F(StaticManifestTest, MiddlewareOpensFilesThatWerentReadWhenRequested) {
+  WriteFile(dir_ / "files" / "small.txt", "small");
+  WriteFile(dir_ / "files" / "large.txt", std::string(100, 'l'));
+  WriteFile(dir_ / "files" / "other.txt", std::string(10, 'o'));
+  WriteFile(dir_ / "files" / "other.txt.gz", "gzipped");
+
+  absl::StatusOr<std::vector<wf::ManifestEntry>> entries =
+    wf::ScanStaticDirectory(dir_ / "files");
+  ASSERT_TRUE(entries.ok());
+  absl::StatusOr<std::string> bytes = wf::SerializeStaticManifest(*entries);
+  ASSERT_TRUE(bytes.ok());
+  WriteFile(dir_ / "manifest", *bytes);
+
+  // Only small.txt fits in memory, and only one file is kept open at a time.
+  wf::ManifestStaticOptions options;
+  options.max_bytes = 8;
+  options.max_file_size = 50;
+  options.max_open_files = 1;
+  absl::StatusOr<std::unique_ptr<wf::ManifestStaticMiddleware>> middleware =
+    wf::ManifestStaticMiddleware::Create(dir_ / "manifest", dir_ / "files",
+                                         "/", options);
+  ASSERT_TRUE(middleware.ok()) << middleware.status();
+
+  auto get = [&](absl::string_view path, absl::string_view accept_encoding) {
+    auto req = std::make_shared<wf::Request>();
+    req->Method("GET");
+    req->Path(path);
+    req->Version("HTTP/1.1");
+    if (!accept_encoding.empty()) {
+      req->Header("Accept-Encoding", accept_encoding);
+    }
+
+    auto res = std::make_shared<wf::Response>();
+    auto writer = std::make_shared<BodyWriter>();
+    res->UseWriter(writer);
+
+    absl::Status next_status = absl::OkStatus();
+    (**middleware)(req, res, [&](absl::Status s) { next_status = s; });
+    EXPECT_TRUE(next_status.ok()) << next_status;
+    return writer->Body();
+  };
+
+  EXPECT_EQ(get("/small.txt", ""), "small");
+  EXPECT_EQ(get("/large.txt", ""), std::string(100, 'l'));
+  EXPECT_EQ(get("/other.txt", ""), std::string(10, 'o'));
+  EXPECT_EQ(get("/other.txt", "gzip"), "gzipped");
+  EXPECT_EQ(get("/large.txt", ""), std::string(100, 'l'));
+}
+
+TEST_F(StaticManifestTest, MiddlewareOpensFilesOnIOPool) {
+  WriteFile(dir_ / "files" / "large.txt", std::string(100, 'l'));
+
+  absl::StatusOr<std::vector<wf::ManifestEntry>> entries =
+    wf::ScanStaticDirectory(dir_ / "files");
+  ASSERT_TRUE(entries.ok());
+  absl::StatusOr<std::string> bytes = wf::SerializeStaticManifest(*entries);
+  ASSERT_TRUE(bytes.ok());
+  WriteFile(dir_ / "manifest", *bytes);
+
+  wf::ManifestStaticOptions options;
+  options.max_file_size = 50;
+  absl::StatusOr<std::unique_ptr<wf::ManifestStaticMiddleware>> middleware =
+    wf::ManifestStaticMiddleware::Create(dir_ / "manifest", dir_ / "files",
+                                         "/", options);
+  ASSERT_TRUE(middleware.ok()) << middleware.status();
+
+  absl::Mutex mutex;
+  std::vector<wf::FileIOPool::Task> posted;
+  wf::FileIOPool::ScopedExecutor executor([&](wf::FileIOPool::Task task) {
+    absl::MutexLock lock(&mutex);
+    posted.push_back(std::move(task));
+  });
+
+  auto get = [&]() {
+    auto req = std::make_shared<wf::Request>();
+    req->Method("GET");
+    req->Path("/large.txt");
+    req->Version("HTTP/1.1");
+
+    auto res = std::make_shared<wf::Response>();
+    auto writer = std::make_shared<BodyWriter>();
+    res->UseWriter(writer);
+    (**middleware)(req, res, [](absl::Status s) {
+      ADD_FAILURE() << "passed on: " << s;
+    });
+    return writer;
+  };
+
+  // The file isn't open yet, so the response waits for the pool to open it,
+  // and only goes out once the executor runs the rest of the request.
+  std::shared_ptr<BodyWriter> first = get();
+  EXPECT_TRUE(first->Body().empty());
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(+[](std::vector<wf::FileIOPool::Task>* p) {
+      return !p->empty();
+    }, &posted));
+    posted.front()();
+  }
+  EXPECT_EQ(first->Body(), std::string(100, 'l'));
+
+  // Now it is, so the response goes out right away.
+  EXPECT_EQ(get()->Body(), std::string(100, 'l'));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}